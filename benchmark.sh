@@ -21,8 +21,8 @@ run_benchmark() {
 
 mkdir -p tmp
 
-# TODO:   './flatcv imgs/parrot_hq.jpeg rotate 90 tmp/rotate_flatcv.jpeg' \
 run_benchmark "Rotate" \
+  './flatcv imgs/parrot_hq.jpeg rotate 90 tmp/rotate_flatcv.jpeg' \
   'gm convert imgs/parrot_hq.jpeg -rotate 90 tmp/rotate_gm.jpeg' \
   'magick convert imgs/parrot_hq.jpeg -rotate 90 tmp/rotate_magick.jpeg' \
   'vips rot imgs/parrot_hq.jpeg tmp/rotate_vips.jpeg d90'
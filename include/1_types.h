@@ -21,3 +21,30 @@ typedef struct {
   double m10, m11, m12;
   double m20, m21, m22;
 } Matrix3x3;
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride; // Number of 64-bit words per row
+  uint64_t *data;  // Pixel (x, y) is bit x % 64 of data[y * stride + x / 64]
+} FCVBinaryImage;
+
+typedef struct {
+  uint32_t offset; // Index of the top-left source pixel (UINT32_MAX: outside)
+  uint16_t dx;     // Horizontal weight of the right neighbours (1/65536)
+  uint16_t dy;     // Vertical weight of the bottom neighbours (1/65536)
+} FCVRemapEntry;
+
+typedef struct {
+  uint32_t in_width;
+  uint32_t in_height;
+  uint32_t out_width;
+  uint32_t out_height;
+  FCVRemapEntry *entries; // One entry per output pixel
+} FCVRemapTable;
+
+typedef enum {
+  FCV_INTERPOLATION_NEAREST,
+  FCV_INTERPOLATION_BILINEAR,
+  FCV_INTERPOLATION_BICUBIC
+} FCVInterpolation;
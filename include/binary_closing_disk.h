@@ -4,6 +4,10 @@
 
 #include <stdint.h>
 
+#ifndef FLATCV_AMALGAMATION
+#include "1_types.h"
+#endif
+
 uint8_t *fcv_binary_dilation_disk(
   uint8_t const *image_data,
   int32_t width,
@@ -31,3 +35,21 @@ uint8_t *fcv_binary_opening_disk(
   int32_t height,
   int32_t radius
 );
+
+/*
+ * Variants operating on bit-packed binary images (see binary_image.h).
+ * They produce the same result as the byte versions above,
+ * but process 64 pixels per word operation.
+ */
+
+FCVBinaryImage *
+fcv_binary_dilation_disk_packed(FCVBinaryImage const *image, int32_t radius);
+
+FCVBinaryImage *
+fcv_binary_erosion_disk_packed(FCVBinaryImage const *image, int32_t radius);
+
+FCVBinaryImage *
+fcv_binary_closing_disk_packed(FCVBinaryImage const *image, int32_t radius);
+
+FCVBinaryImage *
+fcv_binary_opening_disk_packed(FCVBinaryImage const *image, int32_t radius);
@@ -0,0 +1,60 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdint.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "1_types.h"
+#endif
+
+/**
+ * Number of set bits in a word of a bit-packed row.
+ */
+static inline uint32_t fcv_popcount_u64(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return (uint32_t)__builtin_popcountll(word);
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (uint32_t)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * Allocate a bit-packed binary image with all pixels set to black.
+ * Call fcv_free_binary_image to release it.
+ */
+FCVBinaryImage *fcv_binary_image_new(uint32_t width, uint32_t height);
+
+void fcv_free_binary_image(FCVBinaryImage *image);
+
+/**
+ * Pack a single-channel 0/255 image into 1 bit per pixel.
+ * Only pixels with value 255 are set (same rule as the disk morphology).
+ */
+FCVBinaryImage *fcv_pack_binary(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data
+);
+
+/**
+ * Unpack a bit-packed image into a single-channel 0/255 image.
+ */
+uint8_t *fcv_unpack_binary(FCVBinaryImage const *image);
+
+FCVBinaryImage *
+fcv_binary_and(FCVBinaryImage const *a, FCVBinaryImage const *b);
+
+FCVBinaryImage *
+fcv_binary_or(FCVBinaryImage const *a, FCVBinaryImage const *b);
+
+FCVBinaryImage *
+fcv_binary_xor(FCVBinaryImage const *a, FCVBinaryImage const *b);
+
+/**
+ * Count the set (white) pixels.
+ */
+uint64_t fcv_binary_count(FCVBinaryImage const *image);
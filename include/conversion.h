@@ -12,12 +12,27 @@ uint8_t *fcv_apply_gaussian_blur(
   uint8_t const * const data
 );
 
+bool fcv_apply_gaussian_blur_into(
+  uint32_t width,
+  uint32_t height,
+  double radius,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
 uint8_t *fcv_grayscale(
   uint32_t width,
   uint32_t height,
   uint8_t const * const data
 );
 
+void fcv_grayscale_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
 uint8_t *fcv_grayscale_stretch(
   uint32_t width,
   uint32_t height,
@@ -53,3 +68,14 @@ uint8_t *fcv_resize(
   uint32_t* out_height,
   uint8_t const * const data
 );
+
+bool fcv_resize_into(
+  uint32_t width,
+  uint32_t height,
+  double scale_x,
+  double scale_y,
+  uint32_t out_width,
+  uint32_t out_height,
+  uint8_t const * const data,
+  uint8_t *out
+);
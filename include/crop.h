@@ -2,6 +2,7 @@
 #pragma once
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 uint8_t *fcv_crop(
@@ -14,3 +15,15 @@ uint8_t *fcv_crop(
   uint32_t new_width,
   uint32_t new_height
 );
+
+bool fcv_crop_into(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const * const data,
+  uint32_t x,
+  uint32_t y,
+  uint32_t new_width,
+  uint32_t new_height,
+  uint8_t *out
+);
@@ -0,0 +1,89 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Exact squared Euclidean distance transform of a single-channel image.
+ *
+ * Computes for every pixel the squared distance to the nearest feature pixel
+ * in O(width * height) (Felzenszwalb & Huttenlocher).
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the single-channel pixel data.
+ * @param feature_is_white If true, features are white (255) pixels,
+ *        otherwise all pixels that are not white.
+ * @param nearest Optional (may be NULL) array of width * height entries.
+ *        Receives the index (y * width + x) of the nearest feature pixel,
+ *        or -1 if the image has no feature pixels.
+ * @return Squared distances (INT32_MAX if there are no feature pixels),
+ *         clamped to INT32_MAX - 1.
+ */
+int32_t *fcv_distance_transform_sq(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  bool feature_is_white,
+  int64_t *nearest
+);
+
+/**
+ * Exact Euclidean distance transform of a single-channel image.
+ * Same as fcv_distance_transform_sq, but returns the distances
+ * (INFINITY if there are no feature pixels).
+ */
+float *fcv_distance_transform(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  bool feature_is_white,
+  int64_t *nearest
+);
+
+/**
+ * Column pass of fcv_distance_transform_sq for the columns
+ * x_start <= x < x_end. Writes the vertical distance to the nearest
+ * feature in the same column (INT32_MAX if there is none) into `dist`,
+ * and the row of that feature (or -1) into `nearest`.
+ *
+ * Disjoint column ranges can be processed in parallel.
+ * All columns must be done before fcv_distance_transform_rows runs.
+ *
+ * @param dist Array of width * height entries.
+ * @param nearest Optional (may be NULL) array of width * height entries.
+ * @return False on invalid input or if memory ran out.
+ */
+bool fcv_distance_transform_columns(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *data,
+  bool feature_is_white,
+  uint32_t x_start,
+  uint32_t x_end,
+  int32_t *dist,
+  int64_t *nearest
+);
+
+/**
+ * Row pass of fcv_distance_transform_sq for the rows y_start <= y < y_end.
+ * Replaces the column distances of fcv_distance_transform_columns
+ * with the squared distances, and the rows in `nearest`
+ * with the indices of the nearest feature pixels.
+ *
+ * Disjoint row ranges can be processed in parallel.
+ *
+ * @param dist Output of fcv_distance_transform_columns.
+ * @param nearest Output of fcv_distance_transform_columns, or NULL.
+ * @return False on invalid input or if memory ran out.
+ */
+bool fcv_distance_transform_rows(
+  uint32_t width,
+  uint32_t height,
+  uint32_t y_start,
+  uint32_t y_end,
+  int32_t *dist,
+  int64_t *nearest
+);
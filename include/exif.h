@@ -2,6 +2,7 @@
 #pragma once
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -11,3 +12,13 @@
  * @return Orientation value (1-8), or 1 if not found or error.
  */
 int32_t fcv_get_exif_orientation(char const *filename);
+
+/**
+ * Get EXIF orientation from a JPEG file in memory,
+ * e.g. the buffer that is also passed to the decoder.
+ *
+ * @param data Contents of the file.
+ * @param size Size of the data in bytes.
+ * @return Orientation value (1-8), or 1 if not found, not a JPEG or error.
+ */
+int32_t fcv_get_exif_orientation_mem(uint8_t const *data, size_t size);
@@ -2,6 +2,7 @@
 #pragma once
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 uint8_t *fcv_flip_x(
@@ -10,20 +11,54 @@ uint8_t *fcv_flip_x(
   uint8_t const * const data
 );
 
+void fcv_flip_x_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
 uint8_t *fcv_flip_y(
   uint32_t width,
   uint32_t height,
   uint8_t const * const data
 );
 
+void fcv_flip_y_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
+void fcv_reverse_pixels(uint8_t *data, size_t count);
+
+void fcv_flip_x_in_place(uint32_t width, uint32_t height, uint8_t *data);
+
+void fcv_flip_y_in_place(uint32_t width, uint32_t height, uint8_t *data);
+
 uint8_t *fcv_transpose(
   uint32_t width,
   uint32_t height,
   uint8_t const * const data
 );
 
+void fcv_transpose_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
 uint8_t *fcv_transverse(
   uint32_t width,
   uint32_t height,
   uint8_t const * const data
 );
+
+void fcv_transverse_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
@@ -0,0 +1,98 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdint.h>
+
+/*
+ * Grayscale morphology on single-channel images.
+ *
+ * Erosion is a minimum filter and dilation a maximum filter over the
+ * structuring element. Pixels outside the image are ignored.
+ * Every pass runs in O(1) per pixel regardless of the window size
+ * (van Herk / Gil-Werman).
+ */
+
+/**
+ * Minimum filter with a kernel_width x kernel_height rectangle,
+ * anchored at ((kernel_width - 1) / 2, (kernel_height - 1) / 2).
+ */
+uint8_t *fcv_grayscale_erosion_rect(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t kernel_width,
+  int32_t kernel_height
+);
+
+/**
+ * Maximum filter with a kernel_width x kernel_height rectangle,
+ * anchored at ((kernel_width - 1) / 2, (kernel_height - 1) / 2).
+ */
+uint8_t *fcv_grayscale_dilation_rect(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t kernel_width,
+  int32_t kernel_height
+);
+
+/**
+ * Minimum filter with a disk of the given radius.
+ * Small disks are exact, larger ones are approximated by
+ * a union of at most 8 inscribed rectangles.
+ */
+uint8_t *fcv_grayscale_erosion_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+);
+
+/**
+ * Maximum filter with a disk of the given radius
+ * (same disk approximation as fcv_grayscale_erosion_disk).
+ */
+uint8_t *fcv_grayscale_dilation_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+);
+
+uint8_t *fcv_grayscale_opening_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+);
+
+uint8_t *fcv_grayscale_closing_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+);
+
+/**
+ * White top-hat: image minus its opening.
+ * Extracts bright details smaller than the disk.
+ */
+uint8_t *fcv_white_top_hat_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+);
+
+/**
+ * Black top-hat: closing minus the image.
+ * Extracts dark details (e.g. text) smaller than the disk
+ * while removing an unevenly lit background.
+ */
+uint8_t *fcv_black_top_hat_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+);
@@ -0,0 +1,32 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Encode the first channel of an image as baseline JPEG
+ * with a single (grayscale) component.
+ *
+ * Compared to a 3 component JPEG of a gray image, this skips the color
+ * conversion and the chroma blocks, so it is faster and smaller.
+ * Quality uses the same scale as libjpeg and stb_image_write.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels of the pixel data (only the first
+ *        one is encoded).
+ * @param data Pixel data.
+ * @param quality Quality from 1 (smallest) to 100 (best).
+ * @param out_size Receives the size of the JPEG file in bytes.
+ * @return JPEG file contents or NULL on invalid input.
+ */
+uint8_t *fcv_encode_jpeg_gray(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  int32_t quality,
+  size_t *out_size
+);
@@ -0,0 +1,123 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  FCV_NETPBM_PGM, // P5: Binary grayscale
+  FCV_NETPBM_PPM, // P6: Binary RGB
+  FCV_NETPBM_PAM, // P7: Arbitrary map with 1 to 4 channels
+} FCVNetpbmFormat;
+
+typedef struct {
+  FCVNetpbmFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;
+  uint32_t maxval;    // Samples above 255 are stored as 2 bytes (big-endian)
+  size_t data_offset; // Offset of the first sample after the header
+} FCVNetpbmInfo;
+
+/**
+ * Parse the header of a binary PGM, PPM or PAM file.
+ *
+ * The samples start at `info->data_offset` and are stored row-major
+ * without any padding, so images with a maxval of 255 can be used
+ * directly from the (memory mapped) file.
+ * This also parses a bare PAM header, as used for the sidecar
+ * of headerless raw files.
+ *
+ * @param data Contents of the file.
+ * @param size Size of the data in bytes.
+ * @param info Receives the header fields.
+ * @return True if the header is valid.
+ */
+bool fcv_netpbm_info(
+  uint8_t const *const data,
+  size_t size,
+  FCVNetpbmInfo *info
+);
+
+/**
+ * Write the header of a binary PGM, PPM or PAM file.
+ *
+ * PGM always has 1 channel and PPM 3 channels,
+ * PAM uses the given number of channels (1 to 4) with maxval 255.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels of a PAM file.
+ * @param format Format of the file.
+ * @param header Receives the null-terminated header.
+ * @param capacity Size of the header buffer (128 bytes are always enough).
+ * @return Length of the header or 0 if it didn't fit.
+ */
+size_t fcv_netpbm_header(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  FCVNetpbmFormat format,
+  char *header,
+  size_t capacity
+);
+
+/**
+ * Convert the samples of a netpbm image to RGBA pixels.
+ * Gray is copied to all three color channels and samples
+ * with a maxval other than 255 are scaled to 0-255.
+ *
+ * @param info Header of the image.
+ * @param samples Samples of the image (e.g. `data + info->data_offset`).
+ * @param size Number of bytes available at `samples`.
+ * @return RGBA pixel data or NULL if there are too few samples.
+ */
+uint8_t *fcv_netpbm_to_rgba(
+  FCVNetpbmInfo const *info,
+  uint8_t const *const samples,
+  size_t size
+);
+
+/**
+ * Decode a binary PGM, PPM or PAM file to RGBA pixels.
+ *
+ * @param data Contents of the file.
+ * @param size Size of the data in bytes.
+ * @param width Receives the width of the image.
+ * @param height Receives the height of the image.
+ * @param channels Receives the number of channels stored in the file.
+ *        The returned pixels always have 4 channels.
+ * @return RGBA pixel data or NULL if the file is invalid or truncated.
+ */
+uint8_t *fcv_decode_netpbm(
+  uint8_t const *const data,
+  size_t size,
+  uint32_t *width,
+  uint32_t *height,
+  uint32_t *channels
+);
+
+/**
+ * Encode an image as binary PGM, PPM or PAM file.
+ *
+ * PGM stores the luminance, PPM drops the alpha channel
+ * and PAM keeps all channels of the input.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels of the data (1 to 4).
+ * @param data Pixel data.
+ * @param format Format of the file.
+ * @param out_size Receives the size of the file in bytes.
+ * @return File contents or NULL on invalid input.
+ */
+uint8_t *fcv_encode_netpbm(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  FCVNetpbmFormat format,
+  size_t *out_size
+);
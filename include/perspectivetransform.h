@@ -17,5 +17,14 @@ uint8_t *fcv_apply_matrix_3x3(
   Matrix3x3 *tmat
 );
 
+uint8_t *fcv_apply_matrix_3x3_antialiased(
+  int32_t in_width,
+  int32_t in_height,
+  uint8_t *in_data,
+  int32_t out_width,
+  int32_t out_height,
+  Matrix3x3 *tmat
+);
+
 Corners fcv_detect_corners(const uint8_t *image, int32_t width, int32_t height);
 Corners* fcv_detect_corners_ptr(const uint8_t *image, int32_t width, int32_t height);
@@ -0,0 +1,190 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct FCVOperation FCVOperation;
+
+typedef struct {
+  char operation[32];
+  double param;
+  double param2;
+  double param3;
+  double param4;
+  char param_str[64]; // For string parameters like "50%" or "200x300"
+  int32_t has_param;
+  int32_t has_param2;
+  int32_t has_param3;
+  int32_t has_param4;
+  int32_t has_string_param;
+  FCVOperation const *definition; // Registered operation with this name
+} FCVPipelineOp;
+
+// Parsed pipeline, see fcv_pipeline_parse
+typedef struct FCVPipeline FCVPipeline;
+
+/**
+ * Apply an operation to an RGBA image.
+ *
+ * @param width Width of the image, receives the width of the result.
+ * @param height Height of the image, receives the height of the result.
+ * @param op Operation with its parameters.
+ * @param data RGBA pixel data, which must not be changed.
+ * @param output Receives results like detected QR codes, or NULL.
+ * @return New RGBA image or NULL on failure.
+ */
+typedef uint8_t *(*FCVOperationFunction)(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+);
+
+/**
+ * Apply an operation to an RGBA image and write the result
+ * into a buffer of the planned output size.
+ * Returns false if the operation failed.
+ */
+typedef bool (*FCVOperationIntoFunction)(
+  int32_t width,
+  int32_t height,
+  int32_t out_width,
+  int32_t out_height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *out
+);
+
+/**
+ * Parse the parameters of an operation (everything after its name)
+ * into `op`. Returns false and prints an error if they are invalid.
+ */
+typedef bool (*FCVOperationParser)(char *params, FCVPipelineOp *op);
+
+// The output has the same size as the input
+#define FCV_OPERATION_SAME_SIZE 1
+// The image is first converted to grayscale like the grayscale operation
+#define FCV_OPERATION_STARTS_GRAY 2
+// The output only contains black and white pixels
+#define FCV_OPERATION_BINARIZES 4
+
+struct FCVOperation {
+  char const *name;
+  FCVOperationFunction apply;
+  FCVOperationParser parse;      // NULL: Up to 2 numeric parameters
+  FCVOperationIntoFunction into; // Optional, see fcv_register_operation
+  uint32_t flags;                // FCV_OPERATION_* flags
+  void *user_data;               // Available as `op->definition->user_data`
+};
+
+// Buffers that are reused by runs, see fcv_pipeline_context_new
+typedef struct FCVPipelineContext FCVPipelineContext;
+
+typedef struct {
+  int32_t exif_orientation;    // EXIF orientation of the input (0: none)
+  FILE *log;                   // Progress of the operations
+  FILE *explain;               // Planned pipeline and its rewrites
+  FILE *output;                // Results of operations like qr
+  FCVPipelineContext *context; // Buffers kept between runs, or NULL
+} FCVPipelineOptions;
+
+/**
+ * Register an operation, which can then be used in pipelines
+ * like the built-in ones. The name (up to 31 characters)
+ * must stay valid and must not be used by another operation.
+ * Operations must be registered before pipelines are parsed
+ * and not while other threads parse or run pipelines.
+ *
+ * The `into` function is only used for operations
+ * with FCV_OPERATION_SAME_SIZE, whose output size is known in advance.
+ *
+ * @param operation Name, functions and flags of the operation.
+ * @return True on success.
+ */
+bool fcv_register_operation(FCVOperation const *operation);
+
+/**
+ * Find a built-in or registered operation.
+ *
+ * @param name Name of the operation.
+ * @return The operation or NULL if there is none with this name.
+ */
+FCVOperation const *fcv_find_operation(char const *name);
+
+/**
+ * Parse a pipeline of comma-separated operations,
+ * e.g. "grayscale, blur 9, crop 50x50+10+20".
+ *
+ * The pipeline can be executed any number of times
+ * with fcv_pipeline_run, also by several threads at once.
+ *
+ * @param text Operations of the pipeline.
+ * @return Pipeline or NULL if an operation is unknown or invalid.
+ *         It must be freed with fcv_pipeline_free.
+ */
+FCVPipeline *fcv_pipeline_parse(char const *text);
+
+void fcv_pipeline_free(FCVPipeline *pipeline);
+
+/**
+ * Get the number of operations of a parsed pipeline.
+ */
+int32_t fcv_pipeline_count(FCVPipeline const *pipeline);
+
+/**
+ * Get an operation of a parsed pipeline.
+ *
+ * @param pipeline Pipeline from fcv_pipeline_parse.
+ * @param index Position of the operation, starting at 0.
+ * @return The operation or NULL if `index` is out of range.
+ */
+FCVPipelineOp const *
+fcv_pipeline_op(FCVPipeline const *pipeline, int32_t index);
+
+/**
+ * Execute all operations of a pipeline.
+ *
+ * The pipeline is first rewritten to give the same result with less work
+ * (e.g. flips and rotations are combined and crops are moved to the front).
+ * This plan is kept with the pipeline and reused for inputs of the same size,
+ * unless it is explained.
+ * The EXIF orientation is only applied once it is needed,
+ * so large photos are usually only rotated after they were made smaller.
+ * Intermediate images are written alternately into two reused buffers
+ * where possible, which are kept in the context of the options, if any.
+ *
+ * @param pipeline Pipeline from fcv_pipeline_parse.
+ * @param width Width of the input, receives the width of the result.
+ * @param height Height of the input, receives the height of the result.
+ * @param channels Channels of the input: 1 (gray) or 4 (RGBA).
+ * @param data Pixel data, which can be changed in place.
+ * @param options Orientation and output streams, or NULL for none.
+ * @return New RGBA image that must be freed, or NULL on failure.
+ *         It is never `data` itself, which stays owned by the caller.
+ */
+/**
+ * Create a context, which keeps the buffers for the intermediate images
+ * of fcv_pipeline_run between runs (see FCVPipelineOptions).
+ * A worker that runs many pipelines, one after the other,
+ * then doesn't allocate them anew for every image.
+ * A context must only be used by one run at a time.
+ *
+ * @return Context or NULL if memory ran out.
+ *         It must be freed with fcv_pipeline_context_free.
+ */
+FCVPipelineContext *fcv_pipeline_context_new(void);
+
+void fcv_pipeline_context_free(FCVPipelineContext *context);
+
+uint8_t *fcv_pipeline_run(
+  FCVPipeline const *pipeline,
+  int32_t *width,
+  int32_t *height,
+  int32_t channels,
+  uint8_t *data,
+  FCVPipelineOptions const *options
+);
@@ -0,0 +1,116 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  FCV_PNG_FILTER_NONE,
+  FCV_PNG_FILTER_SUB,
+  FCV_PNG_FILTER_UP,
+  FCV_PNG_FILTER_AVERAGE,
+  FCV_PNG_FILTER_PAETH,
+  FCV_PNG_FILTER_ADAPTIVE, // Pick a filter for every row
+} FCVPngFilter;
+
+typedef struct {
+  // Compression effort from 0 to 9:
+  // 0 stores the data uncompressed,
+  // 1 only encodes runs of repeated bytes and Huffman codes (fast,
+  //   well suited for binary and grayscale pages),
+  // 2-9 search for repeated strings with increasingly long hash chains
+  //   (7-9 are several times slower and only a few percent smaller).
+  // The size never grows with the level for photos, scans and pages,
+  // and level 6 takes 0.5-0.8x the time of stb_image_write.
+  int32_t level;
+  FCVPngFilter filter;
+  // Write the smallest lossless format (1, 2, 4 or 8 bit grayscale,
+  // palette, or drop an opaque alpha channel) instead of the input layout
+  bool reduce;
+} FCVPngOptions;
+
+/**
+ * Default PNG options: level 6, adaptive filters and format reduction.
+ */
+FCVPngOptions fcv_png_default_options(void);
+
+/**
+ * Encode an image as PNG.
+ *
+ * Adaptive filtering picks the filter with the smallest sum of absolute
+ * residuals for rows with 8 bit samples, and the one of None and Up
+ * with fewer byte runs for palette and packed (1, 2 or 4 bit) rows.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels: 1 (gray), 2 (gray and alpha),
+ *        3 (RGB) or 4 (RGBA).
+ * @param data Pixel data.
+ * @param options Encoder options (NULL for the defaults).
+ * @param out_size Receives the size of the PNG file in bytes.
+ * @return PNG file contents or NULL on invalid input.
+ */
+uint8_t *fcv_encode_png(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  FCVPngOptions const *options,
+  size_t *out_size
+);
+
+typedef struct FCVPngEncoder FCVPngEncoder;
+
+/**
+ * Start encoding an image as PNG in parts that can be compressed
+ * independently, e.g. on several threads.
+ *
+ * The image is filtered right away and the filtered rows are split into
+ * parts of about 256 KiB. Every part becomes a run of deflate blocks that
+ * may refer back to the previous 32 KiB of data and ends with a sync flush
+ * (an empty stored block), so the compressed parts can be concatenated
+ * into one zlib stream. Its Adler-32 is combined from the ones of the parts.
+ * The output does not depend on the order the parts are compressed in.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels (1 to 4, see fcv_encode_png).
+ * @param data Pixel data (only needed during this call).
+ * @param options Encoder options (NULL for the defaults).
+ * @param num_parts Receives the number of parts to compress.
+ * @return Encoder or NULL on invalid input.
+ */
+FCVPngEncoder *fcv_png_encoder_create(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  FCVPngOptions const *options,
+  uint32_t *num_parts
+);
+
+/**
+ * Compress one part. Different parts of the same encoder
+ * can be compressed concurrently.
+ *
+ * @param encoder Encoder.
+ * @param part_index Index of the part (0 to num_parts - 1).
+ * @return False on invalid input or if memory ran out.
+ */
+bool fcv_png_encoder_compress(FCVPngEncoder *encoder, uint32_t part_index);
+
+/**
+ * Assemble the PNG file from the compressed parts and free the encoder.
+ *
+ * @param encoder Encoder.
+ * @param out_size Receives the size of the PNG file in bytes.
+ * @return PNG file contents or NULL if a part was not compressed.
+ */
+uint8_t *fcv_png_encoder_finish(FCVPngEncoder *encoder, size_t *out_size);
+
+/**
+ * Free an encoder without finishing it.
+ */
+void fcv_png_encoder_free(FCVPngEncoder *encoder);
@@ -0,0 +1,47 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Encode an image as QOI ("Quite OK Image" format).
+ *
+ * QOI is lossless and encodes and decodes several times faster
+ * than PNG, at a somewhat larger size. This makes it a good format
+ * to hand images from one processing step to the next.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels: 3 (RGB) or 4 (RGBA).
+ * @param data Pixel data.
+ * @param out_size Receives the size of the QOI file in bytes.
+ * @return QOI file contents or NULL on invalid input.
+ */
+uint8_t *fcv_encode_qoi(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  size_t *out_size
+);
+
+/**
+ * Decode a QOI file to RGBA pixels.
+ *
+ * @param data Contents of the QOI file.
+ * @param size Size of the data in bytes.
+ * @param width Receives the width of the image.
+ * @param height Receives the height of the image.
+ * @param channels Receives the number of channels stored in the file
+ *        (3 or 4). The returned pixels always have 4 channels.
+ * @return RGBA pixel data or NULL if the file is invalid or truncated.
+ */
+uint8_t *fcv_decode_qoi(
+  uint8_t const *const data,
+  size_t size,
+  uint32_t *width,
+  uint32_t *height,
+  uint32_t *channels
+);
@@ -0,0 +1,86 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "1_types.h"
+#endif
+
+/**
+ * Precompute the source positions of a perspective warp.
+ *
+ * Bakes the same mapping that fcv_apply_matrix_3x3 evaluates per pixel
+ * into a table of fixed-point lookups, so that warps with a fixed geometry
+ * (e.g. a fixed camera) only need fcv_remap per frame.
+ * Call fcv_free_remap_table to release it.
+ *
+ * @param in_width Width of the input images.
+ * @param in_height Height of the input images.
+ * @param out_width Width of the output images.
+ * @param out_height Height of the output images.
+ * @param tmat Matrix mapping output to input coordinates.
+ * @return The remap table or NULL on invalid input.
+ */
+FCVRemapTable *fcv_remap_table_from_matrix(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint32_t out_width,
+  uint32_t out_height,
+  Matrix3x3 const *tmat
+);
+
+/**
+ * Precompute an arbitrary coordinate map.
+ *
+ * @param map_x Source x coordinate for every output pixel.
+ * @param map_y Source y coordinate for every output pixel.
+ * @return The remap table or NULL on invalid input.
+ */
+FCVRemapTable *fcv_remap_table_from_coords(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint32_t out_width,
+  uint32_t out_height,
+  float const *map_x,
+  float const *map_y
+);
+
+void fcv_free_remap_table(FCVRemapTable *table);
+
+/**
+ * Warp a 4-channel image with a precomputed remap table
+ * using bilinear interpolation.
+ * Output pixels that map outside of the input are transparent black.
+ *
+ * @param table Remap table.
+ * @param in_data Input image of table->in_width x table->in_height pixels.
+ * @return Output image of table->out_width x table->out_height pixels.
+ */
+uint8_t *fcv_remap(FCVRemapTable const *table, uint8_t const *in_data);
+
+/**
+ * Warp a range of output rows with a precomputed remap table
+ * into an existing output image, like fcv_remap does for all rows.
+ * Callers can split the rows of a frame across their own threads,
+ * as the rows are independent of each other.
+ *
+ * @param table Remap table.
+ * @param in_data Input image of table->in_width x table->in_height pixels.
+ * @param row_start First output row to write.
+ * @param row_end Output row after the last one to write
+ *        (at most table->out_height).
+ * @param out_data Output image of table->out_width x table->out_height
+ *        pixels, of which only the rows of the range are written.
+ * @return False on invalid input.
+ */
+bool fcv_remap_rows(
+  FCVRemapTable const *table,
+  uint8_t const *in_data,
+  uint32_t row_start,
+  uint32_t row_end,
+  uint8_t *out_data
+);
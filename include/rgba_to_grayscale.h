@@ -14,3 +14,9 @@ uint8_t *fcv_rgba_to_grayscale(
   uint32_t height,
   uint8_t const * const data
 );
+
+void fcv_rgb_to_grayscale_in_place(
+  uint32_t width,
+  uint32_t height,
+  uint8_t *data
+);
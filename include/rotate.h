@@ -10,14 +10,37 @@ uint8_t *fcv_rotate_90_cw(
   uint8_t const * const data
 );
 
+void fcv_rotate_90_cw_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
 uint8_t *fcv_rotate_180(
   uint32_t width,
   uint32_t height,
   uint8_t const * const data
 );
 
+void fcv_rotate_180_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
+
+void fcv_rotate_180_in_place(uint32_t width, uint32_t height, uint8_t *data);
+
 uint8_t *fcv_rotate_270_cw(
   uint32_t width,
   uint32_t height,
   uint8_t const * const data
 );
+
+void fcv_rotate_270_cw_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const * const data,
+  uint8_t *out
+);
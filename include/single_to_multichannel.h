@@ -9,3 +9,10 @@ uint8_t *fcv_single_to_multichannel(
   uint32_t height,
   uint8_t const *const data
 );
+
+void fcv_single_to_multichannel_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+);
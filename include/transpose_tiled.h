@@ -0,0 +1,40 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Cache-blocked transpose of an image with 1 or more channels.
+ *
+ * Writes the width x height source image as a height x width image,
+ * optionally mirrored, so that all four diagonal orientations share it:
+ *
+ * | reverse_rows | reverse_columns | Result           |
+ * |--------------|-----------------|------------------|
+ * | false        | false           | Transpose        |
+ * | false        | true            | Rotate 90° cw    |
+ * | true         | false           | Rotate 270° cw   |
+ * | true         | true            | Transverse       |
+ *
+ * The image is processed in 128 x 128 pixel tiles and every tile in small
+ * blocks that are transposed in registers (SIMD for 4-channel pixels).
+ *
+ * @param width Width of the source image.
+ * @param height Height of the source image.
+ * @param channels Number of bytes per pixel.
+ * @param src Source pixel data.
+ * @param dst Destination buffer of the same size (must not overlap src).
+ * @param reverse_rows Reverse the order of the destination rows.
+ * @param reverse_columns Reverse the order of the destination columns.
+ */
+void fcv_transpose_tiled(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const src,
+  uint8_t *dst,
+  bool reverse_rows,
+  bool reverse_columns
+);
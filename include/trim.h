@@ -2,6 +2,7 @@
 #pragma once
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /**
@@ -39,3 +40,36 @@ uint8_t *fcv_trim_threshold(
   uint8_t const *const data,
   double threshold_percent
 );
+
+/**
+ * Compute the region that fcv_trim_threshold keeps, without copying.
+ *
+ * A column can be trimmed from the left or right if all of its pixels are
+ * within the tolerance of its top pixel, afterwards a row can be trimmed
+ * from the top or bottom if its remaining pixels are within the tolerance
+ * of its first one. At least one column and one row are kept.
+ * The columns are found in a single row-major pass with SIMD comparisons,
+ * which only has to look at the margins.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param channels Number of channels in the image.
+ * @param data Pointer to the pixel data.
+ * @param threshold_percent Tolerance percentage (0-100), 0 for exact matches.
+ * @param left Receives the first kept column.
+ * @param top Receives the first kept row.
+ * @param trimmed_width Receives the number of kept columns.
+ * @param trimmed_height Receives the number of kept rows.
+ * @return false on invalid input.
+ */
+bool fcv_trim_bounds(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  double threshold_percent,
+  uint32_t *left,
+  uint32_t *top,
+  uint32_t *trimmed_width,
+  uint32_t *trimmed_height
+);
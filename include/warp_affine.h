@@ -0,0 +1,95 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "1_types.h"
+#endif
+
+/**
+ * Apply an affine transformation to a 4-channel image.
+ *
+ * The matrix maps output coordinates to input coordinates
+ * (like fcv_apply_matrix_3x3), its last row is ignored.
+ * Source positions are stepped along each row in 32.32 fixed-point,
+ * so there are no divisions per pixel.
+ * Output pixels that map outside of the input are transparent black.
+ *
+ * @param in_width Width of the input image.
+ * @param in_height Height of the input image.
+ * @param in_data Input pixel data.
+ * @param out_width Width of the output image.
+ * @param out_height Height of the output image.
+ * @param tmat Affine matrix from output to input coordinates.
+ * @param interpolation Nearest neighbour, bilinear or bicubic (Catmull-Rom).
+ * @return Output pixel data or NULL on invalid input.
+ */
+uint8_t *fcv_warp_affine(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint8_t const *in_data,
+  uint32_t out_width,
+  uint32_t out_height,
+  Matrix3x3 const *tmat,
+  FCVInterpolation interpolation
+);
+
+/**
+ * Apply an affine transformation to a range of output rows
+ * and write them into an existing output image,
+ * like fcv_warp_affine does for all rows.
+ * Callers can split the rows across their own threads,
+ * as the rows are independent of each other.
+ * The other parameters are the same as for fcv_warp_affine.
+ *
+ * @param row_start First output row to write.
+ * @param row_end Output row after the last one to write
+ *        (at most out_height).
+ * @param out_data Output image of out_width x out_height pixels,
+ *        of which only the rows of the range are written.
+ * @return False on invalid input or if memory ran out.
+ */
+bool fcv_warp_affine_rows(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint8_t const *in_data,
+  uint32_t out_width,
+  uint32_t out_height,
+  Matrix3x3 const *tmat,
+  FCVInterpolation interpolation,
+  uint32_t row_start,
+  uint32_t row_end,
+  uint8_t *out_data
+);
+
+/**
+ * Rotate a 4-channel image clockwise by an arbitrary angle
+ * around its center.
+ *
+ * Multiples of 90° are exact pixel permutations when the canvas is
+ * expanded, all other angles are resampled with fcv_warp_affine.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pixel data.
+ * @param angle Clockwise rotation angle in degrees.
+ * @param interpolation Nearest neighbour, bilinear or bicubic (Catmull-Rom).
+ * @param expand If true, the canvas grows to contain the whole rotated image,
+ *        otherwise it keeps the input size and the corners are cropped.
+ * @param out_width Receives the width of the output image.
+ * @param out_height Receives the height of the output image.
+ * @return Output pixel data or NULL on invalid input.
+ */
+uint8_t *fcv_rotate_angle(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *data,
+  double angle,
+  FCVInterpolation interpolation,
+  bool expand,
+  uint32_t *out_width,
+  uint32_t *out_height
+);
@@ -7,12 +7,26 @@
 #include <string.h>
 
 #ifndef FLATCV_AMALGAMATION
+#include "binary_closing_disk.h"
+#include "binary_image.h"
 #include "conversion.h"
+#include "distance_transform.h"
 #include "perspectivetransform.h"
 #else
 #include "flatcv.h"
 #endif
 
+/**
+ * Squared radius of the disk structuring element.
+ *
+ * The disk contains every offset (dx, dy) with dx² + dy² <= (r + 0.5)²
+ * (slightly larger than r for better connectivity). For integer offsets
+ * this is equivalent to dx² + dy² <= r² + r.
+ */
+static uint64_t disk_squared_radius(int32_t radius) {
+  return (uint64_t)radius * (uint64_t)radius + (uint64_t)radius;
+}
+
 uint8_t *fcv_binary_dilation_disk(
   uint8_t const *image_data,
   int32_t width,
@@ -24,7 +38,7 @@ uint8_t *fcv_binary_dilation_disk(
   }
 
   // Check for overflow: width * height (width and height already validated > 0)
-  if ((size_t)width > SIZE_MAX / (size_t)height) {
+  if ((size_t)width > SIZE_MAX / (size_t)height / sizeof(int32_t)) {
     return NULL;
   }
   size_t num_pixels = (size_t)width * (size_t)height;
@@ -34,38 +48,22 @@ uint8_t *fcv_binary_dilation_disk(
     return NULL;
   }
 
-  // Initialize result to 0 (black)
-  memset(result, 0, num_pixels);
+  // A pixel becomes white if a white (255) pixel lies within the disk.
+  // Thresholding the exact distance transform makes the cost independent
+  // of the radius.
+  int32_t *dist =
+    fcv_distance_transform_sq(width, height, image_data, true, NULL);
+  if (!dist) {
+    free(result);
+    return NULL;
+  }
 
-  // For each pixel in the image
-  for (int32_t y = 0; y < height; y++) {
-    for (int32_t x = 0; x < width; x++) {
-      int32_t idx = y * width + x;
-
-      // If current pixel is white (255), dilate it
-      if (image_data[idx] == 255) {
-        // Apply disk-shaped structuring element
-        for (int32_t dy = -radius; dy <= radius; dy++) {
-          for (int32_t dx = -radius; dx <= radius; dx++) {
-            // Check if point32_t is within disk (use slightly larger radius for
-            // better connectivity)
-            double r_eff = radius + 0.5;
-            if (dx * dx + dy * dy <= r_eff * r_eff) {
-              int32_t ny = y + dy;
-              int32_t nx = x + dx;
-
-              // Check bounds
-              if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
-                int32_t nidx = ny * width + nx;
-                result[nidx] = 255;
-              }
-            }
-          }
-        }
-      }
-    }
+  uint64_t r_sq = disk_squared_radius(radius);
+  for (size_t i = 0; i < num_pixels; i++) {
+    result[i] = dist[i] != INT32_MAX && (uint64_t)dist[i] <= r_sq ? 255 : 0;
   }
 
+  free(dist);
   return result;
 }
 
@@ -81,7 +79,7 @@ static uint8_t *binary_erosion_disk_internal(
   }
 
   // Check for overflow: width * height (width and height already validated > 0)
-  if ((size_t)width > SIZE_MAX / (size_t)height) {
+  if ((size_t)width > SIZE_MAX / (size_t)height / sizeof(int32_t)) {
     return NULL;
   }
   size_t num_pixels = (size_t)width * (size_t)height;
@@ -91,59 +89,37 @@ static uint8_t *binary_erosion_disk_internal(
     return NULL;
   }
 
-  // Initialize result to 0 (black)
-  memset(result, 0, num_pixels);
+  // A pixel stays white if no non-white pixel lies within the disk
+  int32_t *dist =
+    fcv_distance_transform_sq(width, height, image_data, false, NULL);
+  if (!dist) {
+    free(result);
+    return NULL;
+  }
 
-  // For each pixel in the image
+  // Replicating the border never brings a non-white pixel closer
+  // (clamping only shrinks the offset), so in that mode out-of-bounds
+  // pixels are simply ignored. Otherwise they are treated as black,
+  // and the nearest one is straight across the closest image edge.
+  uint64_t r_sq = disk_squared_radius(radius);
   for (int32_t y = 0; y < height; y++) {
     for (int32_t x = 0; x < width; x++) {
-      int32_t idx = y * width + x;
-
-      // Check if structuring element fits entirely within white pixels
-      bool can_erode = true;
-
-      for (int32_t dy = -radius; dy <= radius && can_erode; dy++) {
-        for (int32_t dx = -radius; dx <= radius && can_erode; dx++) {
-          // Check if point32_t is within disk (use slightly larger radius for
-          // better connectivity)
-          double r_eff = radius + 0.5;
-          if (dx * dx + dy * dy <= r_eff * r_eff) {
-            int32_t ny = y + dy;
-            int32_t nx = x + dx;
-
-            uint8_t neighbor_value;
-
-            // Check bounds
-            if (ny < 0 || ny >= height || nx < 0 || nx >= width) {
-              if (replicate_border) {
-                // Replicate border: clamp coordinates to valid range
-                int32_t clamped_y =
-                  ny < 0 ? 0 : (ny >= height ? height - 1 : ny);
-                int32_t clamped_x = nx < 0 ? 0 : (nx >= width ? width - 1 : nx);
-                neighbor_value = image_data[clamped_y * width + clamped_x];
-              }
-              else {
-                // Default: treat out-of-bounds as black
-                neighbor_value = 0;
-              }
-            }
-            else {
-              neighbor_value = image_data[ny * width + nx];
-            }
-
-            if (neighbor_value != 255) {
-              can_erode = false;
-            }
-          }
-        }
+      size_t idx = (size_t)y * width + x;
+      bool can_erode = dist[idx] == INT32_MAX || (uint64_t)dist[idx] > r_sq;
+
+      if (can_erode && !replicate_border) {
+        int64_t edge = x + 1;
+        edge = width - x < edge ? width - x : edge;
+        edge = y + 1 < edge ? y + 1 : edge;
+        edge = height - y < edge ? height - y : edge;
+        can_erode = (uint64_t)(edge * edge) > r_sq;
       }
 
-      if (can_erode) {
-        result[idx] = 255;
-      }
+      result[idx] = can_erode ? 255 : 0;
     }
   }
 
+  free(dist);
   return result;
 }
 
@@ -212,3 +188,254 @@ uint8_t *fcv_binary_opening_disk(
 
   return result;
 }
+
+/**
+ * Half width of the disk row at vertical offset dy (0 <= dy <= radius),
+ * i.e. the largest dx with dx² + dy² <= r² + r.
+ */
+static int32_t disk_half_width(int32_t radius, int32_t dy) {
+  int64_t limit = (int64_t)disk_squared_radius(radius) - (int64_t)dy * dy;
+  int32_t dx = (int32_t)sqrt((double)limit);
+  while ((int64_t)(dx + 1) * (dx + 1) <= limit) {
+    dx++;
+  }
+  while ((int64_t)dx * dx > limit) {
+    dx--;
+  }
+  return dx;
+}
+
+/**
+ * dst[x] = src[x + shift] for a bit row of `words` words.
+ * Bits shifted in from beyond the row are taken from `fill`.
+ */
+static void bits_shift_down(
+  uint64_t *dst,
+  uint64_t const *src,
+  uint32_t words,
+  uint32_t shift,
+  uint64_t fill
+) {
+  uint32_t word_shift = shift / 64;
+  uint32_t bit_shift = shift % 64;
+
+  for (uint32_t i = 0; i < words; i++) {
+    uint64_t lo = i + word_shift < words ? src[i + word_shift] : fill;
+    uint64_t hi = i + word_shift + 1 < words ? src[i + word_shift + 1] : fill;
+    dst[i] = bit_shift == 0 ? lo : (lo >> bit_shift) | (hi << (64 - bit_shift));
+  }
+}
+
+/**
+ * dst[x] = src[x - shift] for a bit row of `words` words.
+ * Bits shifted in from before the row are taken from `fill`.
+ */
+static void bits_shift_up(
+  uint64_t *dst,
+  uint64_t const *src,
+  uint32_t words,
+  uint32_t shift,
+  uint64_t fill
+) {
+  uint32_t word_shift = shift / 64;
+  uint32_t bit_shift = shift % 64;
+
+  for (uint32_t i = 0; i < words; i++) {
+    uint64_t hi = i >= word_shift ? src[i - word_shift] : fill;
+    uint64_t lo = i >= word_shift + 1 ? src[i - word_shift - 1] : fill;
+    dst[i] = bit_shift == 0 ? hi : (hi << bit_shift) | (lo >> (64 - bit_shift));
+  }
+}
+
+/**
+ * Combine every bit with its neighbors within `half` pixels
+ * (OR for dilation, AND for erosion) using log2(half) shifted word ops.
+ * Pixels outside the row read as `fill`.
+ *
+ * @param scratch Two scratch rows of `words` words each.
+ */
+static void bits_row_line(
+  uint64_t *out,
+  uint64_t const *row,
+  uint64_t *scratch,
+  uint32_t width,
+  uint32_t words,
+  uint32_t half,
+  bool use_and,
+  uint64_t fill
+) {
+  uint64_t *fwd = scratch;
+  uint64_t *tmp = scratch + words;
+  uint32_t tail_bits = width % 64;
+  uint64_t tail_mask = tail_bits ? (((uint64_t)1 << tail_bits) - 1) : ~0ULL;
+
+  // Padding bits behave like the area outside the row
+  memcpy(fwd, row, words * sizeof(uint64_t));
+  fwd[words - 1] = (fwd[words - 1] & tail_mask) | (fill & ~tail_mask);
+  memcpy(out, fwd, words * sizeof(uint64_t));
+
+  // fwd[x] = OP row[x .. x + len - 1] and out[x] = OP row[x - len + 1 .. x],
+  // doubling `len` until it covers `half + 1` pixels
+  uint32_t len = 1;
+  while (len < half + 1) {
+    uint32_t step = len < half + 1 - len ? len : half + 1 - len;
+
+    bits_shift_down(tmp, fwd, words, step, fill);
+    for (uint32_t i = 0; i < words; i++) {
+      fwd[i] = use_and ? fwd[i] & tmp[i] : fwd[i] | tmp[i];
+    }
+
+    bits_shift_up(tmp, out, words, step, fill);
+    for (uint32_t i = 0; i < words; i++) {
+      out[i] = use_and ? out[i] & tmp[i] : out[i] | tmp[i];
+    }
+
+    len += step;
+  }
+
+  for (uint32_t i = 0; i < words; i++) {
+    out[i] = use_and ? out[i] & fwd[i] : out[i] | fwd[i];
+  }
+  out[words - 1] &= tail_mask;
+}
+
+/**
+ * Disk morphology on bit-packed images.
+ *
+ * The disk is the union of horizontal segments, one per row offset.
+ * Rows dy and -dy share the same segment, so every distinct segment is
+ * computed once for the whole image and then combined into the
+ * accumulator with both vertical offsets.
+ */
+static FCVBinaryImage *binary_disk_packed_internal(
+  FCVBinaryImage const *image,
+  int32_t radius,
+  bool erode,
+  bool replicate_border
+) {
+  if (!image || !image->data || radius < 0) {
+    return NULL;
+  }
+
+  uint32_t width = image->width;
+  uint32_t height = image->height;
+  uint32_t words = image->stride;
+  size_t num_words = (size_t)words * height;
+
+  FCVBinaryImage *result = fcv_binary_image_new(width, height);
+  FCVBinaryImage *line = fcv_binary_image_new(width, height);
+  uint64_t *scratch = malloc(2 * (size_t)words * sizeof(uint64_t));
+  if (!result || !line || !scratch) {
+    fcv_free_binary_image(result);
+    fcv_free_binary_image(line);
+    free(scratch);
+    return NULL;
+  }
+
+  // Out-of-bounds pixels are black, except for replicated erosion,
+  // where they can be ignored (see binary_erosion_disk_internal)
+  uint64_t fill = erode && replicate_border ? ~0ULL : 0;
+
+  if (erode) {
+    memset(result->data, 0xFF, num_words * sizeof(uint64_t));
+  }
+
+  int32_t prev_half = -1;
+  for (int32_t dy = 0; dy <= radius; dy++) {
+    int32_t half = disk_half_width(radius, dy);
+
+    if (half != prev_half) {
+      for (uint32_t y = 0; y < height; y++) {
+        bits_row_line(
+          line->data + (size_t)y * words,
+          image->data + (size_t)y * words,
+          scratch,
+          width,
+          words,
+          (uint32_t)half,
+          erode,
+          fill
+        );
+      }
+      prev_half = half;
+    }
+
+    for (uint32_t y = 0; y < height; y++) {
+      uint64_t *out = result->data + (size_t)y * words;
+
+      for (int32_t sign = -1; sign <= 1; sign += 2) {
+        if (dy == 0 && sign > 0) {
+          break;
+        }
+
+        int64_t sy = (int64_t)y + sign * dy;
+        if (sy < 0 || sy >= (int64_t)height) {
+          if (erode && !replicate_border) {
+            memset(out, 0, words * sizeof(uint64_t));
+          }
+          continue;
+        }
+
+        uint64_t const *src = line->data + (size_t)sy * words;
+        if (erode) {
+          for (uint32_t i = 0; i < words; i++) {
+            out[i] &= src[i];
+          }
+        }
+        else {
+          for (uint32_t i = 0; i < words; i++) {
+            out[i] |= src[i];
+          }
+        }
+      }
+    }
+  }
+
+  // Keep padding bits cleared
+  if (width % 64) {
+    uint64_t tail_mask = ((uint64_t)1 << (width % 64)) - 1;
+    for (uint32_t y = 0; y < height; y++) {
+      result->data[(size_t)y * words + words - 1] &= tail_mask;
+    }
+  }
+
+  fcv_free_binary_image(line);
+  free(scratch);
+  return result;
+}
+
+FCVBinaryImage *
+fcv_binary_dilation_disk_packed(FCVBinaryImage const *image, int32_t radius) {
+  return binary_disk_packed_internal(image, radius, false, false);
+}
+
+FCVBinaryImage *
+fcv_binary_erosion_disk_packed(FCVBinaryImage const *image, int32_t radius) {
+  return binary_disk_packed_internal(image, radius, true, false);
+}
+
+FCVBinaryImage *
+fcv_binary_closing_disk_packed(FCVBinaryImage const *image, int32_t radius) {
+  FCVBinaryImage *dilated = fcv_binary_dilation_disk_packed(image, radius);
+  if (!dilated) {
+    return NULL;
+  }
+
+  // Same replicate border mode as fcv_binary_closing_disk
+  FCVBinaryImage *result =
+    binary_disk_packed_internal(dilated, radius, true, true);
+  fcv_free_binary_image(dilated);
+  return result;
+}
+
+FCVBinaryImage *
+fcv_binary_opening_disk_packed(FCVBinaryImage const *image, int32_t radius) {
+  FCVBinaryImage *eroded = fcv_binary_erosion_disk_packed(image, radius);
+  if (!eroded) {
+    return NULL;
+  }
+
+  FCVBinaryImage *result = fcv_binary_dilation_disk_packed(eroded, radius);
+  fcv_free_binary_image(eroded);
+  return result;
+}
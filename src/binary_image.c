@@ -0,0 +1,194 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "binary_image.h"
+#else
+#include "flatcv.h"
+#endif
+
+FCVBinaryImage *fcv_binary_image_new(uint32_t width, uint32_t height) {
+  if (width == 0 || height == 0) {
+    return NULL;
+  }
+
+  uint32_t stride = (width + 63) / 64;
+
+  // Check for overflow: stride * height * 8
+  if ((size_t)stride > SIZE_MAX / height / sizeof(uint64_t)) {
+    return NULL;
+  }
+
+  FCVBinaryImage *image = malloc(sizeof(FCVBinaryImage));
+  if (!image) {
+    return NULL;
+  }
+
+  image->data = calloc((size_t)stride * height, sizeof(uint64_t));
+  if (!image->data) {
+    free(image);
+    return NULL;
+  }
+
+  image->width = width;
+  image->height = height;
+  image->stride = stride;
+  return image;
+}
+
+void fcv_free_binary_image(FCVBinaryImage *image) {
+  if (image) {
+    free(image->data);
+    free(image);
+  }
+}
+
+/**
+ * Pack a single-channel 0/255 image into 1 bit per pixel.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the single-channel pixel data.
+ * @return Bit-packed image (free with fcv_free_binary_image).
+ */
+FCVBinaryImage *fcv_pack_binary(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data
+) {
+  if (!data) {
+    return NULL;
+  }
+
+  FCVBinaryImage *image = fcv_binary_image_new(width, height);
+  if (!image) {
+    return NULL;
+  }
+
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t const *row = data + (size_t)y * width;
+    uint64_t *words = image->data + (size_t)y * image->stride;
+
+    for (uint32_t w = 0; w < image->stride; w++) {
+      uint32_t x0 = w * 64;
+      uint32_t count = width - x0 < 64 ? width - x0 : 64;
+      uint64_t word = 0;
+      for (uint32_t i = 0; i < count; i++) {
+        word |= (uint64_t)(row[x0 + i] == 255) << i;
+      }
+      words[w] = word;
+    }
+  }
+
+  return image;
+}
+
+/**
+ * Unpack a bit-packed image into a single-channel 0/255 image.
+ *
+ * @param image Bit-packed image.
+ * @return Pointer to the single-channel pixel data.
+ */
+uint8_t *fcv_unpack_binary(FCVBinaryImage const *image) {
+  if (!image || !image->data) {
+    return NULL;
+  }
+
+  // Check for overflow: width * height
+  if (image->width > SIZE_MAX / image->height) {
+    return NULL;
+  }
+
+  uint8_t *data = malloc((size_t)image->width * image->height);
+  if (!data) {
+    return NULL;
+  }
+
+  for (uint32_t y = 0; y < image->height; y++) {
+    uint8_t *row = data + (size_t)y * image->width;
+    uint64_t const *words = image->data + (size_t)y * image->stride;
+
+    for (uint32_t x = 0; x < image->width; x++) {
+      // Turn bit into 0x00 or 0xFF without branching
+      row[x] = (uint8_t)(0 - ((words[x / 64] >> (x % 64)) & 1));
+    }
+  }
+
+  return data;
+}
+
+typedef enum { BINARY_AND, BINARY_OR, BINARY_XOR } BinaryOp;
+
+static FCVBinaryImage *binary_combine(
+  FCVBinaryImage const *a,
+  FCVBinaryImage const *b,
+  BinaryOp op
+) {
+  if (!a || !b || a->width != b->width || a->height != b->height) {
+    return NULL;
+  }
+
+  FCVBinaryImage *result = fcv_binary_image_new(a->width, a->height);
+  if (!result) {
+    return NULL;
+  }
+
+  // Both images share the same layout, so the rows can be processed
+  // as one contiguous word array (padding bits stay zero for all ops)
+  size_t num_words = (size_t)a->stride * a->height;
+  uint64_t const *wa = a->data;
+  uint64_t const *wb = b->data;
+  uint64_t *wr = result->data;
+
+  switch (op) {
+  case BINARY_AND:
+    for (size_t i = 0; i < num_words; i++) {
+      wr[i] = wa[i] & wb[i];
+    }
+    break;
+  case BINARY_OR:
+    for (size_t i = 0; i < num_words; i++) {
+      wr[i] = wa[i] | wb[i];
+    }
+    break;
+  case BINARY_XOR:
+    for (size_t i = 0; i < num_words; i++) {
+      wr[i] = wa[i] ^ wb[i];
+    }
+    break;
+  }
+
+  return result;
+}
+
+FCVBinaryImage *
+fcv_binary_and(FCVBinaryImage const *a, FCVBinaryImage const *b) {
+  return binary_combine(a, b, BINARY_AND);
+}
+
+FCVBinaryImage *
+fcv_binary_or(FCVBinaryImage const *a, FCVBinaryImage const *b) {
+  return binary_combine(a, b, BINARY_OR);
+}
+
+FCVBinaryImage *
+fcv_binary_xor(FCVBinaryImage const *a, FCVBinaryImage const *b) {
+  return binary_combine(a, b, BINARY_XOR);
+}
+
+/**
+ * Count the set (white) pixels of a bit-packed image.
+ */
+uint64_t fcv_binary_count(FCVBinaryImage const *image) {
+  if (!image || !image->data) {
+    return 0;
+  }
+
+  size_t num_words = (size_t)image->stride * image->height;
+  uint64_t count = 0;
+  for (size_t i = 0; i < num_words; i++) {
+    count += fcv_popcount_u64(image->data[i]);
+  }
+  return count;
+}
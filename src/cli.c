@@ -1,11 +1,26 @@
-#include <ctype.h>
-#include <math.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -15,46 +30,115 @@
 #endif
 #include "stb_image_write.h"
 
-#include "binary_closing_disk.h"
-#include "conversion.h"
-#include "crop.h"
-#include "draw.h"
 #include "exif.h"
-#include "extract_document.h"
-#include "flip.h"
-#include "foerstner_corner.h"
-#include "histogram.h"
-#include "perspectivetransform.h"
-#include "qr_code.h"
+#include "jpeg_encode.h"
+#include "netpbm.h"
+#include "pipeline.h"
+#include "png_encode.h"
+#include "qoi.h"
 #include "rgba_to_grayscale.h"
-#include "rotate.h"
-#include "single_to_multichannel.h"
-#include "sobel_edge_detection.h"
-#include "trim.h"
-#include "watershed_segmentation.h"
+
+typedef enum {
+  OUTPUT_PNG,
+  OUTPUT_JPEG,
+  OUTPUT_QOI,
+  OUTPUT_PGM,
+  OUTPUT_PPM,
+  OUTPUT_PAM,
+  OUTPUT_RAW,
+  OUTPUT_BY_EXTENSION,
+} OutputFormat;
 
 typedef struct {
-  char operation[32];
-  double param;
-  double param2;
-  double param3;
-  double param4;
-  char param_str[64]; // For string parameters like "50%" or "200x300"
-  int32_t has_param;
-  int32_t has_param2;
-  int32_t has_param3;
-  int32_t has_param4;
-  int32_t has_string_param;
-} PipelineOp;
+  FCVPngOptions png;
+  int32_t num_threads; // 0: one per CPU core
+  int32_t jpeg_quality;
+  OutputFormat format;
+  const char *batch_list;  // File with the input files of a batch
+  const char *out_dir;     // Output directory of a batch
+  const char *socket_path; // Unix domain socket of the server
+  int32_t explain;         // Print the planned pipeline
+} OutputOptions;
 
 typedef struct {
-  PipelineOp *ops;
-  int32_t count;
-  int32_t capacity;
-} Pipeline;
+  FCVPngEncoder *encoder;
+  uint32_t num_parts;
+  uint32_t first_part;
+  uint32_t part_step;
+  int32_t success;
+} CompressTask;
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  int32_t is_mapped;
+} InputFile;
+
+typedef struct {
+  uint8_t *data;
+  int32_t width;
+  int32_t height;
+  int32_t channels;      // Channels stored in the file
+  int32_t data_channels; // Channels of the data: 1 (gray) or 4 (RGBA)
+  int32_t orientation;   // EXIF orientation
+  int32_t is_borrowed;   // The data points into the input file
+} DecodedImage;
+
+#ifdef _WIN32
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Condition;
+typedef LPTHREAD_START_ROUTINE ThreadFunction;
+#define THREAD_FUNCTION(name, function)                                        \
+  DWORD WINAPI name(LPVOID argument) {                                         \
+    function(argument);                                                        \
+    return 0;                                                                  \
+  }
+#else
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+typedef void *(*ThreadFunction)(void *);
+#define THREAD_FUNCTION(name, function)                                        \
+  void *name(void *argument) {                                                 \
+    function(argument);                                                        \
+    return NULL;                                                               \
+  }
+#endif
 
 void print32_t_usage(const char *program_name) {
-  printf("Usage: %s <input> <pipeline> <output>\n", program_name);
+  printf("Usage: %s [options] <input> <pipeline> <output>\n", program_name);
+  printf("Options:\n");
+  printf("  --png-level <0-9> - PNG compression effort (default: 6, "
+         "0: uncompressed, 1: fast run-length mode for pages)\n");
+  printf("  --png-filter <none|sub|up|average|paeth|adaptive> - PNG row filter "
+         "(default: adaptive)\n");
+  printf("  --png-keep-format - Write PNGs as RGBA instead of the smallest "
+         "lossless format (1-bit, grayscale, palette)\n");
+  printf("  --threads <n>     - Number of threads for PNG compression "
+         "(default: 0, one per CPU core)\n");
+  printf("  --jpeg-quality <1-100> - JPEG quality (default: 90)\n");
+  printf("  --format <format> - Output format, e.g. for writing to stdout "
+         "(default: by file extension, else png)\n");
+  printf("  --explain         - Print how the pipeline is optimized "
+         "before it is executed\n");
+  printf("Formats (by file extension):\n");
+  printf("  .png, .jpg/.jpeg  - Compressed images\n");
+  printf("  .qoi              - Fast lossless RGBA\n");
+  printf("  .pgm, .ppm, .pam  - Binary netpbm (gray, RGB, RGBA)\n");
+  printf("  .raw              - RGBA pixels, PAM header in <file>.raw.hdr\n");
+  printf("Use - as input or output to read from stdin or write to stdout.\n");
+  printf("Batch mode:\n");
+  printf("  %s --batch <list> <pipeline> --out-dir <dir>\n", program_name);
+  printf("  Applies the pipeline to all files in <list> (one per line, "
+         "- for stdin)\n");
+  printf("  on --threads workers and saves the results to <dir>.\n");
+  printf("Server mode:\n");
+  printf("  %s serve [--socket <path>]\n", program_name);
+  printf("  Executes jobs like {\"input\": \"i.jpg\", \"pipeline\": "
+         "\"grayscale\", \"output\": \"o.png\"}\n");
+  printf("  (one per line) from stdin or a Unix domain socket "
+         "on --threads workers.\n");
   printf("Pipeline operations:\n");
   printf("  grayscale       - Convert image to grayscale\n");
   printf("  blur <radius>   - Apply gaussian blur with radius\n");
@@ -93,8 +177,12 @@ void print32_t_usage(const char *program_name) {
   printf(
     "  flip_y          - Flip image vertically (mirror along horizontal axis)\n"
   );
-  printf("  rotate <angle>  - Rotate image by angle (must be multiple of 90)\n"
-  );
+  printf("  transpose       - Swap rows and columns (mirror along the main "
+         "diagonal)\n");
+  printf("  transverse      - Mirror along the anti-diagonal\n");
+  printf("  rotate <angle>  - Rotate image clockwise by angle in degrees\n");
+  printf("  deskew          - Detect the skew of text lines (±15°) and "
+         "straighten the image\n");
   printf(
     "  trim [<threshold>%%] - Remove border pixels with same color (optional "
     "threshold for JPEG artifacts/vignette)\n"
@@ -142,1733 +230,2035 @@ void print32_t_usage(const char *program_name) {
   printf("  %s input.jpg \"border FF0000 10\" output.jpg\n", program_name);
 }
 
-Pipeline *create_pipeline(void) {
-  Pipeline *p = malloc(sizeof(Pipeline));
-  p->capacity = 8;
-  p->count = 0;
-  p->ops = malloc(sizeof(PipelineOp) * p->capacity);
-  return p;
-}
-
-void free_pipeline(Pipeline *p) {
-  if (p) {
-    free(p->ops);
-    free(p);
-  }
-}
-
-int32_t pipeline_has_binarization(const Pipeline *pipeline) {
-  for (int32_t i = 0; i < pipeline->count; i++) {
-    const char *op = pipeline->ops[i].operation;
-    if (strcmp(op, "threshold") == 0 || strcmp(op, "bw_smart") == 0 ||
-        strcmp(op, "bw_smooth") == 0) {
-      return 1;
-    }
-  }
-  return 0;
-}
-
-void add_operation(
-  Pipeline *p,
-  const char *op,
-  double param,
-  int32_t has_param,
-  double param2,
-  int32_t has_param2,
-  double param3,
-  int32_t has_param3,
-  double param4,
-  int32_t has_param4,
-  const char *param_str,
-  int32_t has_string_param
-) {
-  if (p->count >= p->capacity) {
-    p->capacity *= 2;
-    p->ops = realloc(p->ops, sizeof(PipelineOp) * p->capacity);
+/**
+ * Parse the pipeline from the arguments between input and output.
+ * They are joined with spaces, so the pipeline can be written
+ * with or without quotes.
+ * Returns NULL if it is invalid.
+ */
+FCVPipeline *
+parse_pipeline_arguments(char *argv[], int32_t start_idx, int32_t end_idx) {
+  size_t total_len = 1;
+  for (int32_t i = start_idx; i < end_idx; ++i) {
+    total_len += strlen(argv[i]) + 1; // Followed by a space
   }
 
-  strncpy(
-    p->ops[p->count].operation,
-    op,
-    sizeof(p->ops[p->count].operation) - 1
-  );
-  p->ops[p->count].operation[sizeof(p->ops[p->count].operation) - 1] = '\0';
-  p->ops[p->count].param = param;
-  p->ops[p->count].has_param = has_param;
-  p->ops[p->count].param2 = param2;
-  p->ops[p->count].has_param2 = has_param2;
-  p->ops[p->count].param3 = param3;
-  p->ops[p->count].has_param3 = has_param3;
-  p->ops[p->count].param4 = param4;
-  p->ops[p->count].has_param4 = has_param4;
-
-  if (has_string_param && param_str) {
-    strncpy(
-      p->ops[p->count].param_str,
-      param_str,
-      sizeof(p->ops[p->count].param_str) - 1
-    );
-    p->ops[p->count].param_str[sizeof(p->ops[p->count].param_str) - 1] = '\0';
+  char *combined = malloc(total_len);
+  if (!combined) {
+    fprintf(stderr, "Error: out of memory\n");
+    return NULL;
   }
-  else {
-    p->ops[p->count].param_str[0] = '\0';
+  combined[0] = '\0';
+  for (int32_t i = start_idx; i < end_idx; ++i) {
+    if (i > start_idx) {
+      strcat(combined, " ");
+    }
+    strcat(combined, argv[i]);
   }
-  p->ops[p->count].has_string_param = has_string_param;
-
-  p->count++;
-}
 
-/* Remove leading and trailing white-space, returns pointer to first
-   non-blank char (string is modified in place). */
-static char *trim_whitespace(char *s) {
-  while (*s && isspace((uint8_t)*s)) {
-    s++; // left-trim
-  }
-  if (*s == '\0') {
-    return s;
-  }
-  char *end = s + strlen(s) - 1;
-  while (end > s && isspace((uint8_t)*end)) {
-    end--;
-  }
-  *(end + 1) = '\0'; // right-trim
-  return s;
+  FCVPipeline *pipeline = fcv_pipeline_parse(combined);
+  free(combined);
+  return pipeline;
 }
 
-char *skip_whitespace(char *str) {
-  while (*str && isspace(*str)) {
-    str++;
+int32_t pipeline_has_binarization(FCVPipeline const *pipeline) {
+  for (int32_t i = 0; i < fcv_pipeline_count(pipeline); i++) {
+    if (fcv_pipeline_op(pipeline, i)->definition->flags &
+        FCV_OPERATION_BINARIZES) {
+      return 1;
+    }
   }
-  return str;
+  return 0;
 }
 
 /**
- * Parse geometry string (e.g., "50x50+10+20")
- * Returns 1 on success, 0 on failure
+ * Check if the pipeline can start with 1-channel gray pixels:
+ * its first operation converts to grayscale,
+ * or it only prints the QR codes and no image is written.
  */
-int32_t parse_geometry(
-  const char *geometry,
-  uint32_t *width,
-  uint32_t *height,
-  int32_t *x_offset,
-  int32_t *y_offset
-) {
-  if (!geometry || !width || !height || !x_offset || !y_offset) {
-    return 0;
-  }
-
-  // Parse width x height
-  char *end_ptr;
-  unsigned long w = strtoul(geometry, &end_ptr, 10);
-  if (*end_ptr != 'x' || w == 0 || w > UINT_MAX) {
+int32_t
+pipeline_starts_gray(FCVPipeline const *pipeline, int32_t is_info_only) {
+  FCVPipelineOp const *first_op = fcv_pipeline_op(pipeline, 0);
+  if (!first_op) {
     return 0;
   }
+  const char *first = first_op->operation;
+  return strcmp(first, "grayscale") == 0 ||
+         (is_info_only && strcmp(first, "qr") == 0);
+}
 
-  const char *height_start = end_ptr + 1;
-  unsigned long h = strtoul(height_start, &end_ptr, 10);
-  if (h == 0 || h > UINT_MAX) {
-    return 0;
-  }
-
-  *width = (uint32_t)w;
-  *height = (uint32_t)h;
-
-  // Parse offsets (can be + or -)
-  if (*end_ptr == '\0') {
-    // No offsets specified, default to 0,0
-    *x_offset = 0;
-    *y_offset = 0;
-    return 1;
-  }
-
-  // Parse x offset
-  long x = strtol(end_ptr, &end_ptr, 10);
-  if (x < INT_MIN || x > INT_MAX) {
-    return 0;
-  }
-  *x_offset = (int32_t)x;
+/**
+ * Get the output format with the given name (e.g. "png" or "jpg").
+ * Returns -1 if the format is unknown.
+ */
+int32_t parse_output_format(const char *name) {
+  static const char *const format_names[] =
+    {"png", "jpeg", "qoi", "pgm", "ppm", "pam", "raw"};
 
-  // Parse y offset
-  if (*end_ptr == '\0') {
-    // Only x offset specified, y offset defaults to 0
-    *y_offset = 0;
-    return 1;
+  if (strcmp(name, "jpg") == 0) {
+    return OUTPUT_JPEG;
   }
-
-  long y = strtol(end_ptr, &end_ptr, 10);
-  if (y < INT_MIN || y > INT_MAX || *end_ptr != '\0') {
-    return 0;
+  for (int32_t f = 0; f < OUTPUT_BY_EXTENSION; f++) {
+    if (strcmp(name, format_names[f]) == 0) {
+      return f;
+    }
   }
-  *y_offset = (int32_t)y;
-
-  return 1;
+  return -1;
 }
 
-int32_t parse_pipeline(
-  int32_t argc,
+/**
+ * Remove the output options from the arguments.
+ * Options can appear anywhere in the argument list.
+ * Returns 0 if an option is unknown or has an invalid value.
+ */
+int32_t parse_output_options(
+  int32_t *argc,
   char *argv[],
-  int32_t start_idx,
-  int32_t end_idx,
-  Pipeline *pipeline
+  OutputOptions *options
 ) {
-  (void)argc; // Unused parameter
-
-  /* 1. build one big string from all arguments that form the pipeline */
-  size_t total_len = 0;
-  for (int32_t i = start_idx; i < end_idx; ++i) {
-    total_len += strlen(argv[i]) + 2; // space OR ", "
-  }
-
-  char *combined = malloc(total_len + 1);
-  if (!combined) {
-    fprintf(stderr, "Error: out of memory\n");
-    return 0;
-  }
-
-  combined[0] = '\0';
-  for (int32_t i = start_idx; i < end_idx; ++i) {
-    const char *tok = argv[i];
-
-    /* add space before every token except the first one */
-    if (i > start_idx) {
-      strcat(combined, " ");
-    }
-
-    strcat(combined, tok);
-  }
-
-  /* 2. split the combined string by commas – each chunk is one operation */
-  char *saveptr;
-  for (char *tok = strtok_r(combined, ",", &saveptr); tok;
-       tok = strtok_r(NULL, ",", &saveptr)) {
-    char *piece = trim_whitespace(tok);
-    if (*piece == '\0') {
-      continue; // empty fragment, skip
+  static const char *const filter_names[] =
+    {"none", "sub", "up", "average", "paeth", "adaptive"};
+
+  int32_t count = 1;
+  for (int32_t i = 1; i < *argc; i++) {
+    // A single "-" is stdin or stdout
+    if (strncmp(argv[i], "--", 2) != 0) {
+      argv[count++] = argv[i];
+      continue;
     }
 
-    /* optional surrounding parentheses */
-    size_t len = strlen(piece);
-    if (piece[0] == '(' && piece[len - 1] == ')') {
-      piece[len - 1] = '\0';
-      piece = trim_whitespace(piece + 1);
+    if (strcmp(argv[i], "--png-keep-format") == 0) {
+      options->png.reduce = false;
+      continue;
     }
-    if (*piece == '\0') {
+    if (strcmp(argv[i], "--explain") == 0) {
+      options->explain = 1;
       continue;
     }
 
-    /* split into operation name and (optional) parameters */
-    char *space = strchr(piece, ' ');
-    if (space) {
-      *space = '\0';
-      char *params_str = trim_whitespace(space + 1);
-
-      /* Check if this is a resize operation with special formats */
-      if (strcmp(piece, "resize") == 0) {
-        /* Check for percentage format (50% or 50%x80%) or absolute format
-         * (200x300) */
-        if (strchr(params_str, '%') || strchr(params_str, 'x')) {
-          add_operation(
-            pipeline,
-            piece,
-            0.0,
-            0,
-            0.0,
-            0,
-            0.0,
-            0,
-            0.0,
-            0,
-            params_str,
-            1
-          );
-        }
-        else {
-          /* Fall back to numeric parsing for backward compatibility */
-          char *space2 = strchr(params_str, ' ');
-          if (space2) {
-            *space2 = '\0';
-            double param1 = atof(trim_whitespace(params_str));
-            double param2 = atof(trim_whitespace(space2 + 1));
-            add_operation(
-              pipeline,
-              piece,
-              param1,
-              1,
-              param2,
-              1,
-              0.0,
-              0,
-              0.0,
-              0,
-              NULL,
-              0
-            );
-          }
-          else {
-            double param = atof(params_str);
-            add_operation(
-              pipeline,
-              piece,
-              param,
-              1,
-              0.0,
-              0,
-              0.0,
-              0,
-              0.0,
-              0,
-              NULL,
-              0
-            );
-          }
-        }
+    if (i + 1 >= *argc) {
+      fprintf(stderr, "Error: Missing value for option '%s'\n", argv[i]);
+      return 0;
+    }
+    const char *value = argv[++i];
+
+    if (strcmp(argv[i - 1], "--png-level") == 0) {
+      char *end;
+      long level = strtol(value, &end, 10);
+      if (*end != '\0' || end == value || level < 0 || level > 9) {
+        fprintf(stderr, "Error: PNG level must be between 0 and 9\n");
+        return 0;
       }
-      else if (strcmp(piece, "circle") == 0) {
-        /* Circle operation requires: hex_color radius xXy */
-        char *space2 = strchr(params_str, ' ');
-        if (space2) {
-          *space2 = '\0';
-          char *color = trim_whitespace(params_str);
-          char *remaining = trim_whitespace(space2 + 1);
-          char *space3 = strchr(remaining, ' ');
-          if (space3) {
-            *space3 = '\0';
-            double radius = atof(trim_whitespace(remaining));
-            char *position_str = trim_whitespace(space3 + 1);
-
-            // Parse position in format "x×y" or "xxy"
-            char *pos_copy = strdup(position_str);
-            char *x_pos = strchr(pos_copy, 'x');
-            if (x_pos) {
-              *x_pos = '\0';
-              double center_x = atof(trim_whitespace(pos_copy));
-              double center_y = atof(trim_whitespace(x_pos + 1));
-
-              // Store color in param_str, radius in param, x,y in param2,param3
-              char combined_params[128];
-              snprintf(
-                combined_params,
-                sizeof(combined_params),
-                "%s %.2f %.2f",
-                color,
-                center_x,
-                center_y
-              );
-              add_operation(
-                pipeline,
-                piece,
-                radius,
-                1,
-                center_x,
-                1,
-                center_y,
-                1,
-                0.0,
-                0,
-                combined_params,
-                1
-              );
-              free(pos_copy);
-            }
-            else {
-              fprintf(
-                stderr,
-                "Error: circle position must be in format 'xXy' (e.g., "
-                "'200x150')\n"
-              );
-              free(pos_copy);
-              free(combined);
-              return 0;
-            }
-          }
-          else {
-            fprintf(
-              stderr,
-              "Error: circle operation requires: hex_color radius xXy\n"
-            );
-            free(combined);
-            return 0;
-          }
-        }
-        else {
-          fprintf(
-            stderr,
-            "Error: circle operation requires: hex_color radius xXy\n"
-          );
-          free(combined);
-          return 0;
+      options->png.level = (int32_t)level;
+    }
+    else if (strcmp(argv[i - 1], "--png-filter") == 0) {
+      int32_t filter = -1;
+      for (int32_t f = 0; f <= FCV_PNG_FILTER_ADAPTIVE; f++) {
+        if (strcmp(value, filter_names[f]) == 0) {
+          filter = f;
         }
       }
-      else if (strcmp(piece, "disk") == 0) {
-        /* Disk operation requires: hex_color radius xXy */
-        char *space2 = strchr(params_str, ' ');
-        if (space2) {
-          *space2 = '\0';
-          char *color = trim_whitespace(params_str);
-          char *remaining = trim_whitespace(space2 + 1);
-          char *space3 = strchr(remaining, ' ');
-          if (space3) {
-            *space3 = '\0';
-            double radius = atof(trim_whitespace(remaining));
-            char *position_str = trim_whitespace(space3 + 1);
-
-            // Parse position in format "x×y" or "xxy"
-            char *pos_copy = strdup(position_str);
-            char *x_pos = strchr(pos_copy, 'x');
-            if (x_pos) {
-              *x_pos = '\0';
-              double center_x = atof(trim_whitespace(pos_copy));
-              double center_y = atof(trim_whitespace(x_pos + 1));
-
-              // Store color in param_str, radius in param, x,y in param2,param3
-              char combined_params[128];
-              snprintf(
-                combined_params,
-                sizeof(combined_params),
-                "%s %.2f %.2f",
-                color,
-                center_x,
-                center_y
-              );
-              add_operation(
-                pipeline,
-                piece,
-                radius,
-                1,
-                center_x,
-                1,
-                center_y,
-                1,
-                0.0,
-                0,
-                combined_params,
-                1
-              );
-              free(pos_copy);
-            }
-            else {
-              fprintf(
-                stderr,
-                "Error: disk position must be in format 'xXy' (e.g., "
-                "'200x150')\n"
-              );
-              free(pos_copy);
-              free(combined);
-              return 0;
-            }
-          }
-          else {
-            fprintf(
-              stderr,
-              "Error: disk operation requires: hex_color radius xXy\n"
-            );
-            free(combined);
-            return 0;
-          }
-        }
-        else {
-          fprintf(
-            stderr,
-            "Error: disk operation requires: hex_color radius xXy\n"
-          );
-          free(combined);
-          return 0;
-        }
+      if (filter < 0) {
+        fprintf(stderr, "Error: Unknown PNG filter '%s'\n", value);
+        return 0;
       }
-      else if (strcmp(piece, "watershed") == 0) {
-        /* Watershed operation requires: x1×y1,x2×y2,... */
-        add_operation(
-          pipeline,
-          piece,
-          0.0,
-          0,
-          0.0,
-          0,
-          0.0,
-          0,
-          0.0,
-          0,
-          params_str,
-          1
+      options->png.filter = (FCVPngFilter)filter;
+    }
+    else if (strcmp(argv[i - 1], "--threads") == 0) {
+      char *end;
+      long num_threads = strtol(value, &end, 10);
+      if (*end != '\0' || end == value || num_threads < 0 ||
+          num_threads > 1024) {
+        fprintf(
+          stderr,
+          "Error: Number of threads must be between 0 and 1024\n"
         );
+        return 0;
       }
-      else if (strcmp(piece, "crop") == 0) {
-        uint32_t crop_width, crop_height;
-        int32_t x_offset, y_offset;
-        if (parse_geometry(
-              params_str,
-              &crop_width,
-              &crop_height,
-              &x_offset,
-              &y_offset
-            )) {
-          add_operation(
-            pipeline,
-            piece,
-            (double)x_offset,
-            1,
-            (double)y_offset,
-            1,
-            (double)crop_width,
-            1,
-            (double)crop_height,
-            1,
-            NULL,
-            0
-          );
-        }
-        else {
-          fprintf(
-            stderr,
-            "Error: crop operation requires geometry format (e.g., "
-            "50x50+10+20)\n"
-          );
-          free(combined);
-          return 0;
-        }
-      }
-      else if (strcmp(piece, "extract_document_to") == 0) {
-        // Parse output dimensions in format "widthxheight"
-        char *params_copy = strdup(params_str);
-        char *x_pos = strchr(params_copy, 'x');
-        if (x_pos) {
-          *x_pos = '\0';
-          uint32_t out_width = (uint32_t)atoi(trim_whitespace(params_copy));
-          uint32_t out_height = (uint32_t)atoi(trim_whitespace(x_pos + 1));
-
-          if (out_width > 0 && out_height > 0) {
-            add_operation(
-              pipeline,
-              piece,
-              (double)out_width,
-              1,
-              (double)out_height,
-              1,
-              0.0,
-              0,
-              0.0,
-              0,
-              NULL,
-              0
-            );
-          }
-          else {
-            fprintf(
-              stderr,
-              "Error: extract_document_to requires positive dimensions\n"
-            );
-            free(params_copy);
-            free(combined);
-            return 0;
-          }
-          free(params_copy);
-        }
-        else {
-          fprintf(
-            stderr,
-            "Error: extract_document_to operation requires format "
-            "'widthxheight' (e.g., 800x600)\n"
-          );
-          free(params_copy);
-          free(combined);
-          return 0;
-        }
-      }
-      else if (strcmp(piece, "extract_document") == 0) {
-        // Auto-size version - no parameters needed
-        add_operation(pipeline, piece, 0.0, 0, 0.0, 0, 0.0, 0, 0.0, 0, NULL, 0);
-      }
-      else if (strcmp(piece, "border") == 0) {
-        /* Border operation requires: hex_color border_width */
-        char *space2 = strchr(params_str, ' ');
-        if (space2) {
-          *space2 = '\0';
-          char *color = trim_whitespace(params_str);
-          double border_width = atof(trim_whitespace(space2 + 1));
-
-          if (border_width > 0) {
-            add_operation(
-              pipeline,
-              piece,
-              border_width,
-              1,
-              0.0,
-              0,
-              0.0,
-              0,
-              0.0,
-              0,
-              color,
-              1
-            );
-          }
-          else {
-            fprintf(stderr, "Error: border width must be positive\n");
-            free(combined);
-            return 0;
-          }
-        }
-        else {
-          fprintf(
-            stderr,
-            "Error: border operation requires: hex_color border_width\n"
-          );
-          free(combined);
-          return 0;
-        }
-      }
-      else if (strcmp(piece, "trim") == 0) {
-        /* Trim operation with optional threshold percentage */
-        if (strchr(params_str, '%')) {
-          /* Percentage format: 2% */
-          add_operation(
-            pipeline,
-            piece,
-            0.0,
-            0,
-            0.0,
-            0,
-            0.0,
-            0,
-            0.0,
-            0,
-            params_str,
-            1
-          );
-        }
-        else {
-          /* Numeric threshold (interpreted as percentage) */
-          double param = atof(params_str);
-          add_operation(
-            pipeline,
-            piece,
-            param,
-            1,
-            0.0,
-            0,
-            0.0,
-            0,
-            0.0,
-            0,
-            NULL,
-            0
-          );
-        }
+      options->num_threads = (int32_t)num_threads;
+    }
+    else if (strcmp(argv[i - 1], "--jpeg-quality") == 0) {
+      char *end;
+      long quality = strtol(value, &end, 10);
+      if (*end != '\0' || end == value || quality < 1 || quality > 100) {
+        fprintf(stderr, "Error: JPEG quality must be between 1 and 100\n");
+        return 0;
       }
-      else {
-        /* Regular numeric parameter parsing for other operations */
-        char *space2 = strchr(params_str, ' ');
-        if (space2) {
-          *space2 = '\0';
-          double param1 = atof(trim_whitespace(params_str));
-          double param2 = atof(trim_whitespace(space2 + 1));
-          add_operation(
-            pipeline,
-            piece,
-            param1,
-            1,
-            param2,
-            1,
-            0.0,
-            0,
-            0.0,
-            0,
-            NULL,
-            0
-          );
-        }
-        else {
-          double param = atof(params_str);
-          add_operation(
-            pipeline,
-            piece,
-            param,
-            1,
-            0.0,
-            0,
-            0.0,
-            0,
-            0.0,
-            0,
-            NULL,
-            0
-          );
-        }
+      options->jpeg_quality = (int32_t)quality;
+    }
+    else if (strcmp(argv[i - 1], "--batch") == 0) {
+      options->batch_list = value;
+    }
+    else if (strcmp(argv[i - 1], "--out-dir") == 0) {
+      options->out_dir = value;
+    }
+    else if (strcmp(argv[i - 1], "--socket") == 0) {
+      options->socket_path = value;
+    }
+    else if (strcmp(argv[i - 1], "--format") == 0) {
+      int32_t format = parse_output_format(value);
+      if (format < 0) {
+        fprintf(stderr, "Error: Unknown output format '%s'\n", value);
+        return 0;
       }
+      options->format = (OutputFormat)format;
     }
     else {
-      add_operation(pipeline, piece, 0.0, 0, 0.0, 0, 0.0, 0, 0.0, 0, NULL, 0);
+      fprintf(stderr, "Error: Unknown option '%s'\n", argv[i - 1]);
+      return 0;
     }
   }
 
-  free(combined);
+  *argc = count;
   return 1;
 }
 
-uint8_t *apply_operation(
-  int32_t *width,
-  int32_t *height,
-  const char *operation,
-  double param,
-  int32_t has_param,
-  double param2,
-  int32_t has_param2,
-  double param3,
-  int32_t has_param3,
-  double param4,
-  int32_t has_param4,
-  const char *param_str,
-  int32_t has_string_param,
-  uint8_t *input_data
-) {
-  if (strcmp(operation, "grayscale") == 0) {
-    return (uint8_t *)fcv_grayscale(*width, *height, input_data);
-  }
-  else if (strcmp(operation, "blur") == 0) {
-    if (!has_param) {
-      fprintf(stderr, "Error: blur operation requires radius parameter\n");
-      return NULL;
+int32_t count_cpu_cores(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int32_t)info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int32_t)count : 1;
+#endif
+}
+
+void compress_png_parts(CompressTask *task) {
+  for (uint32_t i = task->first_part; i < task->num_parts;
+       i += task->part_step) {
+    if (!fcv_png_encoder_compress(task->encoder, i)) {
+      task->success = 0;
     }
-    return (uint8_t *)
-      fcv_apply_gaussian_blur(*width, *height, param, input_data);
   }
-  else if (strcmp(operation, "resize") == 0) {
-    double resize_x, resize_y;
-
-    if (has_string_param) {
-      // Parse new resize formats: 50%, 50%x80%, 200x300
-      char *param_copy = strdup(param_str);
-      char *x_pos = strchr(param_copy, 'x');
+}
 
-      if (x_pos) {
-        // Format: 50%x80% or 200x300
-        *x_pos = '\0';
-        char *first_part = trim_whitespace(param_copy);
-        char *second_part = trim_whitespace(x_pos + 1);
+THREAD_FUNCTION(compress_png_parts_thread, compress_png_parts)
 
-        if (strchr(first_part, '%')) {
-          // Percentage format: 50%x80%
-          resize_x = atof(first_part) / 100.0;
-          resize_y = strchr(second_part, '%') ? atof(second_part) / 100.0
-                                              : atof(second_part) / 100.0;
-        }
-        else {
-          // Absolute size format: 200x300
-          resize_x = atof(first_part) / *width;
-          resize_y = atof(second_part) / *height;
-        }
-      }
-      else if (strchr(param_copy, '%')) {
-        // Uniform percentage format: 50%
-        resize_x = resize_y = atof(param_copy) / 100.0;
-      }
-      else {
-        fprintf(stderr, "Error: Invalid resize format '%s'\n", param_str);
-        free(param_copy);
-        return NULL;
-      }
+#ifdef _WIN32
+int32_t start_thread(Thread *thread, ThreadFunction function, void *argument) {
+  *thread = CreateThread(NULL, 0, function, argument, 0, NULL);
+  return *thread != NULL;
+}
 
-      free(param_copy);
-    }
-    else if (has_param) {
-      // Backward compatibility: numeric parameters
-      resize_x = param;
-      resize_y = has_param2 ? param2 : param;
-    }
-    else {
-      fprintf(stderr, "Error: resize operation requires resize parameter\n");
-      return NULL;
-    }
+void join_thread(Thread thread) {
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+}
 
-    uint32_t out_width, out_height;
-    uint8_t *result = (uint8_t *)fcv_resize(
-      *width,
-      *height,
-      resize_x,
-      resize_y,
-      &out_width,
-      &out_height,
-      input_data
-    );
+void mutex_init(Mutex *mutex) { InitializeCriticalSection(mutex); }
+void mutex_lock(Mutex *mutex) { EnterCriticalSection(mutex); }
+void mutex_unlock(Mutex *mutex) { LeaveCriticalSection(mutex); }
+void mutex_destroy(Mutex *mutex) { DeleteCriticalSection(mutex); }
 
-    if (result) {
-      *width = out_width;
-      *height = out_height;
-    }
+void detach_thread(Thread thread) { CloseHandle(thread); }
 
-    return result;
-  }
-  else if (strcmp(operation, "threshold") == 0) {
-    return (uint8_t *)
-      fcv_otsu_threshold_rgba(*width, *height, false, input_data);
-  }
-  else if (strcmp(operation, "bw_smart") == 0) {
-    return (uint8_t *)fcv_bw_smart(*width, *height, false, input_data);
-  }
-  else if (strcmp(operation, "bw_smooth") == 0) {
-    return (uint8_t *)fcv_bw_smart(*width, *height, true, input_data);
-  }
-  else if (strcmp(operation, "detect_corners") == 0) {
-    Corners corners = fcv_detect_corners(input_data, *width, *height);
-    printf("  {\n");
-    printf("    \"corners\": {\n");
-    printf("      \"top_left\": [%.0f, %.0f],\n", corners.tl_x, corners.tl_y);
-    printf("      \"top_right\": [%.0f, %.0f],\n", corners.tr_x, corners.tr_y);
-    printf(
-      "      \"bottom_right\": [%.0f, %.0f],\n",
-      corners.br_x,
-      corners.br_y
-    );
-    printf("      \"bottom_left\": [%.0f, %.0f]\n", corners.bl_x, corners.bl_y);
-    printf("    }\n");
-    printf("  }\n");
+void condition_init(Condition *condition) {
+  InitializeConditionVariable(condition);
+}
+void condition_wait(Condition *condition, Mutex *mutex) {
+  SleepConditionVariableCS(condition, mutex, INFINITE);
+}
+void condition_signal(Condition *condition) {
+  WakeConditionVariable(condition);
+}
+void condition_broadcast(Condition *condition) {
+  WakeAllConditionVariable(condition);
+}
+void condition_destroy(Condition *condition) { (void)condition; }
+#else
+int32_t start_thread(Thread *thread, ThreadFunction function, void *argument) {
+  return pthread_create(thread, NULL, function, argument) == 0;
+}
 
-    // Return a copy of the input data without modification
-    uint8_t *result = malloc(*width * *height * 4);
-    if (result) {
-      memcpy(result, input_data, *width * *height * 4);
-    }
-    return result;
-  }
-  else if (strcmp(operation, "qr") == 0) {
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      return NULL;
-    }
+void join_thread(Thread thread) {
+  pthread_join(thread, NULL);
+}
 
-    FCVQRCodeResult qrs = fcv_decode_qr_codes(*width, *height, grayscale_data);
-    free(grayscale_data);
+void mutex_init(Mutex *mutex) { pthread_mutex_init(mutex, NULL); }
+void mutex_lock(Mutex *mutex) { pthread_mutex_lock(mutex); }
+void mutex_unlock(Mutex *mutex) { pthread_mutex_unlock(mutex); }
+void mutex_destroy(Mutex *mutex) { pthread_mutex_destroy(mutex); }
 
-    printf("  {\n");
-    printf("    \"qr_codes\": [");
-    for (size_t i = 0; i < qrs.count; i++) {
-      FCVQRCode *qr = &qrs.codes[i];
-      if (i > 0) {
-        printf(",");
-      }
-      printf("\n      {\n");
-      printf("        \"text\": \"");
-      for (const char *p = qr->text; *p; p++) {
-        switch (*p) {
-        case '"':
-          printf("\\\"");
-          break;
-        case '\\':
-          printf("\\\\");
-          break;
-        case '\n':
-          printf("\\n");
-          break;
-        case '\r':
-          printf("\\r");
-          break;
-        case '\t':
-          printf("\\t");
-          break;
-        default:
-          putchar(*p);
-        }
-      }
-      printf("\",\n");
-      printf("        \"corners\": {\n");
-      printf(
-        "          \"top_left\": [%.1f, %.1f],\n",
-        qr->corners.tl_x,
-        qr->corners.tl_y
-      );
-      printf(
-        "          \"top_right\": [%.1f, %.1f],\n",
-        qr->corners.tr_x,
-        qr->corners.tr_y
-      );
-      printf(
-        "          \"bottom_right\": [%.1f, %.1f],\n",
-        qr->corners.br_x,
-        qr->corners.br_y
-      );
-      printf(
-        "          \"bottom_left\": [%.1f, %.1f]\n",
-        qr->corners.bl_x,
-        qr->corners.bl_y
-      );
-      printf("        },\n");
-      printf("        \"finders\": {\n");
-      printf(
-        "          \"top_left\": [%.1f, %.1f],\n",
-        qr->finders[0].x,
-        qr->finders[0].y
-      );
-      printf(
-        "          \"top_right\": [%.1f, %.1f],\n",
-        qr->finders[1].x,
-        qr->finders[1].y
-      );
-      printf(
-        "          \"bottom_left\": [%.1f, %.1f]\n",
-        qr->finders[2].x,
-        qr->finders[2].y
-      );
-      printf("        },\n");
-      printf("        \"module_size\": %.2f\n", qr->module_size);
-      printf("      }");
-    }
-    if (qrs.count > 0) {
-      printf("\n    ");
-    }
-    printf("]\n");
-    printf("  }\n");
+void detach_thread(Thread thread) { pthread_detach(thread); }
 
-    fcv_free_qr_result(qrs);
+void condition_init(Condition *condition) {
+  pthread_cond_init(condition, NULL);
+}
+void condition_wait(Condition *condition, Mutex *mutex) {
+  pthread_cond_wait(condition, mutex);
+}
+void condition_signal(Condition *condition) {
+  pthread_cond_signal(condition);
+}
+void condition_broadcast(Condition *condition) {
+  pthread_cond_broadcast(condition);
+}
+void condition_destroy(Condition *condition) {
+  pthread_cond_destroy(condition);
+}
+#endif
 
-    // Return a copy of the input data without modification
-    uint8_t *result = malloc((size_t)(*width) * (*height) * 4);
-    if (result) {
-      memcpy(result, input_data, (size_t)(*width) * (*height) * 4);
-    }
-    return result;
+/**
+ * Open a file for writing. The path "-" is stdout.
+ */
+FILE *open_output_file(const char *path) {
+  if (strcmp(path, "-") == 0) {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    return stdout;
   }
-  else if (strcmp(operation, "qr_draw") == 0) {
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      return NULL;
-    }
-    FCVQRCodeResult qrs = fcv_decode_qr_codes(*width, *height, grayscale_data);
-    free(grayscale_data);
+  return fopen(path, "wb");
+}
 
-    uint32_t img_length_byte = (*width) * (*height) * 4;
-    uint8_t *result = malloc(img_length_byte);
-    if (!result) {
-      fcv_free_qr_result(qrs);
-      return NULL;
-    }
-    memcpy(result, input_data, img_length_byte);
-
-    /* Colour legend for the annotations:
-       - green:   QR outer border (polygon around all modules)
-       - red:     finder-pattern outlines + centres (module 3.5, 3.5)
-       - magenta: alignment-pattern outlines + centres (module 5x5)
-       - yellow:  timing-pattern module centres (row 6 and col 6) */
-    const char *border_color = "00C800";
-    const char *finder_color = "C80000";
-    const char *alignment_color = "C800C8";
-    const char *timing_color = "FFC800";
-
-    for (size_t i = 0; i < qrs.count; i++) {
-      FCVQRCode *qr = &qrs.codes[i];
-      double module = qr->module_size > 0 ? qr->module_size : 1.0;
-      int qr_size = qr->qr_size > 0 ? qr->qr_size : 21;
-      double finder_radius = module * 1.5;
-      double alignment_radius = module * 0.7;
-      double timing_radius = fmax(1.0, module * 0.3);
-      double border_thickness = fmax(1.0, module * 0.25);
-      double outline_thickness = fmax(1.0, module * 0.15);
-
-      /* Module-coordinate → pixel-coordinate projection. Built from the
-         four detected outer corners so we can draw any feature (finders,
-         alignments, timing) by projecting its module-space rectangle. */
-      Corners src_mod = {
-        0.0,
-        0.0,
-        (double)qr_size,
-        0.0,
-        (double)qr_size,
-        (double)qr_size,
-        0.0,
-        (double)qr_size
-      };
-      Matrix3x3 *H =
-        fcv_calculate_perspective_transform(&src_mod, &qr->corners);
-
-      /* Projects module-coordinate (mx, my) to pixel-coordinate (*px, *py)
-         via H. Returns 0 if the projection is degenerate. */
-#define QR_PROJECT(mx, my, px, py)                                             \
-  do {                                                                         \
-    double _w = H->m20 * (mx) + H->m21 * (my) + H->m22;                        \
-    if (fabs(_w) < 1e-9) {                                                     \
-      (px) = 0.0;                                                              \
-      (py) = 0.0;                                                              \
-    }                                                                          \
-    else {                                                                     \
-      (px) = (H->m00 * (mx) + H->m01 * (my) + H->m02) / _w;                    \
-      (py) = (H->m10 * (mx) + H->m11 * (my) + H->m12) / _w;                    \
-    }                                                                          \
-  } while (0)
-
-      /* Draws a straight line from (x0,y0) to (x1,y1) as overlapping disks
-         of radius `thickness` with the given hex colour. */
-#define QR_DRAW_SEGMENT(x0, y0, x1, y1, color, thickness)                      \
-  do {                                                                         \
-    double _dx = (x1) - (x0);                                                  \
-    double _dy = (y1) - (y0);                                                  \
-    double _len = hypot(_dx, _dy);                                             \
-    int _steps = (int)ceil(_len);                                              \
-    if (_steps < 1) {                                                          \
-      _steps = 1;                                                              \
-    }                                                                          \
-    for (int _s = 0; _s <= _steps; _s++) {                                     \
-      double _t = (double)_s / (double)_steps;                                 \
-      fcv_draw_disk(                                                           \
-        *width,                                                                \
-        *height,                                                               \
-        4,                                                                     \
-        color,                                                                 \
-        thickness,                                                             \
-        (x0) + _t * _dx,                                                       \
-        (y0) + _t * _dy,                                                       \
-        result                                                                 \
-      );                                                                       \
-    }                                                                          \
-  } while (0)
-
-      /* Draws the pixel-projected rectangle (mx0,my0)-(mx1,my1) in module
-         coordinates, outlined with the given colour and thickness. */
-#define QR_DRAW_MODULE_RECT(mx0, my0, mx1, my1, color, thickness)              \
-  do {                                                                         \
-    double _c[4][2];                                                           \
-    QR_PROJECT((mx0), (my0), _c[0][0], _c[0][1]);                              \
-    QR_PROJECT((mx1), (my0), _c[1][0], _c[1][1]);                              \
-    QR_PROJECT((mx1), (my1), _c[2][0], _c[2][1]);                              \
-    QR_PROJECT((mx0), (my1), _c[3][0], _c[3][1]);                              \
-    for (int _e = 0; _e < 4; _e++) {                                           \
-      int _e2 = (_e + 1) % 4;                                                  \
-      QR_DRAW_SEGMENT(                                                         \
-        _c[_e][0],                                                             \
-        _c[_e][1],                                                             \
-        _c[_e2][0],                                                            \
-        _c[_e2][1],                                                            \
-        color,                                                                 \
-        thickness                                                              \
-      );                                                                       \
-    }                                                                          \
-  } while (0)
-
-      /* Outer border: connect the four detected corners directly (no
-         projection — these are pixel coords already). */
-      double xs[4] = {
-        qr->corners.tl_x,
-        qr->corners.tr_x,
-        qr->corners.br_x,
-        qr->corners.bl_x,
-      };
-      double ys[4] = {
-        qr->corners.tl_y,
-        qr->corners.tr_y,
-        qr->corners.br_y,
-        qr->corners.bl_y,
-      };
-      for (int e = 0; e < 4; e++) {
-        int e2 = (e + 1) % 4;
-        QR_DRAW_SEGMENT(
-          xs[e],
-          ys[e],
-          xs[e2],
-          ys[e2],
-          border_color,
-          border_thickness
-        );
-      }
+/**
+ * Close a file opened with open_output_file (stdout is only flushed).
+ * Returns 0 if any write to the file failed.
+ */
+int32_t close_output_file(FILE *file) {
+  int32_t success = !ferror(file);
+  if (file == stdout) {
+    return fflush(file) == 0 && success;
+  }
+  return fclose(file) == 0 && success;
+}
 
-      /* Finder patterns: 7x7 module squares at TL, TR, BL. Outlined, and
-         the detected pixel centre drawn as a filled red disk. */
-      double finder_origins[3][2] = {
-        {0.0, 0.0},
-        {(double)(qr_size - 7), 0.0},
-        {0.0, (double)(qr_size - 7)}
-      };
-      for (int f = 0; f < 3; f++) {
-        QR_DRAW_MODULE_RECT(
-          finder_origins[f][0],
-          finder_origins[f][1],
-          finder_origins[f][0] + 7.0,
-          finder_origins[f][1] + 7.0,
-          finder_color,
-          outline_thickness
-        );
-        fcv_draw_disk(
-          *width,
-          *height,
-          4,
-          finder_color,
-          finder_radius,
-          qr->finders[f].x,
-          qr->finders[f].y,
-          result
-        );
-      }
+/**
+ * Write data to a file or to stdout ("-").
+ * Returns 0 on failure.
+ */
+int32_t write_file(const char *path, uint8_t const *data, size_t size) {
+  FILE *file = open_output_file(path);
+  int32_t success = file && fwrite(data, 1, size, file) == size;
+  if (file && !close_output_file(file)) {
+    success = 0;
+  }
+  return success;
+}
 
-      /* Alignment patterns: 5x5 module squares centred at each detected
-         alignment location. The result struct carries pixel-space
-         centres only (not module indices), so draw a screen-aligned
-         5-module box — this matches the actual snap point under any
-         moderate perspective distortion. */
-      for (size_t a = 0; a < qr->alignment_count; a++) {
-        double cx = qr->alignments[a].x;
-        double cy = qr->alignments[a].y;
-        double pts[4][2] = {
-          {cx - 2.5 * module, cy - 2.5 * module},
-          {cx + 2.5 * module, cy - 2.5 * module},
-          {cx + 2.5 * module, cy + 2.5 * module},
-          {cx - 2.5 * module, cy + 2.5 * module}
-        };
-        for (int e = 0; e < 4; e++) {
-          int e2 = (e + 1) % 4;
-          QR_DRAW_SEGMENT(
-            pts[e][0],
-            pts[e][1],
-            pts[e2][0],
-            pts[e2][1],
-            alignment_color,
-            outline_thickness
-          );
-        }
-        fcv_draw_disk(
-          *width,
-          *height,
-          4,
-          alignment_color,
-          alignment_radius,
-          cx,
-          cy,
-          result
-        );
-      }
+/**
+ * Callback for the stb_image_write functions.
+ */
+void write_to_file(void *file, void *data, int size) {
+  fwrite(data, 1, (size_t)size, (FILE *)file);
+}
 
-      /* Timing patterns: every module centre along row 6 cols 8..qr_size-9
-         and col 6 rows 8..qr_size-9 (the interior cells, excluding the
-         7-module finder blocks and their separators). Module centre of
-         (col, row) is (col + 0.5, row + 0.5). */
-      for (int col = 8; col <= qr_size - 9; col++) {
-        double px, py;
-        QR_PROJECT((double)col + 0.5, 6.5, px, py);
-        fcv_draw_disk(
-          *width,
-          *height,
-          4,
-          timing_color,
-          timing_radius,
-          px,
-          py,
-          result
-        );
-      }
-      for (int row = 8; row <= qr_size - 9; row++) {
-        double px, py;
-        QR_PROJECT(6.5, (double)row + 0.5, px, py);
-        fcv_draw_disk(
-          *width,
-          *height,
-          4,
-          timing_color,
-          timing_radius,
-          px,
-          py,
-          result
-        );
-      }
+/**
+ * Encode a 4-channel image as PNG and write it to a file.
+ * The parts of the deflate stream are compressed in parallel,
+ * the output is the same for any number of threads.
+ * Returns 0 on failure.
+ */
+int32_t write_png(
+  const char *path,
+  int32_t width,
+  int32_t height,
+  uint8_t const *data,
+  OutputOptions const *options
+) {
+  uint32_t num_parts;
+  FCVPngEncoder *encoder = fcv_png_encoder_create(
+    (uint32_t)width,
+    (uint32_t)height,
+    4,
+    data,
+    &options->png,
+    &num_parts
+  );
+  if (!encoder) {
+    return 0;
+  }
 
-      printf(
-        "  QR code %zu: v%d (%dx%d modules), %zu alignment pattern%s: \"%s\"\n",
-        i + 1,
-        qr->version,
-        qr_size,
-        qr_size,
-        qr->alignment_count,
-        qr->alignment_count == 1 ? "" : "s",
-        qr->text
-      );
+  uint32_t num_threads = (uint32_t)(options->num_threads > 0
+                                      ? options->num_threads
+                                      : count_cpu_cores());
+  if (num_threads > num_parts) {
+    num_threads = num_parts;
+  }
 
-      /* fcv_calculate_perspective_transform may return a static identity
-         fallback on failure — only free heap-allocated results. The only
-         stable heap result has m22 == 1.0 and non-identity content; the
-         fallback is exactly the identity matrix. */
-      if (H && !(H->m00 == 1.0 && H->m01 == 0.0 && H->m02 == 0.0 &&
-                 H->m10 == 0.0 && H->m11 == 1.0 && H->m12 == 0.0 &&
-                 H->m20 == 0.0 && H->m21 == 0.0 && H->m22 == 1.0)) {
-        free(H);
-      }
+  CompressTask *tasks = malloc(num_threads * sizeof(CompressTask));
+  Thread *threads = malloc(num_threads * sizeof(Thread));
+  int32_t *is_started = calloc(num_threads, sizeof(int32_t));
+  if (!tasks || !threads || !is_started) {
+    free(tasks);
+    free(threads);
+    free(is_started);
+    fcv_png_encoder_free(encoder);
+    return 0;
+  }
 
-#undef QR_PROJECT
-#undef QR_DRAW_SEGMENT
-#undef QR_DRAW_MODULE_RECT
+  for (uint32_t t = 0; t < num_threads; t++) {
+    tasks[t] = (CompressTask){encoder, num_parts, t, num_threads, 1};
+  }
+  // The first task runs on this thread, as does any task without a thread
+  for (uint32_t t = 1; t < num_threads; t++) {
+    is_started[t] =
+      start_thread(&threads[t], compress_png_parts_thread, &tasks[t]);
+  }
+  for (uint32_t t = 0; t < num_threads; t++) {
+    if (!is_started[t]) {
+      compress_png_parts(&tasks[t]);
+    }
+  }
+  for (uint32_t t = 1; t < num_threads; t++) {
+    if (is_started[t]) {
+      join_thread(threads[t]);
     }
+  }
 
-    fcv_free_qr_result(qrs);
-    return result;
+  int32_t success = 1;
+  for (uint32_t t = 0; t < num_threads; t++) {
+    success = success && tasks[t].success;
+  }
+  free(tasks);
+  free(threads);
+  free(is_started);
+
+  size_t size;
+  uint8_t *png = fcv_png_encoder_finish(encoder, &size);
+  if (!success || !png) {
+    free(png);
+    return 0;
   }
-  else if (strcmp(operation, "draw_corners") == 0) {
-    Corners cs = fcv_detect_corners(input_data, *width, *height);
-    printf("  Detected corners:\n");
-    printf("    Top-left:     (%.0f, %.0f)\n", cs.tl_x, cs.tl_y);
-    printf("    Top-right:    (%.0f, %.0f)\n", cs.tr_x, cs.tr_y);
-    printf("    Bottom-right: (%.0f, %.0f)\n", cs.br_x, cs.br_y);
-    printf("    Bottom-left:  (%.0f, %.0f)\n", cs.bl_x, cs.bl_y);
 
-    // Create a copy of the input data and draw disks at detected corners
-    uint32_t img_length_byte = (*width) * (*height) * 4;
-    uint8_t *result = malloc(img_length_byte);
-    if (!result) {
-      return NULL;
-    }
-    memcpy(result, input_data, img_length_byte);
+  success = write_file(path, png, size);
+  free(png);
+  return success;
+}
 
-    // Draw disks using red color and `radius`
-    const double radius = fmin(*width, *height) * 0.02;
-    const char *red = "FF0000";
-    fcv_draw_disk(*width, *height, 4, red, radius, cs.tl_x, cs.tl_y, result);
-    fcv_draw_disk(*width, *height, 4, red, radius, cs.tr_x, cs.tr_y, result);
-    fcv_draw_disk(*width, *height, 4, red, radius, cs.br_x, cs.br_y, result);
-    fcv_draw_disk(*width, *height, 4, red, radius, cs.bl_x, cs.bl_y, result);
+/**
+ * Read a whole file with stdio into an allocated buffer.
+ * Returns 0 on failure.
+ */
+int32_t read_input_file(FILE *file, InputFile *input) {
+  size_t capacity = 1 << 16;
+  size_t size = 0;
+  uint8_t *data = malloc(capacity);
+  while (data) {
+    size += fread(data + size, 1, capacity - size, file);
+    if (size < capacity) {
+      break;
+    }
+    uint8_t *larger = capacity <= SIZE_MAX / 2 ? realloc(data, capacity * 2)
+                                               : NULL;
+    if (!larger) {
+      free(data);
+      data = NULL;
+      break;
+    }
+    data = larger;
+    capacity *= 2;
+  }
+  if (!data || ferror(file)) {
+    free(data);
+    return 0;
+  }
+  *input = (InputFile){data, size, 0};
+  return 1;
+}
 
-    return result;
+/**
+ * Map the input file into memory, so it is opened and read only once
+ * for decoding and for parsing the EXIF orientation.
+ * The mapping is copy-on-write, so pixels used right from the file
+ * can be modified in place without changing the file.
+ * Files that can't be mapped (e.g. empty ones or pipes) are read instead.
+ * The path "-" reads stdin.
+ * Returns 0 on failure.
+ */
+int32_t open_input_file(const char *path, InputFile *input) {
+  if (strcmp(path, "-") == 0) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    return read_input_file(stdin, input);
   }
-  else if (strcmp(operation, "sobel") == 0) {
-    uint8_t *grayscale_sobel =
-      fcv_sobel_edge_detection(*width, *height, 4, input_data);
-    if (!grayscale_sobel) {
-      return NULL;
-    }
 
-    // Convert single-channel grayscale to RGBA format
-    uint8_t *rgba_result =
-      fcv_single_to_multichannel(*width, *height, grayscale_sobel);
-    free(grayscale_sobel);
-    return (uint8_t *)rgba_result;
+#ifdef _WIN32
+  HANDLE file = CreateFileA(
+    path,
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    NULL,
+    OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN,
+    NULL
+  );
+  if (file == INVALID_HANDLE_VALUE) {
+    return 0;
   }
-  else if (strcmp(operation, "circle") == 0) {
-    if (!has_string_param || !has_param || !has_param2 || !has_param3) {
-      fprintf(
-        stderr,
-        "Error: circle operation requires: hex_color radius xXy\n"
-      );
-      return NULL;
-    }
-    // Parse color and coordinates from param_str
-    char *param_copy = strdup(param_str);
-    char *color = strtok(param_copy, " ");
-    double center_x = param2;
-    double center_y = param3;
-    double radius = param;
-
-    uint32_t img_length_byte = (*width) * (*height) * 4;
-    uint8_t *result = malloc(img_length_byte);
-    if (!result) {
-      free(param_copy);
-      return NULL;
+  LARGE_INTEGER file_size;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 &&
+      (uint64_t)file_size.QuadPart <= SIZE_MAX) {
+    HANDLE mapping =
+      CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    // The view keeps the file and the mapping open
+    void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0)
+                         : NULL;
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    if (data) {
+      CloseHandle(file);
+      *input = (InputFile){data, (size_t)file_size.QuadPart, 1};
+      return 1;
     }
-    memcpy(result, input_data, img_length_byte);
-
-    fcv_draw_circle(
-      *width,
-      *height,
-      4,
-      color,
-      radius,
-      center_x,
-      center_y,
-      result
-    );
-
-    free(param_copy);
-    return result;
   }
-  else if (strcmp(operation, "disk") == 0) {
-    if (!has_string_param || !has_param || !has_param2 || !has_param3) {
-      fprintf(stderr, "Error: disk operation requires: hex_color radius xXy\n");
-      return NULL;
-    }
-    // Parse color and coordinates from param_str
-    char *param_copy = strdup(param_str);
-    char *color = strtok(param_copy, " ");
-    double center_x = param2;
-    double center_y = param3;
-    double radius = param;
-
-    uint32_t img_length_byte = (*width) * (*height) * 4;
-    uint8_t *result = malloc(img_length_byte);
-    if (!result) {
-      free(param_copy);
-      return NULL;
+  CloseHandle(file);
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 &&
+      (uint64_t)info.st_size <= SIZE_MAX) {
+    size_t size = (size_t)info.st_size;
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+      madvise(data, size, MADV_SEQUENTIAL);
+#endif
+      close(fd);
+      *input = (InputFile){data, size, 1};
+      return 1;
     }
-    memcpy(result, input_data, img_length_byte);
-
-    fcv_draw_disk(
-      *width,
-      *height,
-      4,
-      color,
-      radius,
-      center_x,
-      center_y,
-      result
-    );
+  }
+  close(fd);
+#endif
 
-    free(param_copy);
-    return result;
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return 0;
   }
-  else if (strcmp(operation, "watershed") == 0) {
-    if (!has_string_param) {
-      fprintf(
-        stderr,
-        "Error: watershed operation requires marker coordinates\n"
-      );
-      return NULL;
-    }
+  int32_t success = read_input_file(file, input);
+  fclose(file);
+  return success;
+}
 
-    // Parse marker coordinates from param_str: "x1×y1 x2×y2 ..."
-    char *param_copy = strdup(param_str);
+void close_input_file(InputFile *input) {
+  if (input->is_mapped) {
+#ifdef _WIN32
+    UnmapViewOfFile(input->data);
+#else
+    munmap(input->data, input->size);
+#endif
+  }
+  else {
+    free(input->data);
+  }
+  input->data = NULL;
+  input->size = 0;
+}
 
-    // Count number of markers by counting spaces + 1
-    int32_t num_markers = 1;
-    for (char *p = param_copy; *p; p++) {
-      if (*p == ' ') {
-        num_markers++;
-      }
+/**
+ * Write a 4-channel image as JPEG.
+ * Gray images (equal red, green and blue values) are written
+ * with a single component, which is smaller and faster to encode.
+ * Returns 0 on failure.
+ */
+int32_t write_jpeg(
+  const char *path,
+  int32_t width,
+  int32_t height,
+  uint8_t const *data,
+  OutputOptions const *options
+) {
+  size_t num_pixels = (size_t)width * height;
+  int32_t is_gray = 1;
+  for (size_t i = 0; i < num_pixels; i++) {
+    uint8_t const *pixel = data + i * 4;
+    if (pixel[0] != pixel[1] || pixel[0] != pixel[2]) {
+      is_gray = 0;
+      break;
     }
+  }
 
-    Point2D *markers = malloc(num_markers * sizeof(Point2D));
-    if (!markers) {
-      free(param_copy);
-      return NULL;
-    }
+  if (!is_gray) {
+    FILE *file = open_output_file(path);
+    int32_t success = file && stbi_write_jpg_to_func(
+                                write_to_file,
+                                file,
+                                width,
+                                height,
+                                4,
+                                data,
+                                options->jpeg_quality
+                              );
+    if (file && !close_output_file(file)) {
+      success = 0;
+    }
+    return success;
+  }
 
-    // Parse each marker
-    char *token = strtok(param_copy, " ");
-    int32_t marker_idx = 0;
+  size_t size;
+  uint8_t *jpeg = fcv_encode_jpeg_gray(
+    (uint32_t)width,
+    (uint32_t)height,
+    4,
+    data,
+    options->jpeg_quality,
+    &size
+  );
+  if (!jpeg) {
+    return 0;
+  }
 
-    while (token && marker_idx < num_markers) {
-      char *x_pos = strchr(token, 'x');
-      if (x_pos) {
-        *x_pos = '\0';
-        markers[marker_idx].x = atof(trim_whitespace(token));
-        markers[marker_idx].y = atof(trim_whitespace(x_pos + 1));
-        marker_idx++;
-      }
-      token = strtok(NULL, " ");
-    }
+  int32_t success = write_file(path, jpeg, size);
+  free(jpeg);
+  return success;
+}
 
-    if (marker_idx == 0) {
-      fprintf(
-        stderr,
-        "Error: No valid markers found in format 'x1×y1 x2×y2 ...'\n"
-      );
-      free(markers);
-      free(param_copy);
-      return NULL;
+/**
+ * Write a 4-channel image as QOI.
+ * Returns 0 on failure.
+ */
+int32_t write_qoi(
+  const char *path,
+  int32_t width,
+  int32_t height,
+  uint8_t const *data
+) {
+  size_t size;
+  uint8_t *qoi =
+    fcv_encode_qoi((uint32_t)width, (uint32_t)height, 4, data, &size);
+  if (!qoi) {
+    return 0;
+  }
+  int32_t success = write_file(path, qoi, size);
+  free(qoi);
+  return success;
+}
+
+/**
+ * Write a 4-channel image as PGM, PPM or PAM (with alpha channel).
+ * Returns 0 on failure.
+ */
+int32_t write_netpbm(
+  const char *path,
+  int32_t width,
+  int32_t height,
+  uint8_t const *data,
+  FCVNetpbmFormat format
+) {
+  size_t size;
+  uint8_t *netpbm = fcv_encode_netpbm(
+    (uint32_t)width,
+    (uint32_t)height,
+    4,
+    data,
+    format,
+    &size
+  );
+  if (!netpbm) {
+    return 0;
+  }
+  int32_t success = write_file(path, netpbm, size);
+  free(netpbm);
+  return success;
+}
+
+/**
+ * Write the RGBA pixels of an image without any header
+ * and its PAM header to the sidecar file `<path>.hdr`.
+ * Returns 0 on failure.
+ */
+int32_t write_raw(
+  const char *path,
+  int32_t width,
+  int32_t height,
+  uint8_t const *data
+) {
+  char header[128];
+  size_t header_length = fcv_netpbm_header(
+    (uint32_t)width,
+    (uint32_t)height,
+    4,
+    FCV_NETPBM_PAM,
+    header,
+    sizeof(header)
+  );
+  size_t path_length = strlen(path);
+  char *header_path = malloc(path_length + sizeof(".hdr"));
+  if (header_length == 0 || !header_path) {
+    free(header_path);
+    return 0;
+  }
+  memcpy(header_path, path, path_length);
+  memcpy(header_path + path_length, ".hdr", sizeof(".hdr"));
+
+  int32_t success =
+    write_file(header_path, (uint8_t const *)header, header_length) &&
+    write_file(path, data, (size_t)width * height * 4);
+  free(header_path);
+  return success;
+}
+
+/**
+ * Write a 4-channel image in the given format.
+ * Returns 0 on failure.
+ */
+int32_t write_image(
+  const char *path,
+  OutputFormat format,
+  int32_t width,
+  int32_t height,
+  uint8_t const *data,
+  OutputOptions const *options
+) {
+  switch (format) {
+  case OUTPUT_JPEG:
+    return write_jpeg(path, width, height, data, options);
+  case OUTPUT_QOI:
+    return write_qoi(path, width, height, data);
+  case OUTPUT_PGM:
+    return write_netpbm(path, width, height, data, FCV_NETPBM_PGM);
+  case OUTPUT_PPM:
+    return write_netpbm(path, width, height, data, FCV_NETPBM_PPM);
+  case OUTPUT_PAM:
+    return write_netpbm(path, width, height, data, FCV_NETPBM_PAM);
+  case OUTPUT_RAW:
+    return write_raw(path, width, height, data);
+  default:
+    return write_png(path, width, height, data, options);
+  }
+}
+
+/**
+ * Read the PAM header of a raw image from its sidecar file `<path>.hdr`.
+ * Returns 0 on failure.
+ */
+int32_t read_raw_header(const char *path, FCVNetpbmInfo *info) {
+  size_t path_length = strlen(path);
+  char *header_path = malloc(path_length + sizeof(".hdr"));
+  if (!header_path) {
+    return 0;
+  }
+  memcpy(header_path, path, path_length);
+  memcpy(header_path + path_length, ".hdr", sizeof(".hdr"));
+  FILE *file = fopen(header_path, "rb");
+  free(header_path);
+  if (!file) {
+    return 0;
+  }
+
+  InputFile header;
+  int32_t success = read_input_file(file, &header);
+  fclose(file);
+  if (!success) {
+    return 0;
+  }
+  success = fcv_netpbm_info(header.data, header.size, info);
+  free(header.data);
+  return success;
+}
+
+/**
+ * Decode the input file.
+ * QOI, PGM, PPM, PAM and raw files (with the PAM header in `<path>.hdr`)
+ * are decoded by FlatCV, all other formats by stb_image.
+ * 8-bit gray and RGBA netpbm and raw images are not decoded at all:
+ * their pixels are used right from the (copy-on-write) mapped file.
+ * Images are decoded to gray if the pipeline starts gray.
+ * Color JPEGs then yield their luma plane, which can differ from
+ * fcv_grayscale by a level or two.
+ * Returns 0 on failure.
+ */
+int32_t decode_input_file(
+  const char *path,
+  InputFile *input,
+  int32_t prefer_gray,
+  DecodedImage *image
+) {
+  *image = (DecodedImage){NULL, 0, 0, 0, 4, 1, 0};
+
+  FCVNetpbmInfo info;
+  uint8_t *samples = NULL;
+  size_t samples_size = 0;
+  const char *ext = strrchr(path, '.');
+  if (ext && strcmp(ext, ".raw") == 0) {
+    if (!read_raw_header(path, &info)) {
+      return 0;
+    }
+    samples = input->data;
+    samples_size = input->size;
+  }
+  else if (fcv_netpbm_info(input->data, input->size, &info) &&
+           info.data_offset <= input->size) {
+    samples = input->data + info.data_offset;
+    samples_size = input->size - info.data_offset;
+  }
+
+  if (samples) {
+    if (info.width > INT_MAX || info.height > INT_MAX) {
+      return 0;
     }
+    image->width = (int32_t)info.width;
+    image->height = (int32_t)info.height;
+    image->channels = (int32_t)info.channels;
 
-    // Convert RGBA to single-channel grayscale for watershed segmentation
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      free(markers);
-      free(param_copy);
-      return NULL;
+    // Check for overflow: width * height * channels
+    int32_t is_complete =
+      info.width <= SIZE_MAX / info.height &&
+      (size_t)info.width * info.height <= samples_size / info.channels;
+    if (is_complete && info.maxval == 255 &&
+        (info.channels == 1 || info.channels == 4)) {
+      image->data = samples;
+      image->data_channels = (int32_t)info.channels;
+      image->is_borrowed = 1;
+    }
+    else {
+      image->data = fcv_netpbm_to_rgba(&info, samples, samples_size);
     }
+    return image->data != NULL;
+  }
+
+  if (input->size >= 4 && memcmp(input->data, "qoif", 4) == 0) {
+    uint32_t width, height, channels;
+    image->data =
+      fcv_decode_qoi(input->data, input->size, &width, &height, &channels);
+    if (!image->data || width > INT_MAX || height > INT_MAX) {
+      free(image->data);
+      image->data = NULL;
+      return 0;
+    }
+    image->width = (int32_t)width;
+    image->height = (int32_t)height;
+    image->channels = (int32_t)channels;
+    return 1;
+  }
 
-    uint8_t *result = (uint8_t *)fcv_watershed_segmentation(
-      *width,
-      *height,
-      grayscale_data,
-      markers,
-      marker_idx,
-      false
+  if (input->size > INT_MAX) {
+    return 0;
+  }
+
+  // Gray images are decoded to 1 channel directly.
+  // For color JPEGs, stb_image then only writes out the luma plane
+  // and skips chroma upsampling and the YCbCr to RGB conversion.
+  // For other color images, its conversion to gray uses other weights,
+  // so they are decoded to RGB (the alpha is dropped by grayscale anyway)
+  // and converted with FlatCV's weights.
+  int32_t width, height;
+  int32_t channels = 0;
+  int32_t is_decoded_gray =
+    prefer_gray &&
+    stbi_info_from_memory(
+      input->data,
+      (int32_t)input->size,
+      &width,
+      &height,
+      &channels
     );
-    free(grayscale_data);
+  int32_t is_jpeg = input->size >= 3 && input->data[0] == 0xFF &&
+                    input->data[1] == 0xD8 && input->data[2] == 0xFF;
+  int32_t is_converted = channels > 2 && !is_jpeg;
+  image->data = stbi_load_from_memory(
+    input->data,
+    (int32_t)input->size,
+    &image->width,
+    &image->height,
+    &image->channels,
+    is_decoded_gray ? (is_converted ? 3 : 1) : 4
+  );
+  if (!image->data) {
+    return 0;
+  }
+  if (is_decoded_gray && is_converted) {
+    fcv_rgb_to_grayscale_in_place(
+      (uint32_t)image->width,
+      (uint32_t)image->height,
+      image->data
+    );
+  }
+  image->data_channels = is_decoded_gray ? 1 : 4;
+
+  // Handle EXIF orientation for JPEGs (other formats yield 1)
+  image->orientation = fcv_get_exif_orientation_mem(input->data, input->size);
+  return 1;
+}
 
-    free(markers);
-    free(param_copy);
-    return result;
+/**
+ * Free the decoded pixels, or close the input file they belong to.
+ */
+void free_decoded_image(DecodedImage *image, InputFile *input) {
+  if (image->is_borrowed) {
+    close_input_file(input);
   }
-  else if (strcmp(operation, "crop") == 0) {
-    if (!has_param || !has_param2 || !has_param3 || !has_param4) {
-      fprintf(
-        stderr,
-        "Error: crop operation requires geometry format (e.g., 50x50+10+20)\n"
-      );
-      return NULL;
+  else {
+    stbi_image_free(image->data);
+  }
+  image->data = NULL;
+}
+
+/**
+ * Get the format of an output file from its extension,
+ * unless a format was set explicitly.
+ * Files without a known extension and stdout default to PNG.
+ */
+OutputFormat resolve_output_format(const char *path, OutputFormat format) {
+  if (format != OUTPUT_BY_EXTENSION) {
+    return format;
+  }
+  const char *ext = strrchr(path, '.');
+  int32_t ext_format = ext ? parse_output_format(ext + 1) : -1;
+  return ext_format >= 0 ? (OutputFormat)ext_format : OUTPUT_PNG;
+}
+
+/**
+ * Decode an opened input file, execute the pipeline and save the result.
+ * The input file is closed afterwards.
+ * Info-only pipelines pass NULL as output path.
+ * Workers pass their own `context` to reuse its buffers for every image,
+ * others pass NULL.
+ * Progress is logged to `log` unless it is NULL, errors go to stderr.
+ * Returns 0 on failure.
+ */
+int32_t process_input_file(
+  const char *input_path,
+  InputFile input,
+  const char *output_path,
+  FCVPipeline const *pipeline,
+  FCVPipelineContext *context,
+  OutputOptions const *options,
+  FILE *log
+) {
+  DecodedImage image;
+  int32_t is_decoded = decode_input_file(
+    input_path,
+    &input,
+    pipeline_starts_gray(pipeline, output_path == NULL),
+    &image
+  );
+  // Borrowed pixels keep the input file open until the pipeline is done
+  if (!is_decoded || !image.is_borrowed) {
+    close_input_file(&input);
+  }
+
+  if (!is_decoded) {
+    fprintf(stderr, "Error: Could not load image '%s'\n", input_path);
+    return 0;
+  }
+
+  int32_t width = image.width;
+  int32_t height = image.height;
+  int32_t orientation = image.orientation;
+  // The orientation is applied during the pipeline, see fcv_pipeline_run
+  int32_t is_transposed = orientation >= 5 && orientation <= 8;
+  if (log) {
+    if (orientation > 1 && orientation <= 8) {
+      fprintf(log, "Applying EXIF orientation: %d\n", orientation);
     }
-    // param and param2 are x_offset and y_offset (can be negative)
-    // param3 and param4 are crop_width and crop_height
-    int32_t x_offset = (int32_t)param;
-    int32_t y_offset = (int32_t)param2;
-    uint32_t crop_width = (uint32_t)param3;
-    uint32_t crop_height = (uint32_t)param4;
+    fprintf(
+      log,
+      "Loaded image: %dx%d with %d channels\n",
+      is_transposed ? height : width,
+      is_transposed ? width : height,
+      image.channels
+    );
+  }
 
-    // Clamp negative offsets to 0
-    uint32_t x = (x_offset < 0) ? 0 : (uint32_t)x_offset;
-    uint32_t y = (y_offset < 0) ? 0 : (uint32_t)y_offset;
+  FCVPipelineOptions pipeline_options = {
+    orientation,
+    log,
+    options->explain ? (log ? log : stderr) : NULL,
+    stdout,
+    context,
+  };
+  uint8_t *result_data = fcv_pipeline_run(
+    pipeline,
+    &width,
+    &height,
+    image.data_channels,
+    image.data,
+    &pipeline_options
+  );
 
-    // Ensure crop area doesn't exceed image bounds
-    if (x >= (uint32_t)*width || y >= (uint32_t)*height) {
-      fprintf(stderr, "Error: crop offset is outside image bounds\n");
-      return NULL;
+  if (!result_data) {
+    fprintf(stderr, "Error: Failed to execute pipeline\n");
+    free_decoded_image(&image, &input);
+    return 0;
+  }
+
+  int32_t success = 1;
+  if (output_path) {
+    if (log) {
+      fprintf(log, "Final output dimensions: %dx%d\n", width, height);
     }
 
-    // Adjust crop dimensions if they would exceed image bounds
-    uint32_t max_width = *width - x;
-    uint32_t max_height = *height - y;
-    if (crop_width > max_width) {
-      crop_width = max_width;
+    success = write_image(
+      output_path,
+      resolve_output_format(output_path, options->format),
+      width,
+      height,
+      result_data,
+      options
+    );
+
+    if (!success) {
+      fprintf(stderr, "Error: Could not save image to '%s'\n", output_path);
     }
-    if (crop_height > max_height) {
-      crop_height = max_height;
+    else if (log) {
+      fprintf(
+        log,
+        "Successfully saved processed image to '%s'\n",
+        strcmp(output_path, "-") == 0 ? "stdout" : output_path
+      );
     }
+  }
 
-    uint8_t *result =
-      fcv_crop(*width, *height, 4, input_data, x, y, crop_width, crop_height);
-    if (result) {
-      *width = crop_width;
-      *height = crop_height;
-    }
-    return result;
+  free(result_data);
+  free_decoded_image(&image, &input);
+  return success;
+}
+
+/**
+ * Load an image, execute the pipeline and save the result.
+ * See process_input_file.
+ * Returns 0 on failure.
+ */
+int32_t process_image(
+  const char *input_path,
+  const char *output_path,
+  FCVPipeline const *pipeline,
+  FCVPipelineContext *context,
+  OutputOptions const *options,
+  FILE *log
+) {
+  InputFile input;
+  if (!open_input_file(input_path, &input)) {
+    fprintf(stderr, "Error: Could not load image '%s'\n", input_path);
+    return 0;
   }
-  else if (strcmp(operation, "extract_document") == 0) {
-    // Auto-size version
-    uint32_t output_width, output_height;
-    uint8_t *result = fcv_extract_document_auto(
-      *width,
-      *height,
-      input_data,
-      &output_width,
-      &output_height
-    );
+  return process_input_file(
+    input_path,
+    input,
+    output_path,
+    pipeline,
+    context,
+    options,
+    log
+  );
+}
 
-    if (result) {
-      *width = output_width;
-      *height = output_height;
+typedef struct {
+  char **input_paths;
+  int32_t num_files;
+  int32_t next_file;  // Guarded by the mutex
+  int32_t num_failed; // Guarded by the mutex
+  Mutex mutex;
+  FCVPipeline const *pipeline;
+  OutputOptions options;
+  const char *out_dir;
+} BatchQueue;
+
+/**
+ * Get the path of the output file for an input file of a batch:
+ * the file name of the input in the output directory,
+ * with the extension of the output format if one was set.
+ * Returns NULL if memory ran out.
+ */
+char *batch_output_path(
+  const char *input_path,
+  const char *out_dir,
+  OutputFormat format
+) {
+  static const char *const extensions[] =
+    {".png", ".jpeg", ".qoi", ".pgm", ".ppm", ".pam", ".raw"};
+
+  const char *name = input_path;
+  for (const char *c = input_path; *c; c++) {
+    if (*c == '/' || *c == '\\') {
+      name = c + 1;
     }
+  }
+  size_t name_length = strlen(name);
+  const char *extension = "";
+  if (format != OUTPUT_BY_EXTENSION) {
+    const char *dot = strrchr(name, '.');
+    name_length = dot ? (size_t)(dot - name) : name_length;
+    extension = extensions[format];
+  }
 
-    return result;
+  size_t dir_length = strlen(out_dir);
+  size_t size = dir_length + 1 + name_length + strlen(extension) + 1;
+  char *output_path = malloc(size);
+  if (output_path) {
+    snprintf(
+      output_path,
+      size,
+      "%s/%.*s%s",
+      out_dir,
+      (int)name_length,
+      name,
+      extension
+    );
   }
-  else if (strcmp(operation, "extract_document_to") == 0) {
-    if (!has_param || !has_param2) {
+  return output_path;
+}
+
+/**
+ * Process the files of a batch until none are left.
+ * Each worker has only one image in flight at a time,
+ * so the memory use is bounded by the number of workers.
+ * The buffers for the intermediate images are reused for all files
+ * of the worker.
+ */
+void process_batch_files(BatchQueue *queue) {
+  // Without a context, the buffers are allocated for every file
+  FCVPipelineContext *context = fcv_pipeline_context_new();
+  while (1) {
+    mutex_lock(&queue->mutex);
+    int32_t index = queue->next_file++;
+    mutex_unlock(&queue->mutex);
+    if (index >= queue->num_files) {
+      fcv_pipeline_context_free(context);
+      return;
+    }
+
+    const char *input_path = queue->input_paths[index];
+    char *output_path =
+      batch_output_path(input_path, queue->out_dir, queue->options.format);
+    int32_t success = output_path && process_image(
+                                       input_path,
+                                       output_path,
+                                       queue->pipeline,
+                                       context,
+                                       &queue->options,
+                                       NULL
+                                     );
+
+    if (success) {
       fprintf(
         stderr,
-        "Error: extract_document_to operation requires output dimensions\n"
+        "[%d/%d] Saved '%s'\n",
+        index + 1,
+        queue->num_files,
+        output_path
       );
-      return NULL;
     }
+    else {
+      fprintf(
+        stderr,
+        "[%d/%d] Failed to process '%s'\n",
+        index + 1,
+        queue->num_files,
+        input_path
+      );
+      mutex_lock(&queue->mutex);
+      queue->num_failed++;
+      mutex_unlock(&queue->mutex);
+    }
+    free(output_path);
+  }
+}
 
-    uint32_t output_width = (uint32_t)param;
-    uint32_t output_height = (uint32_t)param2;
+THREAD_FUNCTION(process_batch_files_thread, process_batch_files)
 
-    uint8_t *result = fcv_extract_document(
-      *width,
-      *height,
-      input_data,
-      output_width,
-      output_height
-    );
+/**
+ * Read the input files of a batch, one path per line.
+ * Empty lines are skipped.
+ * Returns the paths, which point into `*buffer`, or NULL on failure.
+ */
+char **read_batch_list(const char *path, char **buffer, int32_t *num_files) {
+  InputFile list;
+  if (!open_input_file(path, &list)) {
+    return NULL;
+  }
+  // Copy the list to terminate every line with a null character
+  char *text = malloc(list.size + 1);
+  if (text) {
+    memcpy(text, list.data, list.size);
+    text[list.size] = '\0';
+  }
+  size_t size = list.size;
+  close_input_file(&list);
+  if (!text) {
+    return NULL;
+  }
+
+  size_t max_files = 1;
+  for (size_t i = 0; i < size; i++) {
+    max_files += text[i] == '\n';
+  }
+  char **paths = max_files <= INT_MAX ? malloc(max_files * sizeof(char *))
+                                      : NULL;
+  if (!paths) {
+    free(text);
+    return NULL;
+  }
 
-    if (result) {
-      *width = output_width;
-      *height = output_height;
+  int32_t count = 0;
+  char *line = text;
+  while (line) {
+    char *end = strchr(line, '\n');
+    if (end) {
+      *end = '\0';
     }
+    size_t length = strlen(line);
+    if (length > 0 && line[length - 1] == '\r') {
+      line[--length] = '\0';
+    }
+    if (length > 0) {
+      paths[count++] = line;
+    }
+    line = end ? end + 1 : NULL;
+  }
+
+  *buffer = text;
+  *num_files = count;
+  return paths;
+}
 
-    return result;
+/**
+ * Apply the pipeline to all files of the list on a pool of workers.
+ * A file that fails is reported and doesn't stop the batch.
+ * Returns the number of files that failed, or -1 if the batch
+ * couldn't be started.
+ */
+int32_t process_batch(
+  const char *list_path,
+  const char *out_dir,
+  FCVPipeline const *pipeline,
+  OutputOptions const *options
+) {
+  char *buffer;
+  BatchQueue queue = {0};
+  queue.input_paths = read_batch_list(list_path, &buffer, &queue.num_files);
+  if (!queue.input_paths) {
+    fprintf(stderr, "Error: Could not read batch list '%s'\n", list_path);
+    return -1;
   }
-  else if (strcmp(operation, "flip_x") == 0) {
-    return (uint8_t *)fcv_flip_x(*width, *height, input_data);
+  queue.pipeline = pipeline;
+  queue.options = *options;
+  queue.out_dir = out_dir;
+  // The workers already run in parallel, so every PNG is compressed
+  // on the thread of its worker
+  queue.options.num_threads = 1;
+
+  int32_t num_workers =
+    options->num_threads > 0 ? options->num_threads : count_cpu_cores();
+  if (num_workers > queue.num_files) {
+    num_workers = queue.num_files;
   }
-  else if (strcmp(operation, "flip_y") == 0) {
-    return (uint8_t *)fcv_flip_y(*width, *height, input_data);
+  fprintf(
+    stderr,
+    "Processing %d files with %d workers\n",
+    queue.num_files,
+    num_workers
+  );
+
+  Thread *threads = malloc((size_t)(num_workers + 1) * sizeof(Thread));
+  int32_t *is_started = calloc((size_t)num_workers + 1, sizeof(int32_t));
+  if (!threads || !is_started) {
+    free(threads);
+    free(is_started);
+    free(queue.input_paths);
+    free(buffer);
+    return -1;
   }
-  else if (strcmp(operation, "rotate") == 0) {
-    if (!has_param) {
-      fprintf(stderr, "Error: rotate requires an angle parameter\n");
+  mutex_init(&queue.mutex);
+
+  // This thread is a worker as well
+  for (int32_t t = 1; t < num_workers; t++) {
+    is_started[t] =
+      start_thread(&threads[t], process_batch_files_thread, &queue);
+  }
+  process_batch_files(&queue);
+  for (int32_t t = 1; t < num_workers; t++) {
+    if (is_started[t]) {
+      join_thread(threads[t]);
+    }
+  }
+
+  mutex_destroy(&queue.mutex);
+  free(threads);
+  free(is_started);
+  free(queue.input_paths);
+  free(buffer);
+
+  fprintf(
+    stderr,
+    "Processed %d files, %d failed\n",
+    queue.num_files,
+    queue.num_failed
+  );
+  return queue.num_failed;
+}
+
+/**
+ * Read a line of any length without the line break.
+ * Returns NULL at the end of the file or if memory ran out.
+ */
+char *read_line(FILE *file) {
+  size_t capacity = 256;
+  size_t length = 0;
+  char *line = malloc(capacity);
+  while (line && fgets(line + length, (int)(capacity - length), file)) {
+    length += strlen(line + length);
+    if (length > 0 && line[length - 1] == '\n') {
+      break;
+    }
+    if (length + 1 < capacity) {
+      continue; // End of the file without a line break
+    }
+    char *larger = capacity <= SIZE_MAX / 2 ? realloc(line, capacity * 2)
+                                            : NULL;
+    if (!larger) {
+      free(line);
       return NULL;
     }
-    int angle = (int)param;
-    // Normalize angle to 0-359 range
-    angle = ((angle % 360) + 360) % 360;
-    if (angle != 0 && angle != 90 && angle != 180 && angle != 270) {
-      fprintf(stderr, "Error: rotate angle must be a multiple of 90\n");
+    line = larger;
+    capacity *= 2;
+  }
+  if (!line || length == 0) {
+    free(line);
+    return NULL;
+  }
+  while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+    line[--length] = '\0';
+  }
+  return line;
+}
+
+/**
+ * Write a string as JSON string literal.
+ */
+void print_json_string(FILE *file, const char *text) {
+  fputc('"', file);
+  for (const char *c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(file, "\\%c", *c);
+    }
+    else if ((unsigned char)*c < 0x20) {
+      fprintf(file, "\\u%04x", (unsigned char)*c);
+    }
+    else {
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+const char *json_skip_space(const char *cursor) {
+  while (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' ||
+         *cursor == '\r') {
+    cursor++;
+  }
+  return cursor;
+}
+
+/**
+ * Parse a JSON string literal starting at the opening quote.
+ * Returns the unescaped string (UTF-8) or NULL if it is invalid.
+ */
+char *json_parse_string(const char **cursor) {
+  const char *c = *cursor;
+  if (*c != '"') {
+    return NULL;
+  }
+  c++;
+  // The unescaped string is never longer than the literal
+  size_t capacity = 1;
+  while (c[capacity - 1] && c[capacity - 1] != '"') {
+    capacity += c[capacity - 1] == '\\' && c[capacity] ? 2 : 1;
+  }
+  char *text = malloc(capacity);
+  if (!text) {
+    return NULL;
+  }
+
+  size_t length = 0;
+  while (*c != '"') {
+    if (*c == '\0') {
+      free(text);
       return NULL;
     }
-    if (angle == 0) {
-      // No rotation, return a copy
-      size_t size = (size_t)(*width) * (*height) * 4;
-      uint8_t *result = malloc(size);
-      if (result) {
-        memcpy(result, input_data, size);
-      }
-      return result;
-    }
-    else if (angle == 90) {
-      uint8_t *result = fcv_rotate_90_cw(*width, *height, input_data);
-      if (result) {
-        uint32_t tmp = *width;
-        *width = *height;
-        *height = tmp;
-      }
-      return result;
+    if (*c != '\\') {
+      text[length++] = *c++;
+      continue;
     }
-    else if (angle == 180) {
-      return fcv_rotate_180(*width, *height, input_data);
+    c++;
+    char escaped = *c++;
+    char simple = escaped == '"'    ? '"'
+                  : escaped == '\\' ? '\\'
+                  : escaped == '/'  ? '/'
+                  : escaped == 'b'  ? '\b'
+                  : escaped == 'f'  ? '\f'
+                  : escaped == 'n'  ? '\n'
+                  : escaped == 'r'  ? '\r'
+                  : escaped == 't'  ? '\t'
+                                    : '\0';
+    if (simple != '\0') {
+      text[length++] = simple;
+      continue;
     }
-    else { // angle == 270
-      uint8_t *result = fcv_rotate_270_cw(*width, *height, input_data);
-      if (result) {
-        uint32_t tmp = *width;
-        *width = *height;
-        *height = tmp;
+    uint32_t code = 0;
+    for (int32_t i = 0; escaped == 'u' && i < 4; i++) {
+      char digit = *c++;
+      int32_t value = digit >= '0' && digit <= '9'   ? digit - '0'
+                      : digit >= 'a' && digit <= 'f' ? digit - 'a' + 10
+                      : digit >= 'A' && digit <= 'F' ? digit - 'A' + 10
+                                                     : -1;
+      if (value < 0) {
+        free(text);
+        return NULL;
       }
-      return result;
+      code = code << 4 | (uint32_t)value;
     }
-  }
-  else if (strcmp(operation, "trim") == 0) {
-    if (has_string_param && param_str && strchr(param_str, '%')) {
-      // Trim with threshold percentage
-      double threshold = atof(param_str);
-      return (uint8_t *)
-        fcv_trim_threshold(width, height, 4, input_data, threshold);
+    if (escaped != 'u' || code == 0 || (code >= 0xD800 && code < 0xE000)) {
+      // Unknown escapes, null characters and surrogates aren't supported
+      free(text);
+      return NULL;
+    }
+    if (code < 0x80) {
+      text[length++] = (char)code;
     }
-    else if (has_param) {
-      // Trim with threshold as numeric parameter
-      return (uint8_t *)fcv_trim_threshold(width, height, 4, input_data, param);
+    else if (code < 0x800) {
+      text[length++] = (char)(0xC0 | code >> 6);
+      text[length++] = (char)(0x80 | (code & 0x3F));
     }
     else {
-      // Default trim without threshold
-      return (uint8_t *)fcv_trim(width, height, 4, input_data);
-    }
-  }
-  else if (strcmp(operation, "histogram") == 0) {
-    uint32_t hist_width, hist_height;
-    uint8_t *result = fcv_generate_histogram(
-      *width,
-      *height,
-      4,
-      input_data,
-      &hist_width,
-      &hist_height
-    );
-    if (result) {
-      *width = hist_width;
-      *height = hist_height;
+      text[length++] = (char)(0xE0 | code >> 12);
+      text[length++] = (char)(0x80 | (code >> 6 & 0x3F));
+      text[length++] = (char)(0x80 | (code & 0x3F));
     }
-    return result;
   }
-  else if (strcmp(operation, "border") == 0) {
-    if (!has_string_param || !has_param) {
-      fprintf(
-        stderr,
-        "Error: border operation requires: hex_color border_width\n"
-      );
+  text[length] = '\0';
+  *cursor = c + 1;
+  return text;
+}
+
+/**
+ * Decode base64 (whitespace is ignored).
+ * Returns NULL if the text is invalid.
+ */
+uint8_t *decode_base64(const char *text, size_t *size) {
+  size_t length = strlen(text);
+  uint8_t *data = malloc(length / 4 * 3 + 3);
+  if (!data) {
+    return NULL;
+  }
+
+  size_t count = 0;
+  uint32_t bits = 0;
+  int32_t num_bits = 0;
+  int32_t num_padding = 0;
+  for (const char *c = text; *c; c++) {
+    int32_t value = *c >= 'A' && *c <= 'Z'   ? *c - 'A'
+                    : *c >= 'a' && *c <= 'z' ? *c - 'a' + 26
+                    : *c >= '0' && *c <= '9' ? *c - '0' + 52
+                    : *c == '+'              ? 62
+                    : *c == '/'              ? 63
+                                             : -1;
+    if (*c == '=') {
+      num_padding++;
+      continue;
+    }
+    if (value < 0 && strchr(" \t\r\n", *c)) {
+      continue;
+    }
+    if (value < 0 || num_padding > 0) {
+      free(data);
       return NULL;
     }
+    bits = bits << 6 | (uint32_t)value;
+    num_bits += 6;
+    if (num_bits >= 8) {
+      num_bits -= 8;
+      data[count++] = (uint8_t)(bits >> num_bits);
+    }
+  }
 
-    uint32_t border_width = (uint32_t)param;
-    uint32_t output_width, output_height;
+  *size = count;
+  return data;
+}
 
-    uint8_t *result = fcv_add_border(
-      *width,
-      *height,
-      4,
-      param_str,
-      border_width,
-      input_data,
-      &output_width,
-      &output_height
-    );
+typedef struct {
+  FILE *file;
+  Mutex mutex;            // Serializes responses and guards num_references
+  int32_t num_references; // The reader and every unfinished job
+} ServeConnection;
 
-    if (result) {
-      *width = output_width;
-      *height = output_height;
-    }
+typedef struct {
+  char *id; // JSON value of "id" as written in the request, or NULL
+  char *input;
+  char *input_base64;
+  char *pipeline;
+  char *output;
+  char *format;
+  ServeConnection *connection;
+} ServeJob;
+
+#define SERVE_PIPELINE_CACHE_SIZE 64
 
-    return result;
+typedef struct {
+  ServeJob **jobs; // Ring buffer of waiting jobs
+  int32_t capacity;
+  int32_t first;
+  int32_t count;
+  int32_t is_closed;
+  Mutex mutex;
+  Condition has_job;
+  Condition has_space;
+
+  // Parsed pipelines by their text, guarded by the mutex
+  char *pipeline_texts[SERVE_PIPELINE_CACHE_SIZE];
+  FCVPipeline *pipelines[SERVE_PIPELINE_CACHE_SIZE];
+  int32_t num_pipelines;
+
+  OutputOptions options;
+} Server;
+
+void free_serve_job(ServeJob *job) {
+  free(job->id);
+  free(job->input);
+  free(job->input_base64);
+  free(job->pipeline);
+  free(job->output);
+  free(job->format);
+  free(job);
+}
+
+/**
+ * Parse a job like
+ * {"id": 1, "input": "in.jpg", "pipeline": "grayscale", "output": "o.png"}.
+ * Instead of "input", "input_base64" can contain the file itself.
+ * "format" sets the output format, "id" is passed on to the response.
+ * Input and output must be files, as stdin and stdout carry the jobs
+ * and responses.
+ * Returns an error message or NULL on success.
+ */
+const char *parse_serve_job(const char *line, ServeJob *job) {
+  const char *cursor = json_skip_space(line);
+  if (*cursor != '{') {
+    return "Job must be a JSON object";
   }
-  else if (strcmp(operation, "erode") == 0) {
-    if (!has_param) {
-      fprintf(stderr, "Error: erode operation requires radius parameter\n");
-      return NULL;
+  cursor = json_skip_space(cursor + 1);
+
+  while (*cursor != '}') {
+    char *key = json_parse_string(&cursor);
+    if (!key) {
+      return "Invalid key";
     }
+    cursor = json_skip_space(cursor);
+    if (*cursor != ':') {
+      free(key);
+      return "Expected ':' after key";
+    }
+    cursor = json_skip_space(cursor + 1);
 
-    // Convert RGBA to grayscale for binary morphology
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      return NULL;
+    // Strings are unescaped, other values (numbers, true, false and null)
+    // and the id are kept as they are written
+    const char *start = cursor;
+    char *value = NULL;
+    if (*cursor == '"') {
+      value = json_parse_string(&cursor);
+    }
+    else {
+      while (*cursor && strchr("+-.0123456789eEtruefalsn", *cursor)) {
+        cursor++;
+      }
+    }
+    int32_t is_raw = !value || strcmp(key, "id") == 0;
+    if (is_raw && cursor > start) {
+      free(value);
+      value = malloc((size_t)(cursor - start) + 1);
+      if (value) {
+        memcpy(value, start, (size_t)(cursor - start));
+        value[cursor - start] = '\0';
+      }
+    }
+    if (!value) {
+      free(key);
+      return "Invalid value";
     }
 
-    uint8_t *eroded =
-      fcv_binary_erosion_disk(grayscale_data, *width, *height, (int32_t)param);
-    free(grayscale_data);
+    char **field = strcmp(key, "id") == 0             ? &job->id
+                   : strcmp(key, "input") == 0        ? &job->input
+                   : strcmp(key, "input_base64") == 0 ? &job->input_base64
+                   : strcmp(key, "pipeline") == 0     ? &job->pipeline
+                   : strcmp(key, "output") == 0       ? &job->output
+                   : strcmp(key, "format") == 0       ? &job->format
+                                                      : NULL;
+    free(key);
+    if (field) {
+      free(*field);
+      *field = value;
+    }
+    else {
+      free(value);
+    }
 
-    if (!eroded) {
-      return NULL;
+    cursor = json_skip_space(cursor);
+    if (*cursor == ',') {
+      cursor = json_skip_space(cursor + 1);
     }
+    else if (*cursor != '}') {
+      return "Expected ',' or '}'";
+    }
+  }
 
-    // Convert back to RGBA
-    uint8_t *result = fcv_single_to_multichannel(*width, *height, eroded);
-    free(eroded);
-    return result;
+  if (!job->pipeline || !job->output) {
+    return "Job needs a pipeline and an output";
   }
-  else if (strcmp(operation, "dilate") == 0) {
-    if (!has_param) {
-      fprintf(stderr, "Error: dilate operation requires radius parameter\n");
-      return NULL;
-    }
+  if (!job->input == !job->input_base64) {
+    return "Job needs either input or input_base64";
+  }
+  // The server's own stdin and stdout carry jobs and responses
+  if ((job->input && strcmp(job->input, "-") == 0) ||
+      strcmp(job->output, "-") == 0) {
+    return "Input and output of a job can't be '-'";
+  }
+  return NULL;
+}
 
-    // Convert RGBA to grayscale for binary morphology
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      return NULL;
+/**
+ * Get the parsed pipeline for a text from the cache, or parse it.
+ * Lookup, parsing and insertion happen under one lock,
+ * so a new pipeline is only parsed and cached once,
+ * even if several workers get it at the same time.
+ * Pipelines that don't fit into the cache must be freed by the caller,
+ * which is signaled by `is_cached`.
+ * Returns NULL if the pipeline is invalid.
+ */
+FCVPipeline *get_serve_pipeline(
+  Server *server,
+  const char *text,
+  int32_t *is_cached
+) {
+  mutex_lock(&server->mutex);
+  for (int32_t i = 0; i < server->num_pipelines; i++) {
+    if (strcmp(server->pipeline_texts[i], text) == 0) {
+      mutex_unlock(&server->mutex);
+      *is_cached = 1;
+      return server->pipelines[i];
     }
+  }
 
-    uint8_t *dilated =
-      fcv_binary_dilation_disk(grayscale_data, *width, *height, (int32_t)param);
-    free(grayscale_data);
+  FCVPipeline *pipeline = fcv_pipeline_parse(text);
+  if (!pipeline || fcv_pipeline_count(pipeline) == 0) {
+    mutex_unlock(&server->mutex);
+    fcv_pipeline_free(pipeline);
+    return NULL;
+  }
 
-    if (!dilated) {
-      return NULL;
-    }
+  *is_cached = server->num_pipelines < SERVE_PIPELINE_CACHE_SIZE;
+  char *cached_text = *is_cached ? malloc(strlen(text) + 1) : NULL;
+  if (cached_text) {
+    strcpy(cached_text, text);
+    server->pipeline_texts[server->num_pipelines] = cached_text;
+    server->pipelines[server->num_pipelines] = pipeline;
+    server->num_pipelines++;
+  }
+  *is_cached = cached_text != NULL;
+  mutex_unlock(&server->mutex);
+  return pipeline;
+}
 
-    // Convert back to RGBA
-    uint8_t *result = fcv_single_to_multichannel(*width, *height, dilated);
-    free(dilated);
-    return result;
+void release_connection(ServeConnection *connection) {
+  mutex_lock(&connection->mutex);
+  int32_t num_references = --connection->num_references;
+  mutex_unlock(&connection->mutex);
+  if (num_references == 0) {
+    fclose(connection->file);
+    mutex_destroy(&connection->mutex);
+    free(connection);
   }
-  else if (strcmp(operation, "close") == 0) {
-    if (!has_param) {
-      fprintf(stderr, "Error: close operation requires radius parameter\n");
-      return NULL;
-    }
+}
 
-    // Convert RGBA to grayscale for binary morphology
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      return NULL;
-    }
+/**
+ * Write the response to a job as one line of JSON.
+ */
+void respond_to_job(ServeJob const *job, const char *error) {
+  ServeConnection *connection = job->connection;
+  mutex_lock(&connection->mutex);
+  FILE *file = connection->file;
+  fprintf(file, "{\"id\": %s, ", job->id ? job->id : "null");
+  if (error) {
+    fprintf(file, "\"status\": \"error\", \"error\": ");
+    print_json_string(file, error);
+  }
+  else {
+    fprintf(file, "\"status\": \"ok\", \"output\": ");
+    print_json_string(file, job->output);
+  }
+  fprintf(file, "}\n");
+  fflush(file);
+  mutex_unlock(&connection->mutex);
+}
 
-    uint8_t *closed =
-      fcv_binary_closing_disk(grayscale_data, *width, *height, (int32_t)param);
-    free(grayscale_data);
+void run_serve_job(
+  Server *server,
+  ServeJob *job,
+  FCVPipelineContext *context
+) {
+  OutputOptions options = server->options;
+  if (job->format) {
+    int32_t format = parse_output_format(job->format);
+    if (format < 0) {
+      respond_to_job(job, "Unknown output format");
+      return;
+    }
+    options.format = (OutputFormat)format;
+  }
 
-    if (!closed) {
-      return NULL;
-    }
+  int32_t is_cached;
+  FCVPipeline *pipeline = get_serve_pipeline(server, job->pipeline, &is_cached);
+  if (!pipeline) {
+    respond_to_job(job, "Invalid pipeline");
+    return;
+  }
 
-    // Convert back to RGBA
-    uint8_t *result = fcv_single_to_multichannel(*width, *height, closed);
-    free(closed);
-    return result;
+  int32_t success;
+  if (job->input) {
+    success = process_image(
+      job->input,
+      job->output,
+      pipeline,
+      context,
+      &options,
+      NULL
+    );
+  }
+  else {
+    InputFile input = {NULL, 0, 0};
+    input.data = decode_base64(job->input_base64, &input.size);
+    success = input.data && process_input_file(
+                              "",
+                              input,
+                              job->output,
+                              pipeline,
+                              context,
+                              &options,
+                              NULL
+                            );
+  }
+  if (!is_cached) {
+    fcv_pipeline_free(pipeline);
   }
-  else if (strcmp(operation, "open") == 0) {
-    if (!has_param) {
-      fprintf(stderr, "Error: open operation requires radius parameter\n");
-      return NULL;
-    }
 
-    // Convert RGBA to grayscale for binary morphology
-    uint8_t *grayscale_data =
-      fcv_rgba_to_grayscale(*width, *height, input_data);
-    if (!grayscale_data) {
-      return NULL;
-    }
+  respond_to_job(job, success ? NULL : "Failed to process image");
+}
 
-    uint8_t *opened =
-      fcv_binary_opening_disk(grayscale_data, *width, *height, (int32_t)param);
-    free(grayscale_data);
+/**
+ * Take the next job from the queue.
+ * Returns NULL if the queue was closed and all jobs are taken.
+ */
+ServeJob *take_serve_job(Server *server) {
+  mutex_lock(&server->mutex);
+  while (server->count == 0 && !server->is_closed) {
+    condition_wait(&server->has_job, &server->mutex);
+  }
+  ServeJob *job = NULL;
+  if (server->count > 0) {
+    job = server->jobs[server->first];
+    server->first = (server->first + 1) % server->capacity;
+    server->count--;
+    condition_signal(&server->has_space);
+  }
+  mutex_unlock(&server->mutex);
+  return job;
+}
 
-    if (!opened) {
-      return NULL;
+/**
+ * Add a job to the queue. Blocks while the queue is full, so a fast client
+ * can't make the server hold more images than it has workers.
+ */
+void add_serve_job(Server *server, ServeJob *job) {
+  mutex_lock(&server->mutex);
+  while (server->count == server->capacity) {
+    condition_wait(&server->has_space, &server->mutex);
+  }
+  server->jobs[(server->first + server->count) % server->capacity] = job;
+  server->count++;
+  condition_signal(&server->has_job);
+  mutex_unlock(&server->mutex);
+}
+
+/**
+ * Run jobs until the queue is closed.
+ * The buffers for the intermediate images are reused for all jobs
+ * of the worker.
+ */
+void serve_jobs(Server *server) {
+  // Without a context, the buffers are allocated for every job
+  FCVPipelineContext *context = fcv_pipeline_context_new();
+  ServeJob *job;
+  while ((job = take_serve_job(server))) {
+    run_serve_job(server, job, context);
+    ServeConnection *connection = job->connection;
+    free_serve_job(job);
+    release_connection(connection);
+  }
+  fcv_pipeline_context_free(context);
+}
+
+THREAD_FUNCTION(serve_jobs_thread, serve_jobs)
+
+/**
+ * Read jobs from a client until it closes the connection.
+ * Invalid jobs are answered right away, all others are queued.
+ */
+void read_serve_jobs(Server *server, ServeConnection *connection, FILE *in) {
+  char *line;
+  while ((line = read_line(in))) {
+    if (json_skip_space(line)[0] == '\0') {
+      free(line);
+      continue;
+    }
+    ServeJob *job = calloc(1, sizeof(ServeJob));
+    if (!job) {
+      free(line);
+      break;
+    }
+    job->connection = connection;
+    const char *error = parse_serve_job(line, job);
+    free(line);
+    if (error) {
+      respond_to_job(job, error);
+      free_serve_job(job);
+      continue;
     }
 
-    // Convert back to RGBA
-    uint8_t *result = fcv_single_to_multichannel(*width, *height, opened);
-    free(opened);
-    return result;
+    mutex_lock(&connection->mutex);
+    connection->num_references++;
+    mutex_unlock(&connection->mutex);
+    add_serve_job(server, job);
   }
-  else {
-    fprintf(stderr, "Error: Unknown operation '%s'\n", operation);
+  release_connection(connection);
+}
+
+ServeConnection *create_connection(FILE *file) {
+  ServeConnection *connection = malloc(sizeof(ServeConnection));
+  if (!connection) {
     return NULL;
   }
+  connection->file = file;
+  connection->num_references = 1;
+  mutex_init(&connection->mutex);
+  return connection;
 }
 
-uint8_t *execute_pipeline(
-  int32_t *width,
-  int32_t *height,
-  Pipeline *pipeline,
-  uint8_t *input_data
-) {
-  uint8_t *current_data = input_data;
-  uint8_t *temp_data = NULL;
-
-  for (int32_t i = 0; i < pipeline->count; i++) {
-    PipelineOp *op = &pipeline->ops[i];
-    fprintf(stderr, "Applying operation: %s", op->operation);
-    if (op->has_string_param) {
-      fprintf(stderr, " with parameter: %s", op->param_str);
-    }
-    else if (op->has_param) {
-      fprintf(stderr, " with parameter: %.2f", op->param);
-      if (op->has_param2) {
-        fprintf(stderr, " %.2f", op->param2);
-        if (op->has_param3) {
-          fprintf(stderr, " %.2f", op->param3);
-        }
-        if (op->has_param4) {
-          fprintf(stderr, " %.2f", op->param4);
-        }
-      }
-    }
-    fprintf(stderr, "\n");
+#ifndef _WIN32
+typedef struct {
+  Server *server;
+  ServeConnection *connection;
+  FILE *in;
+} ServeClient;
+
+void serve_client(ServeClient *client) {
+  read_serve_jobs(client->server, client->connection, client->in);
+  fclose(client->in);
+  free(client);
+}
 
-    clock_t start_time = clock();
-    uint8_t *result = apply_operation(
-      width,
-      height,
-      op->operation,
-      op->param,
-      op->has_param,
-      op->param2,
-      op->has_param2,
-      op->param3,
-      op->has_param3,
-      op->param4,
-      op->has_param4,
-      op->param_str,
-      op->has_string_param,
-      current_data
-    );
-    clock_t end_time = clock();
+THREAD_FUNCTION(serve_client_thread, serve_client)
 
-    double elapsed_time_ms =
-      ((double)(end_time - start_time)) / CLOCKS_PER_SEC * 1000.0;
-    fprintf(
-      stderr,
-      "  → Completed in %.1f ms (output: %dx%d)\n",
-      elapsed_time_ms,
-      *width,
-      *height
-    );
+/**
+ * Accept clients on a Unix domain socket until the process is stopped.
+ * Every client gets a thread that reads its jobs.
+ * Returns 0 if the socket couldn't be opened.
+ */
+int32_t listen_on_socket(Server *server, const char *path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Error: Socket path '%s' is too long\n", path);
+    return 0;
+  }
+  strcpy(address.sun_path, path);
 
-    if (!result) {
-      if (temp_data && temp_data != input_data) {
-        free(temp_data);
+  // Remove the socket of a previous server, but never any other file
+  struct stat path_stat;
+  if (lstat(path, &path_stat) == 0) {
+    if (!S_ISSOCK(path_stat.st_mode)) {
+      fprintf(stderr, "Error: '%s' exists and is not a socket\n", path);
+      return 0;
+    }
+    unlink(path);
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 ||
+      bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(listener, 16) != 0) {
+    fprintf(stderr, "Error: Could not listen on socket '%s'\n", path);
+    if (listener >= 0) {
+      close(listener);
+    }
+    return 0;
+  }
+  // Clients that disconnect early must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+  fprintf(stderr, "Listening on '%s'\n", path);
+
+  while (1) {
+    int client_fd = accept(listener, NULL, NULL);
+    if (client_fd < 0) {
+      continue;
+    }
+    int response_fd = dup(client_fd);
+    FILE *in = fdopen(client_fd, "r");
+    FILE *out = response_fd >= 0 ? fdopen(response_fd, "w") : NULL;
+    ServeConnection *connection = out ? create_connection(out) : NULL;
+    ServeClient *client = connection ? malloc(sizeof(ServeClient)) : NULL;
+    Thread thread;
+    if (in && client) {
+      *client = (ServeClient){server, connection, in};
+      if (start_thread(&thread, serve_client_thread, client)) {
+        detach_thread(thread);
+        continue;
       }
-      return NULL;
     }
+    // The client couldn't be served
+    free(client);
+    if (connection) {
+      release_connection(connection);
+    }
+    else if (out) {
+      fclose(out);
+    }
+    else if (response_fd >= 0) {
+      close(response_fd);
+    }
+    if (in) {
+      fclose(in);
+    }
+    else {
+      close(client_fd);
+    }
+  }
+}
+#endif
 
-    // Free the previous intermediate result (but not the original input)
-    if (temp_data && temp_data != input_data) {
-      free(temp_data);
+/**
+ * Run FlatCV as a server that executes jobs (one JSON object per line)
+ * on a pool of `--threads` workers, read from stdin or a Unix domain
+ * socket (`--socket <path>`). Every job gets a response line.
+ * Parsed pipelines are kept for later jobs.
+ * Returns 0 if the server couldn't be started.
+ */
+int32_t serve(OutputOptions const *options) {
+  Server server;
+  memset(&server, 0, sizeof(server));
+  server.options = *options;
+  // The workers already run in parallel
+  server.options.num_threads = 1;
+
+  int32_t num_workers =
+    options->num_threads > 0 ? options->num_threads : count_cpu_cores();
+  server.capacity = num_workers * 2;
+  server.jobs = malloc((size_t)server.capacity * sizeof(ServeJob *));
+  Thread *threads = malloc((size_t)num_workers * sizeof(Thread));
+  int32_t *is_started = calloc((size_t)num_workers, sizeof(int32_t));
+  if (!server.jobs || !threads || !is_started) {
+    free(server.jobs);
+    free(threads);
+    free(is_started);
+    return 0;
+  }
+  mutex_init(&server.mutex);
+  condition_init(&server.has_job);
+  condition_init(&server.has_space);
+
+  int32_t num_started = 0;
+  for (int32_t t = 0; t < num_workers; t++) {
+    is_started[t] = start_thread(&threads[t], serve_jobs_thread, &server);
+    num_started += is_started[t];
+  }
+
+  int32_t success = num_started > 0;
+  if (!success) {
+    fprintf(stderr, "Error: Could not start workers\n");
+  }
+  else if (options->socket_path) {
+#ifdef _WIN32
+    fprintf(stderr, "Error: Sockets are not supported on Windows\n");
+    success = 0;
+#else
+    success = listen_on_socket(&server, options->socket_path);
+#endif
+  }
+  else {
+    // Responses go to stdout, so anything the operations print
+    // (e.g. the JSON of qr) is moved to stderr
+    fflush(stdout);
+#ifdef _WIN32
+    int response_fd = _dup(_fileno(stdout));
+    _dup2(_fileno(stderr), _fileno(stdout));
+    FILE *responses = response_fd >= 0 ? _fdopen(response_fd, "w") : NULL;
+#else
+    int response_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    FILE *responses = response_fd >= 0 ? fdopen(response_fd, "w") : NULL;
+#endif
+    ServeConnection *connection =
+      responses ? create_connection(responses) : NULL;
+    if (connection) {
+      fprintf(stderr, "Reading jobs from stdin with %d workers\n", num_started);
+      read_serve_jobs(&server, connection, stdin);
+    }
+    else {
+      if (responses) {
+        fclose(responses);
+      }
+      success = 0;
     }
+  }
 
-    temp_data = result;
-    current_data = result;
+  // Let the workers finish the queued jobs
+  mutex_lock(&server.mutex);
+  server.is_closed = 1;
+  condition_broadcast(&server.has_job);
+  mutex_unlock(&server.mutex);
+  for (int32_t t = 0; t < num_workers; t++) {
+    if (is_started[t]) {
+      join_thread(threads[t]);
+    }
   }
 
-  return current_data;
+  for (int32_t i = 0; i < server.num_pipelines; i++) {
+    free(server.pipeline_texts[i]);
+    fcv_pipeline_free(server.pipelines[i]);
+  }
+  condition_destroy(&server.has_job);
+  condition_destroy(&server.has_space);
+  mutex_destroy(&server.mutex);
+  free(server.jobs);
+  free(threads);
+  free(is_started);
+  return success;
 }
 
 int32_t main(int32_t argc, char *argv[]) {
-  if (argc < 3) {
+  OutputOptions output_options = {
+    fcv_png_default_options(),
+    0,
+    90,
+    OUTPUT_BY_EXTENSION,
+    NULL,
+    NULL,
+    NULL,
+    0,
+  };
+  if (!parse_output_options(&argc, argv, &output_options)) {
+    return 1;
+  }
+
+  if (argc == 2 && strcmp(argv[1], "serve") == 0) {
+    return serve(&output_options) ? 0 : 1;
+  }
+
+  // In batch mode, all arguments are the pipeline
+  int32_t is_batch = output_options.batch_list != NULL;
+  if (is_batch != (output_options.out_dir != NULL)) {
+    fprintf(stderr, "Error: --batch and --out-dir must be used together\n");
+    return 1;
+  }
+
+  if (argc < (is_batch ? 2 : 3)) {
     print32_t_usage(argv[0]);
     return 1;
   }
@@ -1877,157 +2267,76 @@ int32_t main(int32_t argc, char *argv[]) {
 
   // Info-only operations don't require an output image
   int32_t is_info_only = 0;
-  if (argc == 3 &&
+  if (!is_batch && argc == 3 &&
       (strcmp(argv[2], "detect_corners") == 0 || strcmp(argv[2], "qr") == 0)) {
     is_info_only = 1;
   }
 
-  const char *output_path = is_info_only ? NULL : argv[argc - 1];
+  const char *output_path =
+    is_batch || is_info_only ? NULL : argv[argc - 1];
 
-  if (!is_info_only && argc < 4) {
+  if (!is_batch && !is_info_only && argc < 4) {
     print32_t_usage(argv[0]);
     return 1;
   }
 
-  // Parse pipeline from arguments between input and output
-  Pipeline *pipeline = create_pipeline();
-  int32_t pipeline_end_idx = is_info_only ? argc : argc - 1;
-  if (!parse_pipeline(argc, argv, 2, pipeline_end_idx, pipeline)) {
-    free_pipeline(pipeline);
-    return 1;
-  }
-
-  if (pipeline->count == 0) {
-    fprintf(stderr, "Error: No operations specified\n");
-    free_pipeline(pipeline);
+  OutputFormat format = output_path ? resolve_output_format(
+                                        output_path,
+                                        output_options.format
+                                      )
+                                    : output_options.format;
+  if (output_path && format == OUTPUT_RAW && strcmp(output_path, "-") == 0) {
+    fprintf(
+      stderr,
+      "Error: Raw images need a file for their header, use pam instead\n"
+    );
     return 1;
   }
 
-  int32_t width, height, channels;
-  uint8_t *image_data = stbi_load(input_path, &width, &height, &channels, 4);
-
-  if (!image_data) {
-    fprintf(stderr, "Error: Could not load image '%s'\n", input_path);
-    free_pipeline(pipeline);
+  // Parse pipeline from arguments between input and output
+  int32_t pipeline_start_idx = is_batch ? 1 : 2;
+  int32_t pipeline_end_idx = output_path ? argc - 1 : argc;
+  FCVPipeline *pipeline =
+    parse_pipeline_arguments(argv, pipeline_start_idx, pipeline_end_idx);
+  if (!pipeline) {
     return 1;
   }
 
-  // Handle EXIF orientation for JPEGs
-  const char *ext_in = strrchr(input_path, '.');
-  if (ext_in && (strcmp(ext_in, ".jpg") == 0 || strcmp(ext_in, ".jpeg") == 0 ||
-                 strcmp(ext_in, ".JPG") == 0 || strcmp(ext_in, ".JPEG") == 0)) {
-    int32_t orientation = fcv_get_exif_orientation(input_path);
-    if (orientation > 1 && orientation <= 8) {
-      fprintf(stderr, "Applying EXIF orientation: %d\n", orientation);
-      uint8_t *rotated_data = NULL;
-      uint32_t old_width = (uint32_t)width;
-      uint32_t old_height = (uint32_t)height;
-
-      switch (orientation) {
-      case 2: // Flip Horizontal
-        rotated_data = fcv_flip_x(old_width, old_height, image_data);
-        break;
-      case 3: // 180 degrees
-        rotated_data = fcv_rotate_180(old_width, old_height, image_data);
-        break;
-      case 4: // Flip Vertical
-        rotated_data = fcv_flip_y(old_width, old_height, image_data);
-        break;
-      case 5: // Transpose
-        rotated_data = fcv_transpose(old_width, old_height, image_data);
-        width = (int32_t)old_height;
-        height = (int32_t)old_width;
-        break;
-      case 6: // 90 degrees CW
-        rotated_data = fcv_rotate_90_cw(old_width, old_height, image_data);
-        width = (int32_t)old_height;
-        height = (int32_t)old_width;
-        break;
-      case 7: // Transverse
-        rotated_data = fcv_transverse(old_width, old_height, image_data);
-        width = (int32_t)old_height;
-        height = (int32_t)old_width;
-        break;
-      case 8: // 270 degrees CW
-        rotated_data = fcv_rotate_270_cw(old_width, old_height, image_data);
-        width = (int32_t)old_height;
-        height = (int32_t)old_width;
-        break;
-      }
-
-      if (rotated_data) {
-        stbi_image_free(image_data);
-        image_data = rotated_data;
-      }
-    }
-  }
-
-  fprintf(
-    stderr,
-    "Loaded image: %dx%d with %d channels\n",
-    width,
-    height,
-    channels
-  );
-  fprintf(stderr, "Executing pipeline with %d operations:\n", pipeline->count);
-
-  uint8_t *result_data =
-    execute_pipeline(&width, &height, pipeline, image_data);
-
-  if (!result_data) {
-    fprintf(stderr, "Error: Failed to execute pipeline\n");
-    stbi_image_free(image_data);
-    free_pipeline(pipeline);
+  if (fcv_pipeline_count(pipeline) == 0) {
+    fprintf(stderr, "Error: No operations specified\n");
+    fcv_pipeline_free(pipeline);
     return 1;
   }
 
-  if (!is_info_only) {
-    fprintf(stderr, "Final output dimensions: %dx%d\n", width, height);
-
-    int32_t write_result;
-    const char *ext = strrchr(output_path, '.');
-    if (ext && strcmp(ext, ".png") == 0) {
-      write_result =
-        stbi_write_png(output_path, width, height, 4, result_data, width * 4);
-    }
-    else if (ext && (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0)) {
-      if (pipeline_has_binarization(pipeline)) {
-        fprintf(
-          stderr,
-          "WARNING: Saving binarized image as JPEG will result in quality loss "
-          "due to compression artifacts. "
-          "Please use PNG format instead.\n"
-        );
-      }
-      write_result =
-        stbi_write_jpg(output_path, width, height, 4, result_data, 90);
-    }
-    else {
-      write_result =
-        stbi_write_png(output_path, width, height, 4, result_data, width * 4);
-    }
-
-    if (!write_result) {
-      fprintf(stderr, "Error: Could not save image to '%s'\n", output_path);
-      stbi_image_free(image_data);
-      if (result_data != image_data) {
-        free(result_data);
-      }
-      free_pipeline(pipeline);
-      return 1;
-    }
-
+  if (format == OUTPUT_JPEG && pipeline_has_binarization(pipeline)) {
     fprintf(
       stderr,
-      "Successfully saved processed image to '%s'\n",
-      output_path
+      "WARNING: Saving binarized image as JPEG will result in quality loss "
+      "due to compression artifacts. "
+      "Please use PNG format instead.\n"
     );
   }
 
-  stbi_image_free(image_data);
-  if (result_data != image_data) {
-    free(result_data);
+  int32_t success;
+  if (is_batch) {
+    success = process_batch(
+                output_options.batch_list,
+                output_options.out_dir,
+                pipeline,
+                &output_options
+              ) == 0;
   }
-  free_pipeline(pipeline);
-  return 0;
+  else {
+    success = process_image(
+      input_path,
+      output_path,
+      pipeline,
+      NULL,
+      &output_options,
+      stderr
+    );
+  }
+
+  fcv_pipeline_free(pipeline);
+  return success ? 0 : 1;
 }
@@ -53,9 +53,34 @@ fcv_grayscale(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
+  fcv_grayscale_into(width, height, data, grayscale_data);
+
+  return grayscale_data;
+}
+
+/**
+ * Convert raw RGBA image data to grayscale RGBA image data
+ * in a buffer of the same size.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data.
+ * @param out Receives the grayscale image (can be the same as data).
+ */
+void fcv_grayscale_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
+  }
+
   // Process each pixel row by row
-  for (uint32_t i = 0; i < width * height; i++) {
-    uint32_t rgba_index = i * 4;
+  size_t img_length_px = (size_t)width * height;
+  for (size_t i = 0; i < img_length_px; i++) {
+    size_t rgba_index = i * 4;
 
     uint8_t r = data[rgba_index];
     uint8_t g = data[rgba_index + 1];
@@ -63,13 +88,11 @@ fcv_grayscale(uint32_t width, uint32_t height, uint8_t const *const data) {
 
     uint8_t gray = (r * R_WEIGHT + g * G_WEIGHT + b * B_WEIGHT) >> 8;
 
-    grayscale_data[rgba_index] = gray;
-    grayscale_data[rgba_index + 1] = gray;
-    grayscale_data[rgba_index + 2] = gray;
-    grayscale_data[rgba_index + 3] = 255;
+    out[rgba_index] = gray;
+    out[rgba_index + 1] = gray;
+    out[rgba_index + 2] = gray;
+    out[rgba_index + 3] = 255;
   }
-
-  return grayscale_data;
 }
 
 /**
@@ -352,11 +375,6 @@ uint8_t *fcv_apply_gaussian_blur(
     return NULL;
   }
 
-  // Validate radius
-  if (radius < 0 || !isfinite(radius)) {
-    return NULL;
-  }
-
   // Check for overflow: width * height * 4
   if (width > SIZE_MAX / height) {
     return NULL;
@@ -367,16 +385,8 @@ uint8_t *fcv_apply_gaussian_blur(
   }
   size_t img_length_byte = img_length_px * 4;
 
-  if (radius == 0) {
-    uint8_t *copy = malloc(img_length_byte);
-    if (!copy) {
-      return NULL;
-    }
-    return memcpy(copy, data, img_length_byte);
-  }
-
   // Reject excessive radius to prevent excessive memory allocation
-  if (radius > 1000) {
+  if (radius < 0 || !isfinite(radius) || radius > 1000) {
     return NULL;
   }
 
@@ -386,12 +396,75 @@ uint8_t *fcv_apply_gaussian_blur(
     return NULL;
   }
 
+  if (!fcv_apply_gaussian_blur_into(
+        width,
+        height,
+        radius,
+        data,
+        blurred_data
+      )) {
+    free(blurred_data);
+    return NULL;
+  }
+
+  return blurred_data;
+}
+
+/**
+ * Apply gaussian blur to the image data
+ * and write the result into a buffer of the same size.
+ * The horizontal pass needs a temporary image, which is allocated.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param radius Radius of the blur (0 to 1000).
+ * @param data Pointer to the pixel data.
+ * @param out Receives the blurred image (must not overlap data).
+ * @return False if the radius is invalid or memory ran out.
+ */
+bool fcv_apply_gaussian_blur_into(
+  uint32_t width,
+  uint32_t height,
+  double radius,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out || width == 0 || height == 0) {
+    return false;
+  }
+
+  // Validate radius
+  if (radius < 0 || !isfinite(radius) || radius > 1000) {
+    return false;
+  }
+
+  // Check for overflow: width * height * 4
+  if (width > SIZE_MAX / height) {
+    return false;
+  }
+  size_t img_length_px = (size_t)width * height;
+  if (img_length_px > SIZE_MAX / 4) {
+    return false;
+  }
+  size_t img_length_byte = img_length_px * 4;
+
+  if (radius == 0) {
+    memcpy(out, data, img_length_byte);
+    return true;
+  }
+
   uint32_t kernel_size = (uint32_t)(2 * radius + 1);
   float *kernel = malloc(kernel_size * sizeof(float));
 
   if (!kernel) { // Memory allocation failed
-    free(blurred_data);
-    return NULL;
+    return false;
+  }
+
+  // Horizontal pass, read by the vertical pass
+  uint8_t *temp_data = malloc(img_length_byte);
+  if (!temp_data) {
+    free(kernel);
+    return false;
   }
 
   float sigma = radius / 3.0;
@@ -435,25 +508,13 @@ uint8_t *fcv_apply_gaussian_blur(
       }
 
       uint32_t rgba_index = (y * width + x) * 4;
-      blurred_data[rgba_index] = r_sum / weight_sum;
-      blurred_data[rgba_index + 1] = g_sum / weight_sum;
-      blurred_data[rgba_index + 2] = b_sum / weight_sum;
-      blurred_data[rgba_index + 3] = 255;
+      temp_data[rgba_index] = r_sum / weight_sum;
+      temp_data[rgba_index + 1] = g_sum / weight_sum;
+      temp_data[rgba_index + 2] = b_sum / weight_sum;
+      temp_data[rgba_index + 3] = 255;
     }
   }
 
-  // Create temporary buffer for vertical pass to avoid reading from buffer
-  // being written to
-  uint8_t *temp_data = malloc(img_length_px * 4);
-  if (!temp_data) {
-    free(blurred_data);
-    free(kernel);
-    return NULL;
-  }
-
-  // Copy horizontal blur result to temp buffer
-  memcpy(temp_data, blurred_data, img_length_px * 4);
-
   // Apply the kernel in the vertical direction
   for (uint32_t x = 0; x < width; x++) {
     for (uint32_t y = 0; y < height; y++) {
@@ -480,10 +541,10 @@ uint8_t *fcv_apply_gaussian_blur(
       }
 
       uint32_t rgba_index = (y * width + x) * 4;
-      blurred_data[rgba_index] = r_sum / weight_sum;
-      blurred_data[rgba_index + 1] = g_sum / weight_sum;
-      blurred_data[rgba_index + 2] = b_sum / weight_sum;
-      blurred_data[rgba_index + 3] = 255;
+      out[rgba_index] = r_sum / weight_sum;
+      out[rgba_index + 1] = g_sum / weight_sum;
+      out[rgba_index + 2] = b_sum / weight_sum;
+      out[rgba_index + 3] = 255;
     }
   }
 
@@ -491,7 +552,7 @@ uint8_t *fcv_apply_gaussian_blur(
 
   free(kernel);
 
-  return blurred_data;
+  return true;
 }
 
 #include <time.h>
@@ -658,8 +719,57 @@ uint8_t *fcv_resize(
     return NULL;
   }
 
-  for (uint32_t out_y = 0; out_y < *out_height; out_y++) {
-    for (uint32_t out_x = 0; out_x < *out_width; out_x++) {
+  fcv_resize_into(
+    width,
+    height,
+    resize_x,
+    resize_y,
+    *out_width,
+    *out_height,
+    data,
+    resized_data
+  );
+
+  return resized_data;
+}
+
+/**
+ * Resize an image by given resize factors into a buffer
+ * of out_width x out_height pixels.
+ * fcv_resize uses the size rounded down: (uint32_t)(width * resize_x).
+ *
+ * @param width Width of the input image.
+ * @param height Height of the input image.
+ * @param resize_x Horizontal resize factor.
+ * @param resize_y Vertical resize factor.
+ * @param out_width Width of the output image.
+ * @param out_height Height of the output image.
+ * @param data Pointer to the input pixel data.
+ * @param out Receives the resized image (must not overlap data).
+ * @return False if the size or the resize factors are invalid.
+ */
+bool fcv_resize_into(
+  uint32_t width,
+  uint32_t height,
+  double resize_x,
+  double resize_y,
+  uint32_t out_width,
+  uint32_t out_height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out || width == 0 || height == 0 || out_width == 0 ||
+      out_height == 0) {
+    return false;
+  }
+
+  if (resize_x <= 0.0 || resize_y <= 0.0 || !isfinite(resize_x) ||
+      !isfinite(resize_y)) {
+    return false;
+  }
+
+  for (uint32_t out_y = 0; out_y < out_height; out_y++) {
+    for (uint32_t out_x = 0; out_x < out_width; out_x++) {
       if (resize_x < 1.0 || resize_y < 1.0) {
         double src_x = (out_x + 0.5) / resize_x - 0.5;
         double src_y = (out_y + 0.5) / resize_y - 0.5;
@@ -719,19 +829,19 @@ uint8_t *fcv_resize(
         }
 
         if (total_weight > 0.0) {
-          resized_data[(out_y * *out_width + out_x) * 4] =
+          out[(out_y * out_width + out_x) * 4] =
             (uint8_t)(r_sum / total_weight + 0.5);
-          resized_data[(out_y * *out_width + out_x) * 4 + 1] =
+          out[(out_y * out_width + out_x) * 4 + 1] =
             (uint8_t)(g_sum / total_weight + 0.5);
-          resized_data[(out_y * *out_width + out_x) * 4 + 2] =
+          out[(out_y * out_width + out_x) * 4 + 2] =
             (uint8_t)(b_sum / total_weight + 0.5);
         }
         else {
-          resized_data[(out_y * *out_width + out_x) * 4] = 0;
-          resized_data[(out_y * *out_width + out_x) * 4 + 1] = 0;
-          resized_data[(out_y * *out_width + out_x) * 4 + 2] = 0;
+          out[(out_y * out_width + out_x) * 4] = 0;
+          out[(out_y * out_width + out_x) * 4 + 1] = 0;
+          out[(out_y * out_width + out_x) * 4 + 2] = 0;
         }
-        resized_data[(out_y * *out_width + out_x) * 4 + 3] = 255;
+        out[(out_y * out_width + out_x) * 4 + 3] = 255;
       }
       else {
         double src_x = (out_x + 0.5) / resize_x - 0.5;
@@ -781,14 +891,14 @@ uint8_t *fcv_resize(
                                 p01 * dx * (1 - dy) + p10 * (1 - dx) * dy +
                                 p11 * dx * dy;
 
-          resized_data[(out_y * *out_width + out_x) * 4 + c] =
+          out[(out_y * out_width + out_x) * 4 + c] =
             (uint8_t)(interpolated + 0.5);
         }
 
-        resized_data[(out_y * *out_width + out_x) * 4 + 3] = 255;
+        out[(out_y * out_width + out_x) * 4 + 3] = 255;
       }
     }
   }
 
-  return resized_data;
+  return true;
 }
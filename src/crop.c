@@ -13,6 +13,34 @@
 #include "flatcv.h"
 #endif
 
+/** Check the crop area and report if it is outside the image. */
+static bool crop_is_valid(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint32_t x,
+  uint32_t y,
+  uint32_t new_width,
+  uint32_t new_height
+) {
+  if (width == 0 || height == 0 || channels == 0 || new_width == 0 ||
+      new_height == 0) {
+    return false;
+  }
+
+  // Check for overflow in x + new_width and y + new_height
+  if (x > UINT32_MAX - new_width || y > UINT32_MAX - new_height) {
+    return false;
+  }
+
+  if (x + new_width > width || y + new_height > height) {
+    fprintf(stderr, "Crop area is outside the original image bounds.\n");
+    return false;
+  }
+
+  return true;
+}
+
 /**
  * Crop an image.
  *
@@ -36,22 +64,8 @@ uint8_t *fcv_crop(
   uint32_t new_width,
   uint32_t new_height
 ) {
-  if (!data) {
-    return NULL;
-  }
-
-  if (width == 0 || height == 0 || channels == 0 || new_width == 0 ||
-      new_height == 0) {
-    return NULL;
-  }
-
-  // Check for overflow in x + new_width and y + new_height
-  if (x > UINT32_MAX - new_width || y > UINT32_MAX - new_height) {
-    return NULL;
-  }
-
-  if (x + new_width > width || y + new_height > height) {
-    fprintf(stderr, "Crop area is outside the original image bounds.\n");
+  if (!data ||
+      !crop_is_valid(width, height, channels, x, y, new_width, new_height)) {
     return NULL;
   }
 
@@ -71,12 +85,60 @@ uint8_t *fcv_crop(
     return NULL;
   }
 
+  if (!fcv_crop_into(
+        width,
+        height,
+        channels,
+        data,
+        x,
+        y,
+        new_width,
+        new_height,
+        cropped_data
+      )) {
+    free(cropped_data);
+    return NULL;
+  }
+
+  return cropped_data;
+}
+
+/**
+ * Crop an image into a buffer of new_width x new_height pixels.
+ *
+ * @param width Width of the original image.
+ * @param height Height of the original image.
+ * @param channels Number of channels in the image.
+ * @param data Pointer to the pixel data.
+ * @param x The x-coordinate of the top-left corner of the crop area.
+ * @param y The y-coordinate of the top-left corner of the crop area.
+ * @param new_width The width of the crop area.
+ * @param new_height The height of the crop area.
+ * @param out Receives the cropped image (must not overlap data).
+ * @return False if the crop area is outside the original image.
+ */
+bool fcv_crop_into(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  uint32_t x,
+  uint32_t y,
+  uint32_t new_width,
+  uint32_t new_height,
+  uint8_t *out
+) {
+  if (!data || !out ||
+      !crop_is_valid(width, height, channels, x, y, new_width, new_height)) {
+    return false;
+  }
+
   size_t row_bytes = (size_t)new_width * channels;
   for (uint32_t i = 0; i < new_height; ++i) {
     size_t src_index = ((size_t)(y + i) * width + x) * channels;
     size_t dst_index = (size_t)i * row_bytes;
-    memcpy(cropped_data + dst_index, data + src_index, row_bytes);
+    memcpy(out + dst_index, data + src_index, row_bytes);
   }
 
-  return cropped_data;
+  return true;
 }
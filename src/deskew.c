@@ -0,0 +1,363 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "binary_image.h"
+#include "deskew.h"
+#include "warp_affine.h"
+#else
+#include "flatcv.h"
+#endif
+
+// Longest side of the downsampled image that is analyzed
+#define SKEW_MAX_SIDE 1024
+
+// Searched range and step sizes (in degrees)
+#define SKEW_MAX_ANGLE 15.0
+#define SKEW_COARSE_STEP 1.0
+#define SKEW_FINE_STEP 0.05
+
+// Number of coarse angles (-15° to 15° in 1° steps)
+#define SKEW_NUM_COARSE 31
+
+// Width of the column bands that are shifted as a whole (divides 64)
+#define SKEW_BAND 16
+
+// Ratio of the best to the median score that gives a confidence of 1
+#define SKEW_FULL_CONFIDENCE_RATIO 100.0
+
+// fcv_deskew leaves images with a lower confidence unrotated
+#define SKEW_MIN_CONFIDENCE 0.25
+
+typedef struct {
+  uint32_t height;
+  uint32_t num_bands;
+  uint8_t *counts;   // Ink pixels of band b in row y at counts[b * height + y]
+  double *centers;   // Horizontal center of each band relative to the image
+  uint32_t margin;   // Largest shift of a band at SKEW_MAX_ANGLE
+  uint32_t *profile; // Projection profile with height + 2 * margin bins
+} SkewProfile;
+
+static int skew_compare_doubles(void const *a, void const *b) {
+  double da = *(double const *)a;
+  double db = *(double const *)b;
+  return (da > db) - (da < db);
+}
+
+/**
+ * Downsample by averaging factor x factor blocks into a grayscale image.
+ * Transparent pixels are composited onto white.
+ */
+static uint8_t *skew_downsample(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *data,
+  uint32_t factor,
+  uint32_t *out_width,
+  uint32_t *out_height
+) {
+  uint32_t small_width = (width + factor - 1) / factor;
+  uint32_t small_height = (height + factor - 1) / factor;
+  uint8_t *gray = malloc((size_t)small_width * small_height);
+  uint32_t *sums = calloc(small_width, sizeof(uint32_t));
+  uint32_t *counts = calloc(small_width, sizeof(uint32_t));
+  if (!gray || !sums || !counts) {
+    free(gray);
+    free(sums);
+    free(counts);
+    return NULL;
+  }
+
+  for (uint32_t small_y = 0; small_y < small_height; small_y++) {
+    memset(sums, 0, small_width * sizeof(uint32_t));
+    memset(counts, 0, small_width * sizeof(uint32_t));
+
+    uint32_t y_end = (small_y + 1) * factor;
+    y_end = y_end < height ? y_end : height;
+    for (uint32_t y = small_y * factor; y < y_end; y++) {
+      uint8_t const *pixel = data + (size_t)y * width * 4;
+      for (uint32_t small_x = 0, x = 0; small_x < small_width; small_x++) {
+        uint32_t x_end = x + factor < width ? x + factor : width;
+        for (; x < x_end; x++, pixel += 4) {
+          // Luminance (like fcv_rgba_to_grayscale) composited onto white
+          uint32_t luma =
+            (pixel[0] * 77 + pixel[1] * 150 + pixel[2] * 29) >> 8;
+          uint32_t alpha = pixel[3];
+          sums[small_x] += (luma * alpha + 255 * (255 - alpha)) / 255;
+          counts[small_x]++;
+        }
+      }
+    }
+
+    uint8_t *row = gray + (size_t)small_y * small_width;
+    for (uint32_t x = 0; x < small_width; x++) {
+      row[x] = (uint8_t)(sums[x] / counts[x]);
+    }
+  }
+
+  free(sums);
+  free(counts);
+  *out_width = small_width;
+  *out_height = small_height;
+  return gray;
+}
+
+/**
+ * Otsu's threshold: the largest value of the darker class.
+ */
+static uint32_t skew_otsu_threshold(uint8_t const *gray, size_t num_pixels) {
+  uint64_t histogram[256] = {0};
+  for (size_t i = 0; i < num_pixels; i++) {
+    histogram[gray[i]]++;
+  }
+
+  double total_sum = 0;
+  for (uint32_t i = 0; i < 256; i++) {
+    total_sum += (double)i * histogram[i];
+  }
+
+  double weight_dark = 0;
+  double sum_dark = 0;
+  double max_variance = -1;
+  uint32_t threshold = 0;
+  for (uint32_t i = 0; i < 256; i++) {
+    weight_dark += histogram[i];
+    sum_dark += (double)i * histogram[i];
+    double weight_light = num_pixels - weight_dark;
+    if (weight_dark == 0 || weight_light == 0) {
+      continue;
+    }
+
+    double mean_dark = sum_dark / weight_dark;
+    double mean_light = (total_sum - sum_dark) / weight_light;
+    double variance = weight_dark * weight_light * (mean_dark - mean_light) *
+                      (mean_dark - mean_light);
+    if (variance > max_variance) {
+      max_variance = variance;
+      threshold = i;
+    }
+  }
+
+  return threshold;
+}
+
+/**
+ * Count the ink pixels of every SKEW_BAND wide band in every row
+ * of the bit-packed image.
+ */
+static void skew_count_bands(FCVBinaryImage const *ink, uint8_t *counts) {
+  uint32_t bands_per_word = 64 / SKEW_BAND;
+  uint32_t num_bands = (ink->width + SKEW_BAND - 1) / SKEW_BAND;
+  uint64_t band_mask = ((uint64_t)1 << SKEW_BAND) - 1;
+
+  for (uint32_t y = 0; y < ink->height; y++) {
+    uint64_t const *words = ink->data + (size_t)y * ink->stride;
+    for (uint32_t band = 0; band < num_bands; band++) {
+      uint64_t word = words[band / bands_per_word];
+      uint32_t shift = (band % bands_per_word) * SKEW_BAND;
+      counts[(size_t)band * ink->height + y] =
+        (uint8_t)fcv_popcount_u64((word >> shift) & band_mask);
+    }
+  }
+}
+
+/**
+ * Sharpness of the projection profile of the ink sheared by the angle:
+ * the sum of squared differences between neighbouring bins.
+ * Text lines at this angle give high peaks with steep flanks.
+ */
+static double skew_score(SkewProfile const *profile, double angle) {
+  double slope = tan(angle * M_PI / 180.0);
+  uint32_t num_bins = profile->height + 2 * profile->margin;
+  memset(profile->profile, 0, num_bins * sizeof(uint32_t));
+
+  for (uint32_t band = 0; band < profile->num_bands; band++) {
+    // Row y of the band belongs to the line through y - center * slope
+    int64_t shift = (int64_t)profile->margin -
+                    (int64_t)lround(profile->centers[band] * slope);
+    uint32_t *bins = profile->profile + shift;
+    uint8_t const *counts = profile->counts + (size_t)band * profile->height;
+    for (uint32_t y = 0; y < profile->height; y++) {
+      bins[y] += counts[y];
+    }
+  }
+
+  double score = 0;
+  for (uint32_t i = 0; i + 1 < num_bins; i++) {
+    double diff = (double)profile->profile[i + 1] - profile->profile[i];
+    score += diff * diff;
+  }
+  return score;
+}
+
+FCVSkewEstimate fcv_estimate_skew(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data
+) {
+  FCVSkewEstimate estimate = {0.0, 0.0};
+  if (!data || width == 0 || height == 0) {
+    return estimate;
+  }
+
+  uint32_t longest_side = width > height ? width : height;
+  uint32_t factor = (longest_side + SKEW_MAX_SIDE - 1) / SKEW_MAX_SIDE;
+  uint32_t small_width, small_height;
+  uint8_t *gray = skew_downsample(
+    width,
+    height,
+    data,
+    factor,
+    &small_width,
+    &small_height
+  );
+  if (!gray) {
+    return estimate;
+  }
+
+  // Bit-packed ink mask (set bits are pixels of the darker Otsu class)
+  size_t num_pixels = (size_t)small_width * small_height;
+  uint32_t threshold = skew_otsu_threshold(gray, num_pixels);
+  FCVBinaryImage *ink = fcv_binary_image_new(small_width, small_height);
+  if (!ink) {
+    free(gray);
+    return estimate;
+  }
+  for (uint32_t y = 0; y < small_height; y++) {
+    uint8_t const *row = gray + (size_t)y * small_width;
+    uint64_t *words = ink->data + (size_t)y * ink->stride;
+    for (uint32_t x = 0; x < small_width; x++) {
+      words[x / 64] |= (uint64_t)(row[x] <= threshold) << (x % 64);
+    }
+  }
+  free(gray);
+
+  uint64_t ink_count = fcv_binary_count(ink);
+  if (ink_count == 0 || ink_count == num_pixels) {
+    fcv_free_binary_image(ink);
+    return estimate;
+  }
+
+  SkewProfile profile;
+  profile.height = small_height;
+  profile.num_bands = (small_width + SKEW_BAND - 1) / SKEW_BAND;
+  // The centers of the bands are at most num_bands * SKEW_BAND / 2 away
+  // from the middle, which can be more than half of the width
+  profile.margin =
+    (uint32_t)ceil(
+      profile.num_bands * SKEW_BAND / 2.0 * tan(SKEW_MAX_ANGLE * M_PI / 180.0)
+    ) +
+    1;
+  profile.counts = malloc((size_t)profile.num_bands * small_height);
+  profile.centers = malloc(profile.num_bands * sizeof(double));
+  profile.profile =
+    malloc((small_height + 2 * (size_t)profile.margin) * sizeof(uint32_t));
+  if (!profile.counts || !profile.centers || !profile.profile) {
+    free(profile.counts);
+    free(profile.centers);
+    free(profile.profile);
+    fcv_free_binary_image(ink);
+    return estimate;
+  }
+
+  skew_count_bands(ink, profile.counts);
+  fcv_free_binary_image(ink);
+  for (uint32_t band = 0; band < profile.num_bands; band++) {
+    profile.centers[band] =
+      band * SKEW_BAND + (SKEW_BAND - 1) / 2.0 - (small_width - 1) / 2.0;
+  }
+
+  // Coarse sweep over the whole range
+  double coarse_scores[SKEW_NUM_COARSE];
+  double best_angle = 0;
+  double best_score = -1;
+  for (int32_t i = 0; i < SKEW_NUM_COARSE; i++) {
+    double angle = -SKEW_MAX_ANGLE + i * SKEW_COARSE_STEP;
+    coarse_scores[i] = skew_score(&profile, angle);
+    if (coarse_scores[i] > best_score) {
+      best_score = coarse_scores[i];
+      best_angle = angle;
+    }
+  }
+
+  // Fine sweep around the best coarse angle
+  int32_t num_fine = (int32_t)lround(2 * SKEW_COARSE_STEP / SKEW_FINE_STEP) + 1;
+  double *fine_scores = malloc(num_fine * sizeof(double));
+  if (fine_scores && best_score > 0) {
+    double start = best_angle - SKEW_COARSE_STEP;
+    int32_t best_index = -1;
+    for (int32_t i = 0; i < num_fine; i++) {
+      double angle = start + i * SKEW_FINE_STEP;
+      fine_scores[i] = fabs(angle) <= SKEW_MAX_ANGLE + 1e-9
+                         ? skew_score(&profile, angle)
+                         : -1;
+      if (best_index < 0 || fine_scores[i] > fine_scores[best_index]) {
+        best_index = i;
+      }
+    }
+    best_angle = start + best_index * SKEW_FINE_STEP;
+
+    // Vertex of the parabola through the best score and its neighbours
+    if (best_index > 0 && best_index + 1 < num_fine &&
+        fine_scores[best_index - 1] >= 0 && fine_scores[best_index + 1] >= 0) {
+      double left = fine_scores[best_index - 1];
+      double center = fine_scores[best_index];
+      double right = fine_scores[best_index + 1];
+      double curvature = left - 2 * center + right;
+      if (curvature < 0) {
+        best_angle += 0.5 * (left - right) / curvature * SKEW_FINE_STEP;
+      }
+    }
+  }
+  free(fine_scores);
+
+  free(profile.counts);
+  free(profile.centers);
+  free(profile.profile);
+
+  if (best_score > 0) {
+    estimate.angle = fmax(-SKEW_MAX_ANGLE, fmin(SKEW_MAX_ANGLE, best_angle));
+
+    // How much sharper the best profile is than a typical one (log scale)
+    qsort(coarse_scores, SKEW_NUM_COARSE, sizeof(double), skew_compare_doubles);
+    double median = coarse_scores[SKEW_NUM_COARSE / 2];
+    double ratio = median > 0 ? best_score / median : INFINITY;
+    estimate.confidence =
+      fmin(1.0, log(ratio) / log(SKEW_FULL_CONFIDENCE_RATIO));
+  }
+  return estimate;
+}
+
+uint8_t *fcv_deskew(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint32_t *out_width,
+  uint32_t *out_height,
+  FCVSkewEstimate *estimate
+) {
+  if (!data || !out_width || !out_height) {
+    return NULL;
+  }
+
+  FCVSkewEstimate skew = fcv_estimate_skew(width, height, data);
+  if (estimate) {
+    *estimate = skew;
+  }
+
+  double angle = skew.confidence >= SKEW_MIN_CONFIDENCE ? -skew.angle : 0.0;
+  return fcv_rotate_angle(
+    width,
+    height,
+    data,
+    angle,
+    FCV_INTERPOLATION_BILINEAR,
+    true,
+    out_width,
+    out_height
+  );
+}
@@ -0,0 +1,359 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "distance_transform.h"
+#else
+#include "flatcv.h"
+#endif
+
+#define EDT_NONE INT32_MAX
+
+/**
+ * Column pass: vertical distance from every pixel to the nearest feature
+ * in the same column (EDT_NONE if the column has none).
+ *
+ * Handles the columns x0 <= x < x1, walking the image row by row so all
+ * columns of a row are processed together (cache-friendly and
+ * vectorizable). Disjoint column ranges can be processed in parallel.
+ *
+ * @param below Scratch space for x1 - x0 entries.
+ * @param nearest_row Optional output of the row of the nearest feature.
+ */
+static void edt_column_pass(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *data,
+  bool feature_is_white,
+  uint32_t x0,
+  uint32_t x1,
+  int32_t *dist,
+  int32_t *below,
+  int64_t *nearest_row
+) {
+  // Top to bottom: distance to the nearest feature above
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t const *row = data + (size_t)y * width;
+    int32_t *drow = dist + (size_t)y * width;
+    int32_t const *dprev = y > 0 ? drow - width : NULL;
+    int64_t *nrow = nearest_row ? nearest_row + (size_t)y * width : NULL;
+
+    for (uint32_t x = x0; x < x1; x++) {
+      bool is_feature = feature_is_white ? row[x] == 255 : row[x] != 255;
+      if (is_feature) {
+        drow[x] = 0;
+      }
+      else if (dprev && dprev[x] != EDT_NONE) {
+        drow[x] = dprev[x] + 1;
+      }
+      else {
+        drow[x] = EDT_NONE;
+      }
+      if (nrow) {
+        nrow[x] = drow[x] == EDT_NONE ? -1 : (int64_t)y - drow[x];
+      }
+    }
+  }
+
+  // Bottom to top: take the nearest feature below if it is closer
+  for (uint32_t x = x0; x < x1; x++) {
+    below[x - x0] = EDT_NONE;
+  }
+  for (uint32_t y = height; y-- > 0;) {
+    int32_t *drow = dist + (size_t)y * width;
+    int64_t *nrow = nearest_row ? nearest_row + (size_t)y * width : NULL;
+
+    for (uint32_t x = x0; x < x1; x++) {
+      int32_t *b = below + (x - x0);
+      if (drow[x] == 0) {
+        *b = 0;
+        continue;
+      }
+      if (*b != EDT_NONE) {
+        (*b)++;
+        if (*b < drow[x]) {
+          drow[x] = *b;
+          if (nrow) {
+            nrow[x] = (int64_t)y + *b;
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Row pass for one row: lower envelope of the parabolas
+ * (x - q)² + f(q) rooted at every column q with a feature.
+ * Rows are independent of each other and can be processed in parallel.
+ *
+ * @param drow Vertical distances of the row, replaced by squared distances.
+ * @param nrow Optional nearest feature rows, replaced by pixel indices.
+ * @param f, v, z, nrow_copy Scratch space for width (+ 1) entries.
+ */
+static void edt_row_pass(
+  uint32_t width,
+  int32_t *drow,
+  int64_t *nrow,
+  int64_t *f,
+  int32_t *v,
+  double *z,
+  int64_t *nrow_copy
+) {
+  int32_t k = -1;
+  for (int32_t q = 0; q < (int32_t)width; q++) {
+    if (drow[q] == EDT_NONE) {
+      continue;
+    }
+    f[q] = (int64_t)drow[q] * (int64_t)drow[q];
+
+    if (k < 0) {
+      k = 0;
+      v[0] = q;
+      z[0] = -HUGE_VAL;
+      z[1] = HUGE_VAL;
+      continue;
+    }
+
+    // z[0] is -inf, so the loop always terminates with k >= 0
+    double s;
+    while (true) {
+      int32_t p = v[k];
+      s = ((double)(f[q] + (int64_t)q * q) -
+           (double)(f[p] + (int64_t)p * p)) /
+          (2.0 * (double)(q - p));
+      if (s > z[k]) {
+        break;
+      }
+      k--;
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = HUGE_VAL;
+  }
+
+  if (k < 0) {
+    // No feature in any column: the whole row stays EDT_NONE
+    if (nrow) {
+      for (uint32_t x = 0; x < width; x++) {
+        nrow[x] = -1;
+      }
+    }
+    return;
+  }
+
+  if (nrow) {
+    memcpy(nrow_copy, nrow, width * sizeof(int64_t));
+  }
+
+  int32_t j = 0;
+  for (int32_t q = 0; q < (int32_t)width; q++) {
+    while (z[j + 1] < (double)q) {
+      j++;
+    }
+    int64_t dx = q - v[j];
+    int64_t d = dx * dx + f[v[j]];
+    drow[q] = d >= EDT_NONE ? EDT_NONE - 1 : (int32_t)d;
+    if (nrow) {
+      nrow[q] = nrow_copy[v[j]] * (int64_t)width + v[j];
+    }
+  }
+}
+
+/**
+ * Check the shared arguments of the passes. Distances and column indices
+ * are int32, so both dimensions must fit into int32.
+ */
+static bool edt_check_args(
+  uint32_t width,
+  uint32_t height,
+  int32_t const *dist
+) {
+  return dist && width > 0 && height > 0 && width <= INT32_MAX &&
+         height <= INT32_MAX && (uint64_t)width * height <= SIZE_MAX;
+}
+
+/**
+ * Column pass of the distance transform for the columns
+ * x_start <= x < x_end.
+ *
+ * @return False on invalid input or if memory ran out.
+ */
+bool fcv_distance_transform_columns(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *data,
+  bool feature_is_white,
+  uint32_t x_start,
+  uint32_t x_end,
+  int32_t *dist,
+  int64_t *nearest
+) {
+  if (!data || !edt_check_args(width, height, dist) || x_start > x_end ||
+      x_end > width) {
+    return false;
+  }
+  if (x_start == x_end) {
+    return true;
+  }
+
+  int32_t *below = malloc((x_end - x_start) * sizeof(int32_t));
+  if (!below) {
+    return false;
+  }
+  edt_column_pass(
+    width,
+    height,
+    data,
+    feature_is_white,
+    x_start,
+    x_end,
+    dist,
+    below,
+    nearest
+  );
+  free(below);
+  return true;
+}
+
+/**
+ * Row pass of the distance transform for the rows y_start <= y < y_end.
+ *
+ * @return False on invalid input or if memory ran out.
+ */
+bool fcv_distance_transform_rows(
+  uint32_t width,
+  uint32_t height,
+  uint32_t y_start,
+  uint32_t y_end,
+  int32_t *dist,
+  int64_t *nearest
+) {
+  if (!edt_check_args(width, height, dist) || y_start > y_end ||
+      y_end > height) {
+    return false;
+  }
+  if (y_start == y_end) {
+    return true;
+  }
+
+  int64_t *f = malloc(width * sizeof(int64_t));
+  int32_t *v = malloc(width * sizeof(int32_t));
+  double *z = malloc(((size_t)width + 1) * sizeof(double));
+  int64_t *nrow_copy = nearest ? malloc(width * sizeof(int64_t)) : NULL;
+  if (!f || !v || !z || (nearest && !nrow_copy)) {
+    free(f);
+    free(v);
+    free(z);
+    free(nrow_copy);
+    return false;
+  }
+
+  for (uint32_t y = y_start; y < y_end; y++) {
+    edt_row_pass(
+      width,
+      dist + (size_t)y * width,
+      nearest ? nearest + (size_t)y * width : NULL,
+      f,
+      v,
+      z,
+      nrow_copy
+    );
+  }
+
+  free(f);
+  free(v);
+  free(z);
+  free(nrow_copy);
+  return true;
+}
+
+/**
+ * Exact squared Euclidean distance transform of a single-channel image.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the single-channel pixel data.
+ * @param feature_is_white If true, features are white (255) pixels,
+ *        otherwise all pixels that are not white.
+ * @param nearest Optional index of the nearest feature pixel per pixel.
+ * @return Squared distances (INT32_MAX if there are no feature pixels).
+ */
+int32_t *fcv_distance_transform_sq(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  bool feature_is_white,
+  int64_t *nearest
+) {
+  if (!data || width == 0 || height == 0) {
+    return NULL;
+  }
+
+  // Check for overflow: width * height * sizeof(int32_t)
+  if ((uint64_t)width * height > SIZE_MAX / sizeof(int32_t)) {
+    return NULL;
+  }
+  size_t num_pixels = (size_t)width * height;
+
+  int32_t *dist = malloc(num_pixels * sizeof(int32_t));
+  if (!dist) {
+    return NULL;
+  }
+
+  bool ok = fcv_distance_transform_columns(
+    width,
+    height,
+    data,
+    feature_is_white,
+    0,
+    width,
+    dist,
+    nearest
+  );
+  ok = ok &&
+       fcv_distance_transform_rows(width, height, 0, height, dist, nearest);
+  if (!ok) {
+    free(dist);
+    return NULL;
+  }
+  return dist;
+}
+
+/**
+ * Exact Euclidean distance transform of a single-channel image.
+ *
+ * @return Distances (INFINITY if there are no feature pixels).
+ */
+float *fcv_distance_transform(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  bool feature_is_white,
+  int64_t *nearest
+) {
+  int32_t *dist_sq =
+    fcv_distance_transform_sq(width, height, data, feature_is_white, nearest);
+  if (!dist_sq) {
+    return NULL;
+  }
+
+  size_t num_pixels = (size_t)width * height;
+  float *dist = malloc(num_pixels * sizeof(float));
+  if (!dist) {
+    free(dist_sq);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num_pixels; i++) {
+    dist[i] =
+      dist_sq[i] == EDT_NONE ? INFINITY : (float)sqrt((double)dist_sq[i]);
+  }
+
+  free(dist_sq);
+  return dist;
+}
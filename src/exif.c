@@ -1,31 +1,101 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifndef FLATCV_AMALGAMATION
 #include "exif.h"
 #endif
 
-static uint16_t read_u16(FILE *file, int is_little_endian) {
-  uint8_t buf[2];
-  if (fread(buf, 1, 2, file) != 2) {
-    return 0;
+static uint16_t exif_read_u16(uint8_t const *data, int is_little_endian) {
+  if (is_little_endian) {
+    return (uint16_t)(data[0] | (data[1] << 8));
   }
+  return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+static uint32_t exif_read_u32(uint8_t const *data, int is_little_endian) {
   if (is_little_endian) {
-    return (uint16_t)(buf[0] | (buf[1] << 8));
+    return (uint32_t)data[0] | (uint32_t)data[1] << 8 |
+           (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
   }
-  return (uint16_t)((buf[0] << 8) | buf[1]);
+  return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+         (uint32_t)data[2] << 8 | (uint32_t)data[3];
 }
 
-static uint32_t read_u32(FILE *file, int is_little_endian) {
-  uint8_t buf[4];
-  if (fread(buf, 1, 4, file) != 4) {
+/**
+ * Find the orientation tag in the first IFD of an APP1 segment payload
+ * ("Exif\0\0" followed by a TIFF header).
+ * Returns 0 if the segment holds no orientation.
+ */
+static int32_t exif_parse_app1(uint8_t const *data, size_t size) {
+  if (size < 6 + 8 || memcmp(data, "Exif\0\0", 6) != 0) {
     return 0;
   }
-  if (is_little_endian) {
-    return (uint32_t)(buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24));
+  uint8_t const *tiff = data + 6;
+  size_t tiff_size = size - 6;
+
+  int is_little_endian = (tiff[0] == 'I' && tiff[1] == 'I');
+  int is_big_endian = (tiff[0] == 'M' && tiff[1] == 'M');
+  if (!is_little_endian && !is_big_endian) {
+    return 0;
+  }
+  if (exif_read_u16(tiff + 2, is_little_endian) != 42) {
+    return 0;
+  }
+
+  uint32_t ifd_offset = exif_read_u32(tiff + 4, is_little_endian);
+  if (ifd_offset > tiff_size - 2) {
+    return 0;
+  }
+  uint16_t num_entries = exif_read_u16(tiff + ifd_offset, is_little_endian);
+
+  uint8_t const *entry = tiff + ifd_offset + 2;
+  size_t available = tiff_size - ifd_offset - 2;
+  for (uint16_t i = 0; i < num_entries && available >= 12; i++) {
+    // Entries are 12 bytes: tag, type, count and value (or offset)
+    if (exif_read_u16(entry, is_little_endian) == 0x0112) { // Orientation
+      return (int32_t)exif_read_u16(entry + 8, is_little_endian);
+    }
+    entry += 12;
+    available -= 12;
+  }
+  return 0; // IFD0 done
+}
+
+int32_t fcv_get_exif_orientation_mem(uint8_t const *data, size_t size) {
+  if (!data || size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+    return 1;
+  }
+
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    uint8_t const *marker = data + pos;
+    if (marker[0] != 0xFF) {
+      break;
+    }
+
+    if (marker[1] == 0xD9 || marker[1] == 0xDA) { // EOI or SOS
+      break;
+    }
+
+    // Markers are always big-endian and the size includes its two bytes
+    uint16_t segment_size = exif_read_u16(marker + 2, 0);
+    if (segment_size < 2 || segment_size > size - pos - 2) {
+      break;
+    }
+
+    // APP1 - EXIF (other APP1 segments like XMP are skipped)
+    if (marker[1] == 0xE1 && segment_size >= 8 &&
+        memcmp(marker + 4, "Exif\0\0", 6) == 0) {
+      int32_t orientation = exif_parse_app1(marker + 4, segment_size - 2u);
+      return orientation != 0 ? orientation : 1;
+    }
+    pos += 2u + segment_size;
   }
-  return (uint32_t)((buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3]);
+
+  return 1;
 }
 
 int32_t fcv_get_exif_orientation(char const *filename) {
@@ -41,8 +111,10 @@ int32_t fcv_get_exif_orientation(char const *filename) {
     return 1;
   }
 
-  uint8_t marker[2];
-  while (fread(marker, 1, 2, file) == 2) {
+  // Only the segments in front of the image data are read
+  int32_t orientation = 1;
+  uint8_t marker[4];
+  while (fread(marker, 1, 4, file) == 4) {
     if (marker[0] != 0xFF) {
       break;
     }
@@ -51,64 +123,35 @@ int32_t fcv_get_exif_orientation(char const *filename) {
       break;
     }
 
-    uint16_t size = read_u16(file, 0); // Markers are always big-endian
+    uint16_t segment_size = exif_read_u16(marker + 2, 0);
+    if (segment_size < 2) {
+      break;
+    }
 
     if (marker[1] == 0xE1) { // APP1 - EXIF
-      uint8_t exif_header[6];
-      if (fread(exif_header, 1, 6, file) != 6) {
-        break;
-      }
-
-      if (memcmp(exif_header, "Exif\0\0", 6) != 0) {
-        fseek(file, size - 2 - 6, SEEK_CUR);
-        continue;
-      }
-
-      long tiff_start = ftell(file);
-      uint8_t tiff_header[2];
-      if (fread(tiff_header, 1, 2, file) != 2) {
+      size_t payload_size = segment_size - 2u;
+      uint8_t *segment = malloc(payload_size);
+      if (!segment) {
         break;
       }
-
-      int is_little_endian = (tiff_header[0] == 'I' && tiff_header[1] == 'I');
-      int is_big_endian = (tiff_header[0] == 'M' && tiff_header[1] == 'M');
-
-      if (!is_little_endian && !is_big_endian) {
+      if (fread(segment, 1, payload_size, file) != payload_size) {
+        free(segment);
         break;
       }
-
-      uint16_t magic = read_u16(file, is_little_endian);
-      if (magic != 42) {
+      int32_t is_exif =
+        payload_size >= 6 && memcmp(segment, "Exif\0\0", 6) == 0;
+      int32_t app1_orientation = exif_parse_app1(segment, payload_size);
+      free(segment);
+      if (is_exif) {
+        orientation = app1_orientation != 0 ? app1_orientation : 1;
         break;
       }
-
-      uint32_t ifd_offset = read_u32(file, is_little_endian);
-
-      fseek(file, tiff_start + ifd_offset, SEEK_SET);
-
-      uint16_t num_entries = read_u16(file, is_little_endian);
-
-      for (uint16_t i = 0; i < num_entries; i++) {
-        uint16_t tag = read_u16(file, is_little_endian);
-        (void)read_u16(file, is_little_endian); // Skip type
-        (void)read_u32(file, is_little_endian); // Skip count
-
-        if (tag == 0x0112) { // Orientation
-          uint16_t orientation = read_u16(file, is_little_endian);
-          fclose(file);
-          return (int32_t)orientation;
-        }
-        else {
-          fseek(file, 4, SEEK_CUR); // Skip value/offset
-        }
-      }
-      break; // IFD0 done
     }
-    else {
-      fseek(file, size - 2, SEEK_CUR);
+    else if (fseek(file, segment_size - 2, SEEK_CUR) != 0) {
+      break;
     }
   }
 
   fclose(file);
-  return 1;
+  return orientation;
 }
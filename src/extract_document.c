@@ -47,7 +47,7 @@ uint8_t *fcv_extract_document(
   }
 
   // Step 4: Apply the transformation
-  uint8_t *result = fcv_apply_matrix_3x3(
+  uint8_t *result = fcv_apply_matrix_3x3_antialiased(
     width,
     height,
     (uint8_t *)data,
@@ -142,7 +142,7 @@ uint8_t *fcv_extract_document_auto(
   }
 
   // Step 5: Apply the transformation
-  uint8_t *result = fcv_apply_matrix_3x3(
+  uint8_t *result = fcv_apply_matrix_3x3_antialiased(
     width,
     height,
     (uint8_t *)data,
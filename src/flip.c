@@ -1,9 +1,17 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifndef FLATCV_AMALGAMATION
 #include "flip.h"
+#include "transpose_tiled.h"
 #else
 #include "flatcv.h"
 #endif
@@ -38,19 +46,41 @@ fcv_flip_x(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
+  fcv_flip_x_into(width, height, data, flipped_data);
+
+  return flipped_data;
+}
+
+/**
+ * Flip an image horizontally (mirror along vertical axis)
+ * into a buffer of the same size.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data.
+ * @param out Receives the flipped image (must not overlap data).
+ */
+void fcv_flip_x_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
+  }
+
   for (uint32_t y = 0; y < height; y++) {
     for (uint32_t x = 0; x < width; x++) {
       size_t src_index = ((size_t)y * width + x) * 4;
       size_t dst_index = ((size_t)y * width + (width - 1 - x)) * 4;
 
-      flipped_data[dst_index] = data[src_index];         // R
-      flipped_data[dst_index + 1] = data[src_index + 1]; // G
-      flipped_data[dst_index + 2] = data[src_index + 2]; // B
-      flipped_data[dst_index + 3] = data[src_index + 3]; // A
+      out[dst_index] = data[src_index];         // R
+      out[dst_index + 1] = data[src_index + 1]; // G
+      out[dst_index + 2] = data[src_index + 2]; // B
+      out[dst_index + 3] = data[src_index + 3]; // A
     }
   }
-
-  return flipped_data;
 }
 
 /**
@@ -83,19 +113,140 @@ fcv_flip_y(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
+  fcv_flip_y_into(width, height, data, flipped_data);
+
+  return flipped_data;
+}
+
+/**
+ * Flip an image vertically (mirror along horizontal axis)
+ * into a buffer of the same size.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data.
+ * @param out Receives the flipped image (must not overlap data).
+ */
+void fcv_flip_y_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
+  }
+
+  // Whole rows keep their order of pixels
+  size_t row_length = (size_t)width * 4;
   for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-      size_t src_index = ((size_t)y * width + x) * 4;
-      size_t dst_index = ((size_t)(height - 1 - y) * width + x) * 4;
+    memcpy(
+      out + (size_t)(height - 1 - y) * row_length,
+      data + (size_t)y * row_length,
+      row_length
+    );
+  }
+}
 
-      flipped_data[dst_index] = data[src_index];         // R
-      flipped_data[dst_index + 1] = data[src_index + 1]; // G
-      flipped_data[dst_index + 2] = data[src_index + 2]; // B
-      flipped_data[dst_index + 3] = data[src_index + 3]; // A
-    }
+/**
+ * Reverse the order of 4-channel pixels in place.
+ *
+ * Swaps the pixels from both ends towards the middle,
+ * 4 pixels at a time with SSE2 or NEON when available.
+ *
+ * @param data Pointer to the pixel data (modified in-place).
+ * @param count Number of pixels.
+ */
+void fcv_reverse_pixels(uint8_t *data, size_t count) {
+  if (!data || count < 2) {
+    return;
   }
 
-  return flipped_data;
+  uint8_t *left = data;
+  uint8_t *right = data + count * 4; // One past the last pixel
+
+#if defined(__SSE2__)
+  while (right - left >= 32) {
+    __m128i a = _mm_loadu_si128((__m128i const *)left);
+    __m128i b = _mm_loadu_si128((__m128i const *)(right - 16));
+    a = _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 1, 2, 3));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 1, 2, 3));
+    _mm_storeu_si128((__m128i *)left, b);
+    _mm_storeu_si128((__m128i *)(right - 16), a);
+    left += 16;
+    right -= 16;
+  }
+#elif defined(__ARM_NEON)
+  while (right - left >= 32) {
+    uint32x4_t a = vrev64q_u32(vreinterpretq_u32_u8(vld1q_u8(left)));
+    uint32x4_t b = vrev64q_u32(vreinterpretq_u32_u8(vld1q_u8(right - 16)));
+    a = vcombine_u32(vget_high_u32(a), vget_low_u32(a));
+    b = vcombine_u32(vget_high_u32(b), vget_low_u32(b));
+    vst1q_u8(left, vreinterpretq_u8_u32(b));
+    vst1q_u8(right - 16, vreinterpretq_u8_u32(a));
+    left += 16;
+    right -= 16;
+  }
+#endif
+
+  while (right - left >= 8) {
+    uint32_t a;
+    uint32_t b;
+    memcpy(&a, left, 4);
+    memcpy(&b, right - 4, 4);
+    memcpy(left, &b, 4);
+    memcpy(right - 4, &a, 4);
+    left += 4;
+    right -= 4;
+  }
+}
+
+/**
+ * Flip an image horizontally in place.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data (modified in-place).
+ */
+void fcv_flip_x_in_place(uint32_t width, uint32_t height, uint8_t *data) {
+  if (!data || width == 0 || height == 0) {
+    return;
+  }
+
+  for (uint32_t y = 0; y < height; y++) {
+    fcv_reverse_pixels(data + (size_t)y * width * 4, width);
+  }
+}
+
+/**
+ * Flip an image vertically in place by swapping rows.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data (modified in-place).
+ */
+void fcv_flip_y_in_place(uint32_t width, uint32_t height, uint8_t *data) {
+  if (!data || width == 0 || height == 0) {
+    return;
+  }
+
+  // Rows are swapped in chunks through a small stack buffer
+  uint8_t buffer[4096];
+  size_t row_length = (size_t)width * 4;
+
+  for (uint32_t y = 0; y < height / 2; y++) {
+    uint8_t *top = data + (size_t)y * row_length;
+    uint8_t *bottom = data + (size_t)(height - 1 - y) * row_length;
+
+    for (size_t offset = 0; offset < row_length; offset += sizeof(buffer)) {
+      size_t length = row_length - offset < sizeof(buffer)
+                        ? row_length - offset
+                        : sizeof(buffer);
+      memcpy(buffer, top + offset, length);
+      memcpy(top + offset, bottom + offset, length);
+      memcpy(bottom + offset, buffer, length);
+    }
+  }
 }
 
 /**
@@ -123,19 +274,26 @@ fcv_transpose(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
-  for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-      size_t src_index = ((size_t)y * width + x) * 4;
-      size_t dst_index = ((size_t)x * height + y) * 4;
+  fcv_transpose_into(width, height, data, transposed_data);
 
-      transposed_data[dst_index] = data[src_index];
-      transposed_data[dst_index + 1] = data[src_index + 1];
-      transposed_data[dst_index + 2] = data[src_index + 2];
-      transposed_data[dst_index + 3] = data[src_index + 3];
-    }
+  return transposed_data;
+}
+
+/**
+ * Transpose an image (flip along main diagonal)
+ * into a buffer of the same size (height x width pixels).
+ */
+void fcv_transpose_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
   }
 
-  return transposed_data;
+  fcv_transpose_tiled(width, height, 4, data, out, false, false);
 }
 
 /**
@@ -163,18 +321,24 @@ fcv_transverse(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
-  for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-      size_t src_index = ((size_t)y * width + x) * 4;
-      size_t dst_index =
-        ((size_t)(width - 1 - x) * height + (height - 1 - y)) * 4;
+  fcv_transverse_into(width, height, data, transposed_data);
 
-      transposed_data[dst_index] = data[src_index];
-      transposed_data[dst_index + 1] = data[src_index + 1];
-      transposed_data[dst_index + 2] = data[src_index + 2];
-      transposed_data[dst_index + 3] = data[src_index + 3];
-    }
+  return transposed_data;
+}
+
+/**
+ * Transverse an image (flip along anti-diagonal)
+ * into a buffer of the same size (height x width pixels).
+ */
+void fcv_transverse_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
   }
 
-  return transposed_data;
+  fcv_transpose_tiled(width, height, 4, data, out, true, true);
 }
@@ -0,0 +1,530 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef FLATCV_AMALGAMATION
+#include "grayscale_morphology.h"
+#include "transpose_tiled.h"
+#else
+#include "flatcv.h"
+#endif
+
+// Number of columns filtered together in the vertical pass
+#define GRAY_MORPH_STRIP_WIDTH 256
+
+// Disks with more corners are approximated by this many rectangles
+#define GRAY_MORPH_MAX_DISK_RECTS 8
+
+/**
+ * dst = min(a, b) or max(a, b) element-wise,
+ * 16 bytes at a time with SSE2 or NEON when available.
+ */
+static void combine_lanes(
+  uint8_t *dst,
+  uint8_t const *a,
+  uint8_t const *b,
+  size_t lanes,
+  bool is_max
+) {
+  size_t l = 0;
+
+#if defined(__SSE2__)
+  for (; l + 16 <= lanes; l += 16) {
+    __m128i va = _mm_loadu_si128((__m128i const *)(a + l));
+    __m128i vb = _mm_loadu_si128((__m128i const *)(b + l));
+    __m128i vr = is_max ? _mm_max_epu8(va, vb) : _mm_min_epu8(va, vb);
+    _mm_storeu_si128((__m128i *)(dst + l), vr);
+  }
+#elif defined(__ARM_NEON)
+  for (; l + 16 <= lanes; l += 16) {
+    uint8x16_t va = vld1q_u8(a + l);
+    uint8x16_t vb = vld1q_u8(b + l);
+    vst1q_u8(dst + l, is_max ? vmaxq_u8(va, vb) : vminq_u8(va, vb));
+  }
+#endif
+
+  for (; l < lanes; l++) {
+    dst[l] = is_max ? (a[l] > b[l] ? a[l] : b[l]) : (a[l] < b[l] ? a[l] : b[l]);
+  }
+}
+
+/**
+ * Single-lane version of min_max_pass (used for the horizontal pass).
+ */
+static void min_max_pass_scalar(
+  uint8_t const *src,
+  uint8_t *dst,
+  size_t n,
+  size_t stride,
+  size_t before,
+  size_t after,
+  bool is_max,
+  uint8_t *pre,
+  uint8_t *suf
+) {
+  uint8_t const identity = is_max ? 0 : 255;
+  size_t k = before + after + 1;
+  size_t m = n + before + after;
+
+  // Padded copy of the line in `suf`, then the prefix in `pre`
+  memset(suf, identity, before);
+  for (size_t i = 0; i < n; i++) {
+    suf[before + i] = src[i * stride];
+  }
+  memset(suf + before + n, identity, after);
+
+  for (size_t start = 0; start < m; start += k) {
+    size_t end = start + k < m ? start + k : m;
+    uint8_t acc = suf[start];
+    pre[start] = acc;
+    for (size_t i = start + 1; i < end; i++) {
+      uint8_t v = suf[i];
+      acc = is_max ? (v > acc ? v : acc) : (v < acc ? v : acc);
+      pre[i] = acc;
+    }
+    acc = suf[end - 1];
+    for (size_t i = end - 1; i-- > start;) {
+      uint8_t v = suf[i];
+      acc = is_max ? (v > acc ? v : acc) : (v < acc ? v : acc);
+      suf[i] = acc;
+    }
+  }
+
+  for (size_t x = 0; x < n; x++) {
+    uint8_t a = suf[x];
+    uint8_t b = pre[x + k - 1];
+    dst[x * stride] = is_max ? (a > b ? a : b) : (a < b ? a : b);
+  }
+}
+
+/**
+ * One-dimensional running min/max (van Herk / Gil-Werman).
+ *
+ * Filters n elements along one axis with the window
+ * [i - before, i + after]. Every element consists of `lanes` contiguous
+ * bytes which are filtered independently, so the vertical pass can process
+ * a whole strip of columns at once. Elements are `stride` bytes apart.
+ *
+ * The padded line is split into blocks of the window size. A window spans
+ * at most two blocks, so it is the combination of a suffix of the first
+ * block and a prefix of the second: 3 comparisons per element,
+ * independent of the window size.
+ *
+ * @param pre, suf Scratch space of (n + before + after) * lanes bytes each.
+ */
+static void min_max_pass(
+  uint8_t const *src,
+  uint8_t *dst,
+  size_t n,
+  size_t lanes,
+  size_t stride,
+  size_t before,
+  size_t after,
+  bool is_max,
+  uint8_t *pre,
+  uint8_t *suf
+) {
+  uint8_t const identity = is_max ? 0 : 255;
+  size_t k = before + after + 1;
+  size_t m = n + before + after;
+
+  if (lanes == 1) {
+    min_max_pass_scalar(src, dst, n, stride, before, after, is_max, pre, suf);
+    return;
+  }
+
+  // Block-wise prefix combination
+  for (size_t i = 0; i < m; i++) {
+    uint8_t *p = pre + i * lanes;
+    bool inside = i >= before && i < before + n;
+
+    if (!inside) {
+      memset(p, identity, lanes);
+      if (i % k != 0) {
+        memcpy(p, p - lanes, lanes);
+      }
+    }
+    else if (i % k == 0) {
+      memcpy(p, src + (i - before) * stride, lanes);
+    }
+    else {
+      combine_lanes(p, p - lanes, src + (i - before) * stride, lanes, is_max);
+    }
+  }
+
+  // Block-wise suffix combination
+  for (size_t i = m; i-- > 0;) {
+    uint8_t *s = suf + i * lanes;
+    bool inside = i >= before && i < before + n;
+    bool block_end = i % k == k - 1 || i == m - 1;
+
+    if (!inside) {
+      memset(s, identity, lanes);
+      if (!block_end) {
+        memcpy(s, s + lanes, lanes);
+      }
+    }
+    else if (block_end) {
+      memcpy(s, src + (i - before) * stride, lanes);
+    }
+    else {
+      combine_lanes(s, s + lanes, src + (i - before) * stride, lanes, is_max);
+    }
+  }
+
+  // Window of element x covers padded elements x .. x + k - 1
+  for (size_t x = 0; x < n; x++) {
+    combine_lanes(
+      dst + x * stride,
+      suf + x * lanes,
+      pre + (x + k - 1) * lanes,
+      lanes,
+      is_max
+    );
+  }
+}
+
+/**
+ * Separable min/max filter with the window
+ * [x - left, x + right] × [y - up, y + down].
+ */
+static uint8_t *min_max_rect(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t left,
+  int32_t right,
+  int32_t up,
+  int32_t down,
+  bool is_max
+) {
+  // Larger extents than the image don't change the result
+  size_t w = (size_t)width;
+  size_t h = (size_t)height;
+  size_t l = (size_t)left < w ? (size_t)left : w - 1;
+  size_t r = (size_t)right < w ? (size_t)right : w - 1;
+  size_t u = (size_t)up < h ? (size_t)up : h - 1;
+  size_t d = (size_t)down < h ? (size_t)down : h - 1;
+
+  size_t column_scratch = (w + l + r) * GRAY_MORPH_STRIP_WIDTH;
+  size_t row_scratch = (h + u + d) * GRAY_MORPH_STRIP_WIDTH;
+  size_t scratch_len =
+    column_scratch > row_scratch ? column_scratch : row_scratch;
+
+  // A pass with a window of one element is the identity and is skipped
+  bool horizontal = l + r > 0;
+  bool vertical = u + d > 0;
+
+  uint8_t *result = malloc(w * h);
+  uint8_t *tmp = horizontal ? malloc(w * h) : NULL;
+  uint8_t *pre = malloc(scratch_len);
+  uint8_t *suf = malloc(scratch_len);
+  if (!result || (horizontal && !tmp) || !pre || !suf) {
+    free(tmp);
+    free(result);
+    free(pre);
+    free(suf);
+    return NULL;
+  }
+
+  if (!horizontal && !vertical) {
+    memcpy(result, image_data, w * h);
+  }
+
+  // Horizontal pass: filter the columns of the transposed image,
+  // so that it is vectorized across rows like the vertical pass
+  uint8_t const *vertical_src = image_data;
+  if (horizontal) {
+    fcv_transpose_tiled(width, height, 1, image_data, tmp, false, false);
+    for (size_t y0 = 0; y0 < h; y0 += GRAY_MORPH_STRIP_WIDTH) {
+      size_t lanes =
+        h - y0 < GRAY_MORPH_STRIP_WIDTH ? h - y0 : GRAY_MORPH_STRIP_WIDTH;
+      min_max_pass(tmp + y0, result + y0, w, lanes, h, l, r, is_max, pre, suf);
+    }
+    fcv_transpose_tiled(height, width, 1, result, tmp, false, false);
+    vertical_src = tmp;
+    if (!vertical) {
+      memcpy(result, tmp, w * h);
+    }
+  }
+
+  // Vertical pass on strips of columns, vectorized across the strip
+  if (vertical) {
+    for (size_t x0 = 0; x0 < w; x0 += GRAY_MORPH_STRIP_WIDTH) {
+      size_t lanes =
+        w - x0 < GRAY_MORPH_STRIP_WIDTH ? w - x0 : GRAY_MORPH_STRIP_WIDTH;
+      min_max_pass(
+        vertical_src + x0,
+        result + x0,
+        h,
+        lanes,
+        w,
+        u,
+        d,
+        is_max,
+        pre,
+        suf
+      );
+    }
+  }
+
+  free(tmp);
+  free(pre);
+  free(suf);
+  return result;
+}
+
+static bool gray_morph_valid_input(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height
+) {
+  if (!image_data || width <= 0 || height <= 0) {
+    return false;
+  }
+
+  // Check for overflow: width * height
+  return (size_t)width <= SIZE_MAX / (size_t)height;
+}
+
+uint8_t *fcv_grayscale_erosion_rect(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t kernel_width,
+  int32_t kernel_height
+) {
+  if (!gray_morph_valid_input(image_data, width, height) ||
+      kernel_width <= 0 || kernel_height <= 0) {
+    return NULL;
+  }
+
+  int32_t left = (kernel_width - 1) / 2;
+  int32_t up = (kernel_height - 1) / 2;
+  return min_max_rect(
+    image_data,
+    width,
+    height,
+    left,
+    kernel_width - 1 - left,
+    up,
+    kernel_height - 1 - up,
+    false
+  );
+}
+
+uint8_t *fcv_grayscale_dilation_rect(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t kernel_width,
+  int32_t kernel_height
+) {
+  if (!gray_morph_valid_input(image_data, width, height) ||
+      kernel_width <= 0 || kernel_height <= 0) {
+    return NULL;
+  }
+
+  int32_t left = (kernel_width - 1) / 2;
+  int32_t up = (kernel_height - 1) / 2;
+  return min_max_rect(
+    image_data,
+    width,
+    height,
+    left,
+    kernel_width - 1 - left,
+    up,
+    kernel_height - 1 - up,
+    true
+  );
+}
+
+/**
+ * Half width of the disk row at vertical offset dy,
+ * using the same disk as the binary morphology (dx² + dy² <= r² + r).
+ */
+static int32_t gray_disk_half_width(int32_t radius, int32_t dy) {
+  int64_t limit = (int64_t)radius * radius + radius - (int64_t)dy * dy;
+  int32_t dx = (int32_t)sqrt((double)limit);
+  while ((int64_t)(dx + 1) * (dx + 1) <= limit) {
+    dx++;
+  }
+  while ((int64_t)dx * dx > limit) {
+    dx--;
+  }
+  return dx;
+}
+
+/**
+ * Min/max filter with a disk, decomposed into a union of centered
+ * rectangles [-half_width, half_width] × [-half_height, half_height].
+ *
+ * The disk is exactly the union of the rectangles at its staircase corners.
+ * If there are more than GRAY_MORPH_MAX_DISK_RECTS corners, an evenly
+ * spaced subset is used, which yields an inscribed approximation.
+ */
+static uint8_t *min_max_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius,
+  bool is_max
+) {
+  if (!gray_morph_valid_input(image_data, width, height) || radius < 0) {
+    return NULL;
+  }
+
+  // Corners of the staircase: rows where the next row is narrower
+  int32_t *corner_dy = malloc(((size_t)radius + 1) * sizeof(int32_t));
+  if (!corner_dy) {
+    return NULL;
+  }
+  int32_t corner_count = 0;
+  for (int32_t dy = 0; dy <= radius; dy++) {
+    if (dy == radius || gray_disk_half_width(radius, dy + 1) <
+                          gray_disk_half_width(radius, dy)) {
+      corner_dy[corner_count++] = dy;
+    }
+  }
+
+  int32_t rect_count = corner_count < GRAY_MORPH_MAX_DISK_RECTS
+                         ? corner_count
+                         : GRAY_MORPH_MAX_DISK_RECTS;
+
+  uint8_t *result = NULL;
+  size_t num_pixels = (size_t)width * (size_t)height;
+
+  for (int32_t i = 0; i < rect_count; i++) {
+    int32_t corner = rect_count == 1
+                       ? corner_count - 1
+                       : (int32_t)((int64_t)i * (corner_count - 1) /
+                                   (rect_count - 1));
+    int32_t half_height = corner_dy[corner];
+    int32_t half_width = gray_disk_half_width(radius, half_height);
+
+    uint8_t *filtered = min_max_rect(
+      image_data,
+      width,
+      height,
+      half_width,
+      half_width,
+      half_height,
+      half_height,
+      is_max
+    );
+    if (!filtered) {
+      free(result);
+      free(corner_dy);
+      return NULL;
+    }
+
+    if (!result) {
+      result = filtered;
+    }
+    else {
+      combine_lanes(result, result, filtered, num_pixels, is_max);
+      free(filtered);
+    }
+  }
+
+  free(corner_dy);
+  return result;
+}
+
+uint8_t *fcv_grayscale_erosion_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+) {
+  return min_max_disk(image_data, width, height, radius, false);
+}
+
+uint8_t *fcv_grayscale_dilation_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+) {
+  return min_max_disk(image_data, width, height, radius, true);
+}
+
+uint8_t *fcv_grayscale_opening_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+) {
+  uint8_t *eroded = min_max_disk(image_data, width, height, radius, false);
+  if (!eroded) {
+    return NULL;
+  }
+
+  uint8_t *result = min_max_disk(eroded, width, height, radius, true);
+  free(eroded);
+  return result;
+}
+
+uint8_t *fcv_grayscale_closing_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+) {
+  uint8_t *dilated = min_max_disk(image_data, width, height, radius, true);
+  if (!dilated) {
+    return NULL;
+  }
+
+  uint8_t *result = min_max_disk(dilated, width, height, radius, false);
+  free(dilated);
+  return result;
+}
+
+uint8_t *fcv_white_top_hat_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+) {
+  uint8_t *result =
+    fcv_grayscale_opening_disk(image_data, width, height, radius);
+  if (!result) {
+    return NULL;
+  }
+
+  // Opening is never brighter than the image, so this can't underflow
+  size_t num_pixels = (size_t)width * (size_t)height;
+  for (size_t i = 0; i < num_pixels; i++) {
+    result[i] = (uint8_t)(image_data[i] - result[i]);
+  }
+  return result;
+}
+
+uint8_t *fcv_black_top_hat_disk(
+  uint8_t const *image_data,
+  int32_t width,
+  int32_t height,
+  int32_t radius
+) {
+  uint8_t *result =
+    fcv_grayscale_closing_disk(image_data, width, height, radius);
+  if (!result) {
+    return NULL;
+  }
+
+  // Closing is never darker than the image, so this can't underflow
+  size_t num_pixels = (size_t)width * (size_t)height;
+  for (size_t i = 0; i < num_pixels; i++) {
+    result[i] = (uint8_t)(result[i] - image_data[i]);
+  }
+  return result;
+}
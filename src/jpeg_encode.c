@@ -0,0 +1,400 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "jpeg_encode.h"
+#else
+#include "flatcv.h"
+#endif
+
+// Natural (row-major) index of the coefficients in zigzag order
+static const uint8_t jpeg_zigzag[64] = {
+  0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// Luminance quantization table for quality 50 (natural order)
+static const uint8_t jpeg_luma_quant[64] = {
+  16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+  14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+  18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+  49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99
+};
+
+// Standard luminance Huffman tables: number of codes per length (1-16)
+// and the symbols in order of increasing code length
+static const uint8_t jpeg_dc_counts[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1};
+static const uint8_t jpeg_dc_symbols[12] =
+  {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t jpeg_ac_counts[16] =
+  {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+static const uint8_t jpeg_ac_symbols[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+  0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+  0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72,
+  0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45,
+  0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75,
+  0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3,
+  0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+  0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9,
+  0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+  0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4,
+  0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA
+};
+
+// Scale factors of the AAN DCT: cos(k * pi / 16) * sqrt(2) for k > 0
+static const float jpeg_aan_scales[8] = {
+  1.0f,
+  1.387039845f,
+  1.306562965f,
+  1.175875602f,
+  1.0f,
+  0.785694958f,
+  0.541196100f,
+  0.275899379f
+};
+
+typedef struct {
+  uint16_t codes[256];
+  uint8_t lengths[256];
+} JpegHuffman;
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  uint32_t bit_buffer;
+  uint32_t bit_count;
+  bool failed;
+} JpegWriter;
+
+static bool jpeg_reserve(JpegWriter *writer, size_t extra) {
+  if (writer->failed) {
+    return false;
+  }
+  if (extra <= writer->capacity - writer->size) {
+    return true;
+  }
+  size_t capacity = writer->capacity ? writer->capacity : 4096;
+  while (extra > capacity - writer->size) {
+    // Check for overflow:
+    if (capacity > SIZE_MAX / 2) {
+      writer->failed = true;
+      return false;
+    }
+    capacity *= 2;
+  }
+  uint8_t *data = realloc(writer->data, capacity);
+  if (!data) {
+    writer->failed = true;
+    return false;
+  }
+  writer->data = data;
+  writer->capacity = capacity;
+  return true;
+}
+
+static void
+jpeg_put_bytes(JpegWriter *writer, uint8_t const *bytes, size_t count) {
+  if (jpeg_reserve(writer, count)) {
+    memcpy(writer->data + writer->size, bytes, count);
+    writer->size += count;
+  }
+}
+
+/**
+ * Append up to 16 bits, most significant bit first. Every 0xFF byte
+ * of the entropy-coded data is followed by a stuffed 0x00 byte.
+ * Space must have been reserved with jpeg_reserve.
+ */
+static inline void
+jpeg_put_bits(JpegWriter *writer, uint32_t bits, uint32_t count) {
+  writer->bit_buffer = (writer->bit_buffer << count) | bits;
+  writer->bit_count += count;
+  while (writer->bit_count >= 8) {
+    writer->bit_count -= 8;
+    uint8_t byte = (uint8_t)(writer->bit_buffer >> writer->bit_count);
+    writer->data[writer->size++] = byte;
+    if (byte == 0xFF) {
+      writer->data[writer->size++] = 0;
+    }
+  }
+  writer->bit_buffer &= (1u << writer->bit_count) - 1;
+}
+
+static void jpeg_build_huffman(
+  uint8_t const counts[16],
+  uint8_t const *symbols,
+  JpegHuffman *table
+) {
+  uint32_t code = 0;
+  uint32_t k = 0;
+  for (uint32_t length = 1; length <= 16; length++) {
+    for (uint32_t i = 0; i < counts[length - 1]; i++) {
+      table->codes[symbols[k]] = (uint16_t)code;
+      table->lengths[symbols[k]] = (uint8_t)length;
+      code++;
+      k++;
+    }
+    code <<= 1;
+  }
+}
+
+/**
+ * One-dimensional AAN forward DCT of 8 values at the given stride.
+ * The outputs are scaled by jpeg_aan_scales (and 8 for both passes),
+ * which is folded into the quantization.
+ */
+static void jpeg_fdct_1d(float *d, uint32_t stride) {
+  float tmp0 = d[0] + d[7 * stride];
+  float tmp7 = d[0] - d[7 * stride];
+  float tmp1 = d[stride] + d[6 * stride];
+  float tmp6 = d[stride] - d[6 * stride];
+  float tmp2 = d[2 * stride] + d[5 * stride];
+  float tmp5 = d[2 * stride] - d[5 * stride];
+  float tmp3 = d[3 * stride] + d[4 * stride];
+  float tmp4 = d[3 * stride] - d[4 * stride];
+
+  // Even part
+  float tmp10 = tmp0 + tmp3;
+  float tmp13 = tmp0 - tmp3;
+  float tmp11 = tmp1 + tmp2;
+  float tmp12 = tmp1 - tmp2;
+  d[0] = tmp10 + tmp11;
+  d[4 * stride] = tmp10 - tmp11;
+  float z1 = (tmp12 + tmp13) * 0.707106781f;
+  d[2 * stride] = tmp13 + z1;
+  d[6 * stride] = tmp13 - z1;
+
+  // Odd part
+  tmp10 = tmp4 + tmp5;
+  tmp11 = tmp5 + tmp6;
+  tmp12 = tmp6 + tmp7;
+  float z5 = (tmp10 - tmp12) * 0.382683433f;
+  float z2 = tmp10 * 0.541196100f + z5;
+  float z4 = tmp12 * 1.306562965f + z5;
+  float z3 = tmp11 * 0.707106781f;
+  float z11 = tmp7 + z3;
+  float z13 = tmp7 - z3;
+  d[5 * stride] = z13 + z2;
+  d[3 * stride] = z13 - z2;
+  d[stride] = z11 + z4;
+  d[7 * stride] = z11 - z4;
+}
+
+/**
+ * Number of bits needed for the magnitude of value (its JPEG category).
+ */
+static inline uint32_t jpeg_category(int32_t value) {
+  uint32_t magnitude = (uint32_t)(value < 0 ? -value : value);
+  uint32_t category = 0;
+  while (magnitude) {
+    category++;
+    magnitude >>= 1;
+  }
+  return category;
+}
+
+static inline void jpeg_put_value(JpegWriter *writer, int32_t value) {
+  uint32_t category = jpeg_category(value);
+  // Negative values are stored as one's complement
+  uint32_t bits = (uint32_t)(value < 0 ? value - 1 : value);
+  jpeg_put_bits(writer, bits & ((1u << category) - 1), category);
+}
+
+static void jpeg_encode_block(
+  JpegWriter *writer,
+  float block[64],
+  float const scales[64],
+  int32_t *previous_dc,
+  JpegHuffman const *dc_table,
+  JpegHuffman const *ac_table
+) {
+  for (uint32_t row = 0; row < 8; row++) {
+    jpeg_fdct_1d(block + row * 8, 1);
+  }
+  for (uint32_t col = 0; col < 8; col++) {
+    jpeg_fdct_1d(block + col, 8);
+  }
+
+  int32_t coefficients[64];
+  for (uint32_t k = 0; k < 64; k++) {
+    uint32_t n = jpeg_zigzag[k];
+    float value = block[n] * scales[n];
+    int32_t rounded = (int32_t)(value < 0 ? value - 0.5f : value + 0.5f);
+    // Baseline JPEG has at most 11 bit DC and 10 bit AC values
+    int32_t limit = k == 0 ? 2047 : 1023;
+    coefficients[k] = rounded < -limit ? -limit
+                      : rounded > limit ? limit
+                                        : rounded;
+  }
+
+  int32_t diff = coefficients[0] - *previous_dc;
+  *previous_dc = coefficients[0];
+  uint32_t category = jpeg_category(diff);
+  jpeg_put_bits(writer, dc_table->codes[category], dc_table->lengths[category]);
+  jpeg_put_value(writer, diff);
+
+  uint32_t last_nonzero = 0;
+  for (uint32_t k = 63; k > 0; k--) {
+    if (coefficients[k] != 0) {
+      last_nonzero = k;
+      break;
+    }
+  }
+
+  uint32_t zero_run = 0;
+  for (uint32_t k = 1; k <= last_nonzero; k++) {
+    if (coefficients[k] == 0) {
+      zero_run++;
+      continue;
+    }
+    while (zero_run >= 16) {
+      jpeg_put_bits(writer, ac_table->codes[0xF0], ac_table->lengths[0xF0]);
+      zero_run -= 16;
+    }
+    uint32_t symbol = zero_run << 4 | jpeg_category(coefficients[k]);
+    jpeg_put_bits(writer, ac_table->codes[symbol], ac_table->lengths[symbol]);
+    jpeg_put_value(writer, coefficients[k]);
+    zero_run = 0;
+  }
+  if (last_nonzero < 63) {
+    jpeg_put_bits(writer, ac_table->codes[0x00], ac_table->lengths[0x00]);
+  }
+}
+
+uint8_t *fcv_encode_jpeg_gray(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  int32_t quality,
+  size_t *out_size
+) {
+  if (!data || !out_size || width == 0 || height == 0 || width > 65535 ||
+      height > 65535 || channels == 0 || quality < 1 || quality > 100) {
+    return NULL;
+  }
+
+  // Scale the quantization table like libjpeg
+  int32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+  uint8_t quant[64];
+  float scales[64];
+  for (uint32_t i = 0; i < 64; i++) {
+    int32_t value = (jpeg_luma_quant[i] * scale + 50) / 100;
+    quant[i] = (uint8_t)(value < 1 ? 1 : value > 255 ? 255 : value);
+    scales[i] =
+      1.0f / (quant[i] * jpeg_aan_scales[i / 8] * jpeg_aan_scales[i % 8] * 8);
+  }
+
+  JpegHuffman dc_table, ac_table;
+  jpeg_build_huffman(jpeg_dc_counts, jpeg_dc_symbols, &dc_table);
+  jpeg_build_huffman(jpeg_ac_counts, jpeg_ac_symbols, &ac_table);
+
+  JpegWriter writer = {NULL, 0, 0, 0, 0, false};
+
+  // Start of image and JFIF header (version 1.1, no density units)
+  static const uint8_t header[20] = {
+    0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F',
+    0,    1,    1,    0,    0, 1,  0,   1,   0,   0
+  };
+  jpeg_put_bytes(&writer, header, sizeof(header));
+
+  // Quantization table 0 in zigzag order
+  uint8_t dqt[69] = {0xFF, 0xDB, 0, 67, 0};
+  for (uint32_t k = 0; k < 64; k++) {
+    dqt[5 + k] = quant[jpeg_zigzag[k]];
+  }
+  jpeg_put_bytes(&writer, dqt, sizeof(dqt));
+
+  // Baseline frame with one component (8 bit, no subsampling, table 0)
+  uint8_t const sof[13] = {
+    0xFF,
+    0xC0,
+    0,
+    11,
+    8,
+    (uint8_t)(height >> 8),
+    (uint8_t)height,
+    (uint8_t)(width >> 8),
+    (uint8_t)width,
+    1,
+    1,
+    0x11,
+    0
+  };
+  jpeg_put_bytes(&writer, sof, sizeof(sof));
+
+  // Huffman tables: DC table 0 and AC table 0
+  uint8_t dht[4 + 17 + 12 + 17 + 162] = {0xFF, 0xC4, 0, 2 + 17 + 12 + 17 + 162};
+  uint8_t *out = dht + 4;
+  *out++ = 0x00;
+  memcpy(out, jpeg_dc_counts, 16);
+  memcpy(out + 16, jpeg_dc_symbols, 12);
+  out += 16 + 12;
+  *out++ = 0x10;
+  memcpy(out, jpeg_ac_counts, 16);
+  memcpy(out + 16, jpeg_ac_symbols, 162);
+  jpeg_put_bytes(&writer, dht, sizeof(dht));
+
+  // Start of scan: the component uses tables 0, full spectral range
+  static const uint8_t sos[10] = {0xFF, 0xDA, 0, 8, 1, 1, 0x00, 0, 63, 0};
+  jpeg_put_bytes(&writer, sos, sizeof(sos));
+
+  int32_t previous_dc = 0;
+  float block[64];
+  for (uint32_t block_y = 0; block_y < height; block_y += 8) {
+    for (uint32_t block_x = 0; block_x < width; block_x += 8) {
+      // Blocks at the right and bottom edge repeat the last column and row
+      for (uint32_t y = 0; y < 8; y++) {
+        uint32_t src_y = block_y + y < height ? block_y + y : height - 1;
+        uint8_t const *row = data + (size_t)src_y * width * channels;
+        for (uint32_t x = 0; x < 8; x++) {
+          uint32_t src_x = block_x + x < width ? block_x + x : width - 1;
+          block[y * 8 + x] = (float)row[(size_t)src_x * channels] - 128.0f;
+        }
+      }
+
+      // A block takes at most 64 codes of 16 + 11 bits, doubled by stuffing
+      if (!jpeg_reserve(&writer, 512)) {
+        free(writer.data);
+        return NULL;
+      }
+      jpeg_encode_block(
+        &writer,
+        block,
+        scales,
+        &previous_dc,
+        &dc_table,
+        &ac_table
+      );
+    }
+  }
+
+  // Pad the last byte with 1 bits and end the image
+  if (!jpeg_reserve(&writer, 8)) {
+    free(writer.data);
+    return NULL;
+  }
+  if (writer.bit_count > 0) {
+    uint32_t padding = 8 - writer.bit_count;
+    jpeg_put_bits(&writer, (1u << padding) - 1, padding);
+  }
+  static const uint8_t end_of_image[2] = {0xFF, 0xD9};
+  jpeg_put_bytes(&writer, end_of_image, sizeof(end_of_image));
+
+  if (writer.failed) {
+    free(writer.data);
+    return NULL;
+  }
+  *out_size = writer.size;
+  return writer.data;
+}
@@ -0,0 +1,405 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "netpbm.h"
+#include "rgba_to_grayscale.h"
+#else
+#include "flatcv.h"
+#endif
+
+static inline bool netpbm_is_space(uint8_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+         c == '\f';
+}
+
+/**
+ * Skip whitespace and comments (from '#' to the end of the line).
+ * Returns false if there was no whitespace.
+ */
+static bool netpbm_skip_space(uint8_t const *data, size_t size, size_t *pos) {
+  size_t start = *pos;
+  while (*pos < size) {
+    if (data[*pos] == '#') {
+      while (*pos < size && data[*pos] != '\n') {
+        (*pos)++;
+      }
+    }
+    else if (netpbm_is_space(data[*pos])) {
+      (*pos)++;
+    }
+    else {
+      break;
+    }
+  }
+  return *pos > start;
+}
+
+static bool netpbm_read_uint(
+  uint8_t const *data,
+  size_t size,
+  size_t *pos,
+  uint32_t *value
+) {
+  uint32_t result = 0;
+  size_t start = *pos;
+  while (*pos < size && data[*pos] >= '0' && data[*pos] <= '9') {
+    uint32_t digit = data[*pos] - '0';
+    // Check for overflow: result * 10 + digit
+    if (result > (UINT32_MAX - digit) / 10) {
+      return false;
+    }
+    result = result * 10 + digit;
+    (*pos)++;
+  }
+  *value = result;
+  return *pos > start;
+}
+
+/** Parse the header lines of a PAM file after the "P7" magic. */
+static bool netpbm_parse_pam(
+  uint8_t const *data,
+  size_t size,
+  size_t pos,
+  FCVNetpbmInfo *info
+) {
+  bool has_width = false, has_height = false;
+  bool has_depth = false, has_maxval = false;
+
+  while (pos < size) {
+    // Skip leading whitespace and empty lines
+    while (pos < size && netpbm_is_space(data[pos])) {
+      pos++;
+    }
+    if (pos >= size) {
+      break;
+    }
+    if (data[pos] == '#') {
+      while (pos < size && data[pos] != '\n') {
+        pos++;
+      }
+      continue;
+    }
+
+    size_t key_start = pos;
+    while (pos < size && !netpbm_is_space(data[pos])) {
+      pos++;
+    }
+    size_t key_length = pos - key_start;
+    char const *key = (char const *)data + key_start;
+
+    if (key_length == 6 && memcmp(key, "ENDHDR", 6) == 0) {
+      if (pos >= size || data[pos] != '\n' || !has_width || !has_height ||
+          !has_depth || !has_maxval) {
+        return false;
+      }
+      info->data_offset = pos + 1;
+      return true;
+    }
+
+    uint32_t *field = NULL;
+    bool *has_field = NULL;
+    if (key_length == 5 && memcmp(key, "WIDTH", 5) == 0) {
+      field = &info->width;
+      has_field = &has_width;
+    }
+    else if (key_length == 6 && memcmp(key, "HEIGHT", 6) == 0) {
+      field = &info->height;
+      has_field = &has_height;
+    }
+    else if (key_length == 5 && memcmp(key, "DEPTH", 5) == 0) {
+      field = &info->channels;
+      has_field = &has_depth;
+    }
+    else if (key_length == 6 && memcmp(key, "MAXVAL", 6) == 0) {
+      field = &info->maxval;
+      has_field = &has_maxval;
+    }
+
+    if (field) {
+      while (pos < size && (data[pos] == ' ' || data[pos] == '\t')) {
+        pos++;
+      }
+      if (!netpbm_read_uint(data, size, &pos, field)) {
+        return false;
+      }
+      *has_field = true;
+    }
+
+    // Ignore the rest of the line (e.g. the TUPLTYPE)
+    while (pos < size && data[pos] != '\n') {
+      pos++;
+    }
+  }
+
+  return false;
+}
+
+bool fcv_netpbm_info(
+  uint8_t const *const data,
+  size_t size,
+  FCVNetpbmInfo *info
+) {
+  if (!data || !info || size < 3 || data[0] != 'P' ||
+      !netpbm_is_space(data[2])) {
+    return false;
+  }
+
+  FCVNetpbmInfo result = {0};
+  if (data[1] == '7') {
+    result.format = FCV_NETPBM_PAM;
+    if (!netpbm_parse_pam(data, size, 2, &result)) {
+      return false;
+    }
+  }
+  else if (data[1] == '5' || data[1] == '6') {
+    result.format = data[1] == '5' ? FCV_NETPBM_PGM : FCV_NETPBM_PPM;
+    result.channels = data[1] == '5' ? 1 : 3;
+
+    size_t pos = 2;
+    if (!netpbm_skip_space(data, size, &pos) ||
+        !netpbm_read_uint(data, size, &pos, &result.width) ||
+        !netpbm_skip_space(data, size, &pos) ||
+        !netpbm_read_uint(data, size, &pos, &result.height) ||
+        !netpbm_skip_space(data, size, &pos) ||
+        !netpbm_read_uint(data, size, &pos, &result.maxval) || pos >= size ||
+        !netpbm_is_space(data[pos])) {
+      return false;
+    }
+    // Exactly one whitespace character separates the header and the samples
+    result.data_offset = pos + 1;
+  }
+  else {
+    return false;
+  }
+
+  if (result.width == 0 || result.height == 0 || result.channels == 0 ||
+      result.channels > 4 || result.maxval == 0 || result.maxval > 65535) {
+    return false;
+  }
+
+  *info = result;
+  return true;
+}
+
+size_t fcv_netpbm_header(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  FCVNetpbmFormat format,
+  char *header,
+  size_t capacity
+) {
+  static char const *const tuple_types[] =
+    {"GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"};
+
+  if (!header || width == 0 || height == 0) {
+    return 0;
+  }
+
+  int length;
+  if (format == FCV_NETPBM_PGM || format == FCV_NETPBM_PPM) {
+    length = snprintf(
+      header,
+      capacity,
+      "P%c\n%u %u\n255\n",
+      format == FCV_NETPBM_PGM ? '5' : '6',
+      width,
+      height
+    );
+  }
+  else if (format == FCV_NETPBM_PAM && channels >= 1 && channels <= 4) {
+    length = snprintf(
+      header,
+      capacity,
+      "P7\nWIDTH %u\nHEIGHT %u\nDEPTH %u\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n",
+      width,
+      height,
+      channels,
+      tuple_types[channels - 1]
+    );
+  }
+  else {
+    return 0;
+  }
+
+  if (length < 0 || (size_t)length >= capacity) {
+    return 0;
+  }
+  return (size_t)length;
+}
+
+uint8_t *fcv_netpbm_to_rgba(
+  FCVNetpbmInfo const *info,
+  uint8_t const *const samples,
+  size_t size
+) {
+  if (!info || !samples || info->width == 0 || info->height == 0 ||
+      info->channels == 0 || info->channels > 4 || info->maxval == 0 ||
+      info->maxval > 65535) {
+    return NULL;
+  }
+
+  // Check for overflow: width * height * 4 and the size of the samples
+  size_t bytes_per_sample = info->maxval > 255 ? 2 : 1;
+  if (info->width > SIZE_MAX / info->height) {
+    return NULL;
+  }
+  size_t num_pixels = (size_t)info->width * info->height;
+  if (num_pixels > SIZE_MAX / 4 / bytes_per_sample) {
+    return NULL;
+  }
+  size_t num_samples = num_pixels * info->channels;
+  if (size / bytes_per_sample < num_samples) {
+    return NULL;
+  }
+
+  uint8_t *pixels = malloc(num_pixels * 4);
+  if (!pixels) {
+    return NULL;
+  }
+
+  if (info->channels == 4 && info->maxval == 255) {
+    memcpy(pixels, samples, num_pixels * 4);
+    return pixels;
+  }
+
+  uint32_t maxval = info->maxval;
+  uint8_t const *src = samples;
+  for (size_t i = 0; i < num_pixels; i++) {
+    uint8_t values[4] = {0, 0, 0, 255};
+    for (uint32_t c = 0; c < info->channels; c++) {
+      uint32_t sample = *src++;
+      if (bytes_per_sample == 2) {
+        sample = sample << 8 | *src++;
+      }
+      if (maxval != 255) {
+        sample = sample > maxval ? maxval : sample;
+        sample = (sample * 255 + maxval / 2) / maxval;
+      }
+      values[c] = (uint8_t)sample;
+    }
+
+    uint8_t *dst = pixels + i * 4;
+    if (info->channels <= 2) {
+      dst[0] = values[0];
+      dst[1] = values[0];
+      dst[2] = values[0];
+      dst[3] = info->channels == 2 ? values[1] : 255;
+    }
+    else {
+      memcpy(dst, values, 4);
+    }
+  }
+
+  return pixels;
+}
+
+uint8_t *fcv_decode_netpbm(
+  uint8_t const *const data,
+  size_t size,
+  uint32_t *width,
+  uint32_t *height,
+  uint32_t *channels
+) {
+  FCVNetpbmInfo info;
+  if (!width || !height || !channels || !fcv_netpbm_info(data, size, &info) ||
+      info.data_offset > size) {
+    return NULL;
+  }
+
+  uint8_t *pixels = fcv_netpbm_to_rgba(
+    &info,
+    data + info.data_offset,
+    size - info.data_offset
+  );
+  if (!pixels) {
+    return NULL;
+  }
+
+  *width = info.width;
+  *height = info.height;
+  *channels = info.channels;
+  return pixels;
+}
+
+uint8_t *fcv_encode_netpbm(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  FCVNetpbmFormat format,
+  size_t *out_size
+) {
+  if (!data || !out_size || channels == 0 || channels > 4) {
+    return NULL;
+  }
+
+  uint32_t out_channels = format == FCV_NETPBM_PGM   ? 1
+                          : format == FCV_NETPBM_PPM ? 3
+                                                     : channels;
+  char header[128];
+  size_t header_length = fcv_netpbm_header(
+    width,
+    height,
+    out_channels,
+    format,
+    header,
+    sizeof(header)
+  );
+  if (header_length == 0) {
+    return NULL;
+  }
+
+  // Check for overflow: header + width * height * channels
+  if (width > SIZE_MAX / height) {
+    return NULL;
+  }
+  size_t num_pixels = (size_t)width * height;
+  if (num_pixels > (SIZE_MAX - header_length) / 4) {
+    return NULL;
+  }
+  size_t size = header_length + num_pixels * out_channels;
+  uint8_t *out = malloc(size);
+  if (!out) {
+    return NULL;
+  }
+  memcpy(out, header, header_length);
+  uint8_t *dst = out + header_length;
+
+  if (out_channels == channels) {
+    memcpy(dst, data, num_pixels * channels);
+  }
+  else {
+    for (size_t i = 0; i < num_pixels; i++) {
+      uint8_t const *src = data + i * channels;
+      if (format == FCV_NETPBM_PGM) {
+        // Same weights as fcv_rgba_to_grayscale
+        *dst++ = channels <= 2 ? src[0]
+                               : (uint8_t)((src[0] * R_WEIGHT +
+                                            src[1] * G_WEIGHT +
+                                            src[2] * B_WEIGHT) >>
+                                           8);
+      }
+      else if (channels <= 2) {
+        dst[0] = src[0];
+        dst[1] = src[0];
+        dst[2] = src[0];
+        dst += 3;
+      }
+      else {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst += 3;
+      }
+    }
+  }
+
+  *out_size = size;
+  return out;
+}
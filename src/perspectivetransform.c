@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,7 +8,9 @@
 #include <time.h>
 
 #ifndef FLATCV_AMALGAMATION
+#include "bilinear.h"
 #include "perspectivetransform.h"
+#include "warp_clip.h"
 #else
 #include "flatcv.h"
 #endif
@@ -256,17 +259,202 @@ Matrix3x3 *fcv_calculate_perspective_transform(
 }
 
 /**
- * Apply the transformation matrix to the input image
- * and store the result in the output image.
- * Use bilinear interpolation to calculate final pixel values.
+ * Compute the span [*start, *end) of an output row whose source
+ * coordinates can lie inside the input image.
+ *
+ * X, Y and W are linear in x along a row, so as long as W keeps its sign,
+ * every bound 0 <= X / W < in_width (and the same for Y) is a linear
+ * inequality in x. The span is padded by one pixel to absorb rounding,
+ * the exact test is still done per pixel.
  */
-uint8_t *fcv_apply_matrix_3x3(
+static void warp_row_span(
+  double x_row,
+  double y_row,
+  double w_row,
+  Matrix3x3 const *tmat,
+  int32_t in_width,
+  int32_t in_height,
+  int32_t out_width,
+  int32_t *start,
+  int32_t *end
+) {
+  double w_last = w_row + tmat->m20 * (out_width - 1);
+  *start = 0;
+  *end = out_width;
+
+  // W changes its sign within the row: keep the whole row
+  if ((w_row > 0) != (w_last > 0) || w_row == 0 || w_last == 0) {
+    return;
+  }
+
+  double sign = w_row > 0 ? 1.0 : -1.0;
+  double lo = 0;
+  double hi = out_width - 1;
+
+  warp_clip_interval(sign * x_row, sign * tmat->m00, &lo, &hi);
+  warp_clip_interval(
+    sign * (in_width * w_row - x_row),
+    sign * (in_width * tmat->m20 - tmat->m00),
+    &lo,
+    &hi
+  );
+  warp_clip_interval(sign * y_row, sign * tmat->m10, &lo, &hi);
+  warp_clip_interval(
+    sign * (in_height * w_row - y_row),
+    sign * (in_height * tmat->m20 - tmat->m10),
+    &lo,
+    &hi
+  );
+
+  if (!(lo <= hi)) {
+    *end = 0;
+    return;
+  }
+
+  *start = lo - 1 > 0 ? (int32_t)(lo - 1) : 0;
+  *end = hi + 2 < out_width ? (int32_t)(hi + 2) : out_width;
+}
+
+/**
+ * Bilinear sample of the input image at (src_x, src_y).
+ *
+ * @return false if the anchor pixel is outside of the image
+ *         (the output is left untouched).
+ */
+static inline bool warp_sample(
+  uint8_t const *in_data,
+  int32_t in_width,
+  int32_t in_height,
+  double src_x,
+  double src_y,
+  uint8_t *out
+) {
+  if (!(src_x >= 0 && src_x < in_width && src_y >= 0 && src_y < in_height)) {
+    return false;
+  }
+
+  // 16.16 fixed-point coordinates (non-negative, so truncation floors)
+  int64_t fixed_x = (int64_t)(src_x * 65536.0);
+  int64_t fixed_y = (int64_t)(src_y * 65536.0);
+  int32_t x0 = (int32_t)(fixed_x >> 16);
+  int32_t y0 = (int32_t)(fixed_y >> 16);
+  uint32_t dx = (uint32_t)(fixed_x & 0xFFFF);
+  uint32_t dy = (uint32_t)(fixed_y & 0xFFFF);
+
+  // Rounding can push the anchor onto the last row or column + 1
+  if (x0 >= in_width || y0 >= in_height) {
+    return false;
+  }
+
+  // At the borders the missing neighbour gets a weight of 0
+  size_t in_row_length = (size_t)in_width * 4;
+  size_t x_step = 4;
+  if (x0 + 1 >= in_width) {
+    x_step = 0;
+    dx = 0;
+  }
+  size_t y_step = in_row_length;
+  if (y0 + 1 >= in_height) {
+    y_step = 0;
+    dy = 0;
+  }
+
+  uint8_t const *p0 = in_data + (size_t)y0 * in_row_length + (size_t)x0 * 4;
+  bilinear_rgba(p0, p0 + y_step, x_step, dx, dy, out);
+  return true;
+}
+
+// Upper limit for the number of samples per axis of the anti-aliased warp
+#define WARP_MAX_SUPERSAMPLING 16
+
+/**
+ * Number of samples per axis needed to cover the footprint of an output
+ * pixel in the input image, derived from the Jacobian of the homography
+ * at (src_x, src_y).
+ */
+static void warp_footprint(
+  Matrix3x3 const *tmat,
+  double src_x,
+  double src_y,
+  double inv_w,
+  int32_t *samples_x,
+  int32_t *samples_y
+) {
+  double dsx_dx = (tmat->m00 - src_x * tmat->m20) * inv_w;
+  double dsy_dx = (tmat->m10 - src_y * tmat->m20) * inv_w;
+  double dsx_dy = (tmat->m01 - src_x * tmat->m21) * inv_w;
+  double dsy_dy = (tmat->m11 - src_y * tmat->m21) * inv_w;
+
+  double extent_x = round(hypot(dsx_dx, dsy_dx));
+  double extent_y = round(hypot(dsx_dy, dsy_dy));
+
+  *samples_x = (int32_t)fmin(fmax(extent_x, 1), WARP_MAX_SUPERSAMPLING);
+  *samples_y = (int32_t)fmin(fmax(extent_y, 1), WARP_MAX_SUPERSAMPLING);
+}
+
+/**
+ * Average of samples_x * samples_y bilinear samples evenly spread over
+ * the output pixel (out_x, out_y). Samples outside of the input image
+ * count as transparent black, like unmapped pixels.
+ */
+static void warp_supersample(
+  uint8_t const *in_data,
+  int32_t in_width,
+  int32_t in_height,
+  Matrix3x3 const *tmat,
+  int32_t out_x,
+  int32_t out_y,
+  int32_t samples_x,
+  int32_t samples_y,
+  uint8_t *out
+) {
+  uint32_t sum[4] = {0, 0, 0, 0};
+
+  for (int32_t j = 0; j < samples_y; j++) {
+    double y = out_y - 0.5 + (j + 0.5) / samples_y;
+
+    for (int32_t i = 0; i < samples_x; i++) {
+      double x = out_x - 0.5 + (i + 0.5) / samples_x;
+      double w = tmat->m20 * x + tmat->m21 * y + tmat->m22;
+      if (fabs(w) < 1e-10) {
+        continue;
+      }
+
+      double inv_w = 1.0 / w;
+      double src_x = (tmat->m00 * x + tmat->m01 * y + tmat->m02) * inv_w;
+      double src_y = (tmat->m10 * x + tmat->m11 * y + tmat->m12) * inv_w;
+      uint8_t sample[4];
+      if (warp_sample(in_data, in_width, in_height, src_x, src_y, sample)) {
+        for (int32_t c = 0; c < 4; c++) {
+          sum[c] += sample[c];
+        }
+      }
+    }
+  }
+
+  uint32_t count = (uint32_t)(samples_x * samples_y);
+  for (int32_t c = 0; c < 4; c++) {
+    out[c] = (uint8_t)((sum[c] + count / 2) / count);
+  }
+}
+
+/**
+ * Shared implementation of fcv_apply_matrix_3x3 and
+ * fcv_apply_matrix_3x3_antialiased.
+ *
+ * The homography is stepped incrementally along each row
+ * (3 additions and 1 reciprocal per pixel), pixels are sampled with
+ * 16.16 fixed-point weights, and the parts of a row that map outside
+ * of the input image are skipped without evaluating them.
+ */
+static uint8_t *warp_perspective(
   int32_t in_width,
   int32_t in_height,
   uint8_t *in_data,
   int32_t out_width,
   int32_t out_height,
-  Matrix3x3 *tmat
+  Matrix3x3 *tmat,
+  bool antialias
 ) {
   if (!in_data || !tmat) {
     return NULL;
@@ -299,56 +487,124 @@ uint8_t *fcv_apply_matrix_3x3(
     return NULL;
   }
 
-  // Iterate through every pixel in the output image
   for (int32_t out_y = 0; out_y < out_height; ++out_y) {
-    for (int32_t out_x = 0; out_x < out_width; ++out_x) {
-      // Apply the inverse transformation to find the corresponding source pixel
-      double w = tmat->m20 * out_x + tmat->m21 * out_y + tmat->m22;
+    // Homogeneous source coordinates of the first pixel of the row
+    double x_row = tmat->m01 * out_y + tmat->m02;
+    double y_row = tmat->m11 * out_y + tmat->m12;
+    double w_row = tmat->m21 * out_y + tmat->m22;
+
+    // Supersamples lie within half a pixel of the center,
+    // which the padding of the span already covers
+    int32_t start, end;
+    warp_row_span(
+      x_row,
+      y_row,
+      w_row,
+      tmat,
+      in_width,
+      in_height,
+      out_width,
+      &start,
+      &end
+    );
+
+    double x_h = x_row + tmat->m00 * start;
+    double y_h = y_row + tmat->m10 * start;
+    double w_h = w_row + tmat->m20 * start;
+    uint8_t *out_row = out_data + (size_t)out_y * out_width * 4;
+
+    for (int32_t out_x = start; out_x < end; ++out_x) {
+      double w = w_h;
+      double src_x_h = x_h;
+      double src_y_h = y_h;
+
+      // Step to the next pixel
+      x_h += tmat->m00;
+      y_h += tmat->m10;
+      w_h += tmat->m20;
+
       if (fabs(w) < 1e-10) {
         continue; // Skip if w is too close to zero
       }
 
-      double srcX = (tmat->m00 * out_x + tmat->m01 * out_y + tmat->m02) / w;
-      double srcY = (tmat->m10 * out_x + tmat->m11 * out_y + tmat->m12) / w;
-
-      // Convert source coordinates to integers
-      int32_t x0 = (int32_t)floor(srcX);
-      int32_t y0 = (int32_t)floor(srcY);
-      int32_t x1 = x0 + 1;
-      int32_t y1 = y0 + 1;
-
-      // Verify that the anchor pixel is inside the source image
-      if (x0 >= 0 && x0 < in_width && y0 >= 0 && y0 < in_height) {
-
-        // Clamp the neighbor coordinates so that a (degenerated)
-        // bilinear interpolation can be applied at the image borders.
-        int32_t x1c = (x1 < in_width) ? x1 : x0;
-        int32_t y1c = (y1 < in_height) ? y1 : y0;
-
-        double dx = srcX - x0;
-        double dy = srcY - y0;
-
-        // If a neighbour got clamped we force the corresponding weight to 0
-        if (x1c == x0) {
-          dx = 0.0;
-        }
-        if (y1c == y0) {
-          dy = 0.0;
-        }
-
-        uint8_t *p00 = &in_data[(y0 * in_width + x0) * 4];
-        uint8_t *p01 = &in_data[(y0 * in_width + x1c) * 4];
-        uint8_t *p10 = &in_data[(y1c * in_width + x0) * 4];
-        uint8_t *p11 = &in_data[(y1c * in_width + x1c) * 4];
-
-        for (int32_t c = 0; c < 4; ++c) {
-          out_data[(out_y * out_width + out_x) * 4 + c] =
-            (uint8_t)(p00[c] * (1 - dx) * (1 - dy) + p01[c] * dx * (1 - dy) +
-                      p10[c] * (1 - dx) * dy + p11[c] * dx * dy);
+      double inv_w = 1.0 / w;
+      double src_x = src_x_h * inv_w;
+      double src_y = src_y_h * inv_w;
+      uint8_t *out_pixel = out_row + (size_t)out_x * 4;
+
+      if (antialias) {
+        int32_t samples_x, samples_y;
+        warp_footprint(tmat, src_x, src_y, inv_w, &samples_x, &samples_y);
+        if (samples_x > 1 || samples_y > 1) {
+          warp_supersample(
+            in_data,
+            in_width,
+            in_height,
+            tmat,
+            out_x,
+            out_y,
+            samples_x,
+            samples_y,
+            out_pixel
+          );
+          continue;
         }
       }
+
+      warp_sample(in_data, in_width, in_height, src_x, src_y, out_pixel);
     }
   }
 
   return out_data;
 }
+
+/**
+ * Apply the transformation matrix to the input image
+ * and store the result in the output image.
+ * Use bilinear interpolation to calculate final pixel values.
+ */
+uint8_t *fcv_apply_matrix_3x3(
+  int32_t in_width,
+  int32_t in_height,
+  uint8_t *in_data,
+  int32_t out_width,
+  int32_t out_height,
+  Matrix3x3 *tmat
+) {
+  return warp_perspective(
+    in_width,
+    in_height,
+    in_data,
+    out_width,
+    out_height,
+    tmat,
+    false
+  );
+}
+
+/**
+ * Same as fcv_apply_matrix_3x3, but anti-aliased when downscaling.
+ *
+ * Where an output pixel covers more than one input pixel, it is the average
+ * of a grid of bilinear samples sized to the local footprint
+ * (Jacobian of the homography), up to 16 x 16 samples.
+ * Where it doesn't, the result is the same as with fcv_apply_matrix_3x3.
+ */
+uint8_t *fcv_apply_matrix_3x3_antialiased(
+  int32_t in_width,
+  int32_t in_height,
+  uint8_t *in_data,
+  int32_t out_width,
+  int32_t out_height,
+  Matrix3x3 *tmat
+) {
+  return warp_perspective(
+    in_width,
+    in_height,
+    in_data,
+    out_width,
+    out_height,
+    tmat,
+    true
+  );
+}
@@ -0,0 +1,3046 @@
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "binary_closing_disk.h"
+#include "conversion.h"
+#include "crop.h"
+#include "deskew.h"
+#include "draw.h"
+#include "extract_document.h"
+#include "flip.h"
+#include "histogram.h"
+#include "perspectivetransform.h"
+#include "pipeline.h"
+#include "qr_code.h"
+#include "rgba_to_grayscale.h"
+#include "rotate.h"
+#include "single_to_multichannel.h"
+#include "sobel_edge_detection.h"
+#include "trim.h"
+#include "warp_affine.h"
+#include "watershed_segmentation.h"
+#else
+#include "flatcv.h"
+#endif
+
+typedef struct PlanCacheEntry PlanCacheEntry;
+
+struct FCVPipeline {
+  FCVPipelineOp *ops;
+  int32_t count;
+  int32_t capacity;
+  // Plans for the input sizes seen so far, see get_cached_plan
+  _Atomic(PlanCacheEntry *) plans;
+};
+
+/** Plan of a pipeline for one size of the oriented input. */
+struct PlanCacheEntry {
+  int32_t width;
+  int32_t height;
+  FCVPipeline *plan;
+  PlanCacheEntry *next;
+};
+
+// Input sizes beyond this number are planned on every run
+#define MAX_CACHED_PLANS 8
+
+/* Remove leading and trailing white-space, returns pointer to first
+   non-blank char (string is modified in place). */
+static char *pipeline_trim_whitespace(char *s) {
+  while (*s && isspace((uint8_t)*s)) {
+    s++; // left-trim
+  }
+  if (*s == '\0') {
+    return s;
+  }
+  char *end = s + strlen(s) - 1;
+  while (end > s && isspace((uint8_t)*end)) {
+    end--;
+  }
+  *(end + 1) = '\0'; // right-trim
+  return s;
+}
+
+/**
+ * Parse geometry string (e.g., "50x50+10+20")
+ * Returns 1 on success, 0 on failure
+ */
+static int32_t parse_geometry(
+  const char *geometry,
+  uint32_t *width,
+  uint32_t *height,
+  int32_t *x_offset,
+  int32_t *y_offset
+) {
+  if (!geometry || !width || !height || !x_offset || !y_offset) {
+    return 0;
+  }
+
+  // Parse width x height
+  char *end_ptr;
+  unsigned long w = strtoul(geometry, &end_ptr, 10);
+  if (*end_ptr != 'x' || w == 0 || w > UINT_MAX) {
+    return 0;
+  }
+
+  const char *height_start = end_ptr + 1;
+  unsigned long h = strtoul(height_start, &end_ptr, 10);
+  if (h == 0 || h > UINT_MAX) {
+    return 0;
+  }
+
+  *width = (uint32_t)w;
+  *height = (uint32_t)h;
+
+  // Parse offsets (can be + or -)
+  if (*end_ptr == '\0') {
+    // No offsets specified, default to 0,0
+    *x_offset = 0;
+    *y_offset = 0;
+    return 1;
+  }
+
+  // Parse x offset
+  long x = strtol(end_ptr, &end_ptr, 10);
+  if (x < INT_MIN || x > INT_MAX) {
+    return 0;
+  }
+  *x_offset = (int32_t)x;
+
+  // Parse y offset
+  if (*end_ptr == '\0') {
+    // Only x offset specified, y offset defaults to 0
+    *y_offset = 0;
+    return 1;
+  }
+
+  long y = strtol(end_ptr, &end_ptr, 10);
+  if (y < INT_MIN || y > INT_MAX || *end_ptr != '\0') {
+    return 0;
+  }
+  *y_offset = (int32_t)y;
+
+  return 1;
+}
+
+static void set_string_param(FCVPipelineOp *op, const char *text) {
+  strncpy(op->param_str, text, sizeof(op->param_str) - 1);
+  op->param_str[sizeof(op->param_str) - 1] = '\0';
+  op->has_string_param = 1;
+}
+
+/** Parse one or two numeric parameters, the default for all operations. */
+static bool parse_numbers(char *params, FCVPipelineOp *op) {
+  char *space = strchr(params, ' ');
+  if (space) {
+    *space = '\0';
+    op->param = atof(pipeline_trim_whitespace(params));
+    op->param2 = atof(pipeline_trim_whitespace(space + 1));
+    op->has_param2 = 1;
+  }
+  else {
+    op->param = atof(params);
+  }
+  op->has_param = 1;
+  return true;
+}
+
+static bool parse_string(char *params, FCVPipelineOp *op) {
+  set_string_param(op, params);
+  return true;
+}
+
+static bool parse_no_params(char *params, FCVPipelineOp *op) {
+  (void)params;
+  (void)op;
+  return true;
+}
+
+static bool parse_resize(char *params, FCVPipelineOp *op) {
+  // Percentage format (50% or 50%x80%) or absolute format (200x300)
+  if (strchr(params, '%') || strchr(params, 'x')) {
+    return parse_string(params, op);
+  }
+  // Numeric factors for backward compatibility
+  return parse_numbers(params, op);
+}
+
+/** Parse the parameters of circle and disk: hex_color radius xXy */
+static bool parse_shape(char *params, FCVPipelineOp *op) {
+  char *space = strchr(params, ' ');
+  char *space2 = space ? strchr(pipeline_trim_whitespace(space + 1), ' ')
+                       : NULL;
+  if (!space2) {
+    fprintf(
+      stderr,
+      "Error: %s operation requires: hex_color radius xXy\n",
+      op->operation
+    );
+    return false;
+  }
+  *space = '\0';
+  *space2 = '\0';
+  char *color = pipeline_trim_whitespace(params);
+  double radius = atof(pipeline_trim_whitespace(space + 1));
+
+  // Parse position in format "x×y" or "xxy"
+  char *position = pipeline_trim_whitespace(space2 + 1);
+  char *x_pos = strchr(position, 'x');
+  if (!x_pos) {
+    fprintf(
+      stderr,
+      "Error: %s position must be in format 'xXy' (e.g., '200x150')\n",
+      op->operation
+    );
+    return false;
+  }
+  *x_pos = '\0';
+  double center_x = atof(pipeline_trim_whitespace(position));
+  double center_y = atof(pipeline_trim_whitespace(x_pos + 1));
+
+  // Store color in param_str, radius in param, x,y in param2,param3
+  char combined_params[128];
+  snprintf(
+    combined_params,
+    sizeof(combined_params),
+    "%s %.2f %.2f",
+    color,
+    center_x,
+    center_y
+  );
+  set_string_param(op, combined_params);
+  op->param = radius;
+  op->param2 = center_x;
+  op->param3 = center_y;
+  op->has_param = 1;
+  op->has_param2 = 1;
+  op->has_param3 = 1;
+  return true;
+}
+
+static bool parse_crop(char *params, FCVPipelineOp *op) {
+  uint32_t crop_width, crop_height;
+  int32_t x_offset, y_offset;
+  if (!parse_geometry(
+        params,
+        &crop_width,
+        &crop_height,
+        &x_offset,
+        &y_offset
+      )) {
+    fprintf(
+      stderr,
+      "Error: crop operation requires geometry format (e.g., 50x50+10+20)\n"
+    );
+    return false;
+  }
+  op->param = (double)x_offset;
+  op->param2 = (double)y_offset;
+  op->param3 = (double)crop_width;
+  op->param4 = (double)crop_height;
+  op->has_param = 1;
+  op->has_param2 = 1;
+  op->has_param3 = 1;
+  op->has_param4 = 1;
+  return true;
+}
+
+static bool parse_extract_document_to(char *params, FCVPipelineOp *op) {
+  // Parse output dimensions in format "widthxheight"
+  char *x_pos = strchr(params, 'x');
+  if (!x_pos) {
+    fprintf(
+      stderr,
+      "Error: extract_document_to operation requires format "
+      "'widthxheight' (e.g., 800x600)\n"
+    );
+    return false;
+  }
+  *x_pos = '\0';
+  uint32_t out_width = (uint32_t)atoi(pipeline_trim_whitespace(params));
+  uint32_t out_height = (uint32_t)atoi(pipeline_trim_whitespace(x_pos + 1));
+  if (out_width == 0 || out_height == 0) {
+    fprintf(
+      stderr,
+      "Error: extract_document_to requires positive dimensions\n"
+    );
+    return false;
+  }
+  op->param = (double)out_width;
+  op->param2 = (double)out_height;
+  op->has_param = 1;
+  op->has_param2 = 1;
+  return true;
+}
+
+static bool parse_border(char *params, FCVPipelineOp *op) {
+  char *space = strchr(params, ' ');
+  if (!space) {
+    fprintf(
+      stderr,
+      "Error: border operation requires: hex_color border_width\n"
+    );
+    return false;
+  }
+  *space = '\0';
+  double border_width = atof(pipeline_trim_whitespace(space + 1));
+  if (border_width <= 0) {
+    fprintf(stderr, "Error: border width must be positive\n");
+    return false;
+  }
+  set_string_param(op, pipeline_trim_whitespace(params));
+  op->param = border_width;
+  op->has_param = 1;
+  return true;
+}
+
+static bool parse_trim(char *params, FCVPipelineOp *op) {
+  // Threshold as percentage (2%) or number (interpreted as percentage)
+  if (strchr(params, '%')) {
+    return parse_string(params, op);
+  }
+  op->param = atof(params);
+  op->has_param = 1;
+  return true;
+}
+
+/**
+ * Decode the QR codes of a grayscale image and print them as JSON.
+ */
+static void print_qr_codes(
+  FILE *file,
+  int32_t width,
+  int32_t height,
+  uint8_t const *grayscale_data
+) {
+  FCVQRCodeResult qrs = fcv_decode_qr_codes(width, height, grayscale_data);
+
+  fprintf(file, "  {\n");
+  fprintf(file, "    \"qr_codes\": [");
+  for (size_t i = 0; i < qrs.count; i++) {
+    FCVQRCode *qr = &qrs.codes[i];
+    if (i > 0) {
+      fprintf(file, ",");
+    }
+    fprintf(file, "\n      {\n");
+    fprintf(file, "        \"text\": \"");
+    for (const char *p = qr->text; *p; p++) {
+      switch (*p) {
+      case '"':
+        fprintf(file, "\\\"");
+        break;
+      case '\\':
+        fprintf(file, "\\\\");
+        break;
+      case '\n':
+        fprintf(file, "\\n");
+        break;
+      case '\r':
+        fprintf(file, "\\r");
+        break;
+      case '\t':
+        fprintf(file, "\\t");
+        break;
+      default:
+        fputc(*p, file);
+      }
+    }
+    fprintf(file, "\",\n");
+    fprintf(file, "        \"corners\": {\n");
+    fprintf(
+      file,
+      "          \"top_left\": [%.1f, %.1f],\n",
+      qr->corners.tl_x,
+      qr->corners.tl_y
+    );
+    fprintf(
+      file,
+      "          \"top_right\": [%.1f, %.1f],\n",
+      qr->corners.tr_x,
+      qr->corners.tr_y
+    );
+    fprintf(
+      file,
+      "          \"bottom_right\": [%.1f, %.1f],\n",
+      qr->corners.br_x,
+      qr->corners.br_y
+    );
+    fprintf(
+      file,
+      "          \"bottom_left\": [%.1f, %.1f]\n",
+      qr->corners.bl_x,
+      qr->corners.bl_y
+    );
+    fprintf(file, "        },\n");
+    fprintf(file, "        \"finders\": {\n");
+    fprintf(
+      file,
+      "          \"top_left\": [%.1f, %.1f],\n",
+      qr->finders[0].x,
+      qr->finders[0].y
+    );
+    fprintf(
+      file,
+      "          \"top_right\": [%.1f, %.1f],\n",
+      qr->finders[1].x,
+      qr->finders[1].y
+    );
+    fprintf(
+      file,
+      "          \"bottom_left\": [%.1f, %.1f]\n",
+      qr->finders[2].x,
+      qr->finders[2].y
+    );
+    fprintf(file, "        },\n");
+    fprintf(file, "        \"module_size\": %.2f\n", qr->module_size);
+    fprintf(file, "      }");
+  }
+  if (qrs.count > 0) {
+    fprintf(file, "\n    ");
+  }
+  fprintf(file, "]\n");
+  fprintf(file, "  }\n");
+
+  fcv_free_qr_result(qrs);
+}
+
+/**
+ * Get the scale factors of a resize operation for an image
+ * of the given size. Supported formats: 50%, 50%x80%, 200x300
+ * and numeric parameters.
+ * Returns 0 if the parameters are missing or invalid.
+ */
+static int32_t parse_resize_factors(
+  double param,
+  int32_t has_param,
+  double param2,
+  int32_t has_param2,
+  const char *param_str,
+  int32_t has_string_param,
+  int32_t width,
+  int32_t height,
+  double *resize_x,
+  double *resize_y
+) {
+  if (has_string_param) {
+    char *param_copy = strdup(param_str);
+    if (!param_copy) {
+      return 0;
+    }
+    char *x_pos = strchr(param_copy, 'x');
+
+    if (x_pos) {
+      // Format: 50%x80% or 200x300
+      *x_pos = '\0';
+      char *first_part = pipeline_trim_whitespace(param_copy);
+      char *second_part = pipeline_trim_whitespace(x_pos + 1);
+
+      if (strchr(first_part, '%')) {
+        // Percentage format: 50%x80%
+        *resize_x = atof(first_part) / 100.0;
+        *resize_y = atof(second_part) / 100.0;
+      }
+      else {
+        // Absolute size format: 200x300
+        *resize_x = atof(first_part) / width;
+        *resize_y = atof(second_part) / height;
+      }
+    }
+    else if (strchr(param_copy, '%')) {
+      // Uniform percentage format: 50%
+      *resize_x = *resize_y = atof(param_copy) / 100.0;
+    }
+    else {
+      free(param_copy);
+      return 0;
+    }
+
+    free(param_copy);
+    return 1;
+  }
+
+  if (has_param) {
+    // Backward compatibility: numeric parameters
+    *resize_x = param;
+    *resize_y = has_param2 ? param2 : param;
+    return 1;
+  }
+
+  return 0;
+}
+
+static uint8_t *apply_grayscale(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  return (uint8_t *)fcv_grayscale(*width, *height, data);
+}
+
+static uint8_t *apply_blur(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_param) {
+    fprintf(stderr, "Error: blur operation requires radius parameter\n");
+    return NULL;
+  }
+  return (uint8_t *)
+    fcv_apply_gaussian_blur(*width, *height, op->param, data);
+}
+
+static uint8_t *apply_resize(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  double resize_x, resize_y;
+  if (!parse_resize_factors(
+        op->param,
+        op->has_param,
+        op->param2,
+        op->has_param2,
+        op->param_str,
+        op->has_string_param,
+        *width,
+        *height,
+        &resize_x,
+        &resize_y
+      )) {
+    if (op->has_string_param) {
+      fprintf(stderr, "Error: Invalid resize format '%s'\n", op->param_str);
+    }
+    else {
+      fprintf(stderr, "Error: resize operation requires resize parameter\n");
+    }
+    return NULL;
+  }
+
+  uint32_t out_width, out_height;
+  uint8_t *result = (uint8_t *)fcv_resize(
+    *width,
+    *height,
+    resize_x,
+    resize_y,
+    &out_width,
+    &out_height,
+    data
+  );
+
+  if (result) {
+    *width = out_width;
+    *height = out_height;
+  }
+
+  return result;
+}
+
+static uint8_t *apply_threshold(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  return (uint8_t *)
+    fcv_otsu_threshold_rgba(*width, *height, false, data);
+}
+
+static uint8_t *apply_bw_smart(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  return (uint8_t *)fcv_bw_smart(*width, *height, false, data);
+}
+
+static uint8_t *apply_bw_smooth(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  return (uint8_t *)fcv_bw_smart(*width, *height, true, data);
+}
+
+static uint8_t *apply_detect_corners(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  Corners corners = fcv_detect_corners(data, *width, *height);
+  if (output) {
+    fprintf(output, "  {\n");
+    fprintf(output, "    \"corners\": {\n");
+    fprintf(
+      output,
+      "      \"top_left\": [%.0f, %.0f],\n",
+      corners.tl_x,
+      corners.tl_y
+    );
+    fprintf(
+      output,
+      "      \"top_right\": [%.0f, %.0f],\n",
+      corners.tr_x,
+      corners.tr_y
+    );
+    fprintf(
+      output,
+      "      \"bottom_right\": [%.0f, %.0f],\n",
+      corners.br_x,
+      corners.br_y
+    );
+    fprintf(
+      output,
+      "      \"bottom_left\": [%.0f, %.0f]\n",
+      corners.bl_x,
+      corners.bl_y
+    );
+    fprintf(output, "    }\n");
+    fprintf(output, "  }\n");
+  }
+
+  // Return a copy of the input data without modification
+  uint8_t *result = malloc(*width * *height * 4);
+  if (result) {
+    memcpy(result, data, *width * *height * 4);
+  }
+  return result;
+}
+
+static uint8_t *apply_qr(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  uint8_t *grayscale_data =
+    fcv_rgba_to_grayscale(*width, *height, data);
+  if (!grayscale_data) {
+    return NULL;
+  }
+
+  if (output) {
+    print_qr_codes(output, *width, *height, grayscale_data);
+  }
+  free(grayscale_data);
+
+  // Return a copy of the input data without modification
+  uint8_t *result = malloc((size_t)(*width) * (*height) * 4);
+  if (result) {
+    memcpy(result, data, (size_t)(*width) * (*height) * 4);
+  }
+  return result;
+}
+
+static uint8_t *apply_qr_draw(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  uint8_t *grayscale_data =
+    fcv_rgba_to_grayscale(*width, *height, data);
+  if (!grayscale_data) {
+    return NULL;
+  }
+  FCVQRCodeResult qrs = fcv_decode_qr_codes(*width, *height, grayscale_data);
+  free(grayscale_data);
+
+  uint32_t img_length_byte = (*width) * (*height) * 4;
+  uint8_t *result = malloc(img_length_byte);
+  if (!result) {
+    fcv_free_qr_result(qrs);
+    return NULL;
+  }
+  memcpy(result, data, img_length_byte);
+
+  /* Colour legend for the annotations:
+     - green:   QR outer border (polygon around all modules)
+     - red:     finder-pattern outlines + centres (module 3.5, 3.5)
+     - magenta: alignment-pattern outlines + centres (module 5x5)
+     - yellow:  timing-pattern module centres (row 6 and col 6) */
+  const char *border_color = "00C800";
+  const char *finder_color = "C80000";
+  const char *alignment_color = "C800C8";
+  const char *timing_color = "FFC800";
+
+  for (size_t i = 0; i < qrs.count; i++) {
+    FCVQRCode *qr = &qrs.codes[i];
+    double module = qr->module_size > 0 ? qr->module_size : 1.0;
+    int qr_size = qr->qr_size > 0 ? qr->qr_size : 21;
+    double finder_radius = module * 1.5;
+    double alignment_radius = module * 0.7;
+    double timing_radius = fmax(1.0, module * 0.3);
+    double border_thickness = fmax(1.0, module * 0.25);
+    double outline_thickness = fmax(1.0, module * 0.15);
+
+    /* Module-coordinate → pixel-coordinate projection. Built from the
+       four detected outer corners so we can draw any feature (finders,
+       alignments, timing) by projecting its module-space rectangle. */
+    Corners src_mod = {
+      0.0,
+      0.0,
+      (double)qr_size,
+      0.0,
+      (double)qr_size,
+      (double)qr_size,
+      0.0,
+      (double)qr_size
+    };
+    Matrix3x3 *H =
+      fcv_calculate_perspective_transform(&src_mod, &qr->corners);
+
+    /* Projects module-coordinate (mx, my) to pixel-coordinate (*px, *py)
+       via H. Returns 0 if the projection is degenerate. */
+#define QR_PROJECT(mx, my, px, py)                                             \
+do {                                                                           \
+  double _w = H->m20 * (mx) + H->m21 * (my) + H->m22;                          \
+  if (fabs(_w) < 1e-9) {                                                       \
+    (px) = 0.0;                                                                \
+    (py) = 0.0;                                                                \
+  }                                                                            \
+  else {                                                                       \
+    (px) = (H->m00 * (mx) + H->m01 * (my) + H->m02) / _w;                      \
+    (py) = (H->m10 * (mx) + H->m11 * (my) + H->m12) / _w;                      \
+  }                                                                            \
+} while (0)
+
+    /* Draws a straight line from (x0,y0) to (x1,y1) as overlapping disks
+       of radius `thickness` with the given hex colour. */
+#define QR_DRAW_SEGMENT(x0, y0, x1, y1, color, thickness)                      \
+do {                                                                           \
+  double _dx = (x1) - (x0);                                                    \
+  double _dy = (y1) - (y0);                                                    \
+  double _len = hypot(_dx, _dy);                                               \
+  int _steps = (int)ceil(_len);                                                \
+  if (_steps < 1) {                                                            \
+    _steps = 1;                                                                \
+  }                                                                            \
+  for (int _s = 0; _s <= _steps; _s++) {                                       \
+    double _t = (double)_s / (double)_steps;                                   \
+    fcv_draw_disk(                                                             \
+      *width,                                                                  \
+      *height,                                                                 \
+      4,                                                                       \
+      color,                                                                   \
+      thickness,                                                               \
+      (x0) + _t * _dx,                                                         \
+      (y0) + _t * _dy,                                                         \
+      result                                                                   \
+    );                                                                         \
+  }                                                                            \
+} while (0)
+
+    /* Draws the pixel-projected rectangle (mx0,my0)-(mx1,my1) in module
+       coordinates, outlined with the given colour and thickness. */
+#define QR_DRAW_MODULE_RECT(mx0, my0, mx1, my1, color, thickness)              \
+do {                                                                           \
+  double _c[4][2];                                                             \
+  QR_PROJECT((mx0), (my0), _c[0][0], _c[0][1]);                                \
+  QR_PROJECT((mx1), (my0), _c[1][0], _c[1][1]);                                \
+  QR_PROJECT((mx1), (my1), _c[2][0], _c[2][1]);                                \
+  QR_PROJECT((mx0), (my1), _c[3][0], _c[3][1]);                                \
+  for (int _e = 0; _e < 4; _e++) {                                             \
+    int _e2 = (_e + 1) % 4;                                                    \
+    QR_DRAW_SEGMENT(                                                           \
+      _c[_e][0],                                                               \
+      _c[_e][1],                                                               \
+      _c[_e2][0],                                                              \
+      _c[_e2][1],                                                              \
+      color,                                                                   \
+      thickness                                                                \
+    );                                                                         \
+  }                                                                            \
+} while (0)
+
+    /* Outer border: connect the four detected corners directly (no
+       projection — these are pixel coords already). */
+    double xs[4] = {
+      qr->corners.tl_x,
+      qr->corners.tr_x,
+      qr->corners.br_x,
+      qr->corners.bl_x,
+    };
+    double ys[4] = {
+      qr->corners.tl_y,
+      qr->corners.tr_y,
+      qr->corners.br_y,
+      qr->corners.bl_y,
+    };
+    for (int e = 0; e < 4; e++) {
+      int e2 = (e + 1) % 4;
+      QR_DRAW_SEGMENT(
+        xs[e],
+        ys[e],
+        xs[e2],
+        ys[e2],
+        border_color,
+        border_thickness
+      );
+    }
+
+    /* Finder patterns: 7x7 module squares at TL, TR, BL. Outlined, and
+       the detected pixel centre drawn as a filled red disk. */
+    double finder_origins[3][2] = {
+      {0.0, 0.0},
+      {(double)(qr_size - 7), 0.0},
+      {0.0, (double)(qr_size - 7)}
+    };
+    for (int f = 0; f < 3; f++) {
+      QR_DRAW_MODULE_RECT(
+        finder_origins[f][0],
+        finder_origins[f][1],
+        finder_origins[f][0] + 7.0,
+        finder_origins[f][1] + 7.0,
+        finder_color,
+        outline_thickness
+      );
+      fcv_draw_disk(
+        *width,
+        *height,
+        4,
+        finder_color,
+        finder_radius,
+        qr->finders[f].x,
+        qr->finders[f].y,
+        result
+      );
+    }
+
+    /* Alignment patterns: 5x5 module squares centred at each detected
+       alignment location. The result struct carries pixel-space
+       centres only (not module indices), so draw a screen-aligned
+       5-module box — this matches the actual snap point under any
+       moderate perspective distortion. */
+    for (size_t a = 0; a < qr->alignment_count; a++) {
+      double cx = qr->alignments[a].x;
+      double cy = qr->alignments[a].y;
+      double pts[4][2] = {
+        {cx - 2.5 * module, cy - 2.5 * module},
+        {cx + 2.5 * module, cy - 2.5 * module},
+        {cx + 2.5 * module, cy + 2.5 * module},
+        {cx - 2.5 * module, cy + 2.5 * module}
+      };
+      for (int e = 0; e < 4; e++) {
+        int e2 = (e + 1) % 4;
+        QR_DRAW_SEGMENT(
+          pts[e][0],
+          pts[e][1],
+          pts[e2][0],
+          pts[e2][1],
+          alignment_color,
+          outline_thickness
+        );
+      }
+      fcv_draw_disk(
+        *width,
+        *height,
+        4,
+        alignment_color,
+        alignment_radius,
+        cx,
+        cy,
+        result
+      );
+    }
+
+    /* Timing patterns: every module centre along row 6 cols 8..qr_size-9
+       and col 6 rows 8..qr_size-9 (the interior cells, excluding the
+       7-module finder blocks and their separators). Module centre of
+       (col, row) is (col + 0.5, row + 0.5). */
+    for (int col = 8; col <= qr_size - 9; col++) {
+      double px, py;
+      QR_PROJECT((double)col + 0.5, 6.5, px, py);
+      fcv_draw_disk(
+        *width,
+        *height,
+        4,
+        timing_color,
+        timing_radius,
+        px,
+        py,
+        result
+      );
+    }
+    for (int row = 8; row <= qr_size - 9; row++) {
+      double px, py;
+      QR_PROJECT(6.5, (double)row + 0.5, px, py);
+      fcv_draw_disk(
+        *width,
+        *height,
+        4,
+        timing_color,
+        timing_radius,
+        px,
+        py,
+        result
+      );
+    }
+
+    if (output) {
+      fprintf(
+        output,
+        "  QR code %zu: v%d (%dx%d modules), %zu alignment pattern%s: \"%s\"\n",
+        i + 1,
+        qr->version,
+        qr_size,
+        qr_size,
+        qr->alignment_count,
+        qr->alignment_count == 1 ? "" : "s",
+        qr->text
+      );
+    }
+
+    /* fcv_calculate_perspective_transform may return a static identity
+       fallback on failure — only free heap-allocated results. The only
+       stable heap result has m22 == 1.0 and non-identity content; the
+       fallback is exactly the identity matrix. */
+    if (H && !(H->m00 == 1.0 && H->m01 == 0.0 && H->m02 == 0.0 &&
+               H->m10 == 0.0 && H->m11 == 1.0 && H->m12 == 0.0 &&
+               H->m20 == 0.0 && H->m21 == 0.0 && H->m22 == 1.0)) {
+      free(H);
+    }
+
+#undef QR_PROJECT
+#undef QR_DRAW_SEGMENT
+#undef QR_DRAW_MODULE_RECT
+  }
+
+  fcv_free_qr_result(qrs);
+  return result;
+}
+
+static uint8_t *apply_draw_corners(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  Corners cs = fcv_detect_corners(data, *width, *height);
+  if (output) {
+    fprintf(output, "  Detected corners:\n");
+    fprintf(output, "    Top-left:     (%.0f, %.0f)\n", cs.tl_x, cs.tl_y);
+    fprintf(output, "    Top-right:    (%.0f, %.0f)\n", cs.tr_x, cs.tr_y);
+    fprintf(output, "    Bottom-right: (%.0f, %.0f)\n", cs.br_x, cs.br_y);
+    fprintf(output, "    Bottom-left:  (%.0f, %.0f)\n", cs.bl_x, cs.bl_y);
+  }
+
+  // Create a copy of the input data and draw disks at detected corners
+  uint32_t img_length_byte = (*width) * (*height) * 4;
+  uint8_t *result = malloc(img_length_byte);
+  if (!result) {
+    return NULL;
+  }
+  memcpy(result, data, img_length_byte);
+
+  // Draw disks using red color and `radius`
+  const double radius = fmin(*width, *height) * 0.02;
+  const char *red = "FF0000";
+  fcv_draw_disk(*width, *height, 4, red, radius, cs.tl_x, cs.tl_y, result);
+  fcv_draw_disk(*width, *height, 4, red, radius, cs.tr_x, cs.tr_y, result);
+  fcv_draw_disk(*width, *height, 4, red, radius, cs.br_x, cs.br_y, result);
+  fcv_draw_disk(*width, *height, 4, red, radius, cs.bl_x, cs.bl_y, result);
+
+  return result;
+}
+
+static uint8_t *apply_sobel(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  uint8_t *grayscale_sobel =
+    fcv_sobel_edge_detection(*width, *height, 4, data);
+  if (!grayscale_sobel) {
+    return NULL;
+  }
+
+  // Convert single-channel grayscale to RGBA format
+  uint8_t *rgba_result =
+    fcv_single_to_multichannel(*width, *height, grayscale_sobel);
+  free(grayscale_sobel);
+  return (uint8_t *)rgba_result;
+}
+
+static uint8_t *apply_circle(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_string_param || !op->has_param || !op->has_param2 ||
+      !op->has_param3) {
+    fprintf(
+      stderr,
+      "Error: circle operation requires: hex_color radius xXy\n"
+    );
+    return NULL;
+  }
+  // Parse color and coordinates from op->param_str
+  char *param_copy = strdup(op->param_str);
+  char *saveptr;
+  char *color = strtok_r(param_copy, " ", &saveptr);
+  double center_x = op->param2;
+  double center_y = op->param3;
+  double radius = op->param;
+
+  uint32_t img_length_byte = (*width) * (*height) * 4;
+  uint8_t *result = malloc(img_length_byte);
+  if (!result) {
+    free(param_copy);
+    return NULL;
+  }
+  memcpy(result, data, img_length_byte);
+
+  fcv_draw_circle(
+    *width,
+    *height,
+    4,
+    color,
+    radius,
+    center_x,
+    center_y,
+    result
+  );
+
+  free(param_copy);
+  return result;
+}
+
+static uint8_t *apply_disk(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_string_param || !op->has_param || !op->has_param2 ||
+      !op->has_param3) {
+    fprintf(stderr, "Error: disk operation requires: hex_color radius xXy\n");
+    return NULL;
+  }
+  // Parse color and coordinates from op->param_str
+  char *param_copy = strdup(op->param_str);
+  char *saveptr;
+  char *color = strtok_r(param_copy, " ", &saveptr);
+  double center_x = op->param2;
+  double center_y = op->param3;
+  double radius = op->param;
+
+  uint32_t img_length_byte = (*width) * (*height) * 4;
+  uint8_t *result = malloc(img_length_byte);
+  if (!result) {
+    free(param_copy);
+    return NULL;
+  }
+  memcpy(result, data, img_length_byte);
+
+  fcv_draw_disk(
+    *width,
+    *height,
+    4,
+    color,
+    radius,
+    center_x,
+    center_y,
+    result
+  );
+
+  free(param_copy);
+  return result;
+}
+
+static uint8_t *apply_watershed(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_string_param) {
+    fprintf(
+      stderr,
+      "Error: watershed operation requires marker coordinates\n"
+    );
+    return NULL;
+  }
+
+  // Parse marker coordinates from op->param_str: "x1×y1 x2×y2 ..."
+  char *param_copy = strdup(op->param_str);
+
+  // Count number of markers by counting spaces + 1
+  int32_t num_markers = 1;
+  for (char *p = param_copy; *p; p++) {
+    if (*p == ' ') {
+      num_markers++;
+    }
+  }
+
+  Point2D *markers = malloc(num_markers * sizeof(Point2D));
+  if (!markers) {
+    free(param_copy);
+    return NULL;
+  }
+
+  // Parse each marker
+  char *saveptr;
+  char *token = strtok_r(param_copy, " ", &saveptr);
+  int32_t marker_idx = 0;
+
+  while (token && marker_idx < num_markers) {
+    char *x_pos = strchr(token, 'x');
+    if (x_pos) {
+      *x_pos = '\0';
+      markers[marker_idx].x = atof(pipeline_trim_whitespace(token));
+      markers[marker_idx].y = atof(pipeline_trim_whitespace(x_pos + 1));
+      marker_idx++;
+    }
+    token = strtok_r(NULL, " ", &saveptr);
+  }
+
+  if (marker_idx == 0) {
+    fprintf(
+      stderr,
+      "Error: No valid markers found in format 'x1×y1 x2×y2 ...'\n"
+    );
+    free(markers);
+    free(param_copy);
+    return NULL;
+  }
+
+  // Convert RGBA to single-channel grayscale for watershed segmentation
+  uint8_t *grayscale_data =
+    fcv_rgba_to_grayscale(*width, *height, data);
+  if (!grayscale_data) {
+    free(markers);
+    free(param_copy);
+    return NULL;
+  }
+
+  uint8_t *result = (uint8_t *)fcv_watershed_segmentation(
+    *width,
+    *height,
+    grayscale_data,
+    markers,
+    marker_idx,
+    false
+  );
+  free(grayscale_data);
+
+  free(markers);
+  free(param_copy);
+  return result;
+}
+
+static uint8_t *apply_crop(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_param || !op->has_param2 || !op->has_param3 || !op->has_param4) {
+    fprintf(
+      stderr,
+      "Error: crop operation requires geometry format (e.g., 50x50+10+20)\n"
+    );
+    return NULL;
+  }
+  // op->param and op->param2 are x_offset and y_offset (can be negative)
+  // op->param3 and op->param4 are crop_width and crop_height
+  int32_t x_offset = (int32_t)op->param;
+  int32_t y_offset = (int32_t)op->param2;
+  uint32_t crop_width = (uint32_t)op->param3;
+  uint32_t crop_height = (uint32_t)op->param4;
+
+  // Clamp negative offsets to 0
+  uint32_t x = (x_offset < 0) ? 0 : (uint32_t)x_offset;
+  uint32_t y = (y_offset < 0) ? 0 : (uint32_t)y_offset;
+
+  // Ensure crop area doesn't exceed image bounds
+  if (x >= (uint32_t)*width || y >= (uint32_t)*height) {
+    fprintf(stderr, "Error: crop offset is outside image bounds\n");
+    return NULL;
+  }
+
+  // Adjust crop dimensions if they would exceed image bounds
+  uint32_t max_width = *width - x;
+  uint32_t max_height = *height - y;
+  if (crop_width > max_width) {
+    crop_width = max_width;
+  }
+  if (crop_height > max_height) {
+    crop_height = max_height;
+  }
+
+  uint8_t *result =
+    fcv_crop(*width, *height, 4, data, x, y, crop_width, crop_height);
+  if (result) {
+    *width = crop_width;
+    *height = crop_height;
+  }
+  return result;
+}
+
+static uint8_t *apply_extract_document(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  // Auto-size version
+  uint32_t output_width, output_height;
+  uint8_t *result = fcv_extract_document_auto(
+    *width,
+    *height,
+    data,
+    &output_width,
+    &output_height
+  );
+
+  if (result) {
+    *width = output_width;
+    *height = output_height;
+  }
+
+  return result;
+}
+
+static uint8_t *apply_extract_document_to(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_param || !op->has_param2) {
+    fprintf(
+      stderr,
+      "Error: extract_document_to operation requires output dimensions\n"
+    );
+    return NULL;
+  }
+
+  uint32_t output_width = (uint32_t)op->param;
+  uint32_t output_height = (uint32_t)op->param2;
+
+  uint8_t *result = fcv_extract_document(
+    *width,
+    *height,
+    data,
+    output_width,
+    output_height
+  );
+
+  if (result) {
+    *width = output_width;
+    *height = output_height;
+  }
+
+  return result;
+}
+
+static uint8_t *apply_flip_x(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  return (uint8_t *)fcv_flip_x(*width, *height, data);
+}
+
+static uint8_t *apply_flip_y(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  return (uint8_t *)fcv_flip_y(*width, *height, data);
+}
+
+static uint8_t *apply_transpose(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  uint8_t *result = fcv_transpose(*width, *height, data);
+  if (result) {
+    int32_t old_width = *width;
+    *width = *height;
+    *height = old_width;
+  }
+  return result;
+}
+
+static uint8_t *apply_transverse(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  uint8_t *result = fcv_transverse(*width, *height, data);
+  if (result) {
+    int32_t old_width = *width;
+    *width = *height;
+    *height = old_width;
+  }
+  return result;
+}
+
+static uint8_t *apply_rotate(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_param) {
+    fprintf(stderr, "Error: rotate requires an angle parameter\n");
+    return NULL;
+  }
+  // Multiples of 90 are exact, other angles are interpolated bilinearly
+  // on a canvas that is expanded to fit the whole rotated image
+  uint32_t out_width = 0;
+  uint32_t out_height = 0;
+  uint8_t *result = fcv_rotate_angle(
+    *width,
+    *height,
+    data,
+    op->param,
+    FCV_INTERPOLATION_BILINEAR,
+    true,
+    &out_width,
+    &out_height
+  );
+  if (result) {
+    *width = out_width;
+    *height = out_height;
+  }
+  return result;
+}
+
+static uint8_t *apply_deskew(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  uint32_t out_width = 0;
+  uint32_t out_height = 0;
+  FCVSkewEstimate estimate = {0.0, 0.0};
+  uint8_t *result = fcv_deskew(
+    *width,
+    *height,
+    data,
+    &out_width,
+    &out_height,
+    &estimate
+  );
+  if (output) {
+    fprintf(
+      output,
+      "  Detected skew: %.2f° (confidence: %.2f)\n",
+      estimate.angle,
+      estimate.confidence
+    );
+  }
+  if (result) {
+    *width = out_width;
+    *height = out_height;
+  }
+  return result;
+}
+
+static uint8_t *apply_trim(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (op->has_string_param && strchr(op->param_str, '%')) {
+    // Trim with threshold percentage
+    double threshold = atof(op->param_str);
+    return (uint8_t *)
+      fcv_trim_threshold(width, height, 4, data, threshold);
+  }
+  else if (op->has_param) {
+    // Trim with threshold as numeric parameter
+    return (uint8_t *)fcv_trim_threshold(width, height, 4, data, op->param);
+  }
+  else {
+    // Default trim without threshold
+    return (uint8_t *)fcv_trim(width, height, 4, data);
+  }
+}
+
+static uint8_t *apply_histogram(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  uint32_t hist_width, hist_height;
+  uint8_t *result = fcv_generate_histogram(
+    *width,
+    *height,
+    4,
+    data,
+    &hist_width,
+    &hist_height
+  );
+  if (result) {
+    *width = hist_width;
+    *height = hist_height;
+  }
+  return result;
+}
+
+static uint8_t *apply_border(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  if (!op->has_string_param || !op->has_param) {
+    fprintf(
+      stderr,
+      "Error: border operation requires: hex_color border_width\n"
+    );
+    return NULL;
+  }
+
+  uint32_t border_width = (uint32_t)op->param;
+  uint32_t output_width, output_height;
+
+  uint8_t *result = fcv_add_border(
+    *width,
+    *height,
+    4,
+    op->param_str,
+    border_width,
+    (uint8_t *)data,
+    &output_width,
+    &output_height
+  );
+
+  if (result) {
+    *width = output_width;
+    *height = output_height;
+  }
+
+  return result;
+}
+
+/**
+ * Apply a binary morphology operation with a disk of radius `param`
+ * to the grayscale image and convert the result back to RGBA.
+ */
+static uint8_t *apply_morphology(
+  int32_t width,
+  int32_t height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *(*morphology)(uint8_t const *, int32_t, int32_t, int32_t)
+) {
+  if (!op->has_param) {
+    fprintf(
+      stderr,
+      "Error: %s operation requires radius parameter\n",
+      op->operation
+    );
+    return NULL;
+  }
+
+  // Convert RGBA to grayscale for binary morphology
+  uint8_t *grayscale_data = fcv_rgba_to_grayscale(width, height, data);
+  if (!grayscale_data) {
+    return NULL;
+  }
+
+  uint8_t *morphed =
+    morphology(grayscale_data, width, height, (int32_t)op->param);
+  free(grayscale_data);
+
+  if (!morphed) {
+    return NULL;
+  }
+
+  // Convert back to RGBA
+  uint8_t *result = fcv_single_to_multichannel(width, height, morphed);
+  free(morphed);
+  return result;
+}
+
+static uint8_t *apply_erode(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  return apply_morphology(*width, *height, op, data, fcv_binary_erosion_disk);
+}
+
+static uint8_t *apply_dilate(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  return apply_morphology(*width, *height, op, data, fcv_binary_dilation_disk);
+}
+
+static uint8_t *apply_close(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  return apply_morphology(*width, *height, op, data, fcv_binary_closing_disk);
+}
+
+static uint8_t *apply_open(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)output;
+  return apply_morphology(*width, *height, op, data, fcv_binary_opening_disk);
+}
+
+// A pending EXIF orientation is stored as the transform from the decoded
+// image to the displayed one: an optional transpose followed by flips.
+#define ORIENTATION_FLIP_X 1
+#define ORIENTATION_FLIP_Y 2
+#define ORIENTATION_TRANSPOSE 4
+
+static const int32_t orientation_from_exif[9] = {0, 0, 1, 3, 2, 4, 5, 7, 6};
+static const int32_t orientation_to_exif[8] = {1, 2, 4, 3, 5, 6, 8, 7};
+
+/**
+ * Apply an EXIF orientation (1-8) to an image.
+ * Flips and 180° rotations are done in place and return the input,
+ * the other orientations return a new image.
+ * Returns NULL if memory ran out.
+ */
+static uint8_t *apply_exif_orientation(
+  int32_t *width,
+  int32_t *height,
+  int32_t exif_orientation,
+  uint8_t *data
+) {
+  uint32_t old_width = (uint32_t)*width;
+  uint32_t old_height = (uint32_t)*height;
+  uint8_t *result = NULL;
+
+  switch (exif_orientation) {
+  case 2: // Flip Horizontal
+    fcv_flip_x_in_place(old_width, old_height, data);
+    return data;
+  case 3: // 180 degrees
+    fcv_rotate_180_in_place(old_width, old_height, data);
+    return data;
+  case 4: // Flip Vertical
+    fcv_flip_y_in_place(old_width, old_height, data);
+    return data;
+  case 5: // Transpose
+    result = fcv_transpose(old_width, old_height, data);
+    break;
+  case 6: // 90 degrees CW
+    result = fcv_rotate_90_cw(old_width, old_height, data);
+    break;
+  case 7: // Transverse
+    result = fcv_transverse(old_width, old_height, data);
+    break;
+  case 8: // 270 degrees CW
+    result = fcv_rotate_270_cw(old_width, old_height, data);
+    break;
+  default:
+    return data;
+  }
+
+  if (result) {
+    *width = (int32_t)old_height;
+    *height = (int32_t)old_width;
+  }
+  return result;
+}
+
+/**
+ * Absorb flips and rotations by multiples of 90° into the pending
+ * orientation, so they don't have to touch any pixels.
+ * Returns 0 if the operation must be applied to the image.
+ */
+static int32_t
+fold_into_orientation(int32_t *orientation, const FCVPipelineOp *op) {
+  if (strcmp(op->operation, "flip_x") == 0) {
+    *orientation ^= ORIENTATION_FLIP_X;
+    return 1;
+  }
+  if (strcmp(op->operation, "flip_y") == 0) {
+    *orientation ^= ORIENTATION_FLIP_Y;
+    return 1;
+  }
+  if (strcmp(op->operation, "transpose") == 0 ||
+      strcmp(op->operation, "transverse") == 0) {
+    // Mirroring along a diagonal swaps the axes of the flips
+    int32_t flip_x = *orientation & ORIENTATION_FLIP_X;
+    int32_t flip_y = *orientation & ORIENTATION_FLIP_Y;
+    *orientation = (*orientation ^ ORIENTATION_TRANSPOSE) &
+                   ORIENTATION_TRANSPOSE;
+    *orientation |= flip_y ? ORIENTATION_FLIP_X : 0;
+    *orientation |= flip_x ? ORIENTATION_FLIP_Y : 0;
+    if (strcmp(op->operation, "transverse") == 0) {
+      *orientation ^= ORIENTATION_FLIP_X | ORIENTATION_FLIP_Y;
+    }
+    return 1;
+  }
+  if (strcmp(op->operation, "rotate") == 0 && op->has_param &&
+      isfinite(op->param) && fmod(op->param, 90.0) == 0) {
+    int32_t quarter_turns = ((int32_t)fmod(op->param, 360.0) / 90 + 4) % 4;
+    for (int32_t i = 0; i < quarter_turns; i++) {
+      // Rotating the displayed image clockwise transposes it
+      // and moves a vertical flip to the horizontal axis and vice versa
+      int32_t flip_x = *orientation & ORIENTATION_FLIP_X;
+      int32_t flip_y = *orientation & ORIENTATION_FLIP_Y;
+      *orientation = (*orientation ^ ORIENTATION_TRANSPOSE) &
+                     ORIENTATION_TRANSPOSE;
+      *orientation |= flip_y ? 0 : ORIENTATION_FLIP_X;
+      *orientation |= flip_x ? ORIENTATION_FLIP_Y : 0;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Rewrite an operation on the displayed image into the same operation
+ * on the decoded image, so the pending orientation can be applied
+ * after it on a smaller image. Crop rectangles are mirrored and
+ * transposed, resize factors are swapped, and per-pixel operations
+ * are unaffected. Width and height are the ones of the decoded image.
+ *
+ * Crops and per-pixel operations give exactly the same pixels as
+ * applying the orientation first. The sampling positions of fcv_resize
+ * are not mirror-symmetric, so resizes are only mapped through
+ * a transpose (see apply_pending_flips), which gives the same pixels
+ * up to rounding.
+ * Returns 0 if the operation needs the oriented image.
+ */
+static int32_t map_operation_to_decoded(
+  FCVPipelineOp *op,
+  int32_t orientation,
+  int32_t width,
+  int32_t height
+) {
+  int32_t is_transposed = orientation & ORIENTATION_TRANSPOSE;
+  int32_t display_width = is_transposed ? height : width;
+  int32_t display_height = is_transposed ? width : height;
+
+  if (strcmp(op->operation, "grayscale") == 0 ||
+      strcmp(op->operation, "threshold") == 0) {
+    return 1;
+  }
+
+  if (strcmp(op->operation, "resize") == 0) {
+    if (orientation & (ORIENTATION_FLIP_X | ORIENTATION_FLIP_Y)) {
+      return 0;
+    }
+    double resize_x, resize_y;
+    if (!parse_resize_factors(
+          op->param,
+          op->has_param,
+          op->param2,
+          op->has_param2,
+          op->param_str,
+          op->has_string_param,
+          display_width,
+          display_height,
+          &resize_x,
+          &resize_y
+        )) {
+      return 0;
+    }
+    op->param = is_transposed ? resize_y : resize_x;
+    op->param2 = is_transposed ? resize_x : resize_y;
+    op->has_param = 1;
+    op->has_param2 = 1;
+    op->has_string_param = 0;
+    return 1;
+  }
+
+  if (strcmp(op->operation, "crop") == 0) {
+    if (!op->has_param || !op->has_param2 || !op->has_param3 ||
+        !op->has_param4) {
+      return 0;
+    }
+    // Clamp the rectangle like the crop operation
+    uint32_t x = op->param < 0 ? 0 : (uint32_t)op->param;
+    uint32_t y = op->param2 < 0 ? 0 : (uint32_t)op->param2;
+    if (x >= (uint32_t)display_width || y >= (uint32_t)display_height) {
+      return 0;
+    }
+    uint32_t crop_width = (uint32_t)op->param3;
+    uint32_t crop_height = (uint32_t)op->param4;
+    if (crop_width > (uint32_t)display_width - x) {
+      crop_width = (uint32_t)display_width - x;
+    }
+    if (crop_height > (uint32_t)display_height - y) {
+      crop_height = (uint32_t)display_height - y;
+    }
+
+    if (orientation & ORIENTATION_FLIP_X) {
+      x = (uint32_t)display_width - x - crop_width;
+    }
+    if (orientation & ORIENTATION_FLIP_Y) {
+      y = (uint32_t)display_height - y - crop_height;
+    }
+    op->param = is_transposed ? y : x;
+    op->param2 = is_transposed ? x : y;
+    op->param3 = is_transposed ? crop_height : crop_width;
+    op->param4 = is_transposed ? crop_width : crop_height;
+    return 1;
+  }
+
+  return 0;
+}
+
+// Enough for the name, the string and the 4 numbers of any operation
+#define OPERATION_TEXT_SIZE 192
+
+/**
+ * Compute the size of the image after an operation.
+ * Returns 0 if it is only known after executing the operation
+ * (e.g. for trim) or if the operation would fail.
+ */
+static int32_t plan_output_size(
+  FCVPipelineOp const *op,
+  int32_t *width,
+  int32_t *height
+) {
+  if (op->definition && op->definition->flags & FCV_OPERATION_SAME_SIZE) {
+    return 1;
+  }
+
+  int32_t orientation = 0;
+  if (fold_into_orientation(&orientation, op)) {
+    if (orientation & ORIENTATION_TRANSPOSE) {
+      int32_t old_width = *width;
+      *width = *height;
+      *height = old_width;
+    }
+    return 1;
+  }
+
+  // Without an orientation, crops are only clamped
+  // and resizes are converted to factors
+  FCVPipelineOp clamped = *op;
+  if ((strcmp(op->operation, "crop") != 0 &&
+       strcmp(op->operation, "resize") != 0) ||
+      !map_operation_to_decoded(&clamped, 0, *width, *height)) {
+    return 0;
+  }
+
+  if (strcmp(op->operation, "crop") == 0) {
+    *width = (int32_t)clamped.param3;
+    *height = (int32_t)clamped.param4;
+    return 1;
+  }
+
+  // Same rounding as fcv_resize
+  double new_width = *width * clamped.param;
+  double new_height = *height * clamped.param2;
+  if (!(new_width >= 1 && new_height >= 1 && new_width <= INT32_MAX &&
+        new_height <= INT32_MAX)) {
+    return 0;
+  }
+  *width = (int32_t)new_width;
+  *height = (int32_t)new_height;
+  return 1;
+}
+
+/**
+ * Check if an operation converts the image to grayscale first,
+ * with the same weights as the grayscale operation.
+ */
+static int32_t starts_with_grayscale(FCVPipelineOp const *op) {
+  return op->definition && op->definition->flags & FCV_OPERATION_STARTS_GRAY;
+}
+
+/** Reset an operation to the one with the given name without parameters. */
+static void set_operation(FCVPipelineOp *op, const char *name) {
+  memset(op, 0, sizeof(*op));
+  strcpy(op->operation, name);
+  op->definition = fcv_find_operation(name);
+}
+
+/**
+ * Set an operation to the flip or rotation
+ * with the given orientation (1-7).
+ */
+static void
+set_orientation_operation(FCVPipelineOp *op, int32_t orientation) {
+  static const char *const names[8] = {
+    "",
+    "flip_x",
+    "flip_y",
+    "rotate",
+    "transpose",
+    "rotate",
+    "rotate",
+    "transverse",
+  };
+  static const double angles[8] = {0, 0, 0, 180, 0, 90, 270, 0};
+
+  set_operation(op, names[orientation]);
+  op->param = angles[orientation];
+  op->has_param = angles[orientation] != 0;
+}
+
+static void remove_operation(FCVPipeline *pipeline, int32_t index) {
+  memmove(
+    &pipeline->ops[index],
+    &pipeline->ops[index + 1],
+    sizeof(FCVPipelineOp) * (pipeline->count - index - 1)
+  );
+  pipeline->count--;
+}
+
+/**
+ * Write an operation in the syntax of the pipeline to a buffer
+ * of OPERATION_TEXT_SIZE bytes.
+ */
+static void format_operation(FCVPipelineOp const *op, char *text) {
+  int32_t length = snprintf(text, OPERATION_TEXT_SIZE, "%s", op->operation);
+  if (strcmp(op->operation, "crop") == 0 && op->has_param4) {
+    snprintf(
+      text + length,
+      OPERATION_TEXT_SIZE - length,
+      " %gx%g%+g%+g",
+      op->param3,
+      op->param4,
+      op->param,
+      op->param2
+    );
+    return;
+  }
+  if (op->has_string_param) {
+    length += snprintf(
+      text + length,
+      OPERATION_TEXT_SIZE - length,
+      " %s",
+      op->param_str
+    );
+  }
+  double const params[4] = {op->param, op->param2, op->param3, op->param4};
+  int32_t const has_params[4] =
+    {op->has_param, op->has_param2, op->has_param3, op->has_param4};
+  for (int32_t i = 0; i < 4 && has_params[i]; i++) {
+    length +=
+      snprintf(text + length, OPERATION_TEXT_SIZE - length, " %g", params[i]);
+  }
+}
+
+static void print_pipeline(FILE *file, FCVPipeline const *pipeline) {
+  char text[OPERATION_TEXT_SIZE];
+  for (int32_t i = 0; i < pipeline->count; i++) {
+    format_operation(&pipeline->ops[i], text);
+    fprintf(file, "%s%s", i > 0 ? ", " : "", text);
+  }
+  fprintf(file, "\n");
+}
+
+/**
+ * Apply the first possible rewrite of plan_pipeline.
+ * Width and height are the ones of the image before the pipeline.
+ * Returns 0 if there is nothing left to rewrite.
+ */
+static int32_t plan_step(
+  FCVPipeline *pipeline,
+  int32_t width,
+  int32_t height,
+  char *description,
+  size_t description_size
+) {
+  int32_t is_size_known = 1;
+  char op_text[OPERATION_TEXT_SIZE];
+  char next_text[OPERATION_TEXT_SIZE];
+
+  for (int32_t i = 0; i + 1 < pipeline->count; i++) {
+    FCVPipelineOp *op = &pipeline->ops[i];
+    FCVPipelineOp *next = &pipeline->ops[i + 1];
+    format_operation(op, op_text);
+    format_operation(next, next_text);
+
+    // The next operation converts to grayscale on its own
+    if (strcmp(op->operation, "grayscale") == 0 &&
+        starts_with_grayscale(next)) {
+      snprintf(
+        description,
+        description_size,
+        "Removed grayscale before %s, which converts to grayscale itself",
+        next_text
+      );
+      remove_operation(pipeline, i);
+      return 1;
+    }
+
+    // Compose flips and rotations into a single permutation of the pixels
+    int32_t orientation = 0;
+    int32_t is_permutation = fold_into_orientation(&orientation, op);
+    int32_t composed = orientation;
+    if (is_permutation && fold_into_orientation(&composed, next)) {
+      int32_t length = snprintf(
+        description,
+        description_size,
+        "Composed %s and %s",
+        op_text,
+        next_text
+      );
+      remove_operation(pipeline, i + 1);
+      if (composed == 0) {
+        snprintf(
+          description + length,
+          description_size - length,
+          ", which cancel each other out"
+        );
+        remove_operation(pipeline, i);
+      }
+      else {
+        set_orientation_operation(op, composed);
+        format_operation(op, op_text);
+        snprintf(
+          description + length,
+          description_size - length,
+          " into %s",
+          op_text
+        );
+      }
+      return 1;
+    }
+
+    if (is_size_known && strcmp(next->operation, "crop") == 0) {
+      FCVPipelineOp crop = *next;
+      if (strcmp(op->operation, "crop") == 0) {
+        // Crop the clamped rectangle of the second crop out of the first one
+        FCVPipelineOp first = *op;
+        if (map_operation_to_decoded(&first, 0, width, height) &&
+            map_operation_to_decoded(
+              &crop,
+              0,
+              (int32_t)first.param3,
+              (int32_t)first.param4
+            )) {
+          crop.param += first.param;
+          crop.param2 += first.param2;
+          format_operation(&crop, next_text);
+          snprintf(
+            description,
+            description_size,
+            "Merged %s and the following crop into %s",
+            op_text,
+            next_text
+          );
+          *op = crop;
+          remove_operation(pipeline, i + 1);
+          return 1;
+        }
+      }
+      else if (strcmp(op->operation, "grayscale") == 0 ||
+               (is_permutation &&
+                map_operation_to_decoded(&crop, orientation, width, height))) {
+        // Only the cropped pixels need to be converted or moved
+        snprintf(
+          description,
+          description_size,
+          "Moved %s before %s",
+          next_text,
+          op_text
+        );
+        *next = *op;
+        *op = crop;
+        return 1;
+      }
+    }
+
+    if (is_size_known && strcmp(op->operation, "resize") == 0 &&
+        strcmp(next->operation, "resize") == 0) {
+      int32_t resized_width = width;
+      int32_t resized_height = height;
+      if (plan_output_size(op, &resized_width, &resized_height) &&
+          plan_output_size(next, &resized_width, &resized_height)) {
+        // Resample once to the final size of the two resizes
+        double resize_x = (double)resized_width / width;
+        double resize_y = (double)resized_height / height;
+        while ((int32_t)(width * resize_x) < resized_width) {
+          resize_x = nextafter(resize_x, INFINITY);
+        }
+        while ((int32_t)(height * resize_y) < resized_height) {
+          resize_y = nextafter(resize_y, INFINITY);
+        }
+        snprintf(
+          description,
+          description_size,
+          "Merged %s and %s into one resize to %dx%d",
+          op_text,
+          next_text,
+          resized_width,
+          resized_height
+        );
+        set_operation(op, "resize");
+        op->param = resize_x;
+        op->has_param = 1;
+        op->param2 = resize_y;
+        op->has_param2 = 1;
+        remove_operation(pipeline, i + 1);
+        return 1;
+      }
+    }
+
+    is_size_known = is_size_known && plan_output_size(op, &width, &height);
+  }
+
+  return 0;
+}
+
+/**
+ * Plan the execution of a pipeline on an image with the given size.
+ * The planned pipeline gives the same result with less work:
+ *
+ * - A grayscale operation is dropped if the next operation
+ *   (e.g. threshold) converts to grayscale itself.
+ * - Consecutive flips and rotations by multiples of 90°
+ *   are composed into a single one (or none).
+ * - Crops are moved before grayscale conversions, flips and rotations
+ *   (with a mirrored or transposed rectangle) and merged,
+ *   so they only process the cropped pixels.
+ * - Consecutive resizes are merged into one to the same final size.
+ *   This is the only rewrite that changes the pixels,
+ *   as the image is resampled only once.
+ *
+ * Every rewrite is printed to `explain` unless it is NULL.
+ * Returns a new pipeline or NULL if memory ran out.
+ */
+static FCVPipeline *plan_pipeline(
+  FCVPipeline const *pipeline,
+  int32_t width,
+  int32_t height,
+  FILE *explain
+) {
+  FCVPipeline *plan = malloc(sizeof(FCVPipeline));
+  if (!plan) {
+    return NULL;
+  }
+  plan->count = pipeline->count;
+  plan->capacity = pipeline->count > 0 ? pipeline->count : 1;
+  atomic_init(&plan->plans, NULL);
+  plan->ops = malloc(sizeof(FCVPipelineOp) * plan->capacity);
+  if (!plan->ops) {
+    free(plan);
+    return NULL;
+  }
+  memcpy(plan->ops, pipeline->ops, sizeof(FCVPipelineOp) * pipeline->count);
+
+  if (explain) {
+    fprintf(explain, "Pipeline: ");
+    print_pipeline(explain, pipeline);
+  }
+
+  char description[3 * OPERATION_TEXT_SIZE];
+  while (plan_step(plan, width, height, description, sizeof(description))) {
+    if (explain) {
+      fprintf(explain, "  %s\n", description);
+    }
+  }
+
+  if (explain) {
+    fprintf(explain, "Planned pipeline: ");
+    print_pipeline(explain, plan);
+  }
+  return plan;
+}
+
+/**
+ * Two buffers for the intermediate images of a pipeline,
+ * which the operations with an `into` function write to in turn.
+ * The buffers of a context are kept for the next run,
+ * where they are reused if they are large enough.
+ */
+typedef struct {
+  uint8_t *buffers[2];
+  size_t capacities[2]; // Allocated bytes of each buffer
+  size_t size;          // Size of each buffer in bytes for this run
+} ImageArena;
+
+struct FCVPipelineContext {
+  ImageArena arena;
+};
+
+/**
+ * Compute the size of the largest intermediate image of a pipeline,
+ * as far as the output sizes are known before executing it.
+ * Gray input is expanded to RGBA before the first operation.
+ */
+static size_t plan_arena_size(
+  FCVPipeline const *pipeline,
+  int32_t width,
+  int32_t height,
+  int32_t channels
+) {
+  size_t size = channels == 1 ? (size_t)width * height * 4 : 0;
+  for (int32_t i = 0; i < pipeline->count; i++) {
+    if (!plan_output_size(&pipeline->ops[i], &width, &height)) {
+      break;
+    }
+    size_t output_size = (size_t)width * height * 4;
+    size = output_size > size ? output_size : size;
+  }
+  return size;
+}
+
+/**
+ * Get the buffer of the arena that does not hold the current image.
+ * It is allocated on first use.
+ * Returns NULL if the image doesn't fit or memory ran out.
+ */
+static uint8_t *
+get_arena_buffer(ImageArena *arena, uint8_t const *current_data, size_t size) {
+  if (size == 0 || size > arena->size) {
+    return NULL;
+  }
+  int32_t index = arena->buffers[0] == current_data;
+  if (arena->capacities[index] < arena->size) {
+    // Not allocated yet or too small, e.g. from a run on a smaller image
+    free(arena->buffers[index]);
+    arena->buffers[index] = malloc(arena->size);
+    arena->capacities[index] = arena->buffers[index] ? arena->size : 0;
+  }
+  return arena->buffers[index];
+}
+
+static int32_t is_arena_buffer(ImageArena const *arena, uint8_t const *data) {
+  return data && (data == arena->buffers[0] || data == arena->buffers[1]);
+}
+
+/**
+ * Release the buffers of the arena after a run.
+ * The one holding the result is handed over to the caller,
+ * the others are freed unless they are kept for the next run.
+ */
+static void
+release_arena(ImageArena *arena, uint8_t const *result, int32_t is_kept) {
+  for (int32_t i = 0; i < 2; i++) {
+    if (arena->buffers[i] == result || !is_kept) {
+      if (arena->buffers[i] != result) {
+        free(arena->buffers[i]);
+      }
+      arena->buffers[i] = NULL;
+      arena->capacities[i] = 0;
+    }
+  }
+}
+
+/**
+ * Apply an operation with its `into` function and write the result
+ * into a buffer of the arena instead of a new one.
+ * Returns NULL if the operation has no `into` function,
+ * its result doesn't fit into the arena, or it failed.
+ * The operation is then applied with its `apply` function,
+ * which also reports the error.
+ */
+static uint8_t *apply_operation_into(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  ImageArena *arena
+) {
+  FCVOperationIntoFunction into = op->definition ? op->definition->into : NULL;
+  if (!into) {
+    return NULL;
+  }
+
+  int32_t out_width = *width;
+  int32_t out_height = *height;
+  if (!plan_output_size(op, &out_width, &out_height)) {
+    return NULL;
+  }
+  uint8_t *out =
+    get_arena_buffer(arena, data, (size_t)out_width * out_height * 4);
+  if (!out) {
+    return NULL;
+  }
+  if (!into(*width, *height, out_width, out_height, op, data, out)) {
+    return NULL;
+  }
+  *width = out_width;
+  *height = out_height;
+  return out;
+}
+
+/**
+ * Expand gray pixels to RGBA, in the arena if it fits.
+ * Returns NULL if memory ran out.
+ */
+static uint8_t *expand_gray_image(
+  int32_t width,
+  int32_t height,
+  uint8_t const *data,
+  ImageArena *arena
+) {
+  uint8_t *out = get_arena_buffer(arena, data, (size_t)width * height * 4);
+  if (!out) {
+    return fcv_single_to_multichannel(width, height, data);
+  }
+  fcv_single_to_multichannel_into(width, height, data, out);
+  return out;
+}
+
+/**
+ * Apply a pending orientation (see execute_pipeline).
+ * Flips are done in place, transposes in the arena if it fits.
+ * Returns NULL if memory ran out.
+ */
+static uint8_t *apply_pending_orientation(
+  int32_t *width,
+  int32_t *height,
+  int32_t orientation,
+  uint8_t *data,
+  ImageArena *arena
+) {
+  if (orientation & ORIENTATION_TRANSPOSE) {
+    FCVPipelineOp op;
+    set_orientation_operation(&op, orientation);
+    uint8_t *result = apply_operation_into(width, height, &op, data, arena);
+    if (result) {
+      return result;
+    }
+  }
+  return apply_exif_orientation(
+    width,
+    height,
+    orientation_to_exif[orientation],
+    data
+  );
+}
+
+/**
+ * Apply the flips of a pending orientation to the decoded image in place,
+ * so that only its transpose stays pending.
+ */
+static void apply_pending_flips(
+  int32_t width,
+  int32_t height,
+  int32_t *orientation,
+  uint8_t *data
+) {
+  // The flips follow the transpose, so they mirror the other axis
+  // of the decoded image
+  int32_t is_transposed = *orientation & ORIENTATION_TRANSPOSE;
+  int32_t flip_x = *orientation & (is_transposed ? ORIENTATION_FLIP_Y
+                                                 : ORIENTATION_FLIP_X);
+  int32_t flip_y = *orientation & (is_transposed ? ORIENTATION_FLIP_X
+                                                 : ORIENTATION_FLIP_Y);
+  if (flip_x && flip_y) {
+    fcv_rotate_180_in_place(width, height, data);
+  }
+  else if (flip_x) {
+    fcv_flip_x_in_place(width, height, data);
+  }
+  else if (flip_y) {
+    fcv_flip_y_in_place(width, height, data);
+  }
+  *orientation &= ORIENTATION_TRANSPOSE;
+}
+
+/**
+ * Replace the current image of the pipeline with a new one.
+ * The old one is freed unless it is the same or the input image,
+ * which is owned by the caller, or a buffer of the arena.
+ */
+static void replace_image(
+  uint8_t **current_data,
+  uint8_t *new_data,
+  uint8_t const *input_data,
+  ImageArena const *arena
+) {
+  if (new_data && new_data != *current_data) {
+    if (*current_data != input_data &&
+        !is_arena_buffer(arena, *current_data)) {
+      free(*current_data);
+    }
+    *current_data = new_data;
+  }
+}
+
+/**
+ * Execute all operations of the pipeline.
+ * The EXIF orientation of the input is not applied right away, but kept
+ * pending while the operations can be applied to the decoded image
+ * instead (e.g. crop and resize). It is applied before the first
+ * operation that needs the oriented image, or at the end,
+ * so a large photo is usually only rotated after it was made smaller.
+ * As resizing is not mirror-symmetric, the flips of the orientation
+ * are applied in place before a resize and only its transpose
+ * stays pending.
+ *
+ * The input can have 1 (gray) or 4 (RGBA) channels. Gray input is passed
+ * to the grayscale and qr operations as is and expanded to RGBA
+ * for all others. The result always has 4 channels.
+ * Progress is logged to `log` and results of operations like qr
+ * are printed to `output`, unless they are NULL.
+ *
+ * Operations with an `into` function (e.g. crop, resize, flips)
+ * write their result alternately into the two buffers of the arena,
+ * which is sized for the largest intermediate image of the pipeline,
+ * instead of allocating a new image for every step.
+ * The caller releases the arena afterwards (see release_arena).
+ */
+static uint8_t *execute_pipeline(
+  int32_t *width,
+  int32_t *height,
+  FCVPipeline const *pipeline,
+  ImageArena *arena,
+  uint8_t *input_data,
+  int32_t channels,
+  int32_t exif_orientation,
+  FILE *log,
+  FILE *output
+) {
+  uint8_t *current_data = input_data;
+  int32_t orientation = exif_orientation >= 1 && exif_orientation <= 8
+                          ? orientation_from_exif[exif_orientation]
+                          : 0;
+  int32_t is_input_transposed = orientation & ORIENTATION_TRANSPOSE;
+  arena->size = plan_arena_size(
+    pipeline,
+    is_input_transposed ? *height : *width,
+    is_input_transposed ? *width : *height,
+    channels
+  );
+
+  for (int32_t i = 0; i < pipeline->count; i++) {
+    FCVPipelineOp const *op = &pipeline->ops[i];
+    if (log) {
+      fprintf(log, "Applying operation: %s", op->operation);
+      if (op->has_string_param) {
+        fprintf(log, " with parameter: %s", op->param_str);
+      }
+      else if (op->has_param) {
+        fprintf(log, " with parameter: %.2f", op->param);
+        if (op->has_param2) {
+          fprintf(log, " %.2f", op->param2);
+          if (op->has_param3) {
+            fprintf(log, " %.2f", op->param3);
+          }
+          if (op->has_param4) {
+            fprintf(log, " %.2f", op->param4);
+          }
+        }
+      }
+      fprintf(log, "\n");
+    }
+
+    clock_t start_time = clock();
+    uint8_t *result = current_data;
+    int32_t is_grayscale = strcmp(op->operation, "grayscale") == 0;
+    int32_t is_qr = strcmp(op->operation, "qr") == 0 && orientation == 0;
+    if (channels == 1 && is_grayscale) {
+      // Gray pixels only need to be expanded to RGBA
+      result = expand_gray_image(*width, *height, current_data, arena);
+      channels = 4;
+    }
+    else if (channels == 1 && is_qr) {
+      if (output) {
+        print_qr_codes(output, *width, *height, current_data);
+      }
+    }
+    else {
+      if (channels == 1) {
+        result = expand_gray_image(*width, *height, current_data, arena);
+        replace_image(&current_data, result, input_data, arena);
+        channels = 4;
+      }
+      if (result &&
+          (orientation == 0 || !fold_into_orientation(&orientation, op))) {
+        if (strcmp(op->operation, "resize") == 0) {
+          // Resizing is not mirror-symmetric, so only a transpose
+          // can stay pending
+          apply_pending_flips(*width, *height, &orientation, current_data);
+        }
+        FCVPipelineOp decoded_op = *op;
+        if (orientation != 0 && !map_operation_to_decoded(
+                                  &decoded_op,
+                                  orientation,
+                                  *width,
+                                  *height
+                                )) {
+          // The operation needs the oriented image
+          result = apply_pending_orientation(
+            width,
+            height,
+            orientation,
+            current_data,
+            arena
+          );
+          orientation = 0;
+          replace_image(&current_data, result, input_data, arena);
+        }
+        if (result) {
+          result = apply_operation_into(
+            width,
+            height,
+            &decoded_op,
+            current_data,
+            arena
+          );
+          if (!result) {
+            result = decoded_op.definition->apply(
+              width,
+              height,
+              &decoded_op,
+              current_data,
+              output
+            );
+          }
+        }
+      }
+    }
+    clock_t end_time = clock();
+
+    double elapsed_time_ms =
+      ((double)(end_time - start_time)) / CLOCKS_PER_SEC * 1000.0;
+    int32_t is_transposed = orientation & ORIENTATION_TRANSPOSE;
+    if (log) {
+      fprintf(
+        log,
+        "  → Completed in %.1f ms (output: %dx%d)\n",
+        elapsed_time_ms,
+        is_transposed ? *height : *width,
+        is_transposed ? *width : *height
+      );
+    }
+
+    if (!result) {
+      if (current_data != input_data &&
+          !is_arena_buffer(arena, current_data)) {
+        free(current_data);
+      }
+      return NULL;
+    }
+
+    replace_image(&current_data, result, input_data, arena);
+  }
+
+  uint8_t *result = current_data;
+  if (channels == 1) {
+    result = expand_gray_image(*width, *height, current_data, arena);
+    replace_image(&current_data, result, input_data, arena);
+  }
+  if (result && orientation != 0) {
+    result = apply_pending_orientation(
+      width,
+      height,
+      orientation,
+      current_data,
+      arena
+    );
+    replace_image(&current_data, result, input_data, arena);
+  }
+  if (!result && current_data != input_data &&
+      !is_arena_buffer(arena, current_data)) {
+    free(current_data);
+  }
+  return result;
+}
+
+static bool grayscale_into(
+  int32_t width,
+  int32_t height,
+  int32_t out_width,
+  int32_t out_height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *out
+) {
+  (void)out_width;
+  (void)out_height;
+  (void)op;
+  fcv_grayscale_into(width, height, data, out);
+  return true;
+}
+
+static bool blur_into(
+  int32_t width,
+  int32_t height,
+  int32_t out_width,
+  int32_t out_height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *out
+) {
+  (void)out_width;
+  (void)out_height;
+  return op->has_param &&
+         fcv_apply_gaussian_blur_into(width, height, op->param, data, out);
+}
+
+static bool resize_into(
+  int32_t width,
+  int32_t height,
+  int32_t out_width,
+  int32_t out_height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *out
+) {
+  // Converts the parameters to resize factors
+  FCVPipelineOp factors = *op;
+  return map_operation_to_decoded(&factors, 0, width, height) &&
+         fcv_resize_into(
+           width,
+           height,
+           factors.param,
+           factors.param2,
+           (uint32_t)out_width,
+           (uint32_t)out_height,
+           data,
+           out
+         );
+}
+
+static bool crop_into(
+  int32_t width,
+  int32_t height,
+  int32_t out_width,
+  int32_t out_height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *out
+) {
+  // Clamps the crop rectangle to the image
+  FCVPipelineOp clamped = *op;
+  return map_operation_to_decoded(&clamped, 0, width, height) &&
+         fcv_crop_into(
+           width,
+           height,
+           4,
+           data,
+           (uint32_t)clamped.param,
+           (uint32_t)clamped.param2,
+           (uint32_t)out_width,
+           (uint32_t)out_height,
+           out
+         );
+}
+
+/** Apply a flip or a rotation by a multiple of 90°. */
+static bool permute_into(
+  int32_t width,
+  int32_t height,
+  int32_t out_width,
+  int32_t out_height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  uint8_t *out
+) {
+  (void)out_width;
+  (void)out_height;
+  int32_t orientation = 0;
+  if (!fold_into_orientation(&orientation, op)) {
+    return false;
+  }
+
+  switch (orientation) {
+  case 0:
+    memcpy(out, data, (size_t)width * height * 4);
+    break;
+  case ORIENTATION_FLIP_X:
+    fcv_flip_x_into(width, height, data, out);
+    break;
+  case ORIENTATION_FLIP_Y:
+    fcv_flip_y_into(width, height, data, out);
+    break;
+  case ORIENTATION_FLIP_X | ORIENTATION_FLIP_Y:
+    fcv_rotate_180_into(width, height, data, out);
+    break;
+  case ORIENTATION_TRANSPOSE:
+    fcv_transpose_into(width, height, data, out);
+    break;
+  case ORIENTATION_TRANSPOSE | ORIENTATION_FLIP_X:
+    fcv_rotate_90_cw_into(width, height, data, out);
+    break;
+  case ORIENTATION_TRANSPOSE | ORIENTATION_FLIP_Y:
+    fcv_rotate_270_cw_into(width, height, data, out);
+    break;
+  default:
+    fcv_transverse_into(width, height, data, out);
+    break;
+  }
+  return true;
+}
+
+static const FCVOperation builtin_operations[] = {
+  // Name, apply, parse, into, flags, user data
+  {
+    "grayscale",
+    apply_grayscale,
+    NULL,
+    grayscale_into,
+    FCV_OPERATION_SAME_SIZE | FCV_OPERATION_STARTS_GRAY,
+    NULL,
+  },
+  {"blur", apply_blur, NULL, blur_into, FCV_OPERATION_SAME_SIZE, NULL},
+  {"resize", apply_resize, parse_resize, resize_into, 0, NULL},
+  {
+    "threshold",
+    apply_threshold,
+    NULL,
+    NULL,
+    FCV_OPERATION_SAME_SIZE | FCV_OPERATION_STARTS_GRAY |
+      FCV_OPERATION_BINARIZES,
+    NULL,
+  },
+  {
+    "bw_smart",
+    apply_bw_smart,
+    NULL,
+    NULL,
+    FCV_OPERATION_SAME_SIZE | FCV_OPERATION_STARTS_GRAY |
+      FCV_OPERATION_BINARIZES,
+    NULL,
+  },
+  {
+    "bw_smooth",
+    apply_bw_smooth,
+    NULL,
+    NULL,
+    FCV_OPERATION_SAME_SIZE | FCV_OPERATION_STARTS_GRAY |
+      FCV_OPERATION_BINARIZES,
+    NULL,
+  },
+  {"detect_corners", apply_detect_corners, NULL, NULL, 0, NULL},
+  {"qr", apply_qr, NULL, NULL, 0, NULL},
+  {"qr_draw", apply_qr_draw, NULL, NULL, 0, NULL},
+  {"draw_corners", apply_draw_corners, NULL, NULL, 0, NULL},
+  {
+    "sobel",
+    apply_sobel,
+    NULL,
+    NULL,
+    FCV_OPERATION_SAME_SIZE | FCV_OPERATION_STARTS_GRAY,
+    NULL,
+  },
+  {"circle", apply_circle, parse_shape, NULL, 0, NULL},
+  {"disk", apply_disk, parse_shape, NULL, 0, NULL},
+  {"watershed", apply_watershed, parse_string, NULL, 0, NULL},
+  {"crop", apply_crop, parse_crop, crop_into, 0, NULL},
+  {"extract_document", apply_extract_document, parse_no_params, NULL, 0, NULL},
+  {
+    "extract_document_to",
+    apply_extract_document_to,
+    parse_extract_document_to,
+    NULL,
+    0,
+    NULL,
+  },
+  {"flip_x", apply_flip_x, NULL, permute_into, 0, NULL},
+  {"flip_y", apply_flip_y, NULL, permute_into, 0, NULL},
+  {"transpose", apply_transpose, NULL, permute_into, 0, NULL},
+  {"transverse", apply_transverse, NULL, permute_into, 0, NULL},
+  {"rotate", apply_rotate, NULL, permute_into, 0, NULL},
+  {"deskew", apply_deskew, NULL, NULL, 0, NULL},
+  {"trim", apply_trim, parse_trim, NULL, 0, NULL},
+  {"histogram", apply_histogram, NULL, NULL, 0, NULL},
+  {"border", apply_border, parse_border, NULL, 0, NULL},
+  {"erode", apply_erode, NULL, NULL, 0, NULL},
+  {"dilate", apply_dilate, NULL, NULL, 0, NULL},
+  {"close", apply_close, NULL, NULL, 0, NULL},
+  {"open", apply_open, NULL, NULL, 0, NULL},
+};
+
+#define MAX_REGISTERED_OPERATIONS 64
+
+static FCVOperation registered_operations[MAX_REGISTERED_OPERATIONS];
+static int32_t num_registered_operations = 0;
+
+FCVOperation const *fcv_find_operation(char const *name) {
+  if (!name) {
+    return NULL;
+  }
+  size_t num_builtin = sizeof(builtin_operations) / sizeof(FCVOperation);
+  for (size_t i = 0; i < num_builtin; i++) {
+    if (strcmp(builtin_operations[i].name, name) == 0) {
+      return &builtin_operations[i];
+    }
+  }
+  for (int32_t i = 0; i < num_registered_operations; i++) {
+    if (strcmp(registered_operations[i].name, name) == 0) {
+      return &registered_operations[i];
+    }
+  }
+  return NULL;
+}
+
+bool fcv_register_operation(FCVOperation const *operation) {
+  FCVPipelineOp op;
+  if (!operation || !operation->name || !operation->apply ||
+      operation->name[0] == '\0' ||
+      strlen(operation->name) >= sizeof(op.operation) ||
+      strpbrk(operation->name, " ,()") ||
+      fcv_find_operation(operation->name) ||
+      num_registered_operations >= MAX_REGISTERED_OPERATIONS) {
+    return false;
+  }
+  registered_operations[num_registered_operations++] = *operation;
+  return true;
+}
+
+/**
+ * Append an operation to the pipeline.
+ * Returns NULL if memory ran out.
+ */
+static FCVPipelineOp *add_operation(FCVPipeline *pipeline) {
+  if (pipeline->count >= pipeline->capacity) {
+    int32_t capacity = pipeline->capacity * 2;
+    FCVPipelineOp *ops =
+      realloc(pipeline->ops, sizeof(FCVPipelineOp) * capacity);
+    if (!ops) {
+      return NULL;
+    }
+    pipeline->ops = ops;
+    pipeline->capacity = capacity;
+  }
+  return &pipeline->ops[pipeline->count++];
+}
+
+/**
+ * Parse one operation of the pipeline, e.g. "blur 9" or "(resize 50%)",
+ * and append it to the pipeline.
+ * Returns false if it is unknown or invalid.
+ */
+static bool parse_operation(char *piece, FCVPipeline *pipeline) {
+  piece = pipeline_trim_whitespace(piece);
+
+  // Optional surrounding parentheses
+  size_t length = strlen(piece);
+  if (length > 0 && piece[0] == '(' && piece[length - 1] == ')') {
+    piece[length - 1] = '\0';
+    piece = pipeline_trim_whitespace(piece + 1);
+  }
+  if (*piece == '\0') {
+    return true; // Empty fragment, skip
+  }
+
+  // Split into operation name and (optional) parameters
+  char *params = NULL;
+  char *space = strchr(piece, ' ');
+  if (space) {
+    *space = '\0';
+    params = pipeline_trim_whitespace(space + 1);
+  }
+
+  FCVOperation const *operation = fcv_find_operation(piece);
+  if (!operation) {
+    fprintf(stderr, "Error: Unknown operation '%s'\n", piece);
+    return false;
+  }
+
+  FCVPipelineOp *op = add_operation(pipeline);
+  if (!op) {
+    fprintf(stderr, "Error: out of memory\n");
+    return false;
+  }
+  set_operation(op, operation->name);
+  if (!params) {
+    return true;
+  }
+  return operation->parse ? operation->parse(params, op)
+                          : parse_numbers(params, op);
+}
+
+FCVPipeline *fcv_pipeline_parse(char const *text) {
+  if (!text) {
+    return NULL;
+  }
+  FCVPipeline *pipeline = malloc(sizeof(FCVPipeline));
+  char *copy = malloc(strlen(text) + 1);
+  if (!pipeline || !copy) {
+    free(pipeline);
+    free(copy);
+    return NULL;
+  }
+  strcpy(copy, text);
+  pipeline->count = 0;
+  pipeline->capacity = 8;
+  atomic_init(&pipeline->plans, NULL);
+  pipeline->ops = malloc(sizeof(FCVPipelineOp) * pipeline->capacity);
+  if (!pipeline->ops) {
+    free(pipeline);
+    free(copy);
+    return NULL;
+  }
+
+  // Every comma-separated part is one operation
+  char *saveptr;
+  for (char *piece = strtok_r(copy, ",", &saveptr); piece;
+       piece = strtok_r(NULL, ",", &saveptr)) {
+    if (!parse_operation(piece, pipeline)) {
+      fcv_pipeline_free(pipeline);
+      free(copy);
+      return NULL;
+    }
+  }
+
+  free(copy);
+  return pipeline;
+}
+
+FCVPipelineContext *fcv_pipeline_context_new(void) {
+  return calloc(1, sizeof(FCVPipelineContext));
+}
+
+void fcv_pipeline_context_free(FCVPipelineContext *context) {
+  if (context) {
+    release_arena(&context->arena, NULL, 0);
+    free(context);
+  }
+}
+
+void fcv_pipeline_free(FCVPipeline *pipeline) {
+  if (pipeline) {
+    PlanCacheEntry *entry = atomic_load(&pipeline->plans);
+    while (entry) {
+      PlanCacheEntry *next = entry->next;
+      fcv_pipeline_free(entry->plan);
+      free(entry);
+      entry = next;
+    }
+    free(pipeline->ops);
+    free(pipeline);
+  }
+}
+
+/**
+ * Get the plan of a pipeline for an input size, which was already planned
+ * or is planned now and added to the plans of the pipeline.
+ * Several threads can run the same pipeline, so the plans are
+ * a list that is only ever prepended to (with compare-and-swap)
+ * and freed together with the pipeline.
+ * If the list is full, the plan isn't cached and `is_cached` is 0,
+ * so the caller must free it.
+ * Returns NULL if memory ran out.
+ */
+static FCVPipeline *get_cached_plan(
+  FCVPipeline const *pipeline,
+  int32_t width,
+  int32_t height,
+  int32_t *is_cached
+) {
+  _Atomic(PlanCacheEntry *) *plans =
+    (_Atomic(PlanCacheEntry *) *)&pipeline->plans;
+  PlanCacheEntry *head = atomic_load(plans);
+  PlanCacheEntry *new_entry = NULL;
+  *is_cached = 1;
+  while (1) {
+    int32_t num_plans = 0;
+    for (PlanCacheEntry *entry = head; entry; entry = entry->next) {
+      if (entry->width == width && entry->height == height) {
+        if (new_entry) {
+          fcv_pipeline_free(new_entry->plan);
+          free(new_entry);
+        }
+        return entry->plan;
+      }
+      num_plans++;
+    }
+
+    if (!new_entry) {
+      new_entry = malloc(sizeof(PlanCacheEntry));
+      FCVPipeline *plan = plan_pipeline(pipeline, width, height, NULL);
+      if (!new_entry || !plan) {
+        free(new_entry);
+        fcv_pipeline_free(plan);
+        return NULL;
+      }
+      new_entry->width = width;
+      new_entry->height = height;
+      new_entry->plan = plan;
+    }
+    if (num_plans >= MAX_CACHED_PLANS) {
+      FCVPipeline *plan = new_entry->plan;
+      free(new_entry);
+      *is_cached = 0;
+      return plan;
+    }
+    new_entry->next = head;
+    if (atomic_compare_exchange_weak(plans, &head, new_entry)) {
+      return new_entry->plan;
+    }
+    // Another thread added a plan, which could be for the same size
+  }
+}
+
+int32_t fcv_pipeline_count(FCVPipeline const *pipeline) {
+  return pipeline ? pipeline->count : 0;
+}
+
+FCVPipelineOp const *
+fcv_pipeline_op(FCVPipeline const *pipeline, int32_t index) {
+  if (!pipeline || index < 0 || index >= pipeline->count) {
+    return NULL;
+  }
+  return &pipeline->ops[index];
+}
+
+uint8_t *fcv_pipeline_run(
+  FCVPipeline const *pipeline,
+  int32_t *width,
+  int32_t *height,
+  int32_t channels,
+  uint8_t *data,
+  FCVPipelineOptions const *options
+) {
+  if (!pipeline || !width || !height || !data ||
+      (channels != 1 && channels != 4)) {
+    return NULL;
+  }
+  FCVPipelineOptions const no_options = {0, NULL, NULL, NULL, NULL};
+  if (!options) {
+    options = &no_options;
+  }
+
+  // Plan for the size of the oriented image.
+  // Explained plans are always made anew, to print how they were made.
+  int32_t orientation = options->exif_orientation;
+  int32_t is_transposed = orientation >= 5 && orientation <= 8;
+  int32_t plan_width = is_transposed ? *height : *width;
+  int32_t plan_height = is_transposed ? *width : *height;
+  int32_t is_cached = 0;
+  FCVPipeline *plan =
+    options->explain
+      ? plan_pipeline(pipeline, plan_width, plan_height, options->explain)
+      : get_cached_plan(pipeline, plan_width, plan_height, &is_cached);
+  if (!plan) {
+    return NULL;
+  }
+  if (options->log) {
+    fprintf(
+      options->log,
+      "Executing pipeline with %d operations:\n",
+      plan->count
+    );
+  }
+
+  // Without a context, the buffers only live for this run
+  ImageArena run_arena = {{NULL, NULL}, {0, 0}, 0};
+  ImageArena *arena =
+    options->context ? &options->context->arena : &run_arena;
+  uint8_t *result = execute_pipeline(
+    width,
+    height,
+    plan,
+    arena,
+    data,
+    channels,
+    orientation,
+    options->log,
+    options->output
+  );
+  release_arena(arena, result, options->context != NULL);
+  if (!is_cached) {
+    fcv_pipeline_free(plan);
+  }
+
+  // The result is always owned by the caller
+  if (result == data) {
+    size_t size = (size_t)*width * *height * 4;
+    result = malloc(size);
+    if (result) {
+      memcpy(result, data, size);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,1721 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "png_encode.h"
+#else
+#include "flatcv.h"
+#endif
+
+#define PNG_WINDOW_SIZE 32768
+#define PNG_WINDOW_MASK (PNG_WINDOW_SIZE - 1)
+// Keep matches clear of window slots that are about to be overwritten
+#define PNG_MAX_DISTANCE (PNG_WINDOW_SIZE - 262)
+#define PNG_MIN_MATCH 3
+#define PNG_MAX_MATCH 258
+#define PNG_HASH_BITS 15
+#define PNG_HASH_SIZE (1 << PNG_HASH_BITS)
+#define PNG_MAX_BLOCK_TOKENS 16384
+#define PNG_MATCH_FLAG 0x80000000u
+#define PNG_NUM_LITLEN 288
+#define PNG_NUM_DIST 30
+#define PNG_NUM_CODELEN 19
+#define PNG_END_OF_BLOCK 256
+#define PNG_MAX_STORED 65535
+// Data is compressed in independent segments so positions fit 32 bits
+#define PNG_SEGMENT_SIZE ((size_t)1 << 30)
+#define PNG_MAX_CHUNK_DATA ((size_t)1 << 30)
+// Filtered data per independently compressed part (whole rows)
+#define PNG_PART_SIZE ((size_t)256 * 1024)
+
+static const uint16_t png_length_base[29] = {
+  3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t png_length_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t png_dist_base[PNG_NUM_DIST] = {
+  1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+  33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+  1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t png_dist_extra[PNG_NUM_DIST] = {
+  0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+  6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// Order in which the code length code lengths are stored
+static const uint8_t png_codelen_order[PNG_NUM_CODELEN] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+typedef struct {
+  uint32_t chain_length; // Maximum number of hash chain entries to check
+  uint32_t nice_length;  // Stop searching at a match this long
+  // Matches shorter than this wait for a longer one at the next position
+  // (0: take every match right away)
+  uint32_t lazy_length;
+  // Search only a quarter of the chain to improve a match this long
+  uint32_t good_length;
+} PngLevelConfig;
+
+// Levels 2-6 take every match right away and only search longer hash
+// chains, levels 7-9 wait for a longer match at the next position.
+// From level 2 on, parts fall back to the runs of level 1 if those are
+// smaller, so on photos, scans and rendered pages the size never grows
+// with the level. Trade-offs measured on 0.2-20 MP photos and scans:
+static const PngLevelConfig png_level_configs[10] = {
+  {0, 0, 0, 0},          // Stored uncompressed
+  {0, 0, 0, 0},          // Runs only, 2-3x level 0, best for binary pages
+  {4, 16, 0, 0},         // Up to 16 % smaller than level 1, 1.6-1.8x its time
+  {6, 16, 0, 0},         // Longer chains: up to 0.8 % smaller than level 2
+  {8, 32, 0, 0},         // Up to 1.3 % smaller than level 2
+  {12, 32, 0, 0},        // Up to 2 % smaller than level 2
+  {16, 32, 0, 0},        // Up to 2.5 % smaller than level 2, 1.2-1.35x its
+                         // time, 0.5-0.8x the time of stb_image_write
+  {64, 128, 32, 16},     // Lazy, 1-1.5 % smaller than level 6, 2x its time
+  {256, 258, 128, 32},   // 1-2.5 % smaller than level 6, 2.5-5x its time
+  {4096, 258, 258, 258}, // 1.5-3 % smaller than level 6, 5-13x its time
+};
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  uint64_t bit_buffer;
+  uint32_t bit_count;
+  bool failed;
+} PngBitWriter;
+
+typedef struct {
+  uint8_t lengths[PNG_NUM_LITLEN];
+  uint16_t codes[PNG_NUM_LITLEN]; // Bit-reversed for LSB-first output
+} PngHuffman;
+
+typedef struct {
+  uint32_t head[PNG_HASH_SIZE];   // Latest position + 1 per hash (0: none)
+  uint32_t prev[PNG_WINDOW_SIZE]; // Previous position + 1 with the same hash
+  uint32_t tokens[PNG_MAX_BLOCK_TOKENS];
+  size_t num_tokens;
+  uint32_t block_start;
+  uint32_t litlen_freqs[PNG_NUM_LITLEN];
+  uint32_t dist_freqs[PNG_NUM_DIST];
+  uint8_t length_index[256]; // Length code index by length - 3
+  uint8_t dist_index[512];   // Distance code index, see png_dist_code
+  PngHuffman fixed_litlen;
+  PngHuffman fixed_dist;
+} PngDeflater;
+
+typedef struct {
+  uint8_t color_type; // 0: gray, 2: RGB, 3: palette, 4: gray alpha, 6: RGBA
+  uint8_t bit_depth;
+  uint32_t palette_size;
+  uint32_t num_transparent; // Palette entries with alpha (stored first)
+  uint32_t palette[256];    // RGBA packed as r | g << 8 | b << 16 | a << 24
+} PngFormat;
+
+typedef struct {
+  size_t start; // Range of the filtered data
+  size_t end;
+  PngBitWriter output;
+  uint32_t adler; // Adler-32 of the range on its own
+  bool is_compressed;
+} PngPart;
+
+struct FCVPngEncoder {
+  uint32_t width;
+  uint32_t height;
+  int32_t level;
+  PngFormat format;
+  uint8_t *filtered; // Filter type byte and filtered bytes of every row
+  size_t filtered_size;
+  uint32_t num_parts;
+  PngPart *parts;
+};
+
+typedef struct {
+  uint32_t keys[512];
+  int16_t indices[512]; // -1 marks an empty slot
+} PngColorTable;
+
+FCVPngOptions fcv_png_default_options(void) {
+  FCVPngOptions options = {6, FCV_PNG_FILTER_ADAPTIVE, true};
+  return options;
+}
+
+static bool png_reserve(PngBitWriter *writer, size_t extra) {
+  if (writer->failed) {
+    return false;
+  }
+  if (extra <= writer->capacity - writer->size) {
+    return true;
+  }
+  size_t capacity = writer->capacity ? writer->capacity : 4096;
+  while (extra > capacity - writer->size) {
+    // Check for overflow:
+    if (capacity > SIZE_MAX / 2) {
+      writer->failed = true;
+      return false;
+    }
+    capacity *= 2;
+  }
+  uint8_t *data = realloc(writer->data, capacity);
+  if (!data) {
+    writer->failed = true;
+    return false;
+  }
+  writer->data = data;
+  writer->capacity = capacity;
+  return true;
+}
+
+/**
+ * Append up to 32 bits, least significant bit first.
+ * Space must have been reserved with png_reserve.
+ */
+static inline void
+png_put_bits(PngBitWriter *writer, uint32_t bits, uint32_t count) {
+  writer->bit_buffer |= (uint64_t)bits << writer->bit_count;
+  writer->bit_count += count;
+  if (writer->bit_count >= 32) {
+    uint8_t *out = writer->data + writer->size;
+    out[0] = (uint8_t)writer->bit_buffer;
+    out[1] = (uint8_t)(writer->bit_buffer >> 8);
+    out[2] = (uint8_t)(writer->bit_buffer >> 16);
+    out[3] = (uint8_t)(writer->bit_buffer >> 24);
+    writer->size += 4;
+    writer->bit_buffer >>= 32;
+    writer->bit_count -= 32;
+  }
+}
+
+/**
+ * Pad the pending bits with zeros to a whole byte and write them out.
+ */
+static void png_align(PngBitWriter *writer) {
+  while (writer->bit_count > 0) {
+    writer->data[writer->size++] = (uint8_t)writer->bit_buffer;
+    writer->bit_buffer >>= 8;
+    writer->bit_count = writer->bit_count > 8 ? writer->bit_count - 8 : 0;
+  }
+}
+
+static uint32_t png_adler32(uint32_t adler, uint8_t const *data, size_t size) {
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+  while (size > 0) {
+    // Largest block for which b cannot overflow before the modulo
+    size_t block = size < 5552 ? size : 5552;
+    size -= block;
+    for (size_t i = 0; i < block; i++) {
+      a += data[i];
+      b += a;
+    }
+    data += block;
+    a %= 65521;
+    b %= 65521;
+  }
+  return b << 16 | a;
+}
+
+static void png_crc_table(uint32_t table[256]) {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int32_t k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    table[n] = c;
+  }
+}
+
+static uint32_t png_crc(
+  uint32_t const table[256],
+  uint32_t crc,
+  uint8_t const *data,
+  size_t size
+) {
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static uint16_t png_reverse_bits(uint32_t code, uint32_t length) {
+  uint32_t reversed = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  return (uint16_t)reversed;
+}
+
+/**
+ * Assign canonical Huffman codes to the given code lengths.
+ */
+static void png_assign_codes(PngHuffman *tree, uint32_t num_symbols) {
+  uint32_t length_counts[16] = {0};
+  for (uint32_t i = 0; i < num_symbols; i++) {
+    length_counts[tree->lengths[i]]++;
+  }
+  length_counts[0] = 0;
+
+  uint32_t next_code[16] = {0};
+  uint32_t code = 0;
+  for (uint32_t bits = 1; bits < 16; bits++) {
+    code = (code + length_counts[bits - 1]) << 1;
+    next_code[bits] = code;
+  }
+
+  for (uint32_t i = 0; i < num_symbols; i++) {
+    uint32_t length = tree->lengths[i];
+    tree->codes[i] =
+      length ? png_reverse_bits(next_code[length]++, length) : 0;
+  }
+}
+
+/**
+ * Build a Huffman code limited to max_length bits.
+ *
+ * The optimal code lengths are computed in place on the sorted frequencies
+ * (Moffat and Katajainen), and codes that are too long are shortened
+ * by moving leaves down the tree until the Kraft sum is 1 again.
+ * At least two symbols always get a code, so the code is complete.
+ */
+static void png_build_tree(
+  uint32_t const *freqs,
+  uint32_t num_symbols,
+  uint32_t max_length,
+  PngHuffman *tree
+) {
+  uint32_t weights[PNG_NUM_LITLEN];
+  uint16_t symbols[PNG_NUM_LITLEN];
+  uint32_t num_used = 0;
+
+  for (uint32_t i = 0; i < num_symbols; i++) {
+    tree->lengths[i] = 0;
+    if (freqs[i] > 0) {
+      symbols[num_used++] = (uint16_t)i;
+    }
+  }
+  for (uint32_t i = 0; num_used < 2; i++) {
+    if (freqs[i] == 0) {
+      symbols[num_used++] = (uint16_t)i;
+    }
+  }
+
+  // Insertion sort by ascending frequency (ties by symbol)
+  for (uint32_t i = 0; i < num_used; i++) {
+    uint16_t symbol = symbols[i];
+    uint32_t weight = freqs[symbol] ? freqs[symbol] : 1;
+    uint32_t j = i;
+    while (j > 0 && (weights[j - 1] > weight ||
+                     (weights[j - 1] == weight && symbols[j - 1] > symbol))) {
+      weights[j] = weights[j - 1];
+      symbols[j] = symbols[j - 1];
+      j--;
+    }
+    weights[j] = weight;
+    symbols[j] = symbol;
+  }
+
+  // Combine the two lightest nodes, reusing the array for parent pointers
+  uint32_t n = num_used;
+  weights[0] += weights[1];
+  uint32_t root = 0;
+  uint32_t leaf = 2;
+  for (uint32_t next = 1; next < n - 1; next++) {
+    if (leaf >= n || weights[root] < weights[leaf]) {
+      weights[next] = weights[root];
+      weights[root++] = next;
+    }
+    else {
+      weights[next] = weights[leaf++];
+    }
+    if (leaf >= n || (root < next && weights[root] < weights[leaf])) {
+      weights[next] += weights[root];
+      weights[root++] = next;
+    }
+    else {
+      weights[next] += weights[leaf++];
+    }
+  }
+
+  // Convert parent pointers into internal node depths
+  weights[n - 2] = 0;
+  for (int32_t next = (int32_t)n - 3; next >= 0; next--) {
+    weights[next] = weights[weights[next]] + 1;
+  }
+
+  // Convert internal node depths into leaf depths
+  int32_t available = 1;
+  int32_t used = 0;
+  uint32_t depth = 0;
+  int32_t node = (int32_t)n - 2;
+  int32_t next = (int32_t)n - 1;
+  while (available > 0) {
+    while (node >= 0 && weights[node] == depth) {
+      used++;
+      node--;
+    }
+    while (available > used) {
+      weights[next--] = depth;
+      available--;
+    }
+    available = 2 * used;
+    depth++;
+    used = 0;
+  }
+
+  // Limit the code lengths while keeping the code complete
+  uint32_t length_counts[PNG_NUM_LITLEN + 1] = {0};
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t length = weights[i] < max_length ? weights[i] : max_length;
+    length_counts[length]++;
+  }
+  uint32_t kraft_sum = 0;
+  for (uint32_t length = 1; length <= max_length; length++) {
+    kraft_sum += length_counts[length] << (max_length - length);
+  }
+  while (kraft_sum > (1u << max_length)) {
+    // Turn a leaf into a node with two children one level down
+    length_counts[max_length]--;
+    for (uint32_t length = max_length - 1; length > 0; length--) {
+      if (length_counts[length] > 0) {
+        length_counts[length]--;
+        length_counts[length + 1] += 2;
+        break;
+      }
+    }
+    kraft_sum--;
+  }
+
+  // The least frequent symbols get the longest codes
+  uint32_t i = 0;
+  for (uint32_t length = max_length; length > 0; length--) {
+    for (uint32_t count = length_counts[length]; count > 0; count--) {
+      tree->lengths[symbols[i++]] = (uint8_t)length;
+    }
+  }
+
+  png_assign_codes(tree, num_symbols);
+}
+
+static inline uint32_t
+png_dist_code(PngDeflater const *deflater, uint32_t dist) {
+  return dist <= 256 ? deflater->dist_index[dist - 1]
+                     : deflater->dist_index[256 + ((dist - 1) >> 7)];
+}
+
+static PngDeflater *png_create_deflater(void) {
+  PngDeflater *deflater = malloc(sizeof(PngDeflater));
+  if (!deflater) {
+    return NULL;
+  }
+
+  for (uint32_t code = 0; code < 28; code++) {
+    uint32_t count = 1u << png_length_extra[code];
+    for (uint32_t i = 0; i < count; i++) {
+      deflater->length_index[png_length_base[code] - 3 + i] = (uint8_t)code;
+    }
+  }
+  deflater->length_index[PNG_MAX_MATCH - 3] = 28;
+
+  for (uint32_t code = 0; code < PNG_NUM_DIST; code++) {
+    uint32_t count = 1u << png_dist_extra[code];
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t dist = png_dist_base[code] + i;
+      if (dist <= 256) {
+        deflater->dist_index[dist - 1] = (uint8_t)code;
+      }
+      else {
+        deflater->dist_index[256 + ((dist - 1) >> 7)] = (uint8_t)code;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < PNG_NUM_LITLEN; i++) {
+    uint8_t length = 8;
+    if (i >= 144 && i < 256) {
+      length = 9;
+    }
+    else if (i >= 256 && i < 280) {
+      length = 7;
+    }
+    deflater->fixed_litlen.lengths[i] = length;
+  }
+  png_assign_codes(&deflater->fixed_litlen, PNG_NUM_LITLEN);
+  for (uint32_t i = 0; i < PNG_NUM_DIST; i++) {
+    deflater->fixed_dist.lengths[i] = 5;
+  }
+  png_assign_codes(&deflater->fixed_dist, PNG_NUM_DIST);
+
+  return deflater;
+}
+
+static uint64_t png_data_bits(
+  PngDeflater const *deflater,
+  PngHuffman const *litlen,
+  PngHuffman const *dist
+) {
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < 257; i++) {
+    bits += (uint64_t)deflater->litlen_freqs[i] * litlen->lengths[i];
+  }
+  for (uint32_t code = 0; code < 29; code++) {
+    bits += (uint64_t)deflater->litlen_freqs[257 + code] *
+            (litlen->lengths[257 + code] + png_length_extra[code]);
+  }
+  for (uint32_t code = 0; code < PNG_NUM_DIST; code++) {
+    bits += (uint64_t)deflater->dist_freqs[code] *
+            (dist->lengths[code] + png_dist_extra[code]);
+  }
+  return bits;
+}
+
+static void png_write_tokens(
+  PngDeflater const *deflater,
+  PngBitWriter *writer,
+  PngHuffman const *litlen,
+  PngHuffman const *dist
+) {
+  for (size_t i = 0; i < deflater->num_tokens; i++) {
+    uint32_t token = deflater->tokens[i];
+    if (!(token & PNG_MATCH_FLAG)) {
+      png_put_bits(writer, litlen->codes[token], litlen->lengths[token]);
+      continue;
+    }
+
+    uint32_t length = ((token >> 16) & 0xFF) + PNG_MIN_MATCH;
+    uint32_t distance = token & 0xFFFF;
+
+    uint32_t code = deflater->length_index[length - PNG_MIN_MATCH];
+    png_put_bits(
+      writer,
+      litlen->codes[257 + code],
+      litlen->lengths[257 + code]
+    );
+    png_put_bits(
+      writer,
+      length - png_length_base[code],
+      png_length_extra[code]
+    );
+
+    code = png_dist_code(deflater, distance);
+    png_put_bits(writer, dist->codes[code], dist->lengths[code]);
+    png_put_bits(writer, distance - png_dist_base[code], png_dist_extra[code]);
+  }
+  png_put_bits(
+    writer,
+    litlen->codes[PNG_END_OF_BLOCK],
+    litlen->lengths[PNG_END_OF_BLOCK]
+  );
+}
+
+static void png_write_stored(
+  PngBitWriter *writer,
+  uint8_t const *data,
+  size_t size,
+  bool final
+) {
+  do {
+    size_t block = size < PNG_MAX_STORED ? size : PNG_MAX_STORED;
+    size -= block;
+    png_put_bits(writer, final && size == 0, 1);
+    png_put_bits(writer, 0, 2);
+    png_align(writer);
+    uint8_t *out = writer->data + writer->size;
+    out[0] = (uint8_t)block;
+    out[1] = (uint8_t)(block >> 8);
+    out[2] = (uint8_t)~block;
+    out[3] = (uint8_t)(~block >> 8);
+    memcpy(out + 4, data, block);
+    writer->size += 4 + block;
+    data += block;
+  } while (size > 0);
+}
+
+/**
+ * Emit the collected tokens as one block covering base[block_start, end),
+ * as stored, fixed or dynamic Huffman block, whichever is smallest.
+ */
+static void png_flush_block(
+  PngDeflater *deflater,
+  PngBitWriter *writer,
+  uint8_t const *base,
+  uint32_t end,
+  bool final
+) {
+  size_t raw_size = end - deflater->block_start;
+  size_t bound = deflater->num_tokens * 6 + raw_size +
+                 5 * (raw_size / PNG_MAX_STORED + 1) + 1024;
+  if (!png_reserve(writer, bound)) {
+    return;
+  }
+
+  deflater->litlen_freqs[PNG_END_OF_BLOCK]++;
+
+  PngHuffman litlen, dist, codelen;
+  png_build_tree(deflater->litlen_freqs, 286, 15, &litlen);
+  png_build_tree(deflater->dist_freqs, PNG_NUM_DIST, 15, &dist);
+
+  uint32_t num_litlen = 286;
+  while (num_litlen > 257 && litlen.lengths[num_litlen - 1] == 0) {
+    num_litlen--;
+  }
+  uint32_t num_dist = PNG_NUM_DIST;
+  while (num_dist > 1 && dist.lengths[num_dist - 1] == 0) {
+    num_dist--;
+  }
+
+  // Run-length encode the code lengths with the symbols
+  // 16 (repeat previous 3-6 times), 17 (3-10 zeros) and 18 (11-138 zeros)
+  uint8_t lengths[286 + PNG_NUM_DIST];
+  uint32_t num_lengths = num_litlen + num_dist;
+  memcpy(lengths, litlen.lengths, num_litlen);
+  memcpy(lengths + num_litlen, dist.lengths, num_dist);
+
+  uint8_t rle_symbols[286 + PNG_NUM_DIST];
+  uint8_t rle_extras[286 + PNG_NUM_DIST];
+  uint32_t num_rle = 0;
+  uint32_t codelen_freqs[PNG_NUM_CODELEN] = {0};
+  for (uint32_t i = 0; i < num_lengths;) {
+    uint8_t length = lengths[i];
+    uint32_t run = 1;
+    while (i + run < num_lengths && lengths[i + run] == length) {
+      run++;
+    }
+    i += run;
+
+    if (length == 0) {
+      while (run >= 11) {
+        uint32_t count = run < 138 ? run : 138;
+        rle_symbols[num_rle] = 18;
+        rle_extras[num_rle++] = (uint8_t)(count - 11);
+        run -= count;
+      }
+      if (run >= 3) {
+        rle_symbols[num_rle] = 17;
+        rle_extras[num_rle++] = (uint8_t)(run - 3);
+        run = 0;
+      }
+    }
+    else {
+      rle_symbols[num_rle] = length;
+      rle_extras[num_rle++] = 0;
+      run--;
+      while (run >= 3) {
+        uint32_t count = run < 6 ? run : 6;
+        rle_symbols[num_rle] = 16;
+        rle_extras[num_rle++] = (uint8_t)(count - 3);
+        run -= count;
+      }
+    }
+    for (; run > 0; run--) {
+      rle_symbols[num_rle] = length;
+      rle_extras[num_rle++] = 0;
+    }
+  }
+  for (uint32_t i = 0; i < num_rle; i++) {
+    codelen_freqs[rle_symbols[i]]++;
+  }
+
+  png_build_tree(codelen_freqs, PNG_NUM_CODELEN, 7, &codelen);
+  uint32_t num_codelen = PNG_NUM_CODELEN;
+  while (num_codelen > 4 &&
+         codelen.lengths[png_codelen_order[num_codelen - 1]] == 0) {
+    num_codelen--;
+  }
+
+  uint64_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * num_codelen +
+                          png_data_bits(deflater, &litlen, &dist);
+  for (uint32_t i = 0; i < PNG_NUM_CODELEN; i++) {
+    dynamic_bits += (uint64_t)codelen_freqs[i] * codelen.lengths[i];
+  }
+  dynamic_bits += 2 * codelen_freqs[16] + 3 * codelen_freqs[17] +
+                  7 * codelen_freqs[18];
+  uint64_t fixed_bits = 3 + png_data_bits(
+                              deflater,
+                              &deflater->fixed_litlen,
+                              &deflater->fixed_dist
+                            );
+  uint64_t stored_bits =
+    (uint64_t)raw_size * 8 + (raw_size / PNG_MAX_STORED + 1) * 42;
+
+  if (stored_bits <= fixed_bits && stored_bits <= dynamic_bits) {
+    png_write_stored(writer, base + deflater->block_start, raw_size, final);
+  }
+  else if (fixed_bits <= dynamic_bits) {
+    png_put_bits(writer, final, 1);
+    png_put_bits(writer, 1, 2);
+    png_write_tokens(
+      deflater,
+      writer,
+      &deflater->fixed_litlen,
+      &deflater->fixed_dist
+    );
+  }
+  else {
+    png_put_bits(writer, final, 1);
+    png_put_bits(writer, 2, 2);
+    png_put_bits(writer, num_litlen - 257, 5);
+    png_put_bits(writer, num_dist - 1, 5);
+    png_put_bits(writer, num_codelen - 4, 4);
+    for (uint32_t i = 0; i < num_codelen; i++) {
+      png_put_bits(writer, codelen.lengths[png_codelen_order[i]], 3);
+    }
+    for (uint32_t i = 0; i < num_rle; i++) {
+      uint8_t symbol = rle_symbols[i];
+      png_put_bits(writer, codelen.codes[symbol], codelen.lengths[symbol]);
+      if (symbol >= 16) {
+        png_put_bits(
+          writer,
+          rle_extras[i],
+          symbol == 16 ? 2 : symbol == 17 ? 3 : 7
+        );
+      }
+    }
+    png_write_tokens(deflater, writer, &litlen, &dist);
+  }
+
+  deflater->num_tokens = 0;
+  deflater->block_start = end;
+  memset(deflater->litlen_freqs, 0, sizeof(deflater->litlen_freqs));
+  memset(deflater->dist_freqs, 0, sizeof(deflater->dist_freqs));
+}
+
+static inline void png_add_literal(PngDeflater *deflater, uint8_t byte) {
+  deflater->tokens[deflater->num_tokens++] = byte;
+  deflater->litlen_freqs[byte]++;
+}
+
+static inline void
+png_add_match(PngDeflater *deflater, uint32_t length, uint32_t distance) {
+  deflater->tokens[deflater->num_tokens++] =
+    PNG_MATCH_FLAG | (length - PNG_MIN_MATCH) << 16 | distance;
+  uint32_t code = deflater->length_index[length - PNG_MIN_MATCH];
+  deflater->litlen_freqs[257 + code]++;
+  deflater->dist_freqs[png_dist_code(deflater, distance)]++;
+}
+
+/**
+ * Number of leading bytes (up to max_length) that a and b have in common.
+ */
+static inline uint32_t
+png_match_length(uint8_t const *a, uint8_t const *b, uint32_t max_length) {
+  uint32_t length = 0;
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+  defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (length + 8 <= max_length) {
+    uint64_t word_a, word_b;
+    memcpy(&word_a, a + length, 8);
+    memcpy(&word_b, b + length, 8);
+    uint64_t diff = word_a ^ word_b;
+    if (diff) {
+      return length + (uint32_t)__builtin_ctzll(diff) / 8;
+    }
+    length += 8;
+  }
+#endif
+  while (length < max_length && a[length] == b[length]) {
+    length++;
+  }
+  return length;
+}
+
+static inline uint32_t png_hash(uint8_t const *bytes) {
+  uint32_t value = bytes[0] | bytes[1] << 8 | bytes[2] << 16;
+  return (value * 2654435761u) >> (32 - PNG_HASH_BITS);
+}
+
+static inline void
+png_insert(PngDeflater *deflater, uint8_t const *base, uint32_t pos) {
+  uint32_t hash = png_hash(base + pos);
+  deflater->prev[pos & PNG_WINDOW_MASK] = deflater->head[hash];
+  deflater->head[hash] = pos + 1;
+}
+
+/**
+ * Find the longest earlier match of base[pos, size) that is longer than
+ * min_length - 1. pos must already be inserted into the hash chains.
+ *
+ * A longer match only replaces a closer one if it is at least one byte
+ * longer per additional extra bit of its distance. On input, `distance`
+ * is the distance of a match of length min_length - 1 to improve on
+ * (0 if there is none).
+ * Returns 0 if no better match was found.
+ */
+static uint32_t png_find_match(
+  PngDeflater const *deflater,
+  uint8_t const *base,
+  uint32_t pos,
+  uint32_t size,
+  uint32_t min_length,
+  uint32_t chain,
+  uint32_t nice_length,
+  uint32_t *distance
+) {
+  uint32_t max_length =
+    size - pos < PNG_MAX_MATCH ? size - pos : PNG_MAX_MATCH;
+  if (max_length < min_length) {
+    return 0;
+  }
+
+  uint32_t limit = pos > PNG_MAX_DISTANCE ? pos - PNG_MAX_DISTANCE : 0;
+  uint32_t best_length = min_length - 1;
+  uint32_t best_distance = *distance;
+  uint32_t best_extra =
+    best_distance ? png_dist_extra[png_dist_code(deflater, best_distance)] : 0;
+  bool is_found = false;
+  uint8_t const *current = base + pos;
+
+  // Chain entries are positions + 1, so 0 ends every chain
+  for (uint32_t entry = deflater->prev[pos & PNG_WINDOW_MASK];
+       entry > limit && chain > 0;
+       chain--) {
+    uint32_t candidate = entry - 1;
+    uint8_t const *match = base + candidate;
+    if (match[best_length] == current[best_length] && match[0] == current[0]) {
+      uint32_t length = png_match_length(match, current, max_length);
+      uint32_t extra =
+        png_dist_extra[png_dist_code(deflater, pos - candidate)];
+      if (length > best_length &&
+          (!best_distance || length - best_length + best_extra >= extra)) {
+        best_length = length;
+        best_distance = pos - candidate;
+        best_extra = extra;
+        is_found = true;
+        if (length >= nice_length || length == max_length) {
+          break;
+        }
+      }
+    }
+    entry = deflater->prev[candidate & PNG_WINDOW_MASK];
+  }
+
+  *distance = best_distance;
+  return is_found ? best_length : 0;
+}
+
+/**
+ * Compress base[dict_size, size) as a sequence of deflate blocks.
+ * base[0, dict_size) is earlier data that matches may refer to.
+ */
+static void png_compress(
+  PngDeflater *deflater,
+  PngBitWriter *writer,
+  uint8_t const *base,
+  uint32_t dict_size,
+  uint32_t size,
+  int32_t level,
+  bool final
+) {
+  PngLevelConfig const *config = &png_level_configs[level];
+  memset(deflater->litlen_freqs, 0, sizeof(deflater->litlen_freqs));
+  memset(deflater->dist_freqs, 0, sizeof(deflater->dist_freqs));
+  deflater->num_tokens = 0;
+  deflater->block_start = dict_size;
+
+  uint32_t pos = dict_size;
+
+  if (level == 1) {
+    // Only runs of the previous byte (distance 1)
+    while (pos < size) {
+      uint32_t length = 0;
+      if (pos > 0) {
+        uint32_t max_length =
+          size - pos < PNG_MAX_MATCH ? size - pos : PNG_MAX_MATCH;
+        length = png_match_length(base + pos - 1, base + pos, max_length);
+      }
+      if (length >= PNG_MIN_MATCH) {
+        png_add_match(deflater, length, 1);
+        pos += length;
+      }
+      else {
+        png_add_literal(deflater, base[pos]);
+        pos++;
+      }
+      if (deflater->num_tokens == PNG_MAX_BLOCK_TOKENS) {
+        png_flush_block(deflater, writer, base, pos, false);
+      }
+    }
+    png_flush_block(deflater, writer, base, pos, final);
+    return;
+  }
+
+  memset(deflater->head, 0, sizeof(deflater->head));
+  for (uint32_t i = 0; i < dict_size && i + PNG_MIN_MATCH <= size; i++) {
+    png_insert(deflater, base, i);
+  }
+
+  // A match found at pos - 1 that waits for the result at pos
+  bool pending = false;
+  uint32_t pending_length = 0;
+  uint32_t pending_distance = 0;
+
+  while (pos < size) {
+    if (pos + PNG_MIN_MATCH <= size) {
+      png_insert(deflater, base, pos);
+    }
+
+    uint32_t distance = 0;
+    uint32_t length = 0;
+    if (!pending || pending_length < config->lazy_length) {
+      uint32_t min_length = PNG_MIN_MATCH;
+      uint32_t chain = config->chain_length;
+      if (pending && pending_length >= PNG_MIN_MATCH) {
+        // The match at pos has to pay for the literal at pos - 1
+        min_length = pending_length + 2;
+        distance = pending_distance;
+        if (pending_length >= config->good_length) {
+          chain >>= 2;
+        }
+      }
+      length = png_find_match(
+        deflater,
+        base,
+        pos,
+        size,
+        min_length,
+        chain,
+        config->nice_length,
+        &distance
+      );
+    }
+
+    uint32_t match_start = pos;
+    if (pending) {
+      pending = false;
+      if (pending_length >= PNG_MIN_MATCH && length == 0) {
+        // The earlier match wins
+        length = pending_length;
+        distance = pending_distance;
+        match_start = pos - 1;
+      }
+      else {
+        png_add_literal(deflater, base[pos - 1]);
+      }
+    }
+
+    if (length >= PNG_MIN_MATCH &&
+        (match_start < pos || length >= config->lazy_length)) {
+      png_add_match(deflater, length, distance);
+      uint32_t match_end = match_start + length;
+      for (uint32_t i = pos + 1; i < match_end; i++) {
+        if (i + PNG_MIN_MATCH <= size) {
+          png_insert(deflater, base, i);
+        }
+      }
+      pos = match_end;
+    }
+    else if (config->lazy_length > 0) {
+      pending = true;
+      pending_length = length;
+      pending_distance = distance;
+      pos++;
+    }
+    else {
+      png_add_literal(deflater, base[pos]);
+      pos++;
+    }
+
+    if (deflater->num_tokens >= PNG_MAX_BLOCK_TOKENS - 1) {
+      png_flush_block(deflater, writer, base, pending ? pos - 1 : pos, false);
+    }
+  }
+
+  if (pending) {
+    if (pending_length >= PNG_MIN_MATCH) {
+      png_add_match(deflater, pending_length, pending_distance);
+    }
+    else {
+      png_add_literal(deflater, base[pos - 1]);
+    }
+  }
+  png_flush_block(deflater, writer, base, pos, final);
+}
+
+/**
+ * Write data[start, end) as raw deflate blocks. Matches may refer back to
+ * data before start. Unless this is the final part of the stream, it ends
+ * with an empty stored block (sync flush), so the output ends on a byte
+ * boundary and further parts can simply be appended.
+ */
+static void png_deflate(
+  PngBitWriter *writer,
+  uint8_t const *data,
+  size_t start,
+  size_t end,
+  int32_t level,
+  bool final
+) {
+  size_t size = end - start;
+  if (level == 0) {
+    if (png_reserve(writer, size + 5 * (size / PNG_MAX_STORED + 1) + 8)) {
+      png_write_stored(writer, data + start, size, final);
+    }
+    return;
+  }
+
+  PngDeflater *deflater = png_create_deflater();
+  if (!deflater) {
+    writer->failed = true;
+    return;
+  }
+
+  do {
+    size_t segment_end =
+      end - start < PNG_SEGMENT_SIZE ? end : start + PNG_SEGMENT_SIZE;
+    size_t dict_size = start < PNG_WINDOW_SIZE ? start : PNG_WINDOW_SIZE;
+    png_compress(
+      deflater,
+      writer,
+      data + start - dict_size,
+      (uint32_t)dict_size,
+      (uint32_t)(segment_end - start + dict_size),
+      level,
+      final && segment_end == end
+    );
+    start = segment_end;
+  } while (start < end);
+  free(deflater);
+
+  if (!final && png_reserve(writer, 16)) {
+    png_write_stored(writer, data + end, 0, false);
+  }
+}
+
+static inline uint32_t
+png_pack_color(uint8_t const *pixel, uint32_t channels) {
+  switch (channels) {
+  case 1:
+    return pixel[0] * 0x010101u | 0xFF000000u;
+  case 2:
+    return pixel[0] * 0x010101u | (uint32_t)pixel[1] << 24;
+  case 3:
+    return pixel[0] | pixel[1] << 8 | pixel[2] << 16 | 0xFF000000u;
+  default:
+    return pixel[0] | pixel[1] << 8 | pixel[2] << 16 | (uint32_t)pixel[3] << 24;
+  }
+}
+
+static inline uint32_t png_color_slot(uint32_t color) {
+  return (color * 2654435761u) >> 23;
+}
+
+/**
+ * Index of color in the table, or -1 if it is missing.
+ * If insert_index is not negative, a missing color is added with it.
+ */
+static int32_t
+png_lookup_color(PngColorTable *table, uint32_t color, int32_t insert_index) {
+  uint32_t slot = png_color_slot(color);
+  while (table->indices[slot] >= 0) {
+    if (table->keys[slot] == color) {
+      return table->indices[slot];
+    }
+    slot = (slot + 1) & 511;
+  }
+  if (insert_index >= 0) {
+    table->keys[slot] = color;
+    table->indices[slot] = (int16_t)insert_index;
+  }
+  return -1;
+}
+
+/**
+ * Smallest bit depth that represents the gray value exactly.
+ */
+static uint8_t png_gray_depth(uint32_t value) {
+  return value % 255 == 0  ? 1
+         : value % 85 == 0 ? 2
+         : value % 17 == 0 ? 4
+                           : 8;
+}
+
+/**
+ * Collect up to 256 distinct colors into the palette, transparent ones first.
+ * Returns false if there are more.
+ */
+static bool png_collect_palette(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *data,
+  PngFormat *format,
+  PngColorTable *table
+) {
+  memset(table->indices, 0xFF, sizeof(table->indices));
+  uint32_t colors[256];
+  uint32_t num_colors = 0;
+  uint32_t last_color = png_pack_color(data, channels) ^ 1;
+
+  size_t num_pixels = (size_t)width * height;
+  for (size_t i = 0; i < num_pixels; i++) {
+    uint32_t color = png_pack_color(data + i * channels, channels);
+    if (color == last_color) {
+      continue;
+    }
+    last_color = color;
+    if (png_lookup_color(table, color, (int32_t)num_colors) < 0) {
+      if (num_colors == 256) {
+        return false;
+      }
+      colors[num_colors++] = color;
+    }
+  }
+
+  uint32_t num_transparent = 0;
+  for (uint32_t i = 0; i < num_colors; i++) {
+    if (colors[i] >> 24 != 0xFF) {
+      format->palette[num_transparent++] = colors[i];
+    }
+  }
+  uint32_t palette_size = num_transparent;
+  for (uint32_t i = 0; i < num_colors; i++) {
+    if (colors[i] >> 24 == 0xFF) {
+      format->palette[palette_size++] = colors[i];
+    }
+  }
+
+  memset(table->indices, 0xFF, sizeof(table->indices));
+  for (uint32_t i = 0; i < palette_size; i++) {
+    png_lookup_color(table, format->palette[i], (int32_t)i);
+  }
+
+  format->palette_size = palette_size;
+  format->num_transparent = num_transparent;
+  format->bit_depth = palette_size <= 2    ? 1
+                      : palette_size <= 4  ? 2
+                      : palette_size <= 16 ? 4
+                                           : 8;
+  return true;
+}
+
+/**
+ * Choose the smallest lossless PNG format for the image.
+ */
+static void png_choose_format(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *data,
+  bool reduce,
+  PngFormat *format,
+  PngColorTable *table
+) {
+  static const uint8_t color_types[4] = {0, 4, 2, 6};
+  format->color_type = color_types[channels - 1];
+  format->bit_depth = 8;
+  format->palette_size = 0;
+  format->num_transparent = 0;
+  if (!reduce) {
+    return;
+  }
+
+  bool is_opaque = true;
+  bool is_gray = true;
+  bool used_grays[256] = {false};
+  size_t num_pixels = (size_t)width * height;
+  for (size_t i = 0; i < num_pixels; i++) {
+    uint8_t const *pixel = data + i * channels;
+    if (channels >= 3 && (pixel[0] != pixel[1] || pixel[0] != pixel[2])) {
+      is_gray = false;
+    }
+    if ((channels == 2 || channels == 4) && pixel[channels - 1] != 0xFF) {
+      is_opaque = false;
+    }
+    used_grays[pixel[0]] = true;
+  }
+
+  if (is_gray && is_opaque) {
+    uint8_t gray_depth = 1;
+    uint32_t num_grays = 0;
+    for (uint32_t value = 0; value < 256; value++) {
+      if (used_grays[value]) {
+        num_grays++;
+        if (png_gray_depth(value) > gray_depth) {
+          gray_depth = png_gray_depth(value);
+        }
+      }
+    }
+    // A palette only helps if it needs fewer bits per pixel
+    if (gray_depth < 8 || num_grays > 16) {
+      format->color_type = 0;
+      format->bit_depth = gray_depth;
+      return;
+    }
+  }
+
+  if (png_collect_palette(width, height, channels, data, format, table)) {
+    format->color_type = 3;
+    return;
+  }
+
+  format->color_type = is_gray ? (is_opaque ? 0 : 4) : (is_opaque ? 2 : 6);
+}
+
+static uint32_t png_samples_per_pixel(uint8_t color_type) {
+  switch (color_type) {
+  case 2:
+    return 3;
+  case 4:
+    return 2;
+  case 6:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+/**
+ * Convert a row of the input image into the chosen format.
+ */
+static void png_pack_row(
+  uint8_t const *row,
+  uint32_t width,
+  uint32_t channels,
+  PngFormat const *format,
+  PngColorTable *table,
+  uint8_t *out
+) {
+  if (format->color_type == 0 || format->color_type == 3) {
+    uint32_t depth = format->bit_depth;
+    uint32_t per_byte = 8 / depth;
+    uint32_t last_color = 0;
+    uint32_t last_value = 0;
+    if (format->color_type == 3) {
+      last_color = png_pack_color(row, channels);
+      last_value = (uint32_t)png_lookup_color(table, last_color, -1);
+    }
+
+    for (uint32_t x = 0; x < width; x += per_byte) {
+      uint32_t count = width - x < per_byte ? width - x : per_byte;
+      uint32_t byte = 0;
+      for (uint32_t i = 0; i < count; i++) {
+        uint8_t const *pixel = row + (size_t)(x + i) * channels;
+        uint32_t value;
+        if (format->color_type == 0) {
+          value = pixel[0] >> (8 - depth);
+        }
+        else {
+          uint32_t color = png_pack_color(pixel, channels);
+          if (color != last_color) {
+            last_color = color;
+            last_value = (uint32_t)png_lookup_color(table, color, -1);
+          }
+          value = last_value;
+        }
+        byte |= value << (8 - depth * (i + 1));
+      }
+      *out++ = (uint8_t)byte;
+    }
+    return;
+  }
+
+  // Gray with alpha from 4 channels, or RGB without the alpha channel
+  uint32_t samples = png_samples_per_pixel(format->color_type);
+  for (uint32_t x = 0; x < width; x++) {
+    uint8_t const *pixel = row + (size_t)x * channels;
+    if (samples == 2) {
+      out[0] = pixel[0];
+      out[1] = pixel[channels - 1];
+    }
+    else {
+      memcpy(out, pixel, samples);
+    }
+    out += samples;
+  }
+}
+
+static inline uint8_t png_paeth(uint8_t a, uint8_t b, uint8_t c) {
+  int32_t p = a + b - c;
+  int32_t pa = abs(p - a);
+  int32_t pb = abs(p - b);
+  int32_t pc = abs(p - c);
+  return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+/**
+ * Magnitude of a filtered byte read as signed value.
+ */
+static inline uint32_t png_residual(uint8_t value) {
+  return value < 128 ? value : 256 - value;
+}
+
+static void png_filter_row(
+  uint8_t filter,
+  uint8_t const *row,
+  uint8_t const *prior,
+  size_t row_bytes,
+  uint32_t bpp,
+  uint8_t *out
+) {
+  size_t i = 0;
+  switch (filter) {
+  case 0:
+    memcpy(out, row, row_bytes);
+    break;
+  case 1:
+    for (; i < bpp; i++) {
+      out[i] = row[i];
+    }
+    for (; i < row_bytes; i++) {
+      out[i] = (uint8_t)(row[i] - row[i - bpp]);
+    }
+    break;
+  case 2:
+    for (; i < row_bytes; i++) {
+      out[i] = (uint8_t)(row[i] - prior[i]);
+    }
+    break;
+  case 3:
+    for (; i < bpp; i++) {
+      out[i] = (uint8_t)(row[i] - (prior[i] >> 1));
+    }
+    for (; i < row_bytes; i++) {
+      out[i] = (uint8_t)(row[i] - ((row[i - bpp] + prior[i]) >> 1));
+    }
+    break;
+  default:
+    for (; i < bpp; i++) {
+      out[i] = (uint8_t)(row[i] - prior[i]);
+    }
+    for (; i < row_bytes; i++) {
+      uint8_t predictor = png_paeth(row[i - bpp], prior[i], prior[i - bpp]);
+      out[i] = (uint8_t)(row[i] - predictor);
+    }
+    break;
+  }
+}
+
+/**
+ * Pick the filter with the smallest sum of absolute residuals,
+ * scoring all five filters in a single pass over the row.
+ */
+static uint8_t png_pick_filter(
+  uint8_t const *row,
+  uint8_t const *prior,
+  size_t row_bytes,
+  uint32_t bpp
+) {
+  uint64_t sums[5] = {0};
+  for (size_t i = 0; i < row_bytes; i++) {
+    uint8_t a = i >= bpp ? row[i - bpp] : 0;
+    uint8_t b = prior[i];
+    uint8_t c = i >= bpp ? prior[i - bpp] : 0;
+    uint8_t x = row[i];
+    sums[0] += png_residual(x);
+    sums[1] += png_residual((uint8_t)(x - a));
+    sums[2] += png_residual((uint8_t)(x - b));
+    sums[3] += png_residual((uint8_t)(x - ((a + b) >> 1)));
+    sums[4] += png_residual((uint8_t)(x - png_paeth(a, b, c)));
+  }
+
+  uint8_t best = 0;
+  for (uint8_t filter = 1; filter < 5; filter++) {
+    if (sums[filter] < sums[best]) {
+      best = filter;
+    }
+  }
+  return best;
+}
+
+/**
+ * Pick None or Up for packed rows, whichever yields fewer byte runs.
+ */
+static uint8_t png_pick_packed_filter(
+  uint8_t const *row,
+  uint8_t const *prior,
+  size_t row_bytes
+) {
+  size_t none_runs = 0;
+  size_t up_runs = 0;
+  uint8_t last_up = (uint8_t)(row[0] - prior[0]);
+  for (size_t i = 1; i < row_bytes; i++) {
+    uint8_t up = (uint8_t)(row[i] - prior[i]);
+    none_runs += row[i] != row[i - 1];
+    up_runs += up != last_up;
+    last_up = up;
+  }
+  return up_runs < none_runs ? 2 : 0;
+}
+
+static uint8_t *
+png_put_chunk_header(uint8_t *out, uint32_t size, char const type[4]) {
+  out[0] = (uint8_t)(size >> 24);
+  out[1] = (uint8_t)(size >> 16);
+  out[2] = (uint8_t)(size >> 8);
+  out[3] = (uint8_t)size;
+  memcpy(out + 4, type, 4);
+  return out + 8;
+}
+
+/**
+ * Append the CRC of the chunk that starts at chunk (its length field)
+ * and ends at end.
+ */
+static uint8_t *png_put_chunk_crc(
+  uint32_t const crc_table[256],
+  uint8_t *chunk,
+  uint8_t *end
+) {
+  uint32_t crc = png_crc(crc_table, 0, chunk + 4, (size_t)(end - chunk - 4));
+  end[0] = (uint8_t)(crc >> 24);
+  end[1] = (uint8_t)(crc >> 16);
+  end[2] = (uint8_t)(crc >> 8);
+  end[3] = (uint8_t)crc;
+  return end + 4;
+}
+
+static uint32_t
+png_adler32_combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+  uint32_t remainder = (uint32_t)(size2 % 65521);
+  uint32_t sum1 = adler1 & 0xFFFF;
+  uint32_t sum2 = (uint32_t)(((uint64_t)remainder * sum1) % 65521);
+  sum1 += (adler2 & 0xFFFF) + 65521 - 1;
+  sum2 += (adler1 >> 16) + (adler2 >> 16) + 65521 - remainder;
+  sum1 %= 65521;
+  sum2 %= 65521;
+  return sum2 << 16 | sum1;
+}
+
+FCVPngEncoder *fcv_png_encoder_create(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  FCVPngOptions const *options,
+  uint32_t *num_parts
+) {
+  FCVPngOptions defaults = fcv_png_default_options();
+  if (!options) {
+    options = &defaults;
+  }
+  if (!data || !num_parts || width == 0 || height == 0 || channels == 0 ||
+      channels > 4 || options->level < 0 || options->level > 9 ||
+      (int32_t)options->filter < 0 ||
+      options->filter > FCV_PNG_FILTER_ADAPTIVE || width > 0x7FFFFFFF ||
+      height > 0x7FFFFFFF) {
+    return NULL;
+  }
+
+  // Check for overflow:
+  size_t in_row_bytes = (size_t)width * channels;
+  if (in_row_bytes / channels != width || in_row_bytes > SIZE_MAX / height) {
+    return NULL;
+  }
+
+  FCVPngEncoder *encoder = calloc(1, sizeof(FCVPngEncoder));
+  if (!encoder) {
+    return NULL;
+  }
+  encoder->width = width;
+  encoder->height = height;
+  encoder->level = options->level;
+
+  PngFormat *format = &encoder->format;
+  PngColorTable table;
+  png_choose_format(
+    width,
+    height,
+    channels,
+    data,
+    options->reduce,
+    format,
+    &table
+  );
+
+  uint32_t bits_per_pixel =
+    format->bit_depth * png_samples_per_pixel(format->color_type);
+  size_t row_bytes = ((size_t)width * bits_per_pixel + 7) / 8;
+  uint32_t bpp = bits_per_pixel < 8 ? 1 : bits_per_pixel / 8;
+  bool is_packed = format->color_type == 3 || format->bit_depth < 8;
+  bool is_identity = !is_packed && bits_per_pixel == channels * 8;
+
+  // Check for overflow:
+  if (row_bytes + 1 > SIZE_MAX / height) {
+    free(encoder);
+    return NULL;
+  }
+  encoder->filtered_size = (row_bytes + 1) * height;
+
+  size_t rows_per_part = PNG_PART_SIZE / (row_bytes + 1);
+  if (rows_per_part == 0) {
+    rows_per_part = 1;
+  }
+  encoder->num_parts = (uint32_t)((height - 1) / rows_per_part + 1);
+
+  encoder->filtered = malloc(encoder->filtered_size);
+  encoder->parts = calloc(encoder->num_parts, sizeof(PngPart));
+  uint8_t *rows = calloc(2, row_bytes);
+  if (!encoder->filtered || !encoder->parts || !rows) {
+    free(rows);
+    fcv_png_encoder_free(encoder);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < encoder->num_parts; i++) {
+    encoder->parts[i].start = i * rows_per_part * (row_bytes + 1);
+    encoder->parts[i].end = i + 1 < encoder->num_parts
+                              ? (i + 1) * rows_per_part * (row_bytes + 1)
+                              : encoder->filtered_size;
+  }
+
+  uint8_t *prior = rows;
+  uint8_t *current = rows + row_bytes;
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t const *in_row = data + y * in_row_bytes;
+    uint8_t const *row = in_row;
+    if (!is_identity) {
+      png_pack_row(in_row, width, channels, format, &table, current);
+      row = current;
+    }
+    uint8_t const *prior_row = prior;
+    if (is_identity && y > 0) {
+      prior_row = in_row - in_row_bytes;
+    }
+
+    uint8_t filter;
+    if (options->filter != FCV_PNG_FILTER_ADAPTIVE) {
+      filter = (uint8_t)options->filter;
+    }
+    else if (options->level == 0) {
+      filter = 0;
+    }
+    else if (is_packed) {
+      filter = png_pick_packed_filter(row, prior_row, row_bytes);
+    }
+    else {
+      filter = png_pick_filter(row, prior_row, row_bytes, bpp);
+    }
+
+    uint8_t *out = encoder->filtered + y * (row_bytes + 1);
+    out[0] = filter;
+    png_filter_row(filter, row, prior_row, row_bytes, bpp, out + 1);
+
+    if (!is_identity) {
+      uint8_t *swap = prior;
+      prior = current;
+      current = swap;
+    }
+  }
+  free(rows);
+
+  *num_parts = encoder->num_parts;
+  return encoder;
+}
+
+bool fcv_png_encoder_compress(FCVPngEncoder *encoder, uint32_t part_index) {
+  if (!encoder || part_index >= encoder->num_parts) {
+    return false;
+  }
+
+  PngPart *part = &encoder->parts[part_index];
+  bool is_final = part_index + 1 == encoder->num_parts;
+  png_deflate(
+    &part->output,
+    encoder->filtered,
+    part->start,
+    part->end,
+    encoder->level,
+    is_final
+  );
+  if (is_final && png_reserve(&part->output, 8)) {
+    png_align(&part->output);
+  }
+
+  // Matches can cost more than the literals they replace (e.g. on photos
+  // with smooth residuals), so the runs of level 1 are kept if they are
+  // smaller. They take a fraction of the time of the matching levels.
+  if (encoder->level > 1 && !part->output.failed) {
+    PngBitWriter runs = {0};
+    png_deflate(
+      &runs,
+      encoder->filtered,
+      part->start,
+      part->end,
+      1,
+      is_final
+    );
+    if (is_final && png_reserve(&runs, 8)) {
+      png_align(&runs);
+    }
+    if (!runs.failed && runs.size < part->output.size) {
+      free(part->output.data);
+      part->output = runs;
+    }
+    else {
+      free(runs.data);
+    }
+  }
+
+  part->adler = png_adler32(
+    1,
+    encoder->filtered + part->start,
+    part->end - part->start
+  );
+  part->is_compressed = !part->output.failed;
+  return part->is_compressed;
+}
+
+void fcv_png_encoder_free(FCVPngEncoder *encoder) {
+  if (!encoder) {
+    return;
+  }
+  if (encoder->parts) {
+    for (uint32_t i = 0; i < encoder->num_parts; i++) {
+      free(encoder->parts[i].output.data);
+    }
+  }
+  free(encoder->parts);
+  free(encoder->filtered);
+  free(encoder);
+}
+
+uint8_t *fcv_png_encoder_finish(FCVPngEncoder *encoder, size_t *out_size) {
+  if (!encoder) {
+    return NULL;
+  }
+  if (!out_size) {
+    fcv_png_encoder_free(encoder);
+    return NULL;
+  }
+
+  // zlib stream: header, the deflate parts and the Adler-32
+  // of the filtered data combined from the parts
+  size_t zlib_size = 2 + 4;
+  uint32_t adler = 1;
+  for (uint32_t i = 0; i < encoder->num_parts; i++) {
+    PngPart const *part = &encoder->parts[i];
+    if (!part->is_compressed) {
+      fcv_png_encoder_free(encoder);
+      return NULL;
+    }
+    zlib_size += part->output.size;
+    adler = png_adler32_combine(adler, part->adler, part->end - part->start);
+  }
+
+  uint8_t *zlib = malloc(zlib_size);
+  if (!zlib) {
+    fcv_png_encoder_free(encoder);
+    return NULL;
+  }
+  static const uint8_t zlib_levels[10] =
+    {0x01, 0x01, 0x5E, 0x5E, 0x5E, 0x5E, 0x9C, 0x9C, 0xDA, 0xDA};
+  zlib[0] = 0x78;
+  zlib[1] = zlib_levels[encoder->level];
+  size_t offset = 2;
+  for (uint32_t i = 0; i < encoder->num_parts; i++) {
+    PngBitWriter const *output = &encoder->parts[i].output;
+    memcpy(zlib + offset, output->data, output->size);
+    offset += output->size;
+  }
+  for (int32_t shift = 24; shift >= 0; shift -= 8) {
+    zlib[offset++] = (uint8_t)(adler >> shift);
+  }
+
+  PngFormat const *format = &encoder->format;
+  size_t num_idat = (zlib_size + PNG_MAX_CHUNK_DATA - 1) / PNG_MAX_CHUNK_DATA;
+  size_t png_size = 8 + 25 + 12 * (num_idat + 1) + zlib_size;
+  if (format->color_type == 3) {
+    png_size += 12 + 3 * format->palette_size;
+    if (format->num_transparent > 0) {
+      png_size += 12 + format->num_transparent;
+    }
+  }
+
+  uint8_t *png = malloc(png_size);
+  if (!png) {
+    free(zlib);
+    fcv_png_encoder_free(encoder);
+    return NULL;
+  }
+
+  uint32_t crc_table[256];
+  png_crc_table(crc_table);
+
+  static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  memcpy(png, signature, 8);
+  uint8_t *out = png + 8;
+
+  uint8_t *chunk = out;
+  out = png_put_chunk_header(out, 13, "IHDR");
+  for (int32_t shift = 24; shift >= 0; shift -= 8) {
+    out[0] = (uint8_t)(encoder->width >> shift);
+    out[4] = (uint8_t)(encoder->height >> shift);
+    out++;
+  }
+  out += 4;
+  *out++ = format->bit_depth;
+  *out++ = format->color_type;
+  *out++ = 0; // Compression method
+  *out++ = 0; // Filter method
+  *out++ = 0; // No interlacing
+  out = png_put_chunk_crc(crc_table, chunk, out);
+
+  if (format->color_type == 3) {
+    chunk = out;
+    out = png_put_chunk_header(out, 3 * format->palette_size, "PLTE");
+    for (uint32_t i = 0; i < format->palette_size; i++) {
+      *out++ = (uint8_t)format->palette[i];
+      *out++ = (uint8_t)(format->palette[i] >> 8);
+      *out++ = (uint8_t)(format->palette[i] >> 16);
+    }
+    out = png_put_chunk_crc(crc_table, chunk, out);
+
+    if (format->num_transparent > 0) {
+      chunk = out;
+      out = png_put_chunk_header(out, format->num_transparent, "tRNS");
+      for (uint32_t i = 0; i < format->num_transparent; i++) {
+        *out++ = (uint8_t)(format->palette[i] >> 24);
+      }
+      out = png_put_chunk_crc(crc_table, chunk, out);
+    }
+  }
+  fcv_png_encoder_free(encoder);
+
+  for (offset = 0; offset < zlib_size; offset += PNG_MAX_CHUNK_DATA) {
+    size_t size = zlib_size - offset < PNG_MAX_CHUNK_DATA ? zlib_size - offset
+                                                          : PNG_MAX_CHUNK_DATA;
+    chunk = out;
+    out = png_put_chunk_header(out, (uint32_t)size, "IDAT");
+    memcpy(out, zlib + offset, size);
+    out = png_put_chunk_crc(crc_table, chunk, out + size);
+  }
+  free(zlib);
+
+  chunk = out;
+  out = png_put_chunk_header(out, 0, "IEND");
+  png_put_chunk_crc(crc_table, chunk, out);
+
+  *out_size = png_size;
+  return png;
+}
+
+uint8_t *fcv_encode_png(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  FCVPngOptions const *options,
+  size_t *out_size
+) {
+  if (!out_size) {
+    return NULL;
+  }
+
+  uint32_t num_parts;
+  FCVPngEncoder *encoder =
+    fcv_png_encoder_create(width, height, channels, data, options, &num_parts);
+  for (uint32_t i = 0; encoder && i < num_parts; i++) {
+    if (!fcv_png_encoder_compress(encoder, i)) {
+      break;
+    }
+  }
+  return fcv_png_encoder_finish(encoder, out_size);
+}
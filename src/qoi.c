@@ -0,0 +1,260 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "qoi.h"
+#else
+#include "flatcv.h"
+#endif
+
+#define QOI_OP_INDEX 0x00 // 00xxxxxx: Pixel from the color index
+#define QOI_OP_DIFF 0x40  // 01rrggbb: Small difference to the previous pixel
+#define QOI_OP_LUMA 0x80  // 10gggggg rrrrbbbb: Difference relative to green
+#define QOI_OP_RUN 0xC0   // 11xxxxxx: Repeat the previous pixel 1-62 times
+#define QOI_OP_RGB 0xFE
+#define QOI_OP_RGBA 0xFF
+#define QOI_MASK 0xC0
+#define QOI_HEADER_SIZE 14
+#define QOI_MAX_RUN 62
+
+static const uint8_t qoi_end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+typedef struct {
+  uint8_t r, g, b, a;
+} QoiPixel;
+
+static inline uint32_t qoi_hash(QoiPixel pixel) {
+  return (pixel.r * 3u + pixel.g * 5u + pixel.b * 7u + pixel.a * 11u) % 64;
+}
+
+static inline bool qoi_equal(QoiPixel a, QoiPixel b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static inline void qoi_write_u32(uint8_t *out, uint32_t value) {
+  out[0] = (uint8_t)(value >> 24);
+  out[1] = (uint8_t)(value >> 16);
+  out[2] = (uint8_t)(value >> 8);
+  out[3] = (uint8_t)value;
+}
+
+static inline uint32_t qoi_read_u32(uint8_t const *in) {
+  return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 |
+         (uint32_t)in[3];
+}
+
+uint8_t *fcv_encode_qoi(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  size_t *out_size
+) {
+  if (!data || !out_size || width == 0 || height == 0 ||
+      (channels != 3 && channels != 4)) {
+    return NULL;
+  }
+
+  // Check for overflow: every pixel takes at most channels + 1 bytes
+  if ((size_t)width > SIZE_MAX / height) {
+    return NULL;
+  }
+  size_t num_pixels = (size_t)width * height;
+  if (num_pixels > (SIZE_MAX - QOI_HEADER_SIZE - 8) / (channels + 1)) {
+    return NULL;
+  }
+  size_t max_size =
+    QOI_HEADER_SIZE + num_pixels * (channels + 1) + sizeof(qoi_end_marker);
+  uint8_t *out = malloc(max_size);
+  if (!out) {
+    return NULL;
+  }
+
+  memcpy(out, "qoif", 4);
+  qoi_write_u32(out + 4, width);
+  qoi_write_u32(out + 8, height);
+  out[12] = (uint8_t)channels;
+  out[13] = 0; // sRGB with linear alpha
+  size_t pos = QOI_HEADER_SIZE;
+
+  QoiPixel index[64];
+  memset(index, 0, sizeof(index));
+  QoiPixel previous = {0, 0, 0, 255};
+  uint32_t run = 0;
+
+  for (size_t i = 0; i < num_pixels; i++) {
+    uint8_t const *src = data + i * channels;
+    QoiPixel pixel = {src[0], src[1], src[2], channels == 4 ? src[3] : 255};
+
+    if (qoi_equal(pixel, previous)) {
+      run++;
+      if (run == QOI_MAX_RUN) {
+        out[pos++] = (uint8_t)(QOI_OP_RUN | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+
+    if (run > 0) {
+      out[pos++] = (uint8_t)(QOI_OP_RUN | (run - 1));
+      run = 0;
+    }
+
+    uint32_t hash = qoi_hash(pixel);
+    if (qoi_equal(index[hash], pixel)) {
+      out[pos++] = (uint8_t)(QOI_OP_INDEX | hash);
+    }
+    else {
+      index[hash] = pixel;
+
+      if (pixel.a == previous.a) {
+        // Differences wrap around, e.g. 255 to 0 is +1
+        int32_t dr = (int8_t)(uint8_t)(pixel.r - previous.r);
+        int32_t dg = (int8_t)(uint8_t)(pixel.g - previous.g);
+        int32_t db = (int8_t)(uint8_t)(pixel.b - previous.b);
+        int32_t dr_dg = dr - dg;
+        int32_t db_dg = db - dg;
+
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          out[pos++] =
+            (uint8_t)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+        }
+        else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 &&
+                 db_dg >= -8 && db_dg <= 7) {
+          out[pos++] = (uint8_t)(QOI_OP_LUMA | (dg + 32));
+          out[pos++] = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+        }
+        else {
+          out[pos++] = QOI_OP_RGB;
+          out[pos++] = pixel.r;
+          out[pos++] = pixel.g;
+          out[pos++] = pixel.b;
+        }
+      }
+      else {
+        out[pos++] = QOI_OP_RGBA;
+        out[pos++] = pixel.r;
+        out[pos++] = pixel.g;
+        out[pos++] = pixel.b;
+        out[pos++] = pixel.a;
+      }
+    }
+    previous = pixel;
+  }
+
+  if (run > 0) {
+    out[pos++] = (uint8_t)(QOI_OP_RUN | (run - 1));
+  }
+  memcpy(out + pos, qoi_end_marker, sizeof(qoi_end_marker));
+  pos += sizeof(qoi_end_marker);
+
+  *out_size = pos;
+  return out;
+}
+
+uint8_t *fcv_decode_qoi(
+  uint8_t const *const data,
+  size_t size,
+  uint32_t *width,
+  uint32_t *height,
+  uint32_t *channels
+) {
+  if (!data || !width || !height || !channels ||
+      size < QOI_HEADER_SIZE + sizeof(qoi_end_marker) ||
+      memcmp(data, "qoif", 4) != 0) {
+    return NULL;
+  }
+
+  uint32_t file_width = qoi_read_u32(data + 4);
+  uint32_t file_height = qoi_read_u32(data + 8);
+  uint32_t file_channels = data[12];
+  if (file_width == 0 || file_height == 0 ||
+      (file_channels != 3 && file_channels != 4)) {
+    return NULL;
+  }
+
+  // Check for overflow: width * height * 4
+  if ((size_t)file_width > SIZE_MAX / file_height ||
+      (size_t)file_width * file_height > SIZE_MAX / 4) {
+    return NULL;
+  }
+  size_t num_pixels = (size_t)file_width * file_height;
+  uint8_t *pixels = malloc(num_pixels * 4);
+  if (!pixels) {
+    return NULL;
+  }
+
+  QoiPixel index[64];
+  memset(index, 0, sizeof(index));
+  QoiPixel pixel = {0, 0, 0, 255};
+  size_t pos = QOI_HEADER_SIZE;
+  size_t end = size - sizeof(qoi_end_marker);
+  uint32_t run = 0;
+
+  for (size_t i = 0; i < num_pixels; i++) {
+    if (run > 0) {
+      run--;
+    }
+    else {
+      if (pos >= end) {
+        free(pixels);
+        return NULL;
+      }
+      uint8_t op = data[pos++];
+
+      if (op == QOI_OP_RGB || op == QOI_OP_RGBA) {
+        size_t length = op == QOI_OP_RGB ? 3 : 4;
+        if (length > end - pos) {
+          free(pixels);
+          return NULL;
+        }
+        pixel.r = data[pos];
+        pixel.g = data[pos + 1];
+        pixel.b = data[pos + 2];
+        if (op == QOI_OP_RGBA) {
+          pixel.a = data[pos + 3];
+        }
+        pos += length;
+      }
+      else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+        pixel = index[op];
+      }
+      else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+        pixel.r += ((op >> 4) & 0x03) - 2;
+        pixel.g += ((op >> 2) & 0x03) - 2;
+        pixel.b += (op & 0x03) - 2;
+      }
+      else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+        if (pos >= end) {
+          free(pixels);
+          return NULL;
+        }
+        uint8_t second = data[pos++];
+        int32_t dg = (op & 0x3F) - 32;
+        pixel.r += dg - 8 + ((second >> 4) & 0x0F);
+        pixel.g += dg;
+        pixel.b += dg - 8 + (second & 0x0F);
+      }
+      else { // QOI_OP_RUN
+        run = op & 0x3F;
+      }
+
+      index[qoi_hash(pixel)] = pixel;
+    }
+
+    uint8_t *dst = pixels + i * 4;
+    dst[0] = pixel.r;
+    dst[1] = pixel.g;
+    dst[2] = pixel.b;
+    dst[3] = pixel.a;
+  }
+
+  *width = file_width;
+  *height = file_height;
+  *channels = file_channels;
+  return pixels;
+}
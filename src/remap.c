@@ -0,0 +1,222 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FLATCV_AMALGAMATION
+#include "bilinear.h"
+#include "remap.h"
+#else
+#include "flatcv.h"
+#endif
+
+#define REMAP_OUTSIDE UINT32_MAX
+
+
+/**
+ * Quantize a source position to a table entry
+ * (same rounding and border handling as fcv_apply_matrix_3x3).
+ */
+static FCVRemapEntry remap_entry(
+  uint32_t in_width,
+  uint32_t in_height,
+  double src_x,
+  double src_y
+) {
+  FCVRemapEntry outside = {REMAP_OUTSIDE, 0, 0};
+  if (!(src_x >= 0 && src_x < in_width && src_y >= 0 && src_y < in_height)) {
+    return outside;
+  }
+
+  int64_t fixed_x = (int64_t)(src_x * 65536.0);
+  int64_t fixed_y = (int64_t)(src_y * 65536.0);
+  uint32_t x0 = (uint32_t)(fixed_x >> 16);
+  uint32_t y0 = (uint32_t)(fixed_y >> 16);
+  if (x0 >= in_width || y0 >= in_height) {
+    return outside;
+  }
+
+  // The missing neighbour at the right and bottom border gets a weight of 0
+  FCVRemapEntry entry = {
+    .offset = y0 * in_width + x0,
+    .dx = x0 + 1 < in_width ? (uint16_t)(fixed_x & 0xFFFF) : 0,
+    .dy = y0 + 1 < in_height ? (uint16_t)(fixed_y & 0xFFFF) : 0,
+  };
+  return entry;
+}
+
+/**
+ * Allocate a table and validate its dimensions.
+ */
+static FCVRemapTable *remap_table_new(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint32_t out_width,
+  uint32_t out_height
+) {
+  if (in_width == 0 || in_height == 0 || out_width == 0 || out_height == 0) {
+    return NULL;
+  }
+
+  // Check for overflow: source offsets must fit into 32 bits
+  // with UINT32_MAX reserved for pixels outside of the input
+  if ((uint64_t)in_width * in_height >= REMAP_OUTSIDE) {
+    return NULL;
+  }
+
+  // Check for overflow: out_width * out_height * sizeof(FCVRemapEntry)
+  if ((size_t)out_width > SIZE_MAX / out_height) {
+    return NULL;
+  }
+  size_t num_entries = (size_t)out_width * out_height;
+  if (num_entries > SIZE_MAX / sizeof(FCVRemapEntry)) {
+    return NULL;
+  }
+
+  FCVRemapTable *table = malloc(sizeof(FCVRemapTable));
+  if (!table) {
+    return NULL;
+  }
+
+  table->entries = malloc(num_entries * sizeof(FCVRemapEntry));
+  if (!table->entries) {
+    free(table);
+    return NULL;
+  }
+
+  table->in_width = in_width;
+  table->in_height = in_height;
+  table->out_width = out_width;
+  table->out_height = out_height;
+  return table;
+}
+
+FCVRemapTable *fcv_remap_table_from_matrix(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint32_t out_width,
+  uint32_t out_height,
+  Matrix3x3 const *tmat
+) {
+  if (!tmat) {
+    return NULL;
+  }
+
+  FCVRemapTable *table =
+    remap_table_new(in_width, in_height, out_width, out_height);
+  if (!table) {
+    return NULL;
+  }
+
+  // Patch flip matrix if needed (like fcv_apply_matrix_3x3)
+  Matrix3x3 m = *tmat;
+  if (fabs(m.m00 + 1.0) < 1e-9 && fabs(m.m11 + 1.0) < 1e-9 && m.m02 == 0.0 &&
+      m.m12 == 0.0) {
+    m.m02 = in_width - 1.0;
+    m.m12 = in_height - 1.0;
+  }
+
+  FCVRemapEntry outside = {REMAP_OUTSIDE, 0, 0};
+  FCVRemapEntry *entry = table->entries;
+
+  for (uint32_t out_y = 0; out_y < out_height; out_y++) {
+    for (uint32_t out_x = 0; out_x < out_width; out_x++, entry++) {
+      double w = m.m20 * out_x + m.m21 * out_y + m.m22;
+      if (fabs(w) < 1e-10) {
+        *entry = outside;
+        continue;
+      }
+
+      double src_x = (m.m00 * out_x + m.m01 * out_y + m.m02) / w;
+      double src_y = (m.m10 * out_x + m.m11 * out_y + m.m12) / w;
+      *entry = remap_entry(in_width, in_height, src_x, src_y);
+    }
+  }
+
+  return table;
+}
+
+FCVRemapTable *fcv_remap_table_from_coords(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint32_t out_width,
+  uint32_t out_height,
+  float const *map_x,
+  float const *map_y
+) {
+  if (!map_x || !map_y) {
+    return NULL;
+  }
+
+  FCVRemapTable *table =
+    remap_table_new(in_width, in_height, out_width, out_height);
+  if (!table) {
+    return NULL;
+  }
+
+  size_t num_entries = (size_t)out_width * out_height;
+  for (size_t i = 0; i < num_entries; i++) {
+    table->entries[i] = remap_entry(in_width, in_height, map_x[i], map_y[i]);
+  }
+
+  return table;
+}
+
+void fcv_free_remap_table(FCVRemapTable *table) {
+  if (!table) {
+    return;
+  }
+  free(table->entries);
+  free(table);
+}
+
+bool fcv_remap_rows(
+  FCVRemapTable const *table,
+  uint8_t const *in_data,
+  uint32_t row_start,
+  uint32_t row_end,
+  uint8_t *out_data
+) {
+  if (!table || !table->entries || !in_data || !out_data ||
+      row_start > row_end || row_end > table->out_height) {
+    return false;
+  }
+
+  size_t in_row_length = (size_t)table->in_width * 4;
+  size_t end = (size_t)row_end * table->out_width;
+
+  for (size_t i = (size_t)row_start * table->out_width; i < end; i++) {
+    FCVRemapEntry entry = table->entries[i];
+    uint8_t *out = out_data + i * 4;
+    if (entry.offset == REMAP_OUTSIDE) {
+      memset(out, 0, 4);
+      continue;
+    }
+
+    // Neighbours with a weight of 0 are not read,
+    // so entries at the right and bottom border stay in bounds
+    uint8_t const *p0 = in_data + (size_t)entry.offset * 4;
+    uint8_t const *p1 = entry.dy ? p0 + in_row_length : p0;
+    size_t x_step = entry.dx ? 4 : 0;
+    bilinear_rgba(p0, p1, x_step, entry.dx, entry.dy, out);
+  }
+
+  return true;
+}
+
+uint8_t *fcv_remap(FCVRemapTable const *table, uint8_t const *in_data) {
+  if (!table || !table->entries || !in_data) {
+    return NULL;
+  }
+
+  size_t num_entries = (size_t)table->out_width * table->out_height;
+  uint8_t *out_data = malloc(num_entries * 4);
+  if (!out_data) {
+    return NULL;
+  }
+
+  fcv_remap_rows(table, in_data, 0, table->out_height, out_data);
+  return out_data;
+}
@@ -58,3 +58,36 @@ uint8_t *fcv_rgba_to_grayscale(
 
   return grayscale_data;
 }
+
+/**
+ * Convert raw RGB (3 channels) row-major top-to-bottom image data
+ * to single channel grayscale image data in place,
+ * with the same weights as fcv_rgba_to_grayscale.
+ * The gray pixels are written to the first third of the buffer.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data.
+ */
+void fcv_rgb_to_grayscale_in_place(
+  uint32_t width,
+  uint32_t height,
+  uint8_t *data
+) {
+  if (!data) {
+    return;
+  }
+
+  size_t img_length_px = (size_t)width * height;
+  // Gray pixel i only overwrites RGB values of pixels up to i,
+  // which were already read
+  for (size_t i = 0; i < img_length_px; i++) {
+    size_t rgb_index = i * 3;
+
+    uint8_t r = data[rgb_index];
+    uint8_t g = data[rgb_index + 1];
+    uint8_t b = data[rgb_index + 2];
+
+    data[i] = (r * R_WEIGHT + g * G_WEIGHT + b * B_WEIGHT) >> 8;
+  }
+}
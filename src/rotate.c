@@ -3,7 +3,9 @@
 #include <string.h>
 
 #ifndef FLATCV_AMALGAMATION
+#include "flip.h"
 #include "rotate.h"
+#include "transpose_tiled.h"
 #else
 #include "flatcv.h"
 #endif
@@ -33,19 +35,26 @@ fcv_rotate_90_cw(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
-  for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-      size_t src_index = ((size_t)y * width + x) * 4;
-      size_t dst_index = ((size_t)x * height + (height - 1 - y)) * 4;
+  fcv_rotate_90_cw_into(width, height, data, rotated_data);
 
-      rotated_data[dst_index] = data[src_index];
-      rotated_data[dst_index + 1] = data[src_index + 1];
-      rotated_data[dst_index + 2] = data[src_index + 2];
-      rotated_data[dst_index + 3] = data[src_index + 3];
-    }
+  return rotated_data;
+}
+
+/**
+ * Rotate an image 90 degrees clockwise
+ * into a buffer of the same size.
+ */
+void fcv_rotate_90_cw_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
   }
 
-  return rotated_data;
+  fcv_transpose_tiled(width, height, 4, data, out, false, true);
 }
 
 /**
@@ -73,20 +82,59 @@ fcv_rotate_180(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
+  fcv_rotate_180_into(width, height, data, rotated_data);
+
+  return rotated_data;
+}
+
+/**
+ * Rotate an image 180 degrees
+ * into a buffer of the same size.
+ */
+void fcv_rotate_180_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
+  }
+
   for (uint32_t y = 0; y < height; y++) {
     for (uint32_t x = 0; x < width; x++) {
       size_t src_index = ((size_t)y * width + x) * 4;
       size_t dst_index =
         ((size_t)(height - 1 - y) * width + (width - 1 - x)) * 4;
 
-      rotated_data[dst_index] = data[src_index];
-      rotated_data[dst_index + 1] = data[src_index + 1];
-      rotated_data[dst_index + 2] = data[src_index + 2];
-      rotated_data[dst_index + 3] = data[src_index + 3];
+      out[dst_index] = data[src_index];
+      out[dst_index + 1] = data[src_index + 1];
+      out[dst_index + 2] = data[src_index + 2];
+      out[dst_index + 3] = data[src_index + 3];
     }
   }
+}
+
+/**
+ * Rotate an image 180 degrees in place.
+ *
+ * A 180 degree rotation reverses the order of all pixels.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data (modified in-place).
+ */
+void fcv_rotate_180_in_place(uint32_t width, uint32_t height, uint8_t *data) {
+  if (!data || width == 0 || height == 0) {
+    return;
+  }
 
-  return rotated_data;
+  // Check for overflow: width * height * 4
+  if (width > SIZE_MAX / height || (size_t)width * height > SIZE_MAX / 4) {
+    return;
+  }
+
+  fcv_reverse_pixels(data, (size_t)width * height);
 }
 
 /**
@@ -114,17 +162,24 @@ fcv_rotate_270_cw(uint32_t width, uint32_t height, uint8_t const *const data) {
     return NULL;
   }
 
-  for (uint32_t y = 0; y < height; y++) {
-    for (uint32_t x = 0; x < width; x++) {
-      size_t src_index = ((size_t)y * width + x) * 4;
-      size_t dst_index = ((size_t)(width - 1 - x) * height + y) * 4;
+  fcv_rotate_270_cw_into(width, height, data, rotated_data);
 
-      rotated_data[dst_index] = data[src_index];
-      rotated_data[dst_index + 1] = data[src_index + 1];
-      rotated_data[dst_index + 2] = data[src_index + 2];
-      rotated_data[dst_index + 3] = data[src_index + 3];
-    }
+  return rotated_data;
+}
+
+/**
+ * Rotate an image 270 degrees clockwise
+ * into a buffer of the same size.
+ */
+void fcv_rotate_270_cw_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
   }
 
-  return rotated_data;
+  fcv_transpose_tiled(width, height, 4, data, out, true, false);
 }
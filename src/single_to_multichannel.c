@@ -45,13 +45,36 @@ uint8_t *fcv_single_to_multichannel(
     return NULL;
   }
 
+  fcv_single_to_multichannel_into(width, height, data, multichannel_data);
+
+  return multichannel_data;
+}
+
+/**
+ * Convert single channel grayscale image data to RGBA image data
+ * in a buffer of width * height * 4 bytes.
+ *
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param data Pointer to the pixel data.
+ * @param out Receives the RGBA image (must not overlap data).
+ */
+void fcv_single_to_multichannel_into(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *const data,
+  uint8_t *out
+) {
+  if (!data || !out) {
+    return;
+  }
+
+  size_t img_length_px = (size_t)width * height;
   for (size_t i = 0; i < img_length_px; i++) {
     size_t rgba_index = i * 4;
-    multichannel_data[rgba_index] = data[i];
-    multichannel_data[rgba_index + 1] = data[i];
-    multichannel_data[rgba_index + 2] = data[i];
-    multichannel_data[rgba_index + 3] = 255;
+    out[rgba_index] = data[i];
+    out[rgba_index + 1] = data[i];
+    out[rgba_index + 2] = data[i];
+    out[rgba_index + 3] = 255;
   }
-
-  return multichannel_data;
 }
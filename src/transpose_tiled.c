@@ -0,0 +1,262 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifndef FLATCV_AMALGAMATION
+#include "transpose_tiled.h"
+#else
+#include "flatcv.h"
+#endif
+
+// Side length of the square tiles (in pixels) that are kept in cache
+#define TRANSPOSE_TILE 128
+
+/**
+ * Destination layout: pixel (x, y) of the source is written to
+ * dst + (origin + x * x_step + y * y_step) * channels.
+ */
+typedef struct {
+  uint8_t const *src;
+  uint8_t *dst;
+  size_t width;
+  size_t channels;
+  ptrdiff_t origin;
+  ptrdiff_t x_step;
+  ptrdiff_t y_step;
+  bool reverse_columns;
+} TransposeLayout;
+
+static inline uint8_t *
+transpose_dst(TransposeLayout const *layout, size_t x, size_t y) {
+  ptrdiff_t index = layout->origin + (ptrdiff_t)x * layout->x_step +
+                    (ptrdiff_t)y * layout->y_step;
+  return layout->dst + index * (ptrdiff_t)layout->channels;
+}
+
+/**
+ * Copies the pixels of the region [x0, x1) x [y0, y1) one by one.
+ */
+static void transpose_region_scalar(
+  TransposeLayout const *layout,
+  size_t x0,
+  size_t x1,
+  size_t y0,
+  size_t y1
+) {
+  size_t channels = layout->channels;
+  for (size_t y = y0; y < y1; y++) {
+    uint8_t const *row = layout->src + y * layout->width * channels;
+    for (size_t x = x0; x < x1; x++) {
+      memcpy(transpose_dst(layout, x, y), row + x * channels, channels);
+    }
+  }
+}
+
+/**
+ * Transposes the 4 x 4 block of 32-bit pixels at (x, y).
+ */
+static inline void
+transpose_block_4x4_u32(TransposeLayout const *layout, size_t x, size_t y) {
+  size_t stride = layout->width * 4;
+  uint8_t const *s = layout->src + y * stride + x * 4;
+  bool reverse = layout->reverse_columns;
+  size_t first_y = reverse ? y + 3 : y;
+
+#if defined(__SSE2__)
+  __m128i r0 = _mm_loadu_si128((__m128i const *)(s));
+  __m128i r1 = _mm_loadu_si128((__m128i const *)(s + stride));
+  __m128i r2 = _mm_loadu_si128((__m128i const *)(s + 2 * stride));
+  __m128i r3 = _mm_loadu_si128((__m128i const *)(s + 3 * stride));
+
+  __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+  __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+  __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+  __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+  __m128i columns[4] = {
+    _mm_unpacklo_epi64(t0, t1),
+    _mm_unpackhi_epi64(t0, t1),
+    _mm_unpacklo_epi64(t2, t3),
+    _mm_unpackhi_epi64(t2, t3),
+  };
+
+  for (size_t i = 0; i < 4; i++) {
+    __m128i column = reverse
+                       ? _mm_shuffle_epi32(columns[i], _MM_SHUFFLE(0, 1, 2, 3))
+                       : columns[i];
+    _mm_storeu_si128((__m128i *)transpose_dst(layout, x + i, first_y), column);
+  }
+#elif defined(__ARM_NEON)
+  uint32x4_t r0 = vreinterpretq_u32_u8(vld1q_u8(s));
+  uint32x4_t r1 = vreinterpretq_u32_u8(vld1q_u8(s + stride));
+  uint32x4_t r2 = vreinterpretq_u32_u8(vld1q_u8(s + 2 * stride));
+  uint32x4_t r3 = vreinterpretq_u32_u8(vld1q_u8(s + 3 * stride));
+
+  uint32x4x2_t t01 = vtrnq_u32(r0, r1);
+  uint32x4x2_t t23 = vtrnq_u32(r2, r3);
+
+  uint32x4_t columns[4] = {
+    vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])),
+    vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])),
+    vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])),
+    vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])),
+  };
+
+  for (size_t i = 0; i < 4; i++) {
+    uint32x4_t column = columns[i];
+    if (reverse) {
+      column = vrev64q_u32(column);
+      column = vcombine_u32(vget_high_u32(column), vget_low_u32(column));
+    }
+    vst1q_u8(
+      transpose_dst(layout, x + i, first_y),
+      vreinterpretq_u8_u32(column)
+    );
+  }
+#else
+  uint32_t block[4][4];
+  for (size_t row = 0; row < 4; row++) {
+    memcpy(block[row], s + row * stride, 16);
+  }
+  for (size_t i = 0; i < 4; i++) {
+    uint32_t column[4];
+    for (size_t row = 0; row < 4; row++) {
+      column[reverse ? 3 - row : row] = block[row][i];
+    }
+    memcpy(transpose_dst(layout, x + i, first_y), column, 16);
+  }
+#endif
+}
+
+/**
+ * Reverses the byte order of a 64-bit word.
+ */
+static inline uint64_t transpose_reverse_bytes(uint64_t v) {
+  v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+  v = ((v >> 16) & 0x0000FFFF0000FFFFULL) |
+      ((v & 0x0000FFFF0000FFFFULL) << 16);
+  return (v >> 32) | (v << 32);
+}
+
+/**
+ * Transposes the 8 x 8 block of 8-bit pixels at (x, y).
+ *
+ * Each row is loaded into a 64-bit word and the block is transposed by
+ * swapping 1-, 2- and 4-byte sub-blocks with masks (SWAR),
+ * which needs no SIMD instructions.
+ */
+static inline void
+transpose_block_8x8_u8(TransposeLayout const *layout, size_t x, size_t y) {
+  size_t stride = layout->width;
+  uint8_t const *s = layout->src + y * stride + x;
+  uint64_t rows[8];
+  for (size_t i = 0; i < 8; i++) {
+    memcpy(&rows[i], s + i * stride, 8);
+  }
+
+  // Byte j of word i is pixel (x + j, y + i) on little-endian machines
+  for (size_t i = 0; i < 8; i += 2) {
+    uint64_t t = ((rows[i] >> 8) ^ rows[i + 1]) & 0x00FF00FF00FF00FFULL;
+    rows[i + 1] ^= t;
+    rows[i] ^= t << 8;
+  }
+  for (size_t i = 0; i < 8; i += 4) {
+    for (size_t j = i; j < i + 2; j++) {
+      uint64_t t = ((rows[j] >> 16) ^ rows[j + 2]) & 0x0000FFFF0000FFFFULL;
+      rows[j + 2] ^= t;
+      rows[j] ^= t << 16;
+    }
+  }
+  for (size_t i = 0; i < 4; i++) {
+    uint64_t t = ((rows[i] >> 32) ^ rows[i + 4]) & 0x00000000FFFFFFFFULL;
+    rows[i + 4] ^= t;
+    rows[i] ^= t << 32;
+  }
+
+  bool reverse = layout->reverse_columns;
+  size_t first_y = reverse ? y + 7 : y;
+  for (size_t i = 0; i < 8; i++) {
+    uint64_t column = reverse ? transpose_reverse_bytes(rows[i]) : rows[i];
+    memcpy(transpose_dst(layout, x + i, first_y), &column, 8);
+  }
+}
+
+static bool transpose_is_little_endian(void) {
+  uint16_t probe = 1;
+  uint8_t first_byte;
+  memcpy(&first_byte, &probe, 1);
+  return first_byte == 1;
+}
+
+void fcv_transpose_tiled(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const src,
+  uint8_t *dst,
+  bool reverse_rows,
+  bool reverse_columns
+) {
+  if (!src || !dst || width == 0 || height == 0 || channels == 0) {
+    return;
+  }
+
+  size_t w = width;
+  size_t h = height;
+  TransposeLayout layout = {
+    .src = src,
+    .dst = dst,
+    .width = w,
+    .channels = channels,
+    .origin = (ptrdiff_t)((reverse_rows ? (w - 1) * h : 0) +
+                          (reverse_columns ? h - 1 : 0)),
+    .x_step = reverse_rows ? -(ptrdiff_t)h : (ptrdiff_t)h,
+    .y_step = reverse_columns ? -1 : 1,
+    .reverse_columns = reverse_columns,
+  };
+
+  size_t block = 0;
+  if (channels == 4) {
+    block = 4;
+  }
+  else if (channels == 1 && transpose_is_little_endian()) {
+    block = 8;
+  }
+
+  for (size_t y0 = 0; y0 < h; y0 += TRANSPOSE_TILE) {
+    size_t y1 = y0 + TRANSPOSE_TILE < h ? y0 + TRANSPOSE_TILE : h;
+
+    for (size_t x0 = 0; x0 < w; x0 += TRANSPOSE_TILE) {
+      size_t x1 = x0 + TRANSPOSE_TILE < w ? x0 + TRANSPOSE_TILE : w;
+
+      if (block == 0) {
+        transpose_region_scalar(&layout, x0, x1, y0, y1);
+        continue;
+      }
+
+      // Full blocks column by column, so every destination row is written
+      // sequentially, then the right and bottom remainders of the tile
+      size_t bx1 = x0 + (x1 - x0) / block * block;
+      size_t by1 = y0 + (y1 - y0) / block * block;
+      for (size_t x = x0; x < bx1; x += block) {
+        for (size_t y = y0; y < by1; y += block) {
+          if (block == 4) {
+            transpose_block_4x4_u32(&layout, x, y);
+          }
+          else {
+            transpose_block_8x8_u8(&layout, x, y);
+          }
+        }
+      }
+      transpose_region_scalar(&layout, bx1, x1, y0, by1);
+      transpose_region_scalar(&layout, x0, x1, by1, y1);
+    }
+  }
+}
@@ -1,11 +1,14 @@
-#include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #ifndef FLATCV_AMALGAMATION
 #include "crop.h"
@@ -14,187 +17,265 @@
 #include "flatcv.h"
 #endif
 
-static bool
-pixels_match(const uint8_t *pixel1, const uint8_t *pixel2, uint32_t channels) {
-  for (uint32_t c = 0; c < channels; c++) {
-    if (pixel1[c] != pixel2[c]) {
-      return false;
+/**
+ * Check whether any byte of the 16 byte blocks a and b differs
+ * by more than the tolerance.
+ */
+#if defined(__SSE2__)
+static inline bool trim_block_differs(
+  uint8_t const *a,
+  uint8_t const *b,
+  __m128i tolerance
+) {
+  __m128i va = _mm_loadu_si128((__m128i const *)a);
+  __m128i vb = _mm_loadu_si128((__m128i const *)b);
+  __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+  __m128i excess = _mm_subs_epu8(diff, tolerance);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(excess, _mm_setzero_si128())) !=
+         0xFFFF;
+}
+#elif defined(__ARM_NEON)
+static inline bool trim_block_differs(
+  uint8_t const *a,
+  uint8_t const *b,
+  uint8x16_t tolerance
+) {
+  uint8x16_t excess = vcgtq_u8(vabdq_u8(vld1q_u8(a), vld1q_u8(b)), tolerance);
+  uint8x8_t folded = vorr_u8(vget_low_u8(excess), vget_high_u8(excess));
+  return vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0;
+}
+#endif
+
+static inline bool
+trim_byte_differs(uint8_t a, uint8_t b, uint8_t tolerance) {
+  return (a > b ? a - b : b - a) > tolerance;
+}
+
+/**
+ * Index of the first byte in [0, num_bytes) where a and b differ
+ * by more than the tolerance, or num_bytes if there is none.
+ * Whole 16 byte blocks are skipped with SIMD comparisons.
+ */
+static size_t trim_first_mismatch(
+  uint8_t const *a,
+  uint8_t const *b,
+  size_t num_bytes,
+  uint8_t tolerance
+) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  __m128i tolerance_vec = _mm_set1_epi8((char)tolerance);
+  while (i + 16 <= num_bytes &&
+         !trim_block_differs(a + i, b + i, tolerance_vec)) {
+    i += 16;
+  }
+#elif defined(__ARM_NEON)
+  uint8x16_t tolerance_vec = vdupq_n_u8(tolerance);
+  while (i + 16 <= num_bytes &&
+         !trim_block_differs(a + i, b + i, tolerance_vec)) {
+    i += 16;
+  }
+#endif
+
+  for (; i < num_bytes; i++) {
+    if (trim_byte_differs(a[i], b[i], tolerance)) {
+      return i;
     }
   }
-  return true;
+  return num_bytes;
 }
 
 /**
- * Check if two pixels match within a given tolerance.
- *
- * @param pixel1 First pixel data.
- * @param pixel2 Second pixel data.
- * @param channels Number of channels.
- * @param tolerance Maximum allowed difference per channel (0-255).
- * @return true if all channels are within tolerance, false otherwise.
+ * Index of the last byte in [0, num_bytes) where a and b differ
+ * by more than the tolerance, or num_bytes if there is none.
  */
-static bool pixels_match_threshold(
-  const uint8_t *pixel1,
-  const uint8_t *pixel2,
-  uint32_t channels,
+static size_t trim_last_mismatch(
+  uint8_t const *a,
+  uint8_t const *b,
+  size_t num_bytes,
   uint8_t tolerance
 ) {
-  for (uint32_t c = 0; c < channels; c++) {
-    int32_t diff = (int32_t)pixel1[c] - (int32_t)pixel2[c];
-    if (diff < 0) {
-      diff = -diff;
-    }
-    if ((uint8_t)diff > tolerance) {
-      return false;
+  size_t end = num_bytes;
+
+#if defined(__SSE2__)
+  __m128i tolerance_vec = _mm_set1_epi8((char)tolerance);
+  while (end >= 16 &&
+         !trim_block_differs(a + end - 16, b + end - 16, tolerance_vec)) {
+    end -= 16;
+  }
+#elif defined(__ARM_NEON)
+  uint8x16_t tolerance_vec = vdupq_n_u8(tolerance);
+  while (end >= 16 &&
+         !trim_block_differs(a + end - 16, b + end - 16, tolerance_vec)) {
+    end -= 16;
+  }
+#endif
+
+  while (end > 0) {
+    end--;
+    if (trim_byte_differs(a[end], b[end], tolerance)) {
+      return end;
     }
   }
-  return true;
+  return num_bytes;
 }
 
 /**
- * Trim border pixels that have the same color.
- *
- * @param width Pointer to width of the image (will be updated).
- * @param height Pointer to height of the image (will be updated).
- * @param channels Number of channels in the image.
- * @param data Pointer to the pixel data.
- * @return Pointer to the new trimmed image data.
+ * Check whether the pixels [left, right) of a row are all within the
+ * tolerance of the first one. reference_row is scratch space for at least
+ * right - left pixels.
  */
-uint8_t *fcv_trim(
-  int32_t *width,
-  int32_t *height,
+static bool trim_row_is_uniform(
+  uint8_t const *row,
+  uint32_t left,
+  uint32_t right,
   uint32_t channels,
-  uint8_t const *const data
+  uint8_t tolerance,
+  uint8_t *reference_row
 ) {
-  if (!data || !width || !height || *width <= 0 || *height <= 0 ||
-      channels == 0) {
-    return NULL;
+  uint8_t const *first = row + (size_t)left * channels;
+  size_t num_bytes = (size_t)(right - left) * channels;
+
+  // Fill the reference row with the first pixel by doubling the copied part
+  memcpy(reference_row, first, channels);
+  for (size_t filled = channels; filled < num_bytes; filled *= 2) {
+    size_t count = filled < num_bytes - filled ? filled : num_bytes - filled;
+    memcpy(reference_row + filled, reference_row, count);
   }
 
-  uint32_t w = (uint32_t)*width;
-  uint32_t h = (uint32_t)*height;
+  return trim_first_mismatch(first, reference_row, num_bytes, tolerance) ==
+         num_bytes;
+}
 
-  // Check for potential overflow in pixel index calculations
-  if (w > SIZE_MAX / h || (size_t)w * h > SIZE_MAX / channels) {
-    return NULL;
+bool fcv_trim_bounds(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *const data,
+  double threshold_percent,
+  uint32_t *left_out,
+  uint32_t *top_out,
+  uint32_t *width_out,
+  uint32_t *height_out
+) {
+  if (!data || !left_out || !top_out || !width_out || !height_out ||
+      width == 0 || height == 0 || channels == 0 ||
+      !isfinite(threshold_percent)) {
+    return false;
   }
-  uint32_t left = 0;
-  uint32_t top = 0;
-  uint32_t right = w;
-  uint32_t bottom = h;
-
-  // Trim from the left
-  while (left < right) {
-    const uint8_t *ref_pixel = &data[(top * w + left) * channels];
-    bool can_trim = true;
-
-    // Check if the entire left column has the same color as the reference pixel
-    for (uint32_t y = top; y < bottom; y++) {
-      const uint8_t *pixel = &data[(y * w + left) * channels];
-      if (!pixels_match(pixel, ref_pixel, channels)) {
-        can_trim = false;
-        break;
-      }
-    }
 
-    if (can_trim && right - left > 1) {
-      left++;
-    }
-    else {
-      break;
-    }
+  // Check for potential overflow in pixel index calculations
+  if (width > SIZE_MAX / height ||
+      (size_t)width * height > SIZE_MAX / channels) {
+    return false;
   }
 
-  // Trim from the right
-  while (left < right) {
-    const uint8_t *ref_pixel = &data[(top * w + (right - 1)) * channels];
-    bool can_trim = true;
-
-    // Check if the entire right column has the same color as the reference
-    // pixel
-    for (uint32_t y = top; y < bottom; y++) {
-      const uint8_t *pixel = &data[(y * w + (right - 1)) * channels];
-      if (!pixels_match(pixel, ref_pixel, channels)) {
-        can_trim = false;
-        break;
-      }
-    }
-
-    if (can_trim && right - left > 1) {
-      right--;
-    }
-    else {
-      break;
-    }
+  // Clamp threshold to valid range and convert to absolute value (0-255)
+  if (threshold_percent < 0.0) {
+    threshold_percent = 0.0;
   }
+  if (threshold_percent > 100.0) {
+    threshold_percent = 100.0;
+  }
+  uint8_t tolerance = (uint8_t)(threshold_percent * 255.0 / 100.0);
 
-  // Trim from the top
-  while (top < bottom && bottom - top > 1) {
-    const uint8_t *ref_pixel = &data[(top * w + left) * channels];
-    bool can_trim = true;
-
-    // Check if the entire top row has the same color as the reference pixel
-    for (uint32_t x = left; x < right; x++) {
-      const uint8_t *pixel = &data[(top * w + x) * channels];
-      if (!pixels_match(pixel, ref_pixel, channels)) {
-        can_trim = false;
-        break;
+  size_t row_length = (size_t)width * channels;
+
+  // Columns: a column can be trimmed if all its pixels match its top pixel.
+  // One row-major pass compares every row with the first one, but only
+  // outside of the columns that are already known to contain content.
+  size_t first_byte = row_length;
+  size_t last_byte = 0;
+  bool has_content = false;
+  for (uint32_t y = 1; y < height; y++) {
+    uint8_t const *row = data + y * row_length;
+
+    if (!has_content) {
+      first_byte = trim_first_mismatch(row, data, row_length, tolerance);
+      if (first_byte == row_length) {
+        continue;
       }
+      last_byte = trim_last_mismatch(row, data, row_length, tolerance);
+      has_content = true;
+      continue;
     }
 
-    if (can_trim) {
-      top++;
-    }
-    else {
-      break;
-    }
-  }
+    first_byte = trim_first_mismatch(row, data, first_byte, tolerance);
 
-  // Trim from the bottom
-  while (top < bottom && bottom - top > 1) {
-    const uint8_t *ref_pixel = &data[((bottom - 1) * w + left) * channels];
-    bool can_trim = true;
-
-    // Check if the entire bottom row has the same color as the reference pixel
-    for (uint32_t x = left; x < right; x++) {
-      const uint8_t *pixel = &data[((bottom - 1) * w + x) * channels];
-      if (!pixels_match(pixel, ref_pixel, channels)) {
-        can_trim = false;
-        break;
-      }
+    size_t tail = last_byte + 1;
+    size_t last =
+      trim_last_mismatch(row + tail, data + tail, row_length - tail, tolerance);
+    if (last != row_length - tail) {
+      last_byte = tail + last;
     }
 
-    if (can_trim) {
-      bottom--;
-    }
-    else {
+    // Content in the first and the last column: nothing to trim
+    if (first_byte < channels && last_byte >= row_length - channels) {
       break;
     }
   }
 
-  // Calculate new dimensions
-  uint32_t new_width = right - left;
-  uint32_t new_height = bottom - top;
+  // At least one column is kept
+  uint32_t left = has_content ? (uint32_t)(first_byte / channels) : width - 1;
+  uint32_t right = has_content ? (uint32_t)(last_byte / channels) + 1 : width;
 
-  // If no trimming was done, return a copy
-  if (left == 0 && top == 0 && right == w && bottom == h) {
-    size_t alloc_size = (size_t)w * h * channels;
-    uint8_t *result = malloc(alloc_size);
-    if (result) {
-      memcpy(result, data, alloc_size);
-    }
-    return result;
+  // Rows: a row can be trimmed if all its pixels in [left, right)
+  // match its first one
+  uint8_t *reference_row = malloc((size_t)(right - left) * channels);
+  if (!reference_row) {
+    return false;
   }
 
-  // Use existing crop function to extract the trimmed region
-  uint8_t *trimmed_data =
-    fcv_crop(w, h, channels, data, left, top, new_width, new_height);
+  uint32_t top = 0;
+  uint32_t bottom = height;
+  while (bottom - top > 1 &&
+         trim_row_is_uniform(
+           data + top * row_length,
+           left,
+           right,
+           channels,
+           tolerance,
+           reference_row
+         )) {
+    top++;
+  }
+  while (bottom - top > 1 &&
+         trim_row_is_uniform(
+           data + (bottom - 1) * row_length,
+           left,
+           right,
+           channels,
+           tolerance,
+           reference_row
+         )) {
+    bottom--;
+  }
+  free(reference_row);
 
-  // Update dimensions
-  *width = (int32_t)new_width;
-  *height = (int32_t)new_height;
+  *left_out = left;
+  *top_out = top;
+  *width_out = right - left;
+  *height_out = bottom - top;
+  return true;
+}
 
-  return trimmed_data;
+/**
+ * Trim border pixels that have the same color.
+ *
+ * @param width Pointer to width of the image (will be updated).
+ * @param height Pointer to height of the image (will be updated).
+ * @param channels Number of channels in the image.
+ * @param data Pointer to the pixel data.
+ * @return Pointer to the new trimmed image data.
+ */
+uint8_t *fcv_trim(
+  int32_t *width,
+  int32_t *height,
+  uint32_t channels,
+  uint8_t const *const data
+) {
+  return fcv_trim_threshold(width, height, channels, data, 0.0);
 }
 
 /**
@@ -216,151 +297,36 @@ uint8_t *fcv_trim_threshold(
   uint8_t const *const data,
   double threshold_percent
 ) {
-  if (!data || !width || !height || *width <= 0 || *height <= 0 ||
-      channels == 0) {
-    return NULL;
-  }
-
-  // Validate threshold_percent - reject invalid values
-  if (!isfinite(threshold_percent)) {
+  if (!data || !width || !height || *width <= 0 || *height <= 0) {
     return NULL;
   }
 
-  // Clamp threshold to valid range and convert to absolute value (0-255)
-  if (threshold_percent < 0.0) {
-    threshold_percent = 0.0;
-  }
-  if (threshold_percent > 100.0) {
-    threshold_percent = 100.0;
-  }
-  uint8_t tolerance = (uint8_t)(threshold_percent * 255.0 / 100.0);
-
-  // If tolerance is 0, use the exact match version
-  if (tolerance == 0) {
-    return fcv_trim(width, height, channels, data);
-  }
-
   uint32_t w = (uint32_t)*width;
   uint32_t h = (uint32_t)*height;
-
-  // Check for potential overflow in pixel index calculations
-  if (w > SIZE_MAX / h || (size_t)w * h > SIZE_MAX / channels) {
+  uint32_t left, top, new_width, new_height;
+  if (!fcv_trim_bounds(
+        w,
+        h,
+        channels,
+        data,
+        threshold_percent,
+        &left,
+        &top,
+        &new_width,
+        &new_height
+      )) {
     return NULL;
   }
-  uint32_t left = 0;
-  uint32_t top = 0;
-  uint32_t right = w;
-  uint32_t bottom = h;
-
-  // Trim from the left
-  while (left < right) {
-    const uint8_t *ref_pixel = &data[(top * w + left) * channels];
-    bool can_trim = true;
-
-    // Check if the entire left column matches within threshold
-    for (uint32_t y = top; y < bottom; y++) {
-      const uint8_t *pixel = &data[(y * w + left) * channels];
-      if (!pixels_match_threshold(pixel, ref_pixel, channels, tolerance)) {
-        can_trim = false;
-        break;
-      }
-    }
-
-    if (can_trim && right - left > 1) {
-      left++;
-    }
-    else {
-      break;
-    }
-  }
-
-  // Trim from the right
-  while (left < right) {
-    const uint8_t *ref_pixel = &data[(top * w + (right - 1)) * channels];
-    bool can_trim = true;
-
-    // Check if the entire right column matches within threshold
-    for (uint32_t y = top; y < bottom; y++) {
-      const uint8_t *pixel = &data[(y * w + (right - 1)) * channels];
-      if (!pixels_match_threshold(pixel, ref_pixel, channels, tolerance)) {
-        can_trim = false;
-        break;
-      }
-    }
-
-    if (can_trim && right - left > 1) {
-      right--;
-    }
-    else {
-      break;
-    }
-  }
-
-  // Trim from the top
-  while (top < bottom && bottom - top > 1) {
-    const uint8_t *ref_pixel = &data[(top * w + left) * channels];
-    bool can_trim = true;
-
-    // Check if the entire top row matches within threshold
-    for (uint32_t x = left; x < right; x++) {
-      const uint8_t *pixel = &data[(top * w + x) * channels];
-      if (!pixels_match_threshold(pixel, ref_pixel, channels, tolerance)) {
-        can_trim = false;
-        break;
-      }
-    }
-
-    if (can_trim) {
-      top++;
-    }
-    else {
-      break;
-    }
-  }
-
-  // Trim from the bottom
-  while (top < bottom && bottom - top > 1) {
-    const uint8_t *ref_pixel = &data[((bottom - 1) * w + left) * channels];
-    bool can_trim = true;
-
-    // Check if the entire bottom row matches within threshold
-    for (uint32_t x = left; x < right; x++) {
-      const uint8_t *pixel = &data[((bottom - 1) * w + x) * channels];
-      if (!pixels_match_threshold(pixel, ref_pixel, channels, tolerance)) {
-        can_trim = false;
-        break;
-      }
-    }
-
-    if (can_trim) {
-      bottom--;
-    }
-    else {
-      break;
-    }
-  }
-
-  // Calculate new dimensions
-  uint32_t new_width = right - left;
-  uint32_t new_height = bottom - top;
-
-  // If no trimming was done, return a copy
-  if (left == 0 && top == 0 && right == w && bottom == h) {
-    size_t alloc_size = (size_t)w * h * channels;
-    uint8_t *result = malloc(alloc_size);
-    if (result) {
-      memcpy(result, data, alloc_size);
-    }
-    return result;
-  }
 
   // Use existing crop function to extract the trimmed region
+  // (a plain copy if nothing was trimmed)
   uint8_t *trimmed_data =
     fcv_crop(w, h, channels, data, left, top, new_width, new_height);
 
-  // Update dimensions
-  *width = (int32_t)new_width;
-  *height = (int32_t)new_height;
+  if (trimmed_data) {
+    *width = (int32_t)new_width;
+    *height = (int32_t)new_height;
+  }
 
   return trimmed_data;
 }
@@ -0,0 +1,461 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef FLATCV_AMALGAMATION
+#include "bilinear.h"
+#include "rotate.h"
+#include "warp_affine.h"
+#include "warp_clip.h"
+#else
+#include "flatcv.h"
+#endif
+
+// Scale of the 32.32 fixed-point source coordinates
+#define AFFINE_ONE 4294967296.0
+
+// Precision of the bicubic weights and number of tabulated fractions
+#define AFFINE_CUBIC_BITS 12
+#define AFFINE_CUBIC_STEPS 256
+
+// Reduction of the horizontally filtered bicubic rows to 16 bits
+#define AFFINE_CUBIC_SHIFT 6
+
+/**
+ * Compute the span [*start, *end) of an output row whose source
+ * coordinates lie inside [min, max) in both dimensions.
+ * The span is padded by one pixel to absorb rounding,
+ * the exact test is still done per pixel.
+ */
+static void affine_row_span(
+  double x_row,
+  double y_row,
+  double x_step,
+  double y_step,
+  double min,
+  double max_x,
+  double max_y,
+  int64_t out_width,
+  int64_t *start,
+  int64_t *end
+) {
+  double lo = 0;
+  double hi = (double)(out_width - 1);
+
+  warp_clip_interval(x_row - min, x_step, &lo, &hi);
+  warp_clip_interval(max_x - x_row, -x_step, &lo, &hi);
+  warp_clip_interval(y_row - min, y_step, &lo, &hi);
+  warp_clip_interval(max_y - y_row, -y_step, &lo, &hi);
+
+  if (!(lo <= hi)) {
+    *start = 0;
+    *end = 0;
+    return;
+  }
+
+  *start = lo - 1 > 0 ? (int64_t)(lo - 1) : 0;
+  *end = hi + 2 < out_width ? (int64_t)(hi + 2) : out_width;
+}
+
+/**
+ * Fill the table of Catmull-Rom weights for AFFINE_CUBIC_STEPS fractions.
+ * Every row of 4 weights sums up to exactly 1 << AFFINE_CUBIC_BITS.
+ */
+static void affine_cubic_weights(int16_t weights[AFFINE_CUBIC_STEPS][4]) {
+  double scale = 1 << AFFINE_CUBIC_BITS;
+  for (int32_t i = 0; i < AFFINE_CUBIC_STEPS; i++) {
+    double t = (double)i / AFFINE_CUBIC_STEPS;
+    double t2 = t * t;
+    double t3 = t2 * t;
+    weights[i][0] = (int16_t)lround((-t3 + 2 * t2 - t) / 2 * scale);
+    weights[i][2] = (int16_t)lround((-3 * t3 + 4 * t2 + t) / 2 * scale);
+    weights[i][3] = (int16_t)lround((t3 - t2) / 2 * scale);
+    weights[i][1] = (int16_t)((1 << AFFINE_CUBIC_BITS) - weights[i][0] -
+                              weights[i][2] - weights[i][3]);
+  }
+}
+
+/**
+ * Bicubic sample around the anchor pixel (x0, y0)
+ * with neighbours outside of the image clamped to the border.
+ *
+ * The horizontally filtered rows are reduced to 16 bits
+ * (>> AFFINE_CUBIC_SHIFT), so that both steps are sums of 16 x 16 bit
+ * products and the SSE2 path matches the scalar path exactly.
+ */
+static void affine_bicubic(
+  uint8_t const *in_data,
+  int64_t in_width,
+  int64_t in_height,
+  int64_t x0,
+  int64_t y0,
+  int16_t const *weights_x,
+  int16_t const *weights_y,
+  uint8_t *out
+) {
+  // The 4 x 4 neighbourhood, with contiguous rows inside of the image
+  uint8_t block[4][16];
+  bool interior_x = x0 >= 1 && x0 + 2 < in_width;
+  for (int64_t j = 0; j < 4; j++) {
+    int64_t y = y0 - 1 + j;
+    y = y < 0 ? 0 : (y >= in_height ? in_height - 1 : y);
+    uint8_t const *row = in_data + (size_t)y * (size_t)in_width * 4;
+
+    if (interior_x) {
+      memcpy(block[j], row + (x0 - 1) * 4, 16);
+      continue;
+    }
+    for (int64_t i = 0; i < 4; i++) {
+      int64_t x = x0 - 1 + i;
+      x = x < 0 ? 0 : (x >= in_width ? in_width - 1 : x);
+      memcpy(block[j] + i * 4, row + x * 4, 4);
+    }
+  }
+
+  int32_t const shift = 2 * AFFINE_CUBIC_BITS - AFFINE_CUBIC_SHIFT;
+  int32_t const round = 1 << (shift - 1);
+
+#if defined(__SSE2__)
+  __m128i zero = _mm_setzero_si128();
+  __m128i weights_01 = _mm_set1_epi32(
+    (uint16_t)weights_x[0] | ((uint32_t)(uint16_t)weights_x[1] << 16)
+  );
+  __m128i weights_23 = _mm_set1_epi32(
+    (uint16_t)weights_x[2] | ((uint32_t)(uint16_t)weights_x[3] << 16)
+  );
+
+  __m128i rows[4];
+  for (int32_t j = 0; j < 4; j++) {
+    __m128i pixels = _mm_loadu_si128((__m128i const *)block[j]);
+    // Interleave the channels of neighbouring pixels: (p0, p1) and (p2, p3)
+    __m128i pairs_01 = _mm_unpacklo_epi8(
+      _mm_unpacklo_epi8(pixels, _mm_srli_si128(pixels, 4)),
+      zero
+    );
+    __m128i pairs_23 = _mm_unpacklo_epi8(
+      _mm_unpacklo_epi8(_mm_srli_si128(pixels, 8), _mm_srli_si128(pixels, 12)),
+      zero
+    );
+    __m128i horizontal = _mm_add_epi32(
+      _mm_madd_epi16(pairs_01, weights_01),
+      _mm_madd_epi16(pairs_23, weights_23)
+    );
+    rows[j] = _mm_srai_epi32(horizontal, AFFINE_CUBIC_SHIFT);
+  }
+
+  __m128i sum = _mm_set1_epi32(round);
+  for (int32_t j = 0; j < 4; j += 2) {
+    __m128i pair = _mm_or_si128(
+      _mm_and_si128(rows[j], _mm_set1_epi32(0xFFFF)),
+      _mm_slli_epi32(rows[j + 1], 16)
+    );
+    __m128i weights_y_pair = _mm_set1_epi32(
+      (uint16_t)weights_y[j] | ((uint32_t)(uint16_t)weights_y[j + 1] << 16)
+    );
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(pair, weights_y_pair));
+  }
+
+  __m128i result = _mm_srai_epi32(sum, shift);
+  result = _mm_packs_epi32(result, result);
+  result = _mm_packus_epi16(result, result);
+  int32_t packed = _mm_cvtsi128_si32(result);
+  memcpy(out, &packed, 4);
+#else
+  for (int32_t c = 0; c < 4; c++) {
+    int32_t sum = round;
+    for (int32_t j = 0; j < 4; j++) {
+      int32_t horizontal = block[j][c] * weights_x[0] +
+                           block[j][4 + c] * weights_x[1] +
+                           block[j][8 + c] * weights_x[2] +
+                           block[j][12 + c] * weights_x[3];
+      sum += (horizontal >> AFFINE_CUBIC_SHIFT) * weights_y[j];
+    }
+    int32_t value = sum >> shift;
+    out[c] = (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+  }
+#endif
+}
+
+bool fcv_warp_affine_rows(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint8_t const *in_data,
+  uint32_t out_width,
+  uint32_t out_height,
+  Matrix3x3 const *tmat,
+  FCVInterpolation interpolation,
+  uint32_t row_start,
+  uint32_t row_end,
+  uint8_t *out_data
+) {
+  if (!in_data || !tmat || !out_data || in_width == 0 || in_height == 0 ||
+      out_width == 0 || out_height == 0 || row_start > row_end ||
+      row_end > out_height) {
+    return false;
+  }
+
+  // Source coordinates of the span must fit into 32.32 fixed-point
+  if (in_width >= INT32_MAX || in_height >= INT32_MAX) {
+    return false;
+  }
+
+  int16_t(*cubic_weights)[4] = NULL;
+  if (interpolation == FCV_INTERPOLATION_BICUBIC) {
+    cubic_weights = malloc(AFFINE_CUBIC_STEPS * sizeof(*cubic_weights));
+    if (!cubic_weights) {
+      return false;
+    }
+    affine_cubic_weights(cubic_weights);
+  }
+
+  // Pixels outside of the spans stay transparent black
+  size_t out_row_length = (size_t)out_width * 4;
+  memset(
+    out_data + row_start * out_row_length,
+    0,
+    (row_end - row_start) * out_row_length
+  );
+
+  int64_t w = in_width;
+  int64_t h = in_height;
+  size_t in_row_length = (size_t)in_width * 4;
+
+  // Nearest neighbour rounds, the other modes truncate to the anchor pixel
+  bool nearest = interpolation == FCV_INTERPOLATION_NEAREST;
+  double min = nearest ? -0.5 : 0.0;
+  int64_t bias = nearest ? (int64_t)1 << 31 : 0;
+
+  // Constant steps along a row: no division or multiplication per pixel
+  int64_t step_x = (int64_t)llround(tmat->m00 * AFFINE_ONE);
+  int64_t step_y = (int64_t)llround(tmat->m10 * AFFINE_ONE);
+
+  for (uint32_t out_y = row_start; out_y < row_end; out_y++) {
+    double x_row = tmat->m01 * out_y + tmat->m02;
+    double y_row = tmat->m11 * out_y + tmat->m12;
+
+    int64_t start, end;
+    affine_row_span(
+      x_row,
+      y_row,
+      tmat->m00,
+      tmat->m10,
+      min,
+      (double)w + min,
+      (double)h + min,
+      out_width,
+      &start,
+      &end
+    );
+    if (start >= end) {
+      continue;
+    }
+
+    int64_t fixed_x =
+      (int64_t)llround((x_row + tmat->m00 * start) * AFFINE_ONE) + bias;
+    int64_t fixed_y =
+      (int64_t)llround((y_row + tmat->m10 * start) * AFFINE_ONE) + bias;
+    uint8_t *out =
+      out_data + ((size_t)out_y * out_width + (size_t)start) * 4;
+
+    for (int64_t out_x = start; out_x < end;
+         out_x++, out += 4, fixed_x += step_x, fixed_y += step_y) {
+      if (fixed_x < 0 || fixed_y < 0) {
+        continue;
+      }
+      int64_t x0 = fixed_x >> 32;
+      int64_t y0 = fixed_y >> 32;
+      if (x0 >= w || y0 >= h) {
+        continue;
+      }
+
+      uint8_t const *p0 = in_data + (size_t)y0 * in_row_length + x0 * 4;
+
+      switch (interpolation) {
+      case FCV_INTERPOLATION_NEAREST:
+        memcpy(out, p0, 4);
+        break;
+
+      case FCV_INTERPOLATION_BILINEAR: {
+        // The missing neighbour at the right and bottom border
+        // gets a weight of 0 (like fcv_remap)
+        uint32_t dx = x0 + 1 < w ? (uint32_t)(fixed_x >> 16) & 0xFFFF : 0;
+        uint32_t dy = y0 + 1 < h ? (uint32_t)(fixed_y >> 16) & 0xFFFF : 0;
+        uint8_t const *p1 = dy ? p0 + in_row_length : p0;
+        bilinear_rgba(p0, p1, dx ? 4 : 0, dx, dy, out);
+        break;
+      }
+
+      case FCV_INTERPOLATION_BICUBIC:
+        affine_bicubic(
+          in_data,
+          w,
+          h,
+          x0,
+          y0,
+          cubic_weights[(fixed_x >> 24) & 0xFF],
+          cubic_weights[(fixed_y >> 24) & 0xFF],
+          out
+        );
+        break;
+      }
+    }
+  }
+
+  free(cubic_weights);
+  return true;
+}
+
+uint8_t *fcv_warp_affine(
+  uint32_t in_width,
+  uint32_t in_height,
+  uint8_t const *in_data,
+  uint32_t out_width,
+  uint32_t out_height,
+  Matrix3x3 const *tmat,
+  FCVInterpolation interpolation
+) {
+  if (out_width == 0 || out_height == 0) {
+    return NULL;
+  }
+
+  // Check for overflow: out_width * out_height * 4
+  if ((size_t)out_width > SIZE_MAX / out_height) {
+    return NULL;
+  }
+  size_t num_pixels = (size_t)out_width * out_height;
+  if (num_pixels > SIZE_MAX / 4) {
+    return NULL;
+  }
+
+  uint8_t *out_data = malloc(num_pixels * 4);
+  if (!out_data) {
+    return NULL;
+  }
+
+  if (!fcv_warp_affine_rows(
+        in_width,
+        in_height,
+        in_data,
+        out_width,
+        out_height,
+        tmat,
+        interpolation,
+        0,
+        out_height,
+        out_data
+      )) {
+    free(out_data);
+    return NULL;
+  }
+  return out_data;
+}
+
+uint8_t *fcv_rotate_angle(
+  uint32_t width,
+  uint32_t height,
+  uint8_t const *data,
+  double angle,
+  FCVInterpolation interpolation,
+  bool expand,
+  uint32_t *out_width,
+  uint32_t *out_height
+) {
+  if (!data || !out_width || !out_height || width == 0 || height == 0 ||
+      !isfinite(angle)) {
+    return NULL;
+  }
+
+  // Normalize to (-180, 180]
+  double degrees = fmod(angle, 360.0);
+  if (degrees > 180) {
+    degrees -= 360;
+  }
+  else if (degrees <= -180) {
+    degrees += 360;
+  }
+
+  // Multiples of 90° on an expanded canvas are pixel permutations
+  if (expand && fmod(degrees, 90.0) == 0) {
+    bool swap = degrees == 90 || degrees == -90;
+    *out_width = swap ? height : width;
+    *out_height = swap ? width : height;
+
+    if (degrees == 90) {
+      return fcv_rotate_90_cw(width, height, data);
+    }
+    if (degrees == -90) {
+      return fcv_rotate_270_cw(width, height, data);
+    }
+    if (degrees == 180) {
+      return fcv_rotate_180(width, height, data);
+    }
+
+    // Check for overflow: width * height * 4
+    if ((size_t)width > SIZE_MAX / height ||
+        (size_t)width * height > SIZE_MAX / 4) {
+      return NULL;
+    }
+    size_t img_length_byte = (size_t)width * height * 4;
+    uint8_t *copy = malloc(img_length_byte);
+    if (copy) {
+      memcpy(copy, data, img_length_byte);
+    }
+    return copy;
+  }
+
+  double radians = degrees * M_PI / 180.0;
+  double cos_a = cos(radians);
+  double sin_a = sin(radians);
+
+  uint32_t new_width = width;
+  uint32_t new_height = height;
+  if (expand) {
+    // Bounding box of the rotated image (tolerating rounding errors)
+    double box_width = fabs(width * cos_a) + fabs(height * sin_a);
+    double box_height = fabs(width * sin_a) + fabs(height * cos_a);
+    if (box_width >= UINT32_MAX || box_height >= UINT32_MAX) {
+      return NULL;
+    }
+    new_width = (uint32_t)ceil(box_width - 1e-6);
+    new_height = (uint32_t)ceil(box_height - 1e-6);
+  }
+
+  // Output to input: rotate the centered output coordinates back
+  double center_x = (width - 1.0) / 2;
+  double center_y = (height - 1.0) / 2;
+  double center_out_x = (new_width - 1.0) / 2;
+  double center_out_y = (new_height - 1.0) / 2;
+  Matrix3x3 tmat = {
+    cos_a,
+    sin_a,
+    center_x - cos_a * center_out_x - sin_a * center_out_y,
+    -sin_a,
+    cos_a,
+    center_y + sin_a * center_out_x - cos_a * center_out_y,
+    0,
+    0,
+    1,
+  };
+  uint8_t *result = fcv_warp_affine(
+    width,
+    height,
+    data,
+    new_width,
+    new_height,
+    &tmat,
+    interpolation
+  );
+
+  if (result) {
+    *out_width = new_width;
+    *out_height = new_height;
+  }
+  return result;
+}
@@ -0,0 +1,23 @@
+#ifndef FLATCV_AMALGAMATION
+#pragma once
+#endif
+
+#include <math.h>
+
+/**
+ * Restrict the interval [*lo, *hi] to the x with a + b * x >= 0.
+ * The warps use it to find the range of output pixels of a row
+ * whose source position lies inside the input image.
+ */
+static inline void
+warp_clip_interval(double a, double b, double *lo, double *hi) {
+  if (b > 0) {
+    *lo = fmax(*lo, -a / b);
+  }
+  else if (b < 0) {
+    *hi = fmin(*hi, -a / b);
+  }
+  else if (a < 0) {
+    *hi = -INFINITY;
+  }
+}
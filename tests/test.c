@@ -6,19 +6,36 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
 #include "binary_closing_disk.h"
+#include "binary_image.h"
 #include "conversion.h"
+#include "crop.h"
+#include "distance_transform.h"
 #include "corner_peaks.h"
+#include "deskew.h"
 #include "draw.h"
 #include "exif.h"
 #include "flip.h"
 #include "foerstner_corner.h"
+#include "grayscale_morphology.h"
 #include "histogram.h"
+#include "jpeg_encode.h"
+#include "netpbm.h"
 #include "perspectivetransform.h"
+#include "pipeline.h"
+#include "png_encode.h"
+#include "qoi.h"
+#include "remap.h"
 #include "rgba_to_grayscale.h"
 #include "rotate.h"
+#include "single_to_multichannel.h"
 #include "sort_corners.h"
+#include "transpose_tiled.h"
 #include "trim.h"
+#include "warp_affine.h"
 
 int test_exif_orientation(void) {
   printf("Testing EXIF orientation detection...\n");
@@ -54,11 +71,60 @@ int test_exif_orientation(void) {
       else {
         printf("  %s: OK (%d)\n", cases[i].filename, orientation);
       }
+
+      // The same file parsed from memory, complete and cut off
+      f = fopen(cases[i].filename, "rb");
+      uint8_t *data = malloc(1 << 16);
+      size_t size = fread(data, 1, 1 << 16, f);
+      fclose(f);
+      int orientation_mem = fcv_get_exif_orientation_mem(data, size);
+      int orientation_cut = fcv_get_exif_orientation_mem(data, 20);
+      free(data);
+      if (orientation_mem != cases[i].expected || orientation_cut != 1) {
+        printf(
+          "❌ EXIF orientation test failed for %s in memory: "
+          "expected %d, got %d (cut off: %d)\n",
+          cases[i].filename,
+          cases[i].expected,
+          orientation_mem,
+          orientation_cut
+        );
+        test_ok = 1;
+      }
     }
     else {
       printf("  %s: Skipped (file not found)\n", cases[i].filename);
     }
   }
+
+  // A big-endian EXIF segment after an APP0 segment,
+  // with the orientation as second IFD entry
+  uint8_t const jpeg[] = {
+    0xFF, 0xD8, 0xFF, 0xE0, 0,    4,    0,    0,    0xFF, 0xE1, 0,
+    46,   'E',  'x',  'i',  'f',  0,    0,    'M',  'M',  0,    42,
+    0,    0,    0,    8,    0,    2,    0x01, 0x0F, 0,    2,    0,
+    0,    0,    1,    0,    0,    0,    0,    0x01, 0x12, 0,    3,
+    0,    0,    0,    1,    0,    6,    0,    0,    0,    0,    0,
+    0,    0xFF, 0xDA, 0,    8,
+  };
+  int orientation_mem = fcv_get_exif_orientation_mem(jpeg, sizeof(jpeg));
+  // A truncated EXIF segment is ignored
+  int orientation_cut = fcv_get_exif_orientation_mem(jpeg, 52);
+  int orientation_png =
+    fcv_get_exif_orientation_mem((uint8_t const *)"\x89PNG\r\n\x1A\n", 8);
+  if (orientation_mem != 6 || orientation_cut != 1 || orientation_png != 1) {
+    printf(
+      "❌ EXIF orientation test failed in memory: "
+      "got %d (cut off: %d, PNG: %d)\n",
+      orientation_mem,
+      orientation_cut,
+      orientation_png
+    );
+    test_ok = 1;
+  }
+  else {
+    printf("  In memory: OK (%d)\n", orientation_mem);
+  }
   return test_ok;
 }
 
@@ -122,6 +188,529 @@ int test_transformations(void) {
   return test_ok;
 }
 
+int test_fcv_transpose_tiled(void) {
+  int test_ok = 0;
+
+  // Sizes that are not multiples of the block and tile sizes
+  uint32_t width = 141;
+  uint32_t height = 37;
+
+  for (uint32_t channels = 1; channels <= 4; channels++) {
+    size_t length = (size_t)width * height * channels;
+    uint8_t *src = malloc(length);
+    uint8_t *dst = malloc(length);
+    for (size_t i = 0; i < length; i++) {
+      src[i] = (uint8_t)(i * 7 + i / 251);
+    }
+
+    for (int32_t mode = 0; mode < 4; mode++) {
+      bool reverse_rows = mode & 1;
+      bool reverse_columns = mode & 2;
+      fcv_transpose_tiled(
+        width,
+        height,
+        channels,
+        src,
+        dst,
+        reverse_rows,
+        reverse_columns
+      );
+
+      for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+          size_t dst_x = reverse_columns ? height - 1 - y : y;
+          size_t dst_y = reverse_rows ? width - 1 - x : x;
+          size_t src_index = ((size_t)y * width + x) * channels;
+          size_t dst_index = (dst_y * height + dst_x) * channels;
+          if (memcmp(dst + dst_index, src + src_index, channels) != 0) {
+            test_ok = 1;
+          }
+        }
+      }
+    }
+
+    free(src);
+    free(dst);
+  }
+
+  if (test_ok) {
+    printf("❌ Tiled transpose test failed\n");
+  }
+  else {
+    printf("✅ Tiled transpose test passed\n");
+  }
+  return test_ok;
+}
+
+int test_fcv_flip_in_place(void) {
+  int test_ok = 0;
+
+  uint32_t sizes[4][2] = {{1, 1}, {37, 5}, {16, 4}, {9, 1}};
+  for (int32_t i = 0; i < 4; i++) {
+    uint32_t width = sizes[i][0];
+    uint32_t height = sizes[i][1];
+    size_t length = (size_t)width * height * 4;
+    uint8_t *data = malloc(length);
+    for (size_t j = 0; j < length; j++) {
+      data[j] = (uint8_t)(j * 13 + 1);
+    }
+
+    uint8_t *expected = fcv_flip_x(width, height, data);
+    uint8_t *image = malloc(length);
+    memcpy(image, data, length);
+    fcv_flip_x_in_place(width, height, image);
+    if (memcmp(image, expected, length) != 0) {
+      test_ok = 1;
+    }
+    free(expected);
+
+    expected = fcv_flip_y(width, height, data);
+    memcpy(image, data, length);
+    fcv_flip_y_in_place(width, height, image);
+    if (memcmp(image, expected, length) != 0) {
+      test_ok = 1;
+    }
+    free(expected);
+
+    expected = fcv_rotate_180(width, height, data);
+    memcpy(image, data, length);
+    fcv_rotate_180_in_place(width, height, image);
+    if (memcmp(image, expected, length) != 0) {
+      test_ok = 1;
+    }
+    free(expected);
+
+    free(image);
+    free(data);
+  }
+
+  if (test_ok) {
+    printf("❌ In-place flip test failed\n");
+  }
+  else {
+    printf("✅ In-place flip test passed\n");
+  }
+  return test_ok;
+}
+
+int test_fcv_into_variants(void) {
+  int test_ok = 0;
+
+  uint32_t width = 37;
+  uint32_t height = 5;
+  size_t length = (size_t)width * height * 4;
+  uint8_t *data = malloc(length);
+  for (size_t j = 0; j < length; j++) {
+    data[j] = (uint8_t)(j * 13 + 1);
+  }
+  // One more byte to check that nothing is written past the image
+  uint8_t *out = malloc(length + 1);
+  uint8_t *back = malloc(length);
+  uint8_t *expected = malloc(length);
+
+  memcpy(expected, data, length);
+  fcv_flip_x_in_place(width, height, expected);
+  out[length] = 0xAB;
+  fcv_flip_x_into(width, height, data, out);
+  if (memcmp(out, expected, length) != 0 || out[length] != 0xAB) {
+    test_ok = 1;
+  }
+
+  memcpy(expected, data, length);
+  fcv_flip_y_in_place(width, height, expected);
+  fcv_flip_y_into(width, height, data, out);
+  if (memcmp(out, expected, length) != 0) {
+    test_ok = 1;
+  }
+
+  memcpy(expected, data, length);
+  fcv_rotate_180_in_place(width, height, expected);
+  fcv_rotate_180_into(width, height, data, out);
+  if (memcmp(out, expected, length) != 0) {
+    test_ok = 1;
+  }
+
+  // Rotating back and mirroring twice restores the image
+  fcv_rotate_90_cw_into(width, height, data, out);
+  fcv_rotate_270_cw_into(height, width, out, back);
+  if (memcmp(back, data, length) != 0 || out[length] != 0xAB) {
+    test_ok = 1;
+  }
+  fcv_transpose_into(width, height, data, out);
+  fcv_transpose_into(height, width, out, back);
+  if (memcmp(back, data, length) != 0) {
+    test_ok = 1;
+  }
+  fcv_transverse_into(width, height, data, out);
+  fcv_transverse_into(height, width, out, back);
+  if (memcmp(back, data, length) != 0) {
+    test_ok = 1;
+  }
+
+  // Grayscale can be converted in place
+  uint8_t *gray = fcv_grayscale(width, height, data);
+  memcpy(out, data, length);
+  fcv_grayscale_into(width, height, out, out);
+  if (memcmp(out, gray, length) != 0) {
+    test_ok = 1;
+  }
+
+  uint8_t *blurred = fcv_apply_gaussian_blur(width, height, 2, data);
+  if (!fcv_apply_gaussian_blur_into(width, height, 2, data, out) ||
+      memcmp(out, blurred, length) != 0 ||
+      fcv_apply_gaussian_blur_into(width, height, -1, data, out)) {
+    test_ok = 1;
+  }
+
+  uint32_t resized_width, resized_height;
+  uint8_t *resized =
+    fcv_resize(width, height, 0.5, 0.5, &resized_width, &resized_height, data);
+  size_t resized_length = (size_t)resized_width * resized_height * 4;
+  out[resized_length] = 0xAB;
+  if (!fcv_resize_into(
+        width,
+        height,
+        0.5,
+        0.5,
+        resized_width,
+        resized_height,
+        data,
+        out
+      ) ||
+      memcmp(out, resized, resized_length) != 0 ||
+      out[resized_length] != 0xAB) {
+    test_ok = 1;
+  }
+
+  // Row 2 to 3, column 10 to 13
+  if (!fcv_crop_into(width, height, 4, data, 10, 2, 4, 2, out) ||
+      memcmp(out, data + (2 * width + 10) * 4, 16) != 0 ||
+      memcmp(out + 16, data + (3 * width + 10) * 4, 16) != 0 ||
+      fcv_crop_into(width, height, 4, data, 36, 0, 2, 1, out)) {
+    test_ok = 1;
+  }
+
+  uint8_t single[3] = {0, 128, 255};
+  fcv_single_to_multichannel_into(3, 1, single, out);
+  uint8_t const rgba[12] =
+    {0, 0, 0, 255, 128, 128, 128, 255, 255, 255, 255, 255};
+  if (memcmp(out, rgba, sizeof(rgba)) != 0) {
+    test_ok = 1;
+  }
+
+  free(gray);
+  free(blurred);
+  free(resized);
+  free(expected);
+  free(back);
+  free(out);
+  free(data);
+
+  if (test_ok) {
+    printf("❌ Into variants test failed\n");
+  }
+  else {
+    printf("✅ Into variants test passed\n");
+  }
+  return test_ok;
+}
+
+static uint8_t *apply_test_invert(
+  int32_t *width,
+  int32_t *height,
+  FCVPipelineOp const *op,
+  uint8_t const *data,
+  FILE *output
+) {
+  (void)op;
+  (void)output;
+  size_t length = (size_t)*width * *height * 4;
+  uint8_t *result = malloc(length);
+  if (!result) {
+    return NULL;
+  }
+  for (size_t i = 0; i < length; i++) {
+    // Keep the alpha channel
+    result[i] = i % 4 == 3 ? data[i] : 255 - data[i];
+  }
+  return result;
+}
+
+int test_fcv_pipeline(void) {
+  int test_ok = 0;
+
+  int32_t width = 9;
+  int32_t height = 4;
+  size_t length = (size_t)width * height * 4;
+  uint8_t *data = malloc(length);
+  for (size_t j = 0; j < length; j++) {
+    data[j] = (uint8_t)(j * 7 + 3);
+  }
+  uint8_t *gray = fcv_grayscale(width, height, data);
+
+  // Flips which cancel out are removed and the pipeline can be reused
+  FCVPipeline *pipeline = fcv_pipeline_parse("grayscale, flip_x, (flip_x)");
+  if (!pipeline || fcv_pipeline_count(pipeline) != 3 ||
+      strcmp(fcv_pipeline_op(pipeline, 1)->operation, "flip_x") != 0 ||
+      fcv_pipeline_op(pipeline, 3) != NULL) {
+    test_ok = 1;
+  }
+  for (int32_t run = 0; pipeline && run < 2; run++) {
+    uint8_t *input = malloc(length);
+    memcpy(input, data, length);
+    int32_t out_width = width;
+    int32_t out_height = height;
+    uint8_t *result =
+      fcv_pipeline_run(pipeline, &out_width, &out_height, 4, input, NULL);
+    if (!result || out_width != width || out_height != height ||
+        memcmp(result, gray, length) != 0) {
+      test_ok = 1;
+    }
+    free(result);
+    free(input);
+  }
+  fcv_pipeline_free(pipeline);
+
+  // The result is a new image, even if no operation is left
+  pipeline = fcv_pipeline_parse("flip_x, flip_x");
+  uint8_t *input = malloc(length);
+  memcpy(input, data, length);
+  int32_t copy_width = width;
+  int32_t copy_height = height;
+  uint8_t *copy = NULL;
+  if (pipeline) {
+    copy =
+      fcv_pipeline_run(pipeline, &copy_width, &copy_height, 4, input, NULL);
+  }
+  if (!copy || copy == input || memcmp(copy, data, length) != 0) {
+    test_ok = 1;
+  }
+  free(copy);
+  free(input);
+  fcv_pipeline_free(pipeline);
+
+  // Resizing with a mirroring EXIF orientation gives the same pixels
+  // as orienting the image first
+  FCVPipeline *oriented = fcv_pipeline_parse("resize 50%");
+  FCVPipeline *flipped = fcv_pipeline_parse("flip_x, resize 50%");
+  FCVPipelineOptions const orientation_options = {2, NULL, NULL, NULL, NULL};
+  uint8_t *oriented_input = malloc(length);
+  uint8_t *flipped_input = malloc(length);
+  memcpy(oriented_input, data, length);
+  memcpy(flipped_input, data, length);
+  int32_t oriented_width = width;
+  int32_t oriented_height = height;
+  int32_t flipped_width = width;
+  int32_t flipped_height = height;
+  uint8_t *oriented_result = fcv_pipeline_run(
+    oriented,
+    &oriented_width,
+    &oriented_height,
+    4,
+    oriented_input,
+    &orientation_options
+  );
+  uint8_t *flipped_result = fcv_pipeline_run(
+    flipped,
+    &flipped_width,
+    &flipped_height,
+    4,
+    flipped_input,
+    NULL
+  );
+  if (!oriented_result || !flipped_result ||
+      oriented_width != flipped_width || oriented_height != flipped_height ||
+      memcmp(
+        oriented_result,
+        flipped_result,
+        (size_t)flipped_width * flipped_height * 4
+      ) != 0) {
+    test_ok = 1;
+  }
+  free(oriented_result);
+  free(flipped_result);
+  free(oriented_input);
+  free(flipped_input);
+  fcv_pipeline_free(oriented);
+  fcv_pipeline_free(flipped);
+
+  // With a transposing EXIF orientation, crop and resize match rotating
+  // the image first, up to 1 level from the summation order of the resize
+  int32_t const transposed_orientations[2] = {6, 8};
+  for (int32_t i = 0; i < 2; i++) {
+    int32_t exif_orientation = transposed_orientations[i];
+    uint8_t *rotated = exif_orientation == 6
+                         ? fcv_rotate_90_cw(width, height, data)
+                         : fcv_rotate_270_cw(width, height, data);
+    uint8_t *cropped = fcv_crop(height, width, 4, rotated, 1, 2, 2, 6);
+    uint32_t expected_width = 0;
+    uint32_t expected_height = 0;
+    uint8_t *expected_result = fcv_resize(
+      2,
+      6,
+      0.5,
+      0.5,
+      &expected_width,
+      &expected_height,
+      cropped
+    );
+
+    FCVPipeline *transposed = fcv_pipeline_parse("crop 2x6+1+2, resize 50%");
+    FCVPipelineOptions const transposed_options = {
+      exif_orientation,
+      NULL,
+      NULL,
+      NULL,
+      NULL,
+    };
+    uint8_t *transposed_input = malloc(length);
+    memcpy(transposed_input, data, length);
+    int32_t transposed_width = width;
+    int32_t transposed_height = height;
+    uint8_t *transposed_result = fcv_pipeline_run(
+      transposed,
+      &transposed_width,
+      &transposed_height,
+      4,
+      transposed_input,
+      &transposed_options
+    );
+    if (!expected_result || !transposed_result ||
+        transposed_width != (int32_t)expected_width ||
+        transposed_height != (int32_t)expected_height) {
+      test_ok = 1;
+    }
+    else {
+      for (size_t j = 0; j < (size_t)expected_width * expected_height * 4;
+           j++) {
+        if (abs(transposed_result[j] - expected_result[j]) > 1) {
+          test_ok = 1;
+        }
+      }
+    }
+    free(transposed_result);
+    free(transposed_input);
+    fcv_pipeline_free(transposed);
+    free(expected_result);
+    free(cropped);
+    free(rotated);
+  }
+
+  // Plans are cached per input size, also beyond the number of cached sizes,
+  // and the buffers of a context are reused for inputs of all sizes
+  char const *cached_text = "flip_x, crop 3x2+1+1, resize 200%";
+  FCVPipeline *cached = fcv_pipeline_parse(cached_text);
+  FCVPipelineContext *context = fcv_pipeline_context_new();
+  FCVPipelineOptions const context_options = {0, NULL, NULL, NULL, context};
+  for (int32_t run = 0; cached && run < 2; run++) {
+    for (int32_t size = 0; size < 12; size++) {
+      uint32_t crop_width = 4 + size % 6;
+      uint32_t crop_height = 3 + size / 6;
+      uint8_t *cropped =
+        fcv_crop(width, height, 4, data, 0, 0, crop_width, crop_height);
+      uint8_t *results[2] = {NULL, NULL};
+      int32_t widths[2];
+      int32_t heights[2];
+      FCVPipeline *fresh = fcv_pipeline_parse(cached_text);
+      FCVPipeline *pipelines[2] = {cached, fresh};
+      FCVPipelineOptions const *options[2] = {&context_options, NULL};
+      for (int32_t i = 0; cropped && fresh && i < 2; i++) {
+        uint8_t *input = malloc((size_t)crop_width * crop_height * 4);
+        memcpy(input, cropped, (size_t)crop_width * crop_height * 4);
+        widths[i] = (int32_t)crop_width;
+        heights[i] = (int32_t)crop_height;
+        results[i] = fcv_pipeline_run(
+          pipelines[i],
+          &widths[i],
+          &heights[i],
+          4,
+          input,
+          options[i]
+        );
+        free(input);
+      }
+      if (!results[0] || !results[1] || widths[0] != 6 || heights[0] != 4 ||
+          widths[1] != 6 || heights[1] != 4 ||
+          memcmp(results[0], results[1], 6 * 4 * 4) != 0) {
+        test_ok = 1;
+      }
+      free(results[0]);
+      free(results[1]);
+      fcv_pipeline_free(fresh);
+      free(cropped);
+    }
+  }
+  fcv_pipeline_context_free(context);
+  fcv_pipeline_free(cached);
+
+  // Unknown operations and invalid parameters are rejected
+  if (fcv_pipeline_parse("grayscale, unknown_operation") ||
+      fcv_pipeline_parse("crop 10") || fcv_pipeline_parse(NULL)) {
+    test_ok = 1;
+  }
+
+  // Registered operations are used like built-in ones
+  FCVOperation invert = {
+    "test_invert",
+    apply_test_invert,
+    NULL,
+    NULL,
+    FCV_OPERATION_SAME_SIZE,
+    NULL,
+  };
+  FCVOperation duplicate = invert;
+  duplicate.name = "grayscale";
+  FCVOperation invalid_name = invert;
+  invalid_name.name = "two words";
+  if (!fcv_register_operation(&invert) || fcv_register_operation(&invert) ||
+      fcv_register_operation(&duplicate) ||
+      fcv_register_operation(&invalid_name) ||
+      fcv_find_operation("test_invert") == NULL) {
+    test_ok = 1;
+  }
+
+  int32_t out_width = width;
+  int32_t out_height = height;
+  uint8_t *inverted =
+    apply_test_invert(&out_width, &out_height, NULL, data, NULL);
+  uint8_t *inverted_gray = fcv_grayscale(width, height, inverted);
+  uint8_t *expected =
+    apply_test_invert(&out_width, &out_height, NULL, inverted_gray, NULL);
+
+  pipeline = fcv_pipeline_parse("test_invert, grayscale, test_invert");
+  uint8_t *result = NULL;
+  if (pipeline) {
+    result = fcv_pipeline_run(
+      pipeline,
+      &out_width,
+      &out_height,
+      4,
+      data,
+      NULL
+    );
+  }
+  if (!result || out_width != width || out_height != height ||
+      memcmp(result, expected, length) != 0) {
+    test_ok = 1;
+  }
+  free(result);
+  free(expected);
+  free(inverted_gray);
+  free(inverted);
+  fcv_pipeline_free(pipeline);
+
+  free(gray);
+  free(data);
+
+  if (test_ok) {
+    printf("❌ Pipeline test failed\n");
+  }
+  else {
+    printf("✅ Pipeline test passed\n");
+  }
+  return test_ok;
+}
+
 /**
  * Utility function to create binary images from arrays of 0s and 1s.
  *
@@ -420,49 +1009,494 @@ int32_t test_perspective_transform_float(void) {
   }
 }
 
-void free_fcv_corner_peaks(CornerPeaks *peaks) {
-  if (peaks) {
-    free(peaks->points);
-    free(peaks);
+int32_t test_apply_matrix_3x3(void) {
+  bool test_ok = true;
+
+  // 6 x 2 image with a horizontal gradient in every channel
+  uint8_t data[6 * 2 * 4];
+  for (int32_t i = 0; i < 6 * 2; i++) {
+    memset(data + i * 4, (i % 6) * 40, 4);
+  }
+
+  // Test 1: Shift by half a pixel averages neighbours, the last column
+  // has no right neighbour and keeps its value
+  {
+    Matrix3x3 tmat = {1, 0, 0.5, 0, 1, 0, 0, 0, 1};
+    uint8_t *result = fcv_apply_matrix_3x3(6, 2, data, 6, 2, &tmat);
+    uint8_t expected[6] = {20, 60, 100, 140, 180, 200};
+    for (int32_t x = 0; result && x < 6; x++) {
+      if (result[x * 4] != expected[x] ||
+          result[(6 + x) * 4 + 3] != expected[x]) {
+        printf("x = %d: %d instead of %d\n", x, result[x * 4], expected[x]);
+        test_ok = false;
+      }
+    }
+    free(result);
+  }
+
+  // Test 2: Pixels that map outside of the image stay transparent black
+  {
+    Matrix3x3 tmat = {1, 0, -2, 0, 1, 0, 0, 0, 1};
+    uint8_t *result = fcv_apply_matrix_3x3(6, 2, data, 8, 2, &tmat);
+    for (int32_t x = 0; result && x < 8; x++) {
+      uint8_t expected = x >= 2 ? (x - 2) * 40 : 0;
+      if (result[x * 4] != expected || result[x * 4 + 3] != expected) {
+        printf("x = %d: %d instead of %d\n", x, result[x * 4], expected);
+        test_ok = false;
+      }
+    }
+    free(result);
+  }
+
+  // Test 3: Perspective warp matches a direct evaluation within 1
+  {
+    Matrix3x3 tmat = {0.7, 0.1, 0.3, -0.05, 0.8, 0.2, 0.01, 0.02, 1};
+    uint8_t *result = fcv_apply_matrix_3x3(6, 2, data, 9, 3, &tmat);
+    for (int32_t y = 0; result && y < 3; y++) {
+      for (int32_t x = 0; x < 9; x++) {
+        double w = tmat.m20 * x + tmat.m21 * y + tmat.m22;
+        double src_x = (tmat.m00 * x + tmat.m01 * y + tmat.m02) / w;
+        double src_y = (tmat.m10 * x + tmat.m11 * y + tmat.m12) / w;
+        double expected = 0;
+        if (src_x >= 0 && src_x < 6 && src_y >= 0 && src_y < 2) {
+          // The gradient only depends on x
+          int32_t x0 = (int32_t)src_x;
+          double dx = x0 + 1 < 6 ? src_x - x0 : 0;
+          expected = x0 * 40 + dx * 40;
+        }
+        if (fabs(result[(y * 9 + x) * 4] - expected) > 1) {
+          printf(
+            "(%d, %d): %d instead of %f\n",
+            x,
+            y,
+            result[(y * 9 + x) * 4],
+            expected
+          );
+          test_ok = false;
+        }
+      }
+    }
+    free(result);
+  }
+
+  // Test 4: Downscaling a 1 pixel checkerboard by 4 with anti-aliasing
+  // gives an even gray instead of an aliased pattern
+  {
+    uint8_t *board = malloc(64 * 64 * 4);
+    for (int32_t i = 0; i < 64 * 64; i++) {
+      memset(board + i * 4, ((i % 64) + (i / 64)) % 2 ? 255 : 0, 3);
+      board[i * 4 + 3] = 255;
+    }
+    Matrix3x3 tmat = {4, 0, 1.5, 0, 4, 1.5, 0, 0, 1};
+    uint8_t *result =
+      fcv_apply_matrix_3x3_antialiased(64, 64, board, 16, 16, &tmat);
+    for (int32_t i = 0; result && i < 16 * 16; i++) {
+      if (abs(result[i * 4] - 128) > 1 || result[i * 4 + 3] != 255) {
+        printf("pixel %d: %d instead of 128\n", i, result[i * 4]);
+        test_ok = false;
+        break;
+      }
+    }
+    free(result);
+    free(board);
+  }
+
+  if (test_ok) {
+    printf("✅ Apply matrix 3x3 test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Apply matrix 3x3 test failed\n");
+    return 1;
   }
 }
 
-int32_t test_fcv_foerstner_corner(void) {
-  // Create a simple test image with a corner pattern (5x5 RGBA)
-  uint32_t width = 5;
-  uint32_t height = 5;
+int32_t test_fcv_remap(void) {
+  bool test_ok = true;
 
-  // Create a simple corner pattern: white square on black background
-  uint8_t data[100] = {
-    // Row 0: all black
-    0,
-    0,
-    0,
-    255,
-    0,
-    0,
-    0,
-    255,
-    0,
-    0,
-    0,
-    255,
-    0,
-    0,
-    0,
-    255,
-    0,
-    0,
-    0,
-    255,
-    // Row 1: black, then white corner
-    0,
-    0,
-    0,
-    255,
-    0,
-    0,
-    0,
+  uint8_t data[7 * 5 * 4];
+  for (int32_t i = 0; i < 7 * 5 * 4; i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+
+  // Test 1: A table built from a matrix gives the same result as the warp
+  {
+    Matrix3x3 tmat = {0.75, 0.25, -0.5, -0.125, 0.5, 0.25, 0, 0, 1};
+    FCVRemapTable *table = fcv_remap_table_from_matrix(7, 5, 9, 8, &tmat);
+    uint8_t *expected = fcv_apply_matrix_3x3(7, 5, data, 9, 8, &tmat);
+    uint8_t *result = fcv_remap(table, data);
+    if (!table || !expected || !result ||
+        memcmp(result, expected, 9 * 8 * 4) != 0) {
+      printf("❌ Remap test failed: matrix table differs from the warp\n");
+      test_ok = false;
+    }
+    free(expected);
+    free(result);
+    fcv_free_remap_table(table);
+  }
+
+  // Test 2: Coordinate maps, including positions outside of the input
+  {
+    float map_x[3] = {2.0f, 6.5f, -0.5f};
+    float map_y[3] = {1.0f, 4.0f, 0.0f};
+    FCVRemapTable *table =
+      fcv_remap_table_from_coords(7, 5, 3, 1, map_x, map_y);
+    uint8_t *result = fcv_remap(table, data);
+    uint8_t const *corner = data + (4 * 7 + 6) * 4;
+    if (!result || memcmp(result, data + (1 * 7 + 2) * 4, 4) != 0 ||
+        memcmp(result + 4, corner, 4) != 0 || result[8] != 0 ||
+        result[11] != 0) {
+      printf("❌ Remap test failed: wrong coordinate map result\n");
+      test_ok = false;
+    }
+    free(result);
+    fcv_free_remap_table(table);
+  }
+
+  // Test 3: Warping the rows in chunks gives the same result as a whole
+  // warp and overwrites every pixel, including the ones outside the input
+  {
+    Matrix3x3 tmat = {0.75, 0.25, -2.5, -0.125, 0.5, 0.25, 0, 0, 1};
+    FCVRemapTable *table = fcv_remap_table_from_matrix(7, 5, 9, 8, &tmat);
+    uint8_t *expected = fcv_remap(table, data);
+    uint8_t result[9 * 8 * 4];
+    memset(result, 0xAB, sizeof(result));
+    bool ok = fcv_remap_rows(table, data, 0, 3, result) &&
+              fcv_remap_rows(table, data, 3, 3, result) &&
+              fcv_remap_rows(table, data, 3, 8, result);
+    if (!table || !expected || !ok ||
+        memcmp(result, expected, 9 * 8 * 4) != 0) {
+      printf("❌ Remap test failed: chunked rows differ from the warp\n");
+      test_ok = false;
+    }
+    if (fcv_remap_rows(table, data, 4, 9, result) ||
+        fcv_remap_rows(table, data, 5, 4, result)) {
+      printf("❌ Remap test failed: invalid row range accepted\n");
+      test_ok = false;
+    }
+    free(expected);
+    fcv_free_remap_table(table);
+  }
+
+  if (test_ok) {
+    printf("✅ Remap test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Remap test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_rotate_angle(void) {
+  bool test_ok = true;
+
+  uint8_t data[7 * 7 * 4];
+  for (int32_t i = 0; i < 7 * 7 * 4; i++) {
+    data[i] = (uint8_t)(i * 37 + 11);
+  }
+  uint8_t *expected_90 = fcv_rotate_90_cw(7, 7, data);
+
+  // Test 1: A quarter turn on a cropped canvas hits the pixel centers,
+  // so every interpolation mode matches the exact rotation
+  for (int32_t mode = 0; mode < 3; mode++) {
+    uint32_t out_width = 0;
+    uint32_t out_height = 0;
+    uint8_t *result = fcv_rotate_angle(
+      7,
+      7,
+      data,
+      90,
+      (FCVInterpolation)mode,
+      false,
+      &out_width,
+      &out_height
+    );
+    if (!result || !expected_90 || out_width != 7 || out_height != 7 ||
+        memcmp(result, expected_90, 7 * 7 * 4) != 0) {
+      printf("❌ Rotate angle test failed: mode %d differs at 90°\n", mode);
+      test_ok = false;
+    }
+    free(result);
+  }
+  free(expected_90);
+
+  // Test 2: The expanded canvas contains the whole rotated image
+  // and the corners outside of it are transparent black
+  {
+    uint8_t *white = malloc(100 * 50 * 4);
+    memset(white, 255, 100 * 50 * 4);
+    uint32_t out_width = 0;
+    uint32_t out_height = 0;
+    uint8_t *result = fcv_rotate_angle(
+      100,
+      50,
+      white,
+      -45,
+      FCV_INTERPOLATION_BILINEAR,
+      true,
+      &out_width,
+      &out_height
+    );
+    size_t center = ((size_t)out_height / 2 * out_width + out_width / 2) * 4;
+    if (!result || out_width != 107 || out_height != 107 || result[3] != 0 ||
+        result[center] != 255 || result[center + 3] != 255) {
+      printf(
+        "❌ Rotate angle test failed: %ux%u expanded canvas\n",
+        out_width,
+        out_height
+      );
+      test_ok = false;
+    }
+    free(result);
+    free(white);
+  }
+
+  // Test 3: Translations by whole and half pixels
+  {
+    Matrix3x3 shift = {1, 0, 2, 0, 1, 1, 0, 0, 1};
+    uint8_t *result =
+      fcv_warp_affine(7, 7, data, 7, 7, &shift, FCV_INTERPOLATION_NEAREST);
+    for (int32_t x = 0; result && x < 7; x++) {
+      uint8_t const *expected = x + 2 < 7 ? data + (7 + x + 2) * 4 : NULL;
+      uint8_t zero[4] = {0, 0, 0, 0};
+      if (memcmp(result + x * 4, expected ? expected : zero, 4) != 0) {
+        printf("❌ Rotate angle test failed: shifted pixel %d\n", x);
+        test_ok = false;
+      }
+    }
+    free(result);
+
+    uint8_t gradient[4 * 2 * 4] = {0};
+    for (int32_t i = 0; i < 8; i++) {
+      gradient[i * 4] = (uint8_t)((i % 4) * 40);
+    }
+    Matrix3x3 half = {1, 0, 0.5, 0, 1, 0, 0, 0, 1};
+    result = fcv_warp_affine(
+      4,
+      2,
+      gradient,
+      4,
+      2,
+      &half,
+      FCV_INTERPOLATION_BILINEAR
+    );
+    uint8_t expected[4] = {20, 60, 100, 120};
+    for (int32_t x = 0; result && x < 4; x++) {
+      if (result[x * 4] != expected[x]) {
+        printf(
+          "❌ Rotate angle test failed: %d instead of %d\n",
+          result[x * 4],
+          expected[x]
+        );
+        test_ok = false;
+      }
+    }
+    free(result);
+  }
+
+  // Test 4: Warping the rows in chunks gives the same result as a whole warp
+  {
+    Matrix3x3 tmat = {0.8, 0.3, -1.5, -0.2, 0.9, 0.75, 0, 0, 1};
+    for (int32_t mode = 0; mode < 3; mode++) {
+      uint8_t *expected =
+        fcv_warp_affine(7, 7, data, 6, 5, &tmat, (FCVInterpolation)mode);
+      uint8_t result[6 * 5 * 4];
+      memset(result, 0xAB, sizeof(result));
+      bool ok = true;
+      for (uint32_t row = 0; row < 5; row += 2) {
+        uint32_t row_end = row + 2 < 5 ? row + 2 : 5;
+        ok = ok && fcv_warp_affine_rows(
+                     7,
+                     7,
+                     data,
+                     6,
+                     5,
+                     &tmat,
+                     (FCVInterpolation)mode,
+                     row,
+                     row_end,
+                     result
+                   );
+      }
+      if (!expected || !ok || memcmp(result, expected, 6 * 5 * 4) != 0) {
+        printf("❌ Rotate angle test failed: mode %d chunked rows\n", mode);
+        test_ok = false;
+      }
+      free(expected);
+    }
+  }
+
+  if (test_ok) {
+    printf("✅ Rotate angle test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Rotate angle test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_estimate_skew(void) {
+  bool test_ok = true;
+
+  // A page with lines of "words" (dark bars of varying length)
+  uint32_t width = 400;
+  uint32_t height = 300;
+  uint8_t *page = malloc(width * height * 4);
+  memset(page, 255, width * height * 4);
+  for (uint32_t line_y = 30; line_y + 6 < 270; line_y += 16) {
+    uint32_t x = 30;
+    for (uint32_t word = 0; x < 370; word++) {
+      uint32_t word_end = x + 12 + (word * 7 + line_y) % 30;
+      for (uint32_t y = line_y; y < line_y + 6; y++) {
+        for (uint32_t i = x; i < word_end && i < 370; i++) {
+          memset(page + (y * width + i) * 4, 20, 3);
+        }
+      }
+      x = word_end + 6;
+    }
+  }
+
+  // Test 1: The angle of a rotated page is found
+  double angles[3] = {0, 3.5, -8};
+  for (int32_t i = 0; i < 3; i++) {
+    uint32_t rotated_width, rotated_height;
+    uint8_t *rotated = fcv_rotate_angle(
+      width,
+      height,
+      page,
+      angles[i],
+      FCV_INTERPOLATION_BILINEAR,
+      true,
+      &rotated_width,
+      &rotated_height
+    );
+    FCVSkewEstimate estimate =
+      fcv_estimate_skew(rotated_width, rotated_height, rotated);
+    if (fabs(estimate.angle - angles[i]) > 0.2 || estimate.confidence < 0.5) {
+      printf(
+        "❌ Estimate skew test failed: %.2f° (confidence %.2f) "
+        "instead of %.2f°\n",
+        estimate.angle,
+        estimate.confidence,
+        angles[i]
+      );
+      test_ok = false;
+    }
+    free(rotated);
+  }
+
+  // Test 2: The largest angles are found, also if the last band
+  // of 16 columns only has one column
+  double max_angles[2] = {15, -15};
+  for (int32_t i = 0; i < 2; i++) {
+    uint32_t rotated_width, rotated_height;
+    uint8_t *rotated = fcv_rotate_angle(
+      width,
+      height,
+      page,
+      max_angles[i],
+      FCV_INTERPOLATION_BILINEAR,
+      true,
+      &rotated_width,
+      &rotated_height
+    );
+    uint32_t cropped_width = 417; // 26 bands and one column
+    uint8_t *cropped = fcv_crop(
+      rotated_width,
+      rotated_height,
+      4,
+      rotated,
+      0,
+      0,
+      cropped_width,
+      rotated_height
+    );
+    FCVSkewEstimate estimate =
+      fcv_estimate_skew(cropped_width, rotated_height, cropped);
+    if (fabs(estimate.angle - max_angles[i]) > 0.2) {
+      printf(
+        "❌ Estimate skew test failed: %.2f° instead of %.2f°\n",
+        estimate.angle,
+        max_angles[i]
+      );
+      test_ok = false;
+    }
+    free(cropped);
+    free(rotated);
+  }
+
+  // Test 3: A blank page has no confidence and is not rotated
+  {
+    memset(page, 255, width * height * 4);
+    FCVSkewEstimate estimate;
+    uint32_t out_width, out_height;
+    uint8_t *result =
+      fcv_deskew(width, height, page, &out_width, &out_height, &estimate);
+    if (!result || estimate.confidence != 0 || out_width != width ||
+        out_height != height || memcmp(result, page, width * height * 4)) {
+      printf("❌ Estimate skew test failed: blank page was changed\n");
+      test_ok = false;
+    }
+    free(result);
+  }
+
+  free(page);
+
+  if (test_ok) {
+    printf("✅ Estimate skew test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Estimate skew test failed\n");
+    return 1;
+  }
+}
+
+void free_fcv_corner_peaks(CornerPeaks *peaks) {
+  if (peaks) {
+    free(peaks->points);
+    free(peaks);
+  }
+}
+
+int32_t test_fcv_foerstner_corner(void) {
+  // Create a simple test image with a corner pattern (5x5 RGBA)
+  uint32_t width = 5;
+  uint32_t height = 5;
+
+  // Create a simple corner pattern: white square on black background
+  uint8_t data[100] = {
+    // Row 0: all black
+    0,
+    0,
+    0,
+    255,
+    0,
+    0,
+    0,
+    255,
+    0,
+    0,
+    0,
+    255,
+    0,
+    0,
+    0,
+    255,
+    0,
+    0,
+    0,
+    255,
+    // Row 1: black, then white corner
+    0,
+    0,
+    0,
+    255,
+    0,
+    0,
+    0,
     255,
     0,
     0,
@@ -1081,6 +2115,42 @@ next_test:
     }
   }
 
+  // Test 5: Bounds of a wide 3-channel image (margins span SIMD blocks)
+  // whose content touches different columns in different rows
+  {
+    uint32_t width = 70;
+    uint32_t height = 9;
+    uint8_t *data = malloc(width * height * 3);
+    memset(data, 200, width * height * 3);
+    data[(2 * width + 23) * 3 + 1] = 0;
+    data[(4 * width + 17) * 3] = 0;
+    data[(6 * width + 51) * 3 + 2] = 0;
+    uint32_t left, top, trimmed_width, trimmed_height;
+    bool ok = fcv_trim_bounds(
+      width,
+      height,
+      3,
+      data,
+      0.0,
+      &left,
+      &top,
+      &trimmed_width,
+      &trimmed_height
+    );
+    if (!ok || left != 17 || top != 2 || trimmed_width != 35 ||
+        trimmed_height != 5) {
+      printf(
+        "❌ Trim test failed: bounds %ux%u+%u+%u instead of 35x5+17+2\n",
+        trimmed_width,
+        trimmed_height,
+        left,
+        top
+      );
+      test_ok = false;
+    }
+    free(data);
+  }
+
   if (test_ok) {
     printf("✅ Trim test passed\n");
     return 0;
@@ -2067,6 +3137,46 @@ int32_t test_fcv_binary_dilation_disk(void) {
     }
   }
 
+  // Test 4: Large radius keeps the exact disk shape
+  {
+    uint32_t width = 81;
+    uint32_t height = 81;
+    int32_t radius = 25;
+
+    uint8_t *data = calloc(width * height, 1);
+    if (data) {
+      data[40 * width + 40] = 255;
+      uint8_t const *result =
+        fcv_binary_dilation_disk(data, width, height, radius);
+      if (!result) {
+        printf("❌ Dilation test failed: NULL result for radius 25\n");
+        test_ok = false;
+      }
+      else {
+        double r_eff = radius + 0.5;
+        for (int32_t y = 0; y < (int32_t)height; y++) {
+          for (int32_t x = 0; x < (int32_t)width; x++) {
+            int32_t dx = x - 40;
+            int32_t dy = y - 40;
+            uint8_t expected = dx * dx + dy * dy <= r_eff * r_eff ? 255 : 0;
+            if (result[y * width + x] != expected) {
+              printf(
+                "❌ Dilation test failed: wrong disk shape at (%d, %d)\n",
+                x,
+                y
+              );
+              test_ok = false;
+              y = (int32_t)height;
+              break;
+            }
+          }
+        }
+        free((void *)result);
+      }
+      free(data);
+    }
+  }
+
   if (test_ok) {
     printf("✅ Binary dilation disk test passed\n");
     return 0;
@@ -2240,15 +3350,864 @@ int32_t test_fcv_binary_opening_disk(void) {
   }
 }
 
+int32_t test_fcv_binary_image(void) {
+  bool test_ok = true;
+
+  // Test 1: Pack/unpack round trip across a word boundary and counting
+  {
+    uint32_t width = 70;
+    uint32_t height = 3;
+    uint8_t data[210] = {0};
+    data[0] = 255;
+    data[63] = 255;
+    data[64] = 255;
+    data[69] = 255;
+    data[140] = 255;
+    data[150] = 128; // Gray is not white
+
+    FCVBinaryImage *packed = fcv_pack_binary(width, height, data);
+    if (!packed) {
+      printf("❌ Binary image test failed: NULL packed image\n");
+      return 1;
+    }
+
+    if (packed->stride != 2 || fcv_binary_count(packed) != 5) {
+      printf("❌ Binary image test failed: wrong stride or count\n");
+      test_ok = false;
+    }
+
+    uint8_t *unpacked = fcv_unpack_binary(packed);
+    for (uint32_t i = 0; unpacked && i < width * height; i++) {
+      uint8_t expected = data[i] == 255 ? 255 : 0;
+      if (unpacked[i] != expected) {
+        printf("❌ Binary image test failed: round trip at %u\n", i);
+        test_ok = false;
+        break;
+      }
+    }
+    free(unpacked);
+
+    // Test 2: Logic operations
+    FCVBinaryImage *other = fcv_binary_image_new(width, height);
+    other->data[0] = 0x3; // Pixels 0 and 1
+    FCVBinaryImage *and_img = fcv_binary_and(packed, other);
+    FCVBinaryImage *or_img = fcv_binary_or(packed, other);
+    FCVBinaryImage *xor_img = fcv_binary_xor(packed, other);
+    if (fcv_binary_count(and_img) != 1 || fcv_binary_count(or_img) != 6 ||
+        fcv_binary_count(xor_img) != 5) {
+      printf("❌ Binary image test failed: wrong AND/OR/XOR counts\n");
+      test_ok = false;
+    }
+    fcv_free_binary_image(and_img);
+    fcv_free_binary_image(or_img);
+    fcv_free_binary_image(xor_img);
+    fcv_free_binary_image(other);
+    fcv_free_binary_image(packed);
+  }
+
+  // Test 3: Packed morphology matches the byte implementation
+  {
+    uint32_t width = 100;
+    uint32_t height = 37;
+    uint8_t *data = malloc(width * height);
+    uint32_t seed = 42;
+    for (uint32_t i = 0; i < width * height; i++) {
+      seed = seed * 1103515245 + 12345;
+      data[i] = (seed >> 16) % 3 ? 255 : 0;
+    }
+
+    FCVBinaryImage *packed = fcv_pack_binary(width, height, data);
+    for (int32_t radius = 0; radius <= 7; radius++) {
+      uint8_t *expected[4] = {
+        fcv_binary_dilation_disk(data, width, height, radius),
+        fcv_binary_erosion_disk(data, width, height, radius),
+        fcv_binary_closing_disk(data, width, height, radius),
+        fcv_binary_opening_disk(data, width, height, radius),
+      };
+      FCVBinaryImage *results[4] = {
+        fcv_binary_dilation_disk_packed(packed, radius),
+        fcv_binary_erosion_disk_packed(packed, radius),
+        fcv_binary_closing_disk_packed(packed, radius),
+        fcv_binary_opening_disk_packed(packed, radius),
+      };
+
+      for (int op = 0; op < 4; op++) {
+        uint8_t *actual = fcv_unpack_binary(results[op]);
+        if (!actual || memcmp(actual, expected[op], width * height) != 0) {
+          printf(
+            "❌ Binary image test failed: packed morphology %d differs "
+            "(radius %d)\n",
+            op,
+            radius
+          );
+          test_ok = false;
+        }
+        free(actual);
+        free(expected[op]);
+        fcv_free_binary_image(results[op]);
+      }
+    }
+    fcv_free_binary_image(packed);
+    free(data);
+  }
+
+  if (test_ok) {
+    printf("✅ Binary image test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Binary image test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_distance_transform(void) {
+  bool test_ok = true;
+
+  // Test 1: Squared distances and nearest features match brute force
+  {
+    uint32_t width = 6;
+    uint32_t height = 4;
+    int pattern[24] = {
+      0, 0, 0, 0, 0, 0, //
+      0, 1, 0, 0, 0, 0, //
+      0, 0, 0, 0, 0, 1, //
+      0, 0, 0, 0, 0, 0, //
+    };
+    uint8_t *data = create_binary_image(pattern, width, height);
+    int64_t nearest[24];
+    int32_t *dist =
+      fcv_distance_transform_sq(width, height, data, true, nearest);
+    if (!dist) {
+      printf("❌ Distance transform test failed: NULL result\n");
+      free(data);
+      return 1;
+    }
+
+    for (int32_t y = 0; y < (int32_t)height; y++) {
+      for (int32_t x = 0; x < (int32_t)width; x++) {
+        int32_t d_a = (x - 1) * (x - 1) + (y - 1) * (y - 1);
+        int32_t d_b = (x - 5) * (x - 5) + (y - 2) * (y - 2);
+        int32_t expected = d_a < d_b ? d_a : d_b;
+        int32_t idx = y * (int32_t)width + x;
+        int32_t nx = (int32_t)(nearest[idx] % width);
+        int32_t ny = (int32_t)(nearest[idx] / width);
+        int32_t d_nearest = (x - nx) * (x - nx) + (y - ny) * (y - ny);
+        if (dist[idx] != expected || d_nearest != expected) {
+          printf("❌ Distance transform test failed at (%d, %d)\n", x, y);
+          test_ok = false;
+        }
+      }
+    }
+
+    free(dist);
+    free(data);
+  }
+
+  // Test 2: Euclidean distances to non-white pixels
+  {
+    uint8_t data[5] = {0, 255, 255, 255, 128};
+    float *dist = fcv_distance_transform(5, 1, data, false, NULL);
+    if (!dist || dist[0] != 0.0f || dist[1] != 1.0f || dist[2] != 2.0f ||
+        dist[3] != 1.0f || dist[4] != 0.0f) {
+      printf("❌ Distance transform test failed: wrong float distances\n");
+      test_ok = false;
+    }
+    free(dist);
+  }
+
+  // Test 3: No feature pixels
+  {
+    uint8_t data[4] = {0, 0, 0, 0};
+    int64_t nearest[4];
+    int32_t *dist = fcv_distance_transform_sq(2, 2, data, true, nearest);
+    if (!dist || dist[0] != INT32_MAX || nearest[3] != -1) {
+      printf("❌ Distance transform test failed: expected no features\n");
+      test_ok = false;
+    }
+    free(dist);
+  }
+
+  // Test 4: The passes in column and row chunks give the same result
+  {
+    uint32_t width = 9;
+    uint32_t height = 7;
+    uint8_t data[9 * 7];
+    for (uint32_t i = 0; i < width * height; i++) {
+      data[i] = (i * 37 + 11) % 5 == 0 ? 255 : 0;
+    }
+    int64_t expected_nearest[9 * 7];
+    int32_t *expected =
+      fcv_distance_transform_sq(width, height, data, true, expected_nearest);
+    int32_t dist[9 * 7];
+    int64_t nearest[9 * 7];
+    bool ok = true;
+    for (uint32_t x = 0; x < width; x += 4) {
+      uint32_t x_end = x + 4 < width ? x + 4 : width;
+      ok = ok && fcv_distance_transform_columns(
+                   width,
+                   height,
+                   data,
+                   true,
+                   x,
+                   x_end,
+                   dist,
+                   nearest
+                 );
+    }
+    for (uint32_t y = 0; y < height; y += 3) {
+      uint32_t y_end = y + 3 < height ? y + 3 : height;
+      ok = ok && fcv_distance_transform_rows(
+                   width,
+                   height,
+                   y,
+                   y_end,
+                   dist,
+                   nearest
+                 );
+    }
+    if (!expected || !ok || memcmp(dist, expected, sizeof(dist)) != 0 ||
+        memcmp(nearest, expected_nearest, sizeof(nearest)) != 0) {
+      printf("❌ Distance transform test failed: chunked passes differ\n");
+      test_ok = false;
+    }
+    if (fcv_distance_transform_rows(width, height, 5, 8, dist, NULL)) {
+      printf("❌ Distance transform test failed: invalid row range\n");
+      test_ok = false;
+    }
+    free(expected);
+  }
+
+  if (test_ok) {
+    printf("✅ Distance transform test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Distance transform test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_grayscale_morphology(void) {
+  bool test_ok = true;
+  int32_t width = 23;
+  int32_t height = 17;
+  uint8_t data[23 * 17];
+  uint32_t seed = 12345;
+  for (int32_t i = 0; i < width * height; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (uint8_t)(seed >> 16);
+  }
+
+  // Test 1: Rectangle erosion and dilation match brute force
+  int32_t kernels[4][2] = {{1, 1}, {3, 5}, {8, 2}, {40, 40}};
+  for (int32_t k = 0; k < 4; k++) {
+    int32_t kw = kernels[k][0];
+    int32_t kh = kernels[k][1];
+    uint8_t *eroded = fcv_grayscale_erosion_rect(data, width, height, kw, kh);
+    uint8_t *dilated =
+      fcv_grayscale_dilation_rect(data, width, height, kw, kh);
+    if (!eroded || !dilated) {
+      printf("❌ Grayscale morphology test failed: NULL result\n");
+      free(eroded);
+      free(dilated);
+      return 1;
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+      for (int32_t x = 0; x < width; x++) {
+        uint8_t min = 255;
+        uint8_t max = 0;
+        for (int32_t dy = -(kh - 1) / 2; dy <= kh / 2; dy++) {
+          for (int32_t dx = -(kw - 1) / 2; dx <= kw / 2; dx++) {
+            int32_t nx = x + dx;
+            int32_t ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+              continue;
+            }
+            uint8_t v = data[ny * width + nx];
+            min = v < min ? v : min;
+            max = v > max ? v : max;
+          }
+        }
+        if (eroded[y * width + x] != min || dilated[y * width + x] != max) {
+          printf(
+            "❌ Grayscale morphology test failed: %dx%d rect at (%d, %d)\n",
+            kw,
+            kh,
+            x,
+            y
+          );
+          test_ok = false;
+        }
+      }
+    }
+
+    free(eroded);
+    free(dilated);
+  }
+
+  // Test 2: Disk erosion matches brute force for small radii
+  for (int32_t r = 0; r <= 4; r++) {
+    uint8_t *eroded = fcv_grayscale_erosion_disk(data, width, height, r);
+    if (!eroded) {
+      printf("❌ Grayscale morphology test failed: NULL result\n");
+      return 1;
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+      for (int32_t x = 0; x < width; x++) {
+        uint8_t min = 255;
+        for (int32_t dy = -r; dy <= r; dy++) {
+          for (int32_t dx = -r; dx <= r; dx++) {
+            int32_t nx = x + dx;
+            int32_t ny = y + dy;
+            if (dx * dx + dy * dy > r * r + r || nx < 0 || ny < 0 ||
+                nx >= width || ny >= height) {
+              continue;
+            }
+            uint8_t v = data[ny * width + nx];
+            min = v < min ? v : min;
+          }
+        }
+        if (eroded[y * width + x] != min) {
+          printf(
+            "❌ Grayscale morphology test failed: disk r=%d at (%d, %d)\n",
+            r,
+            x,
+            y
+          );
+          test_ok = false;
+        }
+      }
+    }
+
+    free(eroded);
+  }
+
+  // Test 3: Top-hats extract small spots and ignore the background
+  {
+    uint8_t spots[9 * 9];
+    memset(spots, 100, sizeof(spots));
+    spots[4 * 9 + 4] = 200;
+    spots[2 * 9 + 6] = 20;
+
+    uint8_t *white = fcv_white_top_hat_disk(spots, 9, 9, 2);
+    uint8_t *black = fcv_black_top_hat_disk(spots, 9, 9, 2);
+    if (!white || !black || white[4 * 9 + 4] != 100 || white[0] != 0 ||
+        black[2 * 9 + 6] != 80 || black[0] != 0) {
+      printf("❌ Grayscale morphology test failed: wrong top-hat\n");
+      test_ok = false;
+    }
+    free(white);
+    free(black);
+  }
+
+  if (test_ok) {
+    printf("✅ Grayscale morphology test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Grayscale morphology test failed\n");
+    return 1;
+  }
+}
+
+/**
+ * Encode the image as PNG and check that it decodes to the same pixels.
+ * Stores the color type and bit depth from the IHDR chunk.
+ */
+static bool png_round_trips(
+  uint32_t width,
+  uint32_t height,
+  uint32_t channels,
+  uint8_t const *data,
+  FCVPngOptions const *options,
+  uint8_t *color_type,
+  uint8_t *bit_depth
+) {
+  size_t size;
+  uint8_t *png = fcv_encode_png(width, height, channels, data, options, &size);
+  if (!png) {
+    return false;
+  }
+  *bit_depth = png[24];
+  *color_type = png[25];
+
+  int32_t decoded_width, decoded_height, decoded_channels;
+  uint8_t *decoded = stbi_load_from_memory(
+    png,
+    (int32_t)size,
+    &decoded_width,
+    &decoded_height,
+    &decoded_channels,
+    (int32_t)channels
+  );
+  free(png);
+
+  bool matches = decoded && decoded_width == (int32_t)width &&
+                 decoded_height == (int32_t)height &&
+                 memcmp(decoded, data, width * height * channels) == 0;
+  stbi_image_free(decoded);
+  return matches;
+}
+
+int32_t test_fcv_encode_png(void) {
+  bool test_ok = true;
+  uint32_t width = 37;
+  uint32_t height = 23;
+  uint8_t *image = malloc(width * height * 4);
+  uint8_t color_type, bit_depth;
+
+  // Test 1: A black and white page is written as 1-bit grayscale
+  for (uint32_t i = 0; i < width * height; i++) {
+    uint8_t value = (i / 5 + i / width) % 3 ? 255 : 0;
+    memset(image + i * 4, value, 3);
+    image[i * 4 + 3] = 255;
+  }
+  bool round_trips =
+    png_round_trips(width, height, 4, image, NULL, &color_type, &bit_depth);
+  if (!round_trips || color_type != 0 || bit_depth != 1) {
+    printf("❌ Encode PNG test failed: binary image\n");
+    test_ok = false;
+  }
+
+  // Test 2: Keeping the format writes RGBA
+  FCVPngOptions options = fcv_png_default_options();
+  options.reduce = false;
+  round_trips =
+    png_round_trips(width, height, 4, image, &options, &color_type, &bit_depth);
+  if (!round_trips || color_type != 6 || bit_depth != 8) {
+    printf("❌ Encode PNG test failed: kept format\n");
+    test_ok = false;
+  }
+
+  // Test 3: Few colors with transparency use a palette
+  uint8_t const colors[3][4] = {
+    {255, 0, 0, 255},
+    {0, 0, 255, 128},
+    {9, 9, 9, 0},
+  };
+  for (uint32_t i = 0; i < width * height; i++) {
+    memcpy(image + i * 4, colors[(i / 3 + i / width) % 3], 4);
+  }
+  round_trips =
+    png_round_trips(width, height, 4, image, NULL, &color_type, &bit_depth);
+  if (!round_trips || color_type != 3 || bit_depth != 2) {
+    printf("❌ Encode PNG test failed: palette image\n");
+    test_ok = false;
+  }
+
+  // Test 4: Noisy images round-trip with every level and filter
+  uint32_t state = 7;
+  for (uint32_t i = 0; i < width * height * 4; i++) {
+    state = state * 1103515245 + 12345;
+    image[i] = i % 97 < 40 ? (uint8_t)(i / 4 % 7) : (uint8_t)(state >> 24);
+  }
+  for (int32_t level = 0; level <= 9; level++) {
+    for (int32_t filter = 0; filter <= FCV_PNG_FILTER_ADAPTIVE; filter++) {
+      options.level = level;
+      options.filter = (FCVPngFilter)filter;
+      for (uint32_t channels = 1; channels <= 4; channels++) {
+        if (!png_round_trips(
+              width,
+              height,
+              channels,
+              image,
+              &options,
+              &color_type,
+              &bit_depth
+            )) {
+          printf(
+            "❌ Encode PNG test failed: level %d, filter %d, %u channels\n",
+            level,
+            filter,
+            channels
+          );
+          test_ok = false;
+        }
+      }
+    }
+  }
+
+  free(image);
+
+  // Test 5: Parts compressed in any order give the same PNG
+  // as encoding in one go
+  {
+    uint32_t big_width = 400;
+    uint32_t big_height = 300;
+    uint8_t *big = malloc(big_width * big_height * 4);
+    for (uint32_t i = 0; i < big_width * big_height * 4; i++) {
+      state = state * 1103515245 + 12345;
+      big[i] = (i / 4) % big_width < 200 ? (uint8_t)(i / 4 / big_width)
+                                           : (uint8_t)(state >> 28);
+    }
+
+    uint32_t num_parts;
+    FCVPngEncoder *encoder =
+      fcv_png_encoder_create(big_width, big_height, 4, big, NULL, &num_parts);
+    for (uint32_t i = num_parts; i > 0; i--) {
+      fcv_png_encoder_compress(encoder, i - 1);
+    }
+    size_t size, expected_size;
+    uint8_t *png = fcv_png_encoder_finish(encoder, &size);
+    uint8_t *expected =
+      fcv_encode_png(big_width, big_height, 4, big, NULL, &expected_size);
+    round_trips = png_round_trips(
+      big_width,
+      big_height,
+      4,
+      big,
+      NULL,
+      &color_type,
+      &bit_depth
+    );
+    if (num_parts < 2 || !png || !expected || size != expected_size ||
+        memcmp(png, expected, size) != 0 || !round_trips) {
+      printf("❌ Encode PNG test failed: parts\n");
+      test_ok = false;
+    }
+    free(png);
+    free(expected);
+    free(big);
+  }
+
+  // Test 6: A higher level never gives a larger file for a photo-like
+  // image (noisy gradients) with a few repeated patterns
+  {
+    uint32_t photo_width = 256;
+    uint32_t photo_height = 192;
+    uint8_t *photo = malloc(photo_width * photo_height * 3);
+    for (uint32_t y = 0; y < photo_height; y++) {
+      for (uint32_t x = 0; x < photo_width; x++) {
+        for (uint32_t c = 0; c < 3; c++) {
+          state = state * 1103515245 + 12345;
+          uint32_t value = (x + y) / 2 + c * 20 + (state >> 29);
+          if (y % 32 < 8 && x % 24 < 12) {
+            value = (x % 24) * 20 + y % 32;
+          }
+          photo[(y * photo_width + x) * 3 + c] = (uint8_t)value;
+        }
+      }
+    }
+
+    size_t previous_size = SIZE_MAX;
+    for (int32_t level = 1; level <= 9; level++) {
+      FCVPngOptions photo_options = fcv_png_default_options();
+      photo_options.level = level;
+      size_t size;
+      uint8_t *png = fcv_encode_png(
+        photo_width,
+        photo_height,
+        3,
+        photo,
+        &photo_options,
+        &size
+      );
+      if (!png || size > previous_size) {
+        printf(
+          "❌ Encode PNG test failed: level %d gives %zu > %zu bytes\n",
+          level,
+          size,
+          previous_size
+        );
+        test_ok = false;
+      }
+      previous_size = size;
+      free(png);
+    }
+    free(photo);
+  }
+
+  if (test_ok) {
+    printf("✅ Encode PNG test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Encode PNG test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_rgb_to_grayscale_in_place(void) {
+  uint32_t width = 13;
+  uint32_t height = 7;
+  size_t num_pixels = (size_t)width * height;
+  uint8_t *rgb = malloc(num_pixels * 3);
+  uint8_t *rgba = malloc(num_pixels * 4);
+  for (size_t i = 0; i < num_pixels; i++) {
+    for (size_t c = 0; c < 3; c++) {
+      rgb[i * 3 + c] = (uint8_t)(i * 37 + c * 101 + i * i);
+      rgba[i * 4 + c] = rgb[i * 3 + c];
+    }
+    rgba[i * 4 + 3] = 255;
+  }
+
+  // The gray pixels are the same as from fcv_rgba_to_grayscale
+  uint8_t *expected = fcv_rgba_to_grayscale(width, height, rgba);
+  fcv_rgb_to_grayscale_in_place(width, height, rgb);
+  int32_t test_ok = expected && memcmp(rgb, expected, num_pixels) == 0;
+
+  free(expected);
+  free(rgba);
+  free(rgb);
+
+  if (test_ok) {
+    printf("✅ RGB to grayscale in place test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ RGB to grayscale in place test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_encode_jpeg_gray(void) {
+  bool test_ok = true;
+  uint32_t width = 45;
+  uint32_t height = 19;
+  uint8_t *image = malloc(width * height * 4);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t *pixel = image + (y * width + x) * 4;
+      memset(pixel, (int32_t)(x * 5 + y * 2), 3);
+      pixel[3] = 255;
+    }
+  }
+
+  size_t size;
+  uint8_t *jpeg = fcv_encode_jpeg_gray(width, height, 4, image, 95, &size);
+  int32_t decoded_width, decoded_height, decoded_channels;
+  uint8_t *decoded = jpeg ? stbi_load_from_memory(
+                              jpeg,
+                              (int32_t)size,
+                              &decoded_width,
+                              &decoded_height,
+                              &decoded_channels,
+                              1
+                            )
+                          : NULL;
+
+  // Test 1: The file has a single component
+  if (!decoded || decoded_width != (int32_t)width ||
+      decoded_height != (int32_t)height || decoded_channels != 1) {
+    printf("❌ Encode JPEG gray test failed: not a gray JPEG\n");
+    test_ok = false;
+  }
+  else {
+    // Test 2: A smooth gradient is reproduced closely,
+    // including the partial blocks at the edges
+    uint32_t max_error = 0;
+    for (uint32_t i = 0; i < width * height; i++) {
+      uint32_t error = (uint32_t)abs(decoded[i] - image[i * 4]);
+      max_error = error > max_error ? error : max_error;
+    }
+    if (max_error > 6) {
+      printf(
+        "❌ Encode JPEG gray test failed: max error %u is too large\n",
+        max_error
+      );
+      test_ok = false;
+    }
+  }
+  stbi_image_free(decoded);
+  free(jpeg);
+
+  // Test 3: Invalid quality is rejected
+  if (fcv_encode_jpeg_gray(width, height, 4, image, 0, &size) ||
+      fcv_encode_jpeg_gray(width, height, 4, image, 101, &size)) {
+    printf("❌ Encode JPEG gray test failed: invalid quality accepted\n");
+    test_ok = false;
+  }
+  free(image);
+
+  if (test_ok) {
+    printf("✅ Encode JPEG gray test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Encode JPEG gray test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_encode_qoi(void) {
+  bool test_ok = true;
+
+  // Test 1: Two equal pixels matching the start pixel are a single run
+  uint8_t black[8] = {0, 0, 0, 255, 0, 0, 0, 255};
+  uint8_t expected[] =
+    {'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 1, 4, 0, 0xC1, 0, 0, 0, 0, 0,
+     0, 0, 1};
+  size_t size;
+  uint8_t *qoi = fcv_encode_qoi(2, 1, 4, black, &size);
+  if (!qoi || size != sizeof(expected) || memcmp(qoi, expected, size) != 0) {
+    printf("❌ Encode QOI test failed: unexpected encoding of a run\n");
+    test_ok = false;
+  }
+  free(qoi);
+
+  // Test 2: Round trip of an image that uses all operations
+  // (long runs, small and large differences, alpha changes, index hits)
+  uint32_t width = 97;
+  uint32_t height = 13;
+  uint8_t *image = malloc(width * height * 4);
+  for (uint32_t i = 0; i < width * height; i++) {
+    uint8_t *pixel = image + i * 4;
+    uint32_t x = i % width;
+    pixel[0] = (uint8_t)(x < 70 ? 10 : i * 7);
+    pixel[1] = (uint8_t)(x < 70 ? 20 : i * 3 + (i % 5));
+    pixel[2] = (uint8_t)(x < 70 ? 30 : i * 11);
+    pixel[3] = (uint8_t)(x % 17 == 0 ? 128 : 255);
+  }
+
+  for (uint32_t channels = 3; channels <= 4; channels++) {
+    uint8_t *input = malloc(width * height * channels);
+    for (uint32_t i = 0; i < width * height; i++) {
+      memcpy(input + i * channels, image + i * 4, channels);
+    }
+    qoi = fcv_encode_qoi(width, height, channels, input, &size);
+    uint32_t decoded_width = 0, decoded_height = 0, decoded_channels = 0;
+    uint8_t *decoded = qoi ? fcv_decode_qoi(
+                               qoi,
+                               size,
+                               &decoded_width,
+                               &decoded_height,
+                               &decoded_channels
+                             )
+                           : NULL;
+    bool is_equal = decoded && decoded_width == width &&
+                    decoded_height == height && decoded_channels == channels;
+    for (uint32_t i = 0; is_equal && i < width * height; i++) {
+      is_equal = memcmp(decoded + i * 4, input + i * channels, channels) == 0 &&
+                 (channels == 4 || decoded[i * 4 + 3] == 255);
+    }
+    if (!is_equal) {
+      printf("❌ Encode QOI test failed: %u channel round trip\n", channels);
+      test_ok = false;
+    }
+
+    // Test 3: Truncated files are rejected
+    if (qoi && fcv_decode_qoi(
+                 qoi,
+                 size / 2,
+                 &decoded_width,
+                 &decoded_height,
+                 &decoded_channels
+               )) {
+      printf("❌ Encode QOI test failed: truncated file accepted\n");
+      test_ok = false;
+    }
+    free(decoded);
+    free(qoi);
+    free(input);
+  }
+  free(image);
+
+  if (test_ok) {
+    printf("✅ Encode QOI test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Encode QOI test failed\n");
+    return 1;
+  }
+}
+
+int32_t test_fcv_netpbm(void) {
+  bool test_ok = true;
+  uint32_t width, height, channels;
+
+  // Test 1: PGM with comments and 16-bit samples
+  uint8_t pgm[] = "P5 # comment\n2 # width\n1\n1000\n\x03\xE8\x01\xF4";
+  uint8_t *decoded =
+    fcv_decode_netpbm(pgm, sizeof(pgm) - 1, &width, &height, &channels);
+  if (!decoded || width != 2 || height != 1 || channels != 1 ||
+      memcmp(decoded, "\xFF\xFF\xFF\xFF\x80\x80\x80\xFF", 8) != 0) {
+    printf("❌ Netpbm test failed: 16-bit PGM not decoded correctly\n");
+    test_ok = false;
+  }
+  free(decoded);
+
+  // Test 2: PAM header with the samples right after ENDHDR
+  uint8_t pam[] = "P7\nWIDTH 1\nHEIGHT 2\nDEPTH 2\nMAXVAL 255\n"
+                  "TUPLTYPE GRAYSCALE_ALPHA\nENDHDR\n\x10\x20\x30\x40";
+  FCVNetpbmInfo info;
+  if (!fcv_netpbm_info(pam, sizeof(pam) - 1, &info) ||
+      info.format != FCV_NETPBM_PAM || info.width != 1 || info.height != 2 ||
+      info.channels != 2 || info.maxval != 255 ||
+      info.data_offset != sizeof(pam) - 5) {
+    printf("❌ Netpbm test failed: PAM header not parsed correctly\n");
+    test_ok = false;
+  }
+
+  // Test 3: Round trips and conversions of an RGBA image
+  uint8_t image[] =
+    {255, 0, 0, 255, 0, 255, 0, 128, 0, 0, 255, 0, 10, 20, 30, 40};
+  FCVNetpbmFormat formats[] = {FCV_NETPBM_PGM, FCV_NETPBM_PPM, FCV_NETPBM_PAM};
+  for (uint32_t f = 0; f < 3; f++) {
+    size_t size;
+    uint8_t *file = fcv_encode_netpbm(2, 2, 4, image, formats[f], &size);
+    decoded =
+      file ? fcv_decode_netpbm(file, size, &width, &height, &channels) : NULL;
+    bool is_ok = decoded && width == 2 && height == 2;
+    for (uint32_t i = 0; is_ok && i < 4; i++) {
+      uint8_t const *src = image + i * 4;
+      uint8_t gray =
+        (src[0] * R_WEIGHT + src[1] * G_WEIGHT + src[2] * B_WEIGHT) >> 8;
+      uint8_t expected[4] = {src[0], src[1], src[2], 255};
+      if (formats[f] == FCV_NETPBM_PGM) {
+        memset(expected, gray, 3);
+      }
+      if (formats[f] == FCV_NETPBM_PAM) {
+        expected[3] = src[3];
+      }
+      is_ok = memcmp(decoded + i * 4, expected, 4) == 0;
+    }
+    if (!is_ok) {
+      printf("❌ Netpbm test failed: round trip of format %u\n", f);
+      test_ok = false;
+    }
+    free(decoded);
+    free(file);
+  }
+
+  // Test 4: Truncated and invalid files are rejected
+  if (fcv_decode_netpbm(pgm, sizeof(pgm) - 2, &width, &height, &channels) ||
+      fcv_netpbm_info((uint8_t const *)"P6\n0 1\n255\n", 11, &info) ||
+      fcv_netpbm_info((uint8_t const *)"P7\nWIDTH 1\nENDHDR\n", 18, &info)) {
+    printf("❌ Netpbm test failed: invalid file accepted\n");
+    test_ok = false;
+  }
+
+  if (test_ok) {
+    printf("✅ Netpbm test passed\n");
+    return 0;
+  }
+  else {
+    printf("❌ Netpbm test failed\n");
+    return 1;
+  }
+}
+
 int32_t main(void) {
   if (!test_otsu_threshold() && !test_perspective_transform() &&
-      !test_perspective_transform_float() && !test_fcv_foerstner_corner() &&
+      !test_perspective_transform_float() && !test_apply_matrix_3x3() &&
+      !test_fcv_remap() && !test_fcv_rotate_angle() &&
+      !test_fcv_estimate_skew() && !test_fcv_foerstner_corner() &&
       !test_fcv_corner_peaks() && !test_fcv_binary_closing_disk() &&
       !test_fcv_binary_dilation_disk() && !test_fcv_binary_erosion_disk() &&
-      !test_fcv_binary_opening_disk() && !test_fcv_trim() &&
-      !test_fcv_trim_threshold() && !test_fcv_histogram() &&
+      !test_fcv_binary_opening_disk() && !test_fcv_binary_image() &&
+      !test_fcv_distance_transform() && !test_fcv_grayscale_morphology() &&
+      !test_fcv_trim() && !test_fcv_trim_threshold() && !test_fcv_histogram() &&
       !test_fcv_add_border() && !test_sort_corners() &&
-      !test_exif_orientation() && !test_transformations()) {
+      !test_exif_orientation() && !test_transformations() &&
+      !test_fcv_transpose_tiled() && !test_fcv_flip_in_place() &&
+      !test_fcv_rgb_to_grayscale_in_place() && !test_fcv_into_variants() &&
+      !test_fcv_pipeline() && !test_fcv_encode_png() &&
+      !test_fcv_encode_jpeg_gray() && !test_fcv_encode_qoi() &&
+      !test_fcv_netpbm()) {
     printf("✅ All tests passed\n");
     return 0;
   }